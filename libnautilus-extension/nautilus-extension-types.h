@@ -79,6 +79,18 @@ GType nautilus_operation_result_get_type (void);
  * @include: libnautilus-extension/nautilus-extension-types.h
  *
  * Methods that each extension implements.
+ *
+ * Extensions that only implement #NautilusInfoProvider,
+ * #NautilusMenuProvider and #NautilusColumnProvider can ask to be run in
+ * a separate process, where a crash or a slow call cannot take the file
+ * manager down with it. They do so by installing a key file next to the
+ * module, named like it but with a “.nautilus-extension” suffix instead
+ * of the module suffix, for instance libnautilus-foo.nautilus-extension
+ * next to libnautilus-foo.so, containing:
+ * |[
+ * [Nautilus Extension]
+ * ExtensionHost=true
+ * ]|
  */
 
 void nautilus_module_initialize (GTypeModule  *module);
@@ -103,6 +103,59 @@ nautilus_info_provider_cancel_update (NautilusInfoProvider    *provider,
                                                                 handle);
 }
 
+/**
+ * nautilus_info_provider_supports_batch:
+ * @provider: a #NautilusInfoProvider
+ *
+ * Returns: %TRUE if @provider implements
+ * nautilus_info_provider_update_file_info_batch().
+ */
+gboolean
+nautilus_info_provider_supports_batch (NautilusInfoProvider *provider)
+{
+    g_return_val_if_fail (NAUTILUS_IS_INFO_PROVIDER (provider), FALSE);
+
+    return NAUTILUS_INFO_PROVIDER_GET_IFACE (provider)->update_file_info_batch != NULL;
+}
+
+/**
+ * nautilus_info_provider_update_file_info_batch:
+ * @provider: a #NautilusInfoProvider
+ * @files: (element-type NautilusFileInfo): the files to update
+ * @update_complete: the closure to invoke once the whole batch is done
+ * @handle: (out): an opaque handle for the operation
+ *
+ * Like nautilus_info_provider_update_file_info(), but for several files
+ * at once. Providers that can answer for many files with one query (a
+ * version control status, say) should implement this; Nautilus falls
+ * back to nautilus_info_provider_update_file_info() for those that
+ * don't.
+ *
+ * If the provider returns %NAUTILUS_OPERATION_IN_PROGRESS, it must invoke
+ * @update_complete exactly once, after all of @files have been updated.
+ * Any entry of @files may be %NULL if the file went away in the meantime
+ * and must then be skipped.
+ *
+ * Returns: a #NautilusOperationResult
+ */
+NautilusOperationResult
+nautilus_info_provider_update_file_info_batch (NautilusInfoProvider     *provider,
+                                               GList                    *files,
+                                               GClosure                 *update_complete,
+                                               NautilusOperationHandle **handle)
+{
+    g_return_val_if_fail (NAUTILUS_IS_INFO_PROVIDER (provider),
+                          NAUTILUS_OPERATION_FAILED);
+    g_return_val_if_fail (NAUTILUS_INFO_PROVIDER_GET_IFACE (provider)->update_file_info_batch != NULL,
+                          NAUTILUS_OPERATION_FAILED);
+    g_return_val_if_fail (update_complete != NULL,
+                          NAUTILUS_OPERATION_FAILED);
+    g_return_val_if_fail (handle != NULL, NAUTILUS_OPERATION_FAILED);
+
+    return NAUTILUS_INFO_PROVIDER_GET_IFACE (provider)->update_file_info_batch
+               (provider, files, update_complete, handle);
+}
+
 void
 nautilus_info_provider_update_complete_invoke (GClosure                *update_complete,
                                                NautilusInfoProvider    *provider,
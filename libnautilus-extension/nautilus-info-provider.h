@@ -54,6 +54,8 @@ typedef void (*NautilusInfoProviderUpdateComplete) (NautilusInfoProvider    *pro
  *   See nautilus_info_provider_update_file_info() for details.
  * @cancel_update: Cancels a previous call to nautilus_info_provider_update_file_info().
  *   See nautilus_info_provider_cancel_update() for details.
+ * @update_file_info_batch: Optional. Returns a #NautilusOperationResult.
+ *   See nautilus_info_provider_update_file_info_batch() for details.
  *
  * Interface for extensions to provide additional information about files.
  */
@@ -66,6 +68,10 @@ struct _NautilusInfoProviderIface {
 						     NautilusOperationHandle **handle);
 	void                    (*cancel_update)    (NautilusInfoProvider     *provider,
 						     NautilusOperationHandle  *handle);
+	NautilusOperationResult (*update_file_info_batch) (NautilusInfoProvider     *provider,
+							   GList                    *files,
+							   GClosure                 *update_complete,
+							   NautilusOperationHandle **handle);
 };
 
 /* Interface Functions */
@@ -76,6 +82,11 @@ NautilusOperationResult nautilus_info_provider_update_file_info       (NautilusI
 								       NautilusOperationHandle **handle);
 void                    nautilus_info_provider_cancel_update          (NautilusInfoProvider     *provider,
 								       NautilusOperationHandle  *handle);
+gboolean                nautilus_info_provider_supports_batch         (NautilusInfoProvider     *provider);
+NautilusOperationResult nautilus_info_provider_update_file_info_batch (NautilusInfoProvider     *provider,
+								       GList                    *files,
+								       GClosure                 *update_complete,
+								       NautilusOperationHandle **handle);
 
 
 
@@ -44,10 +44,12 @@
 #include "nautilus-file-utilities.h"
 #include "nautilus-file-operations.h"
 #include "nautilus-global-preferences.h"
+#include "nautilus-keyfile-metadata.h"
 #include "nautilus-lib-self-check-functions.h"
 #include "nautilus-module.h"
 #include "nautilus-profile.h"
 #include "nautilus-signaller.h"
+#include "nautilus-thumbnails.h"
 #include "nautilus-ui-utilities.h"
 #include <libnautilus-extension/nautilus-menu-provider.h>
 
@@ -131,24 +133,44 @@ nautilus_application_get_bookmarks (NautilusApplication *self)
     return priv->bookmark_list;
 }
 
-static gboolean
-check_required_directories (NautilusApplication *self)
+static void
+check_required_directories_thread (GTask        *task,
+                                   gpointer      source_object,
+                                   gpointer      task_data,
+                                   GCancellable *cancellable)
 {
     char *user_directory;
-    GSList *directories;
-    gboolean ret;
-
-    g_assert (NAUTILUS_IS_APPLICATION (self));
 
     nautilus_profile_start (NULL);
 
-    ret = TRUE;
-
+    /* Creates the directory if it is missing */
     user_directory = nautilus_get_user_directory ();
 
+    if (g_file_test (user_directory, G_FILE_TEST_IS_DIR))
+    {
+        g_clear_pointer (&user_directory, g_free);
+    }
+
+    nautilus_profile_end (NULL);
+
+    g_task_return_pointer (task, user_directory, g_free);
+}
+
+static void
+check_required_directories_done (GObject      *source_object,
+                                 GAsyncResult *res,
+                                 gpointer      user_data)
+{
+    NautilusApplication *self;
+    char *user_directory;
+    GSList *directories;
+
+    self = NAUTILUS_APPLICATION (source_object);
+    user_directory = g_task_propagate_pointer (G_TASK (res), NULL);
+
     directories = NULL;
 
-    if (!g_file_test (user_directory, G_FILE_TEST_IS_DIR))
+    if (user_directory != NULL)
     {
         directories = g_slist_prepend (directories, user_directory);
     }
@@ -162,8 +184,6 @@ check_required_directories (NautilusApplication *self)
         const char *detail_string;
         GtkDialog *dialog;
 
-        ret = FALSE;
-
         failed_count = g_slist_length (directories);
 
         directories_as_string = g_string_new ((const char *) directories->data);
@@ -198,9 +218,22 @@ check_required_directories (NautilusApplication *self)
 
     g_slist_free (directories);
     g_free (user_directory);
-    nautilus_profile_end (NULL);
+}
 
-    return ret;
+/* Check the user's .nautilus directories and post warnings
+ * if there are problems. The check touches the disk, so it runs in
+ * a worker and reports back whenever it is done.
+ */
+static void
+check_required_directories (NautilusApplication *self)
+{
+    GTask *task;
+
+    g_assert (NAUTILUS_IS_APPLICATION (self));
+
+    task = g_task_new (self, NULL, check_required_directories_done, NULL);
+    g_task_run_in_thread (task, check_required_directories_thread);
+    g_object_unref (task);
 }
 
 static void
@@ -224,6 +257,10 @@ menu_provider_init_callback (void)
     {
         NautilusMenuProvider *provider = NAUTILUS_MENU_PROVIDER (l->data);
 
+        /* Providers seen before are connected already */
+        g_signal_handlers_disconnect_by_func (provider,
+                                              menu_provider_items_updated_handler,
+                                              NULL);
         g_signal_connect_after (G_OBJECT (provider), "items-updated",
                                 (GCallback) menu_provider_items_updated_handler,
                                 NULL);
@@ -232,6 +269,52 @@ menu_provider_init_callback (void)
     nautilus_module_extension_list_free (providers);
 }
 
+static void
+extension_quarantined (const char *extension_name,
+                       gpointer    user_data)
+{
+    NautilusApplication *self = user_data;
+    GNotification *notification;
+    char *body;
+    char *id;
+
+    notification = g_notification_new (_("An extension was turned off"));
+    body = g_strdup_printf (_("“%s” kept making Files unresponsive. It will "
+                              "stay off until Files is restarted."),
+                            extension_name);
+    g_notification_set_body (notification, body);
+
+    id = g_strconcat ("extension-quarantined-", extension_name, NULL);
+    nautilus_application_send_notification (self, id, notification);
+
+    g_free (id);
+    g_free (body);
+    g_object_unref (notification);
+}
+
+static gboolean
+menu_provider_init_idle (gpointer user_data)
+{
+    menu_provider_init_callback ();
+
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean first_window_created = FALSE;
+
+/* Time to first window, as measured by test/benchmark-startup.sh */
+static gboolean
+first_window_map_event (GtkWidget *widget,
+                        GdkEvent  *event,
+                        gpointer   user_data)
+{
+    nautilus_profile_msg ("First window mapped");
+
+    g_signal_handlers_disconnect_by_func (widget, first_window_map_event, user_data);
+
+    return GDK_EVENT_PROPAGATE;
+}
+
 NautilusWindow *
 nautilus_application_create_window (NautilusApplication *self,
                                     GdkScreen           *screen)
@@ -278,6 +361,13 @@ nautilus_application_create_window (NautilusApplication *self,
     }
     g_free (geometry_string);
 
+    if (n_windows == 0 && !first_window_created)
+    {
+        first_window_created = TRUE;
+        g_signal_connect (window, "map-event",
+                          G_CALLBACK (first_window_map_event), NULL);
+    }
+
     DEBUG ("Creating a new navigation window");
     nautilus_profile_end (NULL);
 
@@ -647,6 +737,14 @@ do_cmdline_sanity_checks (NautilusApplication *self,
         goto out;
     }
 
+    if (g_variant_dict_contains (options, "generate-thumbnails") &&
+        !g_variant_dict_contains (options, G_OPTION_REMAINING))
+    {
+        g_printerr ("%s\n",
+                    _("--generate-thumbnails must be used with at least an URI."));
+        goto out;
+    }
+
     retval = TRUE;
 
 out:
@@ -931,6 +1029,8 @@ const GOptionEntry options[] =
       N_("Quit Nautilus."), NULL },
     { "select", 's', 0, G_OPTION_ARG_NONE, NULL,
       N_("Select specified URI in parent folder."), NULL },
+    { "generate-thumbnails", '\0', 0, G_OPTION_ARG_NONE, NULL,
+      N_("Generate missing thumbnails for all files under the specified folders."), NULL },
     { G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_STRING_ARRAY, NULL, NULL, N_("[URI…]") },
 
     { NULL }
@@ -1006,6 +1106,13 @@ nautilus_application_handle_file_args (NautilusApplication *self,
     {
         nautilus_application_select (self, files, len);
     }
+    else if (g_variant_dict_contains (options, "generate-thumbnails"))
+    {
+        for (idx = 0; idx < len; idx++)
+        {
+            nautilus_thumbnail_pregenerate (files[idx]);
+        }
+    }
     else
     {
         /* Create new windows */
@@ -1214,6 +1321,7 @@ on_application_shutdown (GApplication *application,
     g_list_free (notification_ids);
 
     nautilus_icon_info_clear_caches ();
+    nautilus_keyfile_metadata_shutdown ();
 }
 
 void
@@ -1241,20 +1349,24 @@ nautilus_application_startup_common (NautilusApplication *self)
     /* register property pages */
     nautilus_image_properties_page_register ();
 
-    /* initialize nautilus modules */
-    nautilus_profile_start ("Modules");
-    nautilus_module_setup ();
-    nautilus_profile_end ("Modules");
-
-    /* attach menu-provider module callback */
-    menu_provider_init_callback ();
+    /* Disk-bound setup runs in workers alongside the rest of startup;
+     * none of it is needed to put the first window up. A window asking
+     * for extensions before the modules are set up makes do with the
+     * built-in ones until "extensions-loaded". */
+    nautilus_module_setup_in_background ();
+    nautilus_module_set_quarantine_func (extension_quarantined, self);
+    nautilus_application_get_bookmarks (self);
+
+    /* attach menu-provider module callback. Asking for the menu providers
+     * loads their modules, so leave it until the first window is up, and
+     * do it again for those that only show up later. */
+    g_idle_add_full (G_PRIORITY_LOW, menu_provider_init_idle, NULL, NULL);
+    g_signal_connect (nautilus_signaller_get_current (), "extensions-loaded",
+                      G_CALLBACK (menu_provider_init_callback), NULL);
 
     /* Initialize the UI handler singleton for file operations */
     priv->progress_handler = nautilus_progress_persistence_handler_new (G_OBJECT (self));
 
-    /* Check the user's .nautilus directories and post warnings
-     * if there are problems.
-     */
     check_required_directories (self);
 
     nautilus_init_application_actions (self);
@@ -39,9 +39,7 @@ struct _NautilusBatchRenameDialog
     NautilusWindow *window;
 
     GtkWidget *cancel_button;
-    GtkWidget *original_name_listbox;
-    GtkWidget *arrow_listbox;
-    GtkWidget *result_listbox;
+    GtkWidget *tree_view;
     GtkWidget *name_entry;
     GtkWidget *rename_button;
     GtkWidget *find_entry;
@@ -62,16 +60,14 @@ struct _NautilusBatchRenameDialog
     GtkWidget *conflict_down;
     GtkWidget *conflict_up;
 
-    GList *original_name_listbox_rows;
-    GList *arrow_listbox_rows;
-    GList *result_listbox_rows;
-    GList *listbox_labels_new;
-    GList *listbox_labels_old;
-    GList *listbox_icons;
-    GtkSizeGroup *size_group;
-
     GList *selection;
+    /* FileNames of the selection, in the same order */
+    GPtrArray *files;
     GList *new_names;
+    /* new_names again, so rows can find theirs */
+    GPtrArray *new_names_array;
+    GCancellable *new_names_cancellable;
+    gboolean generating_names;
     NautilusBatchRenameDialogMode mode;
     NautilusDirectory *directory;
 
@@ -89,6 +85,13 @@ struct _NautilusBatchRenameDialog
     gint conflicts_number;
 
     GList *duplicates;
+    /* the old and new names of files, by directory */
+    BatchRenameConflicts *name_conflicts;
+    /* duplicates again, for going to the nth one */
+    GPtrArray *conflicts;
+    /* whether each row has a conflict */
+    gboolean *conflict_rows;
+    GdkRGBA conflict_color;
     GCancellable *conflict_cancellable;
     gboolean checking_conflicts;
 
@@ -97,10 +100,6 @@ struct _NautilusBatchRenameDialog
      * and position */
     GHashTable *tag_info_table;
 
-    GtkWidget *preselected_row1;
-    GtkWidget *preselected_row2;
-
-    gint row_height;
     gboolean rename_clicked;
 };
 
@@ -115,7 +114,25 @@ typedef struct
 } TagData;
 
 
+enum
+{
+    PREVIEW_COLUMN_INDEX,
+    PREVIEW_NUM_COLUMNS
+};
+
+typedef struct
+{
+    NautilusBatchRenameDialogMode mode;
+    GPtrArray *files;
+    GList *text_chunks;
+    GList *selection_metadata;
+    gchar *entry_text;
+    gchar *replace_text;
+} NewNamesData;
+
 static void     update_display_text (NautilusBatchRenameDialog *dialog);
+static void     update_file_names (NautilusBatchRenameDialog *dialog);
+static void     clear_conflicts (NautilusBatchRenameDialog *dialog);
 
 G_DEFINE_TYPE (NautilusBatchRenameDialog, nautilus_batch_rename_dialog, GTK_TYPE_DIALOG);
 
@@ -141,6 +158,7 @@ change_numbering_order (GSimpleAction *action,
             dialog->selection = nautilus_batch_rename_dialog_sort (dialog->selection,
                                                                    sorts_constants[i].sort_mode,
                                                                    dialog->create_date);
+            update_file_names (dialog);
             break;
         }
     }
@@ -271,54 +289,6 @@ const GActionEntry dialog_entries[] =
     { "add-album-name-tag", add_metadata_tag },
 };
 
-static void
-row_selected (GtkListBox    *box,
-              GtkListBoxRow *listbox_row,
-              gpointer       user_data)
-{
-    NautilusBatchRenameDialog *dialog;
-    GtkListBoxRow *row;
-    gint index;
-
-    if (!GTK_IS_LIST_BOX_ROW (listbox_row))
-    {
-        return;
-    }
-
-    dialog = NAUTILUS_BATCH_RENAME_DIALOG (user_data);
-    index = gtk_list_box_row_get_index (listbox_row);
-
-    if (GTK_WIDGET (box) == dialog->original_name_listbox)
-    {
-        row = gtk_list_box_get_row_at_index (GTK_LIST_BOX (dialog->arrow_listbox), index);
-        gtk_list_box_select_row (GTK_LIST_BOX (dialog->arrow_listbox),
-                                 row);
-        row = gtk_list_box_get_row_at_index (GTK_LIST_BOX (dialog->result_listbox), index);
-        gtk_list_box_select_row (GTK_LIST_BOX (dialog->result_listbox),
-                                 row);
-    }
-
-    if (GTK_WIDGET (box) == dialog->arrow_listbox)
-    {
-        row = gtk_list_box_get_row_at_index (GTK_LIST_BOX (dialog->original_name_listbox), index);
-        gtk_list_box_select_row (GTK_LIST_BOX (dialog->original_name_listbox),
-                                 row);
-        row = gtk_list_box_get_row_at_index (GTK_LIST_BOX (dialog->result_listbox), index);
-        gtk_list_box_select_row (GTK_LIST_BOX (dialog->result_listbox),
-                                 row);
-    }
-
-    if (GTK_WIDGET (box) == dialog->result_listbox)
-    {
-        row = gtk_list_box_get_row_at_index (GTK_LIST_BOX (dialog->arrow_listbox), index);
-        gtk_list_box_select_row (GTK_LIST_BOX (dialog->arrow_listbox),
-                                 row);
-        row = gtk_list_box_get_row_at_index (GTK_LIST_BOX (dialog->original_name_listbox), index);
-        gtk_list_box_select_row (GTK_LIST_BOX (dialog->original_name_listbox),
-                                 row);
-    }
-}
-
 static gint
 compare_int (gconstpointer a,
              gconstpointer b)
@@ -420,240 +390,365 @@ split_entry_text (NautilusBatchRenameDialog *self,
     return result;
 }
 
-static GList *
-batch_rename_dialog_get_new_names (NautilusBatchRenameDialog *dialog)
+static void
+update_file_names (NautilusBatchRenameDialog *dialog)
 {
-    GList *result = NULL;
-    GList *selection;
-    GList *text_chunks;
-    g_autofree gchar *entry_text = NULL;
-    g_autofree gchar *replace_text = NULL;
-
-    selection = dialog->selection;
-    text_chunks = NULL;
+    GList *l;
+    FileNames *file_names;
+    g_autofree gchar *parent_uri = NULL;
 
-    if (dialog->mode == NAUTILUS_BATCH_RENAME_DIALOG_REPLACE)
+    if (dialog->files != NULL)
     {
-        entry_text = g_strdup (gtk_entry_get_text (GTK_ENTRY (dialog->find_entry)));
+        g_ptr_array_unref (dialog->files);
     }
-    else
+    if (dialog->name_conflicts != NULL)
     {
-        entry_text = g_strdup (gtk_entry_get_text (GTK_ENTRY (dialog->name_entry)));
+        batch_rename_conflicts_free (dialog->name_conflicts);
     }
 
-    replace_text = g_strdup (gtk_entry_get_text (GTK_ENTRY (dialog->replace_entry)));
-
-    if (dialog->mode == NAUTILUS_BATCH_RENAME_DIALOG_REPLACE)
-    {
-        result = batch_rename_dialog_get_new_names_list (dialog->mode,
-                                                         selection,
-                                                         NULL,
-                                                         NULL,
-                                                         entry_text,
-                                                         replace_text);
-    }
-    else
+    /* Names being generated keep a reference on the old array */
+    dialog->files = g_ptr_array_new_with_free_func (file_names_free);
+    dialog->name_conflicts = batch_rename_conflicts_new ();
+    for (l = dialog->selection; l != NULL; l = l->next)
     {
-        text_chunks = split_entry_text (dialog, entry_text);
+        file_names = file_names_new (NAUTILUS_FILE (l->data));
+        g_ptr_array_add (dialog->files, file_names);
 
-        result = batch_rename_dialog_get_new_names_list (dialog->mode,
-                                                         selection,
-                                                         text_chunks,
-                                                         dialog->selection_metadata,
-                                                         entry_text,
-                                                         replace_text);
-        g_list_free_full (text_chunks, string_free);
+        g_free (parent_uri);
+        parent_uri = nautilus_file_get_parent_uri (NAUTILUS_FILE (l->data));
+        batch_rename_conflicts_add_file (dialog->name_conflicts, parent_uri, file_names->name);
     }
 
-    result = g_list_reverse (result);
-
-    return result;
+    /* The names and conflicts found so far are for the old order, so they
+     * would show against the wrong files until the new names arrive */
+    g_ptr_array_set_size (dialog->new_names_array, 0);
+    if (dialog->conflict_rows != NULL)
+    {
+        clear_conflicts (dialog);
+        gtk_widget_hide (dialog->conflict_box);
+    }
+    gtk_widget_set_sensitive (dialog->rename_button, FALSE);
 }
 
 static void
-begin_batch_rename (NautilusBatchRenameDialog *dialog,
-                    GList                     *new_names)
+string_list_free (gpointer data)
 {
-    batch_rename_sort_lists_for_rename (&dialog->selection, &new_names, NULL, NULL, NULL, FALSE);
+    g_list_free_full (data, string_free);
+}
 
-    /* do the actual rename here */
-    nautilus_file_batch_rename (dialog->selection, new_names, NULL, NULL);
+static void
+new_names_data_free (gpointer data)
+{
+    NewNamesData *new_names_data = data;
 
-    gdk_window_set_cursor (gtk_widget_get_window (GTK_WIDGET (dialog->window)), NULL);
+    g_ptr_array_unref (new_names_data->files);
+    g_list_free_full (new_names_data->text_chunks, string_free);
+    g_free (new_names_data->entry_text);
+    g_free (new_names_data->replace_text);
+    g_free (new_names_data);
 }
 
 static void
-listbox_header_func (GtkListBoxRow             *row,
-                     GtkListBoxRow             *before,
-                     NautilusBatchRenameDialog *dialog)
+get_new_names_thread (GTask        *task,
+                      gpointer      source_object,
+                      gpointer      task_data,
+                      GCancellable *cancellable)
 {
-    gboolean show_separator;
+    NewNamesData *data = task_data;
+    GList *new_names;
 
-    show_separator = GPOINTER_TO_INT (g_object_get_data (G_OBJECT (row),
-                                                         "show-separator"));
+    new_names = batch_rename_dialog_get_new_names_list (data->mode,
+                                                        data->files,
+                                                        data->text_chunks,
+                                                        data->selection_metadata,
+                                                        data->entry_text,
+                                                        data->replace_text,
+                                                        cancellable);
 
-    if (show_separator)
+    if (g_task_return_error_if_cancelled (task))
     {
-        GtkWidget *separator;
-
-        separator = gtk_separator_new (GTK_ORIENTATION_HORIZONTAL);
-        gtk_widget_show (separator);
+        g_list_free_full (new_names, string_free);
 
-        gtk_list_box_row_set_header (row, separator);
+        return;
     }
+
+    g_task_return_pointer (task, g_list_reverse (new_names), string_list_free);
 }
 
-/* This is manually done instead of using GtkSizeGroup because of the computational
- * complexity of the later.*/
+/* The names are made in a thread from a copy of everything they depend
+ * on, so typing in a pattern for thousands of files doesn't block. A
+ * new call cancels the previous one. */
 static void
-update_rows_height (NautilusBatchRenameDialog *dialog)
+batch_rename_dialog_get_new_names_async (NautilusBatchRenameDialog *dialog,
+                                         GAsyncReadyCallback        callback)
 {
-    GList *l;
-    gint current_row_natural_height;
-    gint maximum_height;
-
-    maximum_height = -1;
+    g_autoptr (GTask) task = NULL;
+    NewNamesData *data;
 
-    /* check if maximum height has changed */
-    for (l = dialog->listbox_labels_new; l != NULL; l = l->next)
+    if (dialog->new_names_cancellable != NULL)
     {
-        gtk_widget_get_preferred_height (GTK_WIDGET (l->data),
-                                         NULL,
-                                         &current_row_natural_height);
-
-        if (current_row_natural_height > maximum_height)
-        {
-            maximum_height = current_row_natural_height;
-        }
+        g_cancellable_cancel (dialog->new_names_cancellable);
+        g_clear_object (&dialog->new_names_cancellable);
     }
 
-    for (l = dialog->listbox_labels_old; l != NULL; l = l->next)
-    {
-        gtk_widget_get_preferred_height (GTK_WIDGET (l->data),
-                                         NULL,
-                                         &current_row_natural_height);
+    dialog->new_names_cancellable = g_cancellable_new ();
+    dialog->generating_names = TRUE;
 
-        if (current_row_natural_height > maximum_height)
-        {
-            maximum_height = current_row_natural_height;
-        }
-    }
+    data = g_new0 (NewNamesData, 1);
+    data->mode = dialog->mode;
+    data->files = g_ptr_array_ref (dialog->files);
+    data->replace_text = g_strdup (gtk_entry_get_text (GTK_ENTRY (dialog->replace_entry)));
 
-    for (l = dialog->listbox_icons; l != NULL; l = l->next)
+    if (dialog->mode == NAUTILUS_BATCH_RENAME_DIALOG_REPLACE)
     {
-        gtk_widget_get_preferred_height (GTK_WIDGET (l->data),
-                                         NULL,
-                                         &current_row_natural_height);
-
-        if (current_row_natural_height > maximum_height)
-        {
-            maximum_height = current_row_natural_height;
-        }
+        data->entry_text = g_strdup (gtk_entry_get_text (GTK_ENTRY (dialog->find_entry)));
     }
-
-    if (maximum_height != dialog->row_height)
+    else
     {
-        dialog->row_height = maximum_height + ROW_MARGIN_TOP_BOTTOM * 2;
+        data->entry_text = g_strdup (gtk_entry_get_text (GTK_ENTRY (dialog->name_entry)));
+        data->text_chunks = split_entry_text (dialog, data->entry_text);
+        /* Not modified after the query is finished, and freed with the
+         * dialog, which the task keeps alive */
+        data->selection_metadata = dialog->selection_metadata;
+    }
 
-        for (l = dialog->listbox_icons; l != NULL; l = l->next)
-        {
-            g_object_set (G_OBJECT (l->data), "height-request", dialog->row_height, NULL);
-        }
+    task = g_task_new (dialog, dialog->new_names_cancellable, callback, NULL);
+    g_task_set_task_data (task, data, new_names_data_free);
+    g_task_run_in_thread (task, get_new_names_thread);
+}
 
-        for (l = dialog->listbox_labels_new; l != NULL; l = l->next)
-        {
-            g_object_set (G_OBJECT (l->data), "height-request", dialog->row_height, NULL);
-        }
+static void
+begin_batch_rename (NautilusBatchRenameDialog *dialog,
+                    GList                     *new_names)
+{
+    batch_rename_sort_lists_for_rename (&dialog->selection, &new_names, NULL, NULL, NULL, FALSE);
 
-        for (l = dialog->listbox_labels_old; l != NULL; l = l->next)
-        {
-            g_object_set (G_OBJECT (l->data), "height-request", dialog->row_height, NULL);
-        }
-    }
+    /* do the actual rename here */
+    nautilus_file_batch_rename (dialog->selection, new_names, NULL, NULL);
+
+    gdk_window_set_cursor (gtk_widget_get_window (GTK_WIDGET (dialog->window)), NULL);
 }
 
-static GtkWidget *
-create_original_name_row_for_label (NautilusBatchRenameDialog *dialog,
-                                    const gchar               *old_text,
-                                    gboolean                   show_separator)
+static gint
+get_row_index (GtkTreeModel *model,
+               GtkTreeIter  *iter)
 {
-    GtkWidget *row;
-    GtkWidget *label_old;
+    gint index;
 
-    row = gtk_list_box_row_new ();
+    gtk_tree_model_get (model, iter, PREVIEW_COLUMN_INDEX, &index, -1);
 
-    g_object_set_data (G_OBJECT (row), "show-separator", GINT_TO_POINTER (show_separator));
+    return index;
+}
 
-    label_old = gtk_label_new (old_text);
-    gtk_label_set_xalign (GTK_LABEL (label_old), 0.0);
-    gtk_widget_set_hexpand (label_old, TRUE);
-    gtk_widget_set_margin_start (label_old, ROW_MARGIN_START);
-    gtk_label_set_ellipsize (GTK_LABEL (label_old), PANGO_ELLIPSIZE_END);
+static void
+set_conflict_background (NautilusBatchRenameDialog *dialog,
+                         GtkCellRenderer           *cell,
+                         GtkTreeIter               *iter,
+                         gint                       index)
+{
+    GtkTreeSelection *selection;
+    gboolean highlight;
+
+    /* selected rows keep the selection colors */
+    selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (dialog->tree_view));
+    highlight = dialog->conflict_rows[index] &&
+                !gtk_tree_selection_iter_is_selected (selection, iter);
+
+    g_object_set (cell,
+                  "cell-background-rgba", &dialog->conflict_color,
+                  "cell-background-set", highlight,
+                  NULL);
+}
 
-    dialog->listbox_labels_old = g_list_prepend (dialog->listbox_labels_old, label_old);
+/* The rows only hold their index, the text is looked up when a row is
+ * drawn, so only the visible ones cost anything */
+static void
+original_name_cell_data_func (GtkTreeViewColumn *column,
+                              GtkCellRenderer   *cell,
+                              GtkTreeModel      *model,
+                              GtkTreeIter       *iter,
+                              gpointer           user_data)
+{
+    NautilusBatchRenameDialog *dialog;
+    FileNames *file;
+    GString *markup;
+    gint index;
+
+    dialog = NAUTILUS_BATCH_RENAME_DIALOG (user_data);
+    index = get_row_index (model, iter);
+    file = g_ptr_array_index (dialog->files, index);
+
+    if (dialog->mode == NAUTILUS_BATCH_RENAME_DIALOG_FORMAT)
+    {
+        g_object_set (cell, "text", file->name, NULL);
+    }
+    else
+    {
+        markup = batch_rename_replace_label_text (file->name,
+                                                  gtk_entry_get_text (GTK_ENTRY (dialog->find_entry)));
+        g_object_set (cell, "markup", markup->str, NULL);
 
-    gtk_container_add (GTK_CONTAINER (row), label_old);
-    gtk_widget_show_all (row);
+        g_string_free (markup, TRUE);
+    }
 
-    return row;
+    set_conflict_background (dialog, cell, iter, index);
 }
 
-static GtkWidget *
-create_result_row_for_label (NautilusBatchRenameDialog *dialog,
-                             const gchar               *new_text,
-                             gboolean                   show_separator)
+static void
+arrow_cell_data_func (GtkTreeViewColumn *column,
+                      GtkCellRenderer   *cell,
+                      GtkTreeModel      *model,
+                      GtkTreeIter       *iter,
+                      gpointer           user_data)
 {
-    GtkWidget *row;
-    GtkWidget *label_new;
+    NautilusBatchRenameDialog *dialog;
 
-    row = gtk_list_box_row_new ();
+    dialog = NAUTILUS_BATCH_RENAME_DIALOG (user_data);
 
-    g_object_set_data (G_OBJECT (row), "show-separator", GINT_TO_POINTER (show_separator));
+    set_conflict_background (dialog, cell, iter, get_row_index (model, iter));
+}
 
-    label_new = gtk_label_new (new_text);
-    gtk_label_set_xalign (GTK_LABEL (label_new), 0.0);
-    gtk_widget_set_hexpand (label_new, TRUE);
-    gtk_widget_set_margin_start (label_new, ROW_MARGIN_START);
-    gtk_label_set_ellipsize (GTK_LABEL (label_new), PANGO_ELLIPSIZE_END);
+static void
+result_cell_data_func (GtkTreeViewColumn *column,
+                       GtkCellRenderer   *cell,
+                       GtkTreeModel      *model,
+                       GtkTreeIter       *iter,
+                       gpointer           user_data)
+{
+    NautilusBatchRenameDialog *dialog;
+    GString *new_name;
+    gint index;
 
-    dialog->listbox_labels_new = g_list_prepend (dialog->listbox_labels_new, label_new);
+    dialog = NAUTILUS_BATCH_RENAME_DIALOG (user_data);
+    index = get_row_index (model, iter);
 
-    gtk_container_add (GTK_CONTAINER (row), label_new);
-    gtk_widget_show_all (row);
+    /* the first names may still be on their way */
+    if ((guint) index < dialog->new_names_array->len)
+    {
+        new_name = g_ptr_array_index (dialog->new_names_array, index);
+        g_object_set (cell, "text", new_name->str, NULL);
+    }
+    else
+    {
+        g_object_set (cell, "text", "", NULL);
+    }
 
-    return row;
+    set_conflict_background (dialog, cell, iter, index);
 }
 
-static GtkWidget *
-create_arrow_row_for_label (NautilusBatchRenameDialog *dialog,
-                            gboolean                   show_separator)
+static gboolean
+on_query_tooltip (GtkWidget  *widget,
+                  gint        x,
+                  gint        y,
+                  gboolean    keyboard_mode,
+                  GtkTooltip *tooltip,
+                  gpointer    user_data)
 {
-    GtkWidget *row;
-    GtkWidget *icon;
+    NautilusBatchRenameDialog *dialog;
+    GtkTreeView *tree_view;
+    GtkTreeModel *model;
+    GtkTreePath *path;
+    GtkTreeIter iter;
+    GtkTreeViewColumn *column;
+    FileNames *file;
+    GString *new_name;
+    gint index;
 
-    row = gtk_list_box_row_new ();
+    dialog = NAUTILUS_BATCH_RENAME_DIALOG (user_data);
+    tree_view = GTK_TREE_VIEW (widget);
+
+    if (!gtk_tree_view_get_tooltip_context (tree_view, &x, &y, keyboard_mode,
+                                            &model, &path, &iter))
+    {
+        return FALSE;
+    }
 
-    g_object_set_data (G_OBJECT (row), "show-separator", GINT_TO_POINTER (show_separator));
+    index = get_row_index (model, &iter);
+    column = NULL;
+    if (!keyboard_mode)
+    {
+        gtk_tree_view_get_path_at_pos (tree_view, x, y, NULL, &column, NULL, NULL);
+    }
 
-    if (gtk_widget_get_direction (row) == GTK_TEXT_DIR_RTL)
+    if (column == gtk_tree_view_get_column (tree_view, 2) &&
+        (guint) index < dialog->new_names_array->len)
     {
-        icon = gtk_label_new ("←");
+        new_name = g_ptr_array_index (dialog->new_names_array, index);
+        gtk_tooltip_set_text (tooltip, new_name->str);
     }
     else
     {
-        icon = gtk_label_new ("→");
+        file = g_ptr_array_index (dialog->files, index);
+        gtk_tooltip_set_text (tooltip, file->name);
     }
 
-    gtk_label_set_xalign (GTK_LABEL (icon), 1.0);
-    gtk_widget_set_hexpand (icon, FALSE);
-    gtk_widget_set_margin_start (icon, ROW_MARGIN_START);
+    gtk_tree_view_set_tooltip_row (tree_view, tooltip, path);
+    gtk_tree_path_free (path);
+
+    return TRUE;
+}
+
+static void
+add_preview_column (NautilusBatchRenameDialog *dialog,
+                    GtkCellRenderer           *cell,
+                    gboolean                   expand,
+                    GtkTreeCellDataFunc        func)
+{
+    GtkTreeViewColumn *column;
+    gint width;
 
-    dialog->listbox_icons = g_list_prepend (dialog->listbox_icons, icon);
+    column = gtk_tree_view_column_new ();
+    gtk_tree_view_column_pack_start (column, cell, TRUE);
+    gtk_tree_view_column_set_cell_data_func (column, cell, func, dialog, NULL);
 
-    gtk_container_add (GTK_CONTAINER (row), icon);
-    gtk_widget_show_all (row);
+    /* fixed height mode wants fixed columns */
+    gtk_cell_renderer_get_preferred_width (cell, dialog->tree_view, NULL, &width);
+    gtk_tree_view_column_set_sizing (column, GTK_TREE_VIEW_COLUMN_FIXED);
+    gtk_tree_view_column_set_fixed_width (column, width);
+    gtk_tree_view_column_set_expand (column, expand);
 
-    return row;
+    gtk_tree_view_append_column (GTK_TREE_VIEW (dialog->tree_view), column);
+}
+
+static void
+setup_preview (NautilusBatchRenameDialog *dialog)
+{
+    GtkCellRenderer *cell;
+
+    cell = gtk_cell_renderer_text_new ();
+    g_object_set (cell,
+                  "ellipsize", PANGO_ELLIPSIZE_END,
+                  "xpad", ROW_MARGIN_START,
+                  "ypad", ROW_MARGIN_TOP_BOTTOM,
+                  NULL);
+    add_preview_column (dialog, cell, TRUE, original_name_cell_data_func);
+
+    cell = gtk_cell_renderer_text_new ();
+    g_object_set (cell,
+                  "text", gtk_widget_get_direction (dialog->tree_view) == GTK_TEXT_DIR_RTL ? "←" : "→",
+                  "xalign", 1.0,
+                  "xpad", ROW_MARGIN_START,
+                  "ypad", ROW_MARGIN_TOP_BOTTOM,
+                  NULL);
+    add_preview_column (dialog, cell, FALSE, arrow_cell_data_func);
+
+    cell = gtk_cell_renderer_text_new ();
+    g_object_set (cell,
+                  "ellipsize", PANGO_ELLIPSIZE_END,
+                  "xpad", ROW_MARGIN_START,
+                  "ypad", ROW_MARGIN_TOP_BOTTOM,
+                  NULL);
+    add_preview_column (dialog, cell, TRUE, result_cell_data_func);
+
+    if (!gtk_style_context_lookup_color (gtk_widget_get_style_context (dialog->tree_view),
+                                         "conflict_bg",
+                                         &dialog->conflict_color))
+    {
+        gdk_rgba_parse (&dialog->conflict_color, "#fef6b6");
+    }
+
+    g_signal_connect (dialog->tree_view, "query-tooltip",
+                      G_CALLBACK (on_query_tooltip), dialog);
 }
 
 static void
@@ -662,9 +757,9 @@ prepare_batch_rename (NautilusBatchRenameDialog *dialog)
     GdkCursor *cursor;
     GdkDisplay *display;
 
-    /* wait for checking conflicts to finish, to be sure that
-     * the rename can actually take place */
-    if (dialog->checking_conflicts)
+    /* wait for the new names and the conflicts check to finish, to be
+     * sure that the rename can actually take place */
+    if (dialog->generating_names || dialog->checking_conflicts)
     {
         dialog->rename_clicked = TRUE;
         return;
@@ -690,6 +785,8 @@ prepare_batch_rename (NautilusBatchRenameDialog *dialog)
     gtk_widget_hide (GTK_WIDGET (dialog));
     begin_batch_rename (dialog, dialog->new_names);
 
+    g_cancellable_cancel (dialog->new_names_cancellable);
+
     if (dialog->conflict_cancellable)
     {
         g_cancellable_cancel (dialog->conflict_cancellable);
@@ -710,6 +807,8 @@ batch_rename_dialog_on_response (NautilusBatchRenameDialog *dialog,
     }
     else
     {
+        g_cancellable_cancel (dialog->new_names_cancellable);
+
         if (dialog->conflict_cancellable)
         {
             g_cancellable_cancel (dialog->conflict_cancellable);
@@ -721,122 +820,51 @@ batch_rename_dialog_on_response (NautilusBatchRenameDialog *dialog,
 }
 
 static void
-fill_display_listbox (NautilusBatchRenameDialog *dialog)
+fill_display_model (NautilusBatchRenameDialog *dialog)
 {
-    GtkWidget *row;
-    GList *l1;
-    GList *l2;
-    NautilusFile *file;
-    GString *new_name;
-    gchar *name;
-
-    dialog->original_name_listbox_rows = NULL;
-    dialog->arrow_listbox_rows = NULL;
-    dialog->result_listbox_rows = NULL;
-
-    gtk_size_group_add_widget (dialog->size_group, dialog->result_listbox);
-    gtk_size_group_add_widget (dialog->size_group, dialog->original_name_listbox);
+    GtkListStore *store;
+    guint i;
 
-    for (l1 = dialog->new_names, l2 = dialog->selection; l1 != NULL && l2 != NULL; l1 = l1->next, l2 = l2->next)
+    store = gtk_list_store_new (PREVIEW_NUM_COLUMNS, G_TYPE_INT);
+    for (i = 0; i < dialog->files->len; i++)
     {
-        file = NAUTILUS_FILE (l2->data);
-        new_name = l1->data;
-
-        name = nautilus_file_get_name (file);
-        row = create_original_name_row_for_label (dialog, name, TRUE);
-        gtk_container_add (GTK_CONTAINER (dialog->original_name_listbox), row);
-        dialog->original_name_listbox_rows = g_list_prepend (dialog->original_name_listbox_rows,
-                                                             row);
-
-        row = create_arrow_row_for_label (dialog, TRUE);
-        gtk_container_add (GTK_CONTAINER (dialog->arrow_listbox), row);
-        dialog->arrow_listbox_rows = g_list_prepend (dialog->arrow_listbox_rows,
-                                                     row);
-
-        row = create_result_row_for_label (dialog, new_name->str, TRUE);
-        gtk_container_add (GTK_CONTAINER (dialog->result_listbox), row);
-        dialog->result_listbox_rows = g_list_prepend (dialog->result_listbox_rows,
-                                                      row);
-
-        g_free (name);
+        gtk_list_store_insert_with_values (store, NULL, -1,
+                                           PREVIEW_COLUMN_INDEX, i,
+                                           -1);
     }
 
-    dialog->original_name_listbox_rows = g_list_reverse (dialog->original_name_listbox_rows);
-    dialog->arrow_listbox_rows = g_list_reverse (dialog->arrow_listbox_rows);
-    dialog->result_listbox_rows = g_list_reverse (dialog->result_listbox_rows);
-    dialog->listbox_labels_old = g_list_reverse (dialog->listbox_labels_old);
-    dialog->listbox_labels_new = g_list_reverse (dialog->listbox_labels_new);
-    dialog->listbox_icons = g_list_reverse (dialog->listbox_icons);
+    gtk_tree_view_set_model (GTK_TREE_VIEW (dialog->tree_view), GTK_TREE_MODEL (store));
+    g_object_unref (store);
 }
 
 static void
 select_nth_conflict (NautilusBatchRenameDialog *dialog)
 {
-    GList *l;
-    GString *conflict_file_name;
-    GString *display_text;
-    GString *new_name;
-    gint nth_conflict_index;
-    gint nth_conflict;
-    gint name_occurences;
-    GtkAdjustment *adjustment;
-    GtkAllocation allocation;
+    g_autofree gchar *display_text = NULL;
+    GtkTreePath *path;
     ConflictData *conflict_data;
 
-    nth_conflict = dialog->selected_conflict;
-    l = g_list_nth (dialog->duplicates, nth_conflict);
-    conflict_data = l->data;
-
-    /* the conflict that has to be selected */
-    conflict_file_name = g_string_new (conflict_data->name);
-    display_text = g_string_new ("");
-
-    nth_conflict_index = conflict_data->index;
-
-    l = g_list_nth (dialog->original_name_listbox_rows, nth_conflict_index);
-    gtk_list_box_select_row (GTK_LIST_BOX (dialog->original_name_listbox),
-                             l->data);
-
-    l = g_list_nth (dialog->arrow_listbox_rows, nth_conflict_index);
-    gtk_list_box_select_row (GTK_LIST_BOX (dialog->arrow_listbox),
-                             l->data);
-
-    l = g_list_nth (dialog->result_listbox_rows, nth_conflict_index);
-    gtk_list_box_select_row (GTK_LIST_BOX (dialog->result_listbox),
-                             l->data);
+    conflict_data = g_ptr_array_index (dialog->conflicts, dialog->selected_conflict);
 
-    /* scroll to the selected row */
-    adjustment = gtk_scrolled_window_get_vadjustment (GTK_SCROLLED_WINDOW (dialog->scrolled_window));
-    gtk_widget_get_allocation (GTK_WIDGET (l->data), &allocation);
-    gtk_adjustment_set_value (adjustment, (allocation.height + 1) * nth_conflict_index);
+    path = gtk_tree_path_new_from_indices (conflict_data->index, -1);
+    gtk_tree_selection_select_path (gtk_tree_view_get_selection (GTK_TREE_VIEW (dialog->tree_view)),
+                                    path);
+    gtk_tree_view_scroll_to_cell (GTK_TREE_VIEW (dialog->tree_view), path, NULL,
+                                  TRUE, 0.5, 0.0);
+    gtk_tree_path_free (path);
 
-    name_occurences = 0;
-    for (l = dialog->new_names; l != NULL; l = l->next)
-    {
-        new_name = l->data;
-        if (g_string_equal (new_name, conflict_file_name))
-        {
-            name_occurences++;
-        }
-    }
-    if (name_occurences > 1)
+    if (batch_rename_conflicts_is_duplicate (dialog->name_conflicts, conflict_data->index))
     {
-        g_string_append_printf (display_text,
-                                _("“%s” would not be a unique new name."),
-                                conflict_file_name->str);
+        display_text = g_strdup_printf (_("“%s” would not be a unique new name."),
+                                        conflict_data->name);
     }
     else
     {
-        g_string_append_printf (display_text,
-                                _("“%s” would conflict with an existing file."),
-                                conflict_file_name->str);
+        display_text = g_strdup_printf (_("“%s” would conflict with an existing file."),
+                                        conflict_data->name);
     }
 
-    gtk_label_set_label (GTK_LABEL (dialog->conflict_label),
-                         display_text->str);
-
-    g_string_free (conflict_file_name, TRUE);
-    g_string_free (display_text, TRUE);
+    gtk_label_set_label (GTK_LABEL (dialog->conflict_label), display_text);
 }
 
 static void
@@ -876,111 +904,57 @@ select_next_conflict_up (NautilusBatchRenameDialog *dialog)
 }
 
 static void
-update_conflict_row_background (NautilusBatchRenameDialog *dialog)
+clear_conflicts (NautilusBatchRenameDialog *dialog)
 {
-    GList *l1;
-    GList *l2;
-    GList *l3;
-    GList *duplicates;
-    gint index;
-    GtkStyleContext *context;
-    ConflictData *conflict_data;
-
-    index = 0;
-
-    duplicates = dialog->duplicates;
-
-    for (l1 = dialog->original_name_listbox_rows,
-         l2 = dialog->arrow_listbox_rows,
-         l3 = dialog->result_listbox_rows;
-         l1 != NULL && l2 != NULL && l3 != NULL;
-         l1 = l1->next, l2 = l2->next, l3 = l3->next)
-    {
-        context = gtk_widget_get_style_context (GTK_WIDGET (l1->data));
-
-        if (gtk_style_context_has_class (context, "conflict-row"))
-        {
-            gtk_style_context_remove_class (context, "conflict-row");
+    g_list_free_full (dialog->duplicates, conflict_data_free);
+    dialog->duplicates = NULL;
 
-            context = gtk_widget_get_style_context (GTK_WIDGET (l2->data));
-            gtk_style_context_remove_class (context, "conflict-row");
+    g_ptr_array_set_size (dialog->conflicts, 0);
+    memset (dialog->conflict_rows, 0, dialog->files->len * sizeof (gboolean));
 
-            context = gtk_widget_get_style_context (GTK_WIDGET (l3->data));
-            gtk_style_context_remove_class (context, "conflict-row");
-        }
+    gtk_widget_queue_draw (dialog->tree_view);
+}
 
-        if (duplicates != NULL)
-        {
-            conflict_data = duplicates->data;
-            if (conflict_data->index == index)
-            {
-                context = gtk_widget_get_style_context (GTK_WIDGET (l1->data));
-                gtk_style_context_add_class (context, "conflict-row");
+static void
+update_conflicts (NautilusBatchRenameDialog *dialog)
+{
+    GList *l;
+    ConflictData *conflict_data;
 
-                context = gtk_widget_get_style_context (GTK_WIDGET (l2->data));
-                gtk_style_context_add_class (context, "conflict-row");
+    g_ptr_array_set_size (dialog->conflicts, 0);
+    memset (dialog->conflict_rows, 0, dialog->files->len * sizeof (gboolean));
 
-                context = gtk_widget_get_style_context (GTK_WIDGET (l3->data));
-                gtk_style_context_add_class (context, "conflict-row");
+    for (l = dialog->duplicates; l != NULL; l = l->next)
+    {
+        conflict_data = l->data;
 
-                duplicates = duplicates->next;
-            }
-        }
-        index++;
+        g_ptr_array_add (dialog->conflicts, conflict_data);
+        dialog->conflict_rows[conflict_data->index] = TRUE;
     }
+
+    gtk_widget_queue_draw (dialog->tree_view);
 }
 
 static void
-update_listbox (NautilusBatchRenameDialog *dialog)
+update_preview (NautilusBatchRenameDialog *dialog)
 {
-    GList *l1;
-    GList *l2;
-    NautilusFile *file;
-    gchar *old_name;
-    GtkLabel *label;
+    GList *l;
     GString *new_name;
     gboolean empty_name = FALSE;
 
-    for (l1 = dialog->new_names, l2 = dialog->listbox_labels_new; l1 != NULL && l2 != NULL; l1 = l1->next, l2 = l2->next)
-    {
-        label = GTK_LABEL (l2->data);
-        new_name = l1->data;
-
-        gtk_label_set_label (label, new_name->str);
-        gtk_widget_set_tooltip_text (GTK_WIDGET (label), new_name->str);
-
-        if (g_strcmp0 (new_name->str, "") == 0)
-        {
-            empty_name = TRUE;
-        }
-    }
+    update_conflicts (dialog);
 
-    for (l1 = dialog->selection, l2 = dialog->listbox_labels_old; l1 != NULL && l2 != NULL; l1 = l1->next, l2 = l2->next)
+    for (l = dialog->new_names; l != NULL; l = l->next)
     {
-        label = GTK_LABEL (l2->data);
-        file = NAUTILUS_FILE (l1->data);
-
-        old_name = nautilus_file_get_name (file);
-        gtk_widget_set_tooltip_text (GTK_WIDGET (label), old_name);
+        new_name = l->data;
 
-        if (dialog->mode == NAUTILUS_BATCH_RENAME_DIALOG_FORMAT)
+        if (new_name->len == 0)
         {
-            gtk_label_set_label (label, old_name);
-        }
-        else
-        {
-            new_name = batch_rename_replace_label_text (old_name,
-                                                        gtk_entry_get_text (GTK_ENTRY (dialog->find_entry)));
-            gtk_label_set_markup (GTK_LABEL (label), new_name->str);
-
-            g_string_free (new_name, TRUE);
+            empty_name = TRUE;
+            break;
         }
-
-        g_free (old_name);
     }
 
-    update_rows_height (dialog);
-
     if (empty_name)
     {
         gtk_widget_set_sensitive (dialog->rename_button, FALSE);
@@ -991,20 +965,18 @@ update_listbox (NautilusBatchRenameDialog *dialog)
     /* check if there are name conflicts and display them if they exist */
     if (dialog->duplicates != NULL)
     {
-        update_conflict_row_background (dialog);
-
         gtk_widget_set_sensitive (dialog->rename_button, FALSE);
 
         gtk_widget_show (dialog->conflict_box);
 
         dialog->selected_conflict = 0;
-        dialog->conflicts_number = g_list_length (dialog->duplicates);
+        dialog->conflicts_number = dialog->conflicts->len;
 
         select_nth_conflict (dialog);
 
         gtk_widget_set_sensitive (dialog->conflict_up, FALSE);
 
-        if (g_list_length (dialog->duplicates) == 1)
+        if (dialog->conflicts_number == 1)
         {
             gtk_widget_set_sensitive (dialog->conflict_down, FALSE);
         }
@@ -1020,7 +992,6 @@ update_listbox (NautilusBatchRenameDialog *dialog)
         /* re-enable the rename button if there are no more name conflicts */
         if (dialog->duplicates == NULL && !gtk_widget_is_sensitive (dialog->rename_button))
         {
-            update_conflict_row_background (dialog);
             gtk_widget_set_sensitive (dialog->rename_button, TRUE);
         }
     }
@@ -1037,141 +1008,49 @@ update_listbox (NautilusBatchRenameDialog *dialog)
     }
 }
 
+/* Each directory of the selection is checked in turn, against the names
+ * of the selection's files that are in it */
 void
 check_conflict_for_files (NautilusBatchRenameDialog *dialog,
                           NautilusDirectory         *directory,
                           GList                     *files)
 {
-    gchar *current_directory;
-    gchar *parent_uri;
-    gchar *name;
-    NautilusFile *file;
-    GString *new_name;
-    GString *file_name;
-    GList *l1, *l2;
+    g_autofree gchar *current_directory = NULL;
     GHashTable *directory_files_table;
-    GHashTable *new_names_table;
-    GHashTable *names_conflicts_table;
-    gboolean exists;
-    gboolean have_conflict;
-    gboolean tag_present;
-    gboolean same_parent_directory;
+    GArray *indices;
+    GList *l;
+    guint i;
+    guint index;
     ConflictData *conflict_data;
 
     current_directory = nautilus_directory_get_uri (directory);
-
-    directory_files_table = g_hash_table_new_full (g_str_hash,
-                                                   g_str_equal,
-                                                   (GDestroyNotify) g_free,
-                                                   NULL);
-    new_names_table = g_hash_table_new_full (g_str_hash,
-                                             g_str_equal,
-                                             (GDestroyNotify) g_free,
-                                             (GDestroyNotify) g_free);
-    names_conflicts_table = g_hash_table_new_full (g_str_hash,
-                                                   g_str_equal,
-                                                   (GDestroyNotify) g_free,
-                                                   (GDestroyNotify) g_free);
-
-    /* names_conflicts_table is used for knowing which names from the list are not unique,
-     * so that they can easily be reached when needed */
-    for (l1 = dialog->new_names, l2 = dialog->selection;
-         l1 != NULL && l2 != NULL;
-         l1 = l1->next, l2 = l2->next)
-    {
-        new_name = l1->data;
-        file = NAUTILUS_FILE (l2->data);
-        parent_uri = nautilus_file_get_parent_uri (file);
-
-        tag_present = g_hash_table_lookup (new_names_table, new_name->str) != NULL;
-        same_parent_directory = g_strcmp0 (parent_uri, current_directory) == 0;
-
-        if (same_parent_directory)
-        {
-            if (!tag_present)
-            {
-                g_hash_table_insert (new_names_table,
-                                     g_strdup (new_name->str),
-                                     nautilus_file_get_parent_uri (file));
-            }
-            else
-            {
-                g_hash_table_insert (names_conflicts_table,
-                                     g_strdup (new_name->str),
-                                     nautilus_file_get_parent_uri (file));
-            }
-        }
-
-        g_free (parent_uri);
+    indices = batch_rename_conflicts_get_files_in (dialog->name_conflicts, current_directory);
+    if (indices == NULL)
+    {
+        return;
     }
 
-    for (l1 = files; l1 != NULL; l1 = l1->next)
+    directory_files_table = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+    for (l = files; l != NULL; l = l->next)
     {
-        file = NAUTILUS_FILE (l1->data);
-        g_hash_table_insert (directory_files_table,
-                             nautilus_file_get_name (file),
-                             GINT_TO_POINTER (TRUE));
+        g_hash_table_add (directory_files_table, nautilus_file_get_name (NAUTILUS_FILE (l->data)));
     }
 
-    for (l1 = dialog->selection, l2 = dialog->new_names; l1 != NULL && l2 != NULL; l1 = l1->next, l2 = l2->next)
+    for (i = 0; i < indices->len; i++)
     {
-        file = NAUTILUS_FILE (l1->data);
-
-        name = nautilus_file_get_name (file);
-        file_name = g_string_new (name);
-        g_free (name);
-
-        parent_uri = nautilus_file_get_parent_uri (file);
+        index = g_array_index (indices, guint, i);
 
-        new_name = l2->data;
-
-        have_conflict = FALSE;
-
-        /* check for duplicate only if the parent of the current file is
-         * the current directory and the name of the file has changed */
-        if (g_strcmp0 (parent_uri, current_directory) == 0 &&
-            !g_string_equal (new_name, file_name))
+        if (batch_rename_conflicts_has_conflict (dialog->name_conflicts, index, directory_files_table))
         {
-            exists = GPOINTER_TO_INT (g_hash_table_lookup (directory_files_table, new_name->str));
-
-            if (exists == TRUE &&
-                !file_name_conflicts_with_results (dialog->selection, dialog->new_names, new_name, parent_uri))
-            {
-                conflict_data = g_new (ConflictData, 1);
-                conflict_data->name = g_strdup (new_name->str);
-                conflict_data->index = g_list_index (dialog->selection, l1->data);
-                dialog->duplicates = g_list_prepend (dialog->duplicates,
-                                                     conflict_data);
-
-                have_conflict = TRUE;
-            }
+            conflict_data = g_new (ConflictData, 1);
+            conflict_data->name = g_strdup (batch_rename_conflicts_get_new_name (dialog->name_conflicts, index));
+            conflict_data->index = index;
+            dialog->duplicates = g_list_prepend (dialog->duplicates,
+                                                 conflict_data);
         }
-
-        if (!have_conflict)
-        {
-            tag_present = g_hash_table_lookup (names_conflicts_table, new_name->str) != NULL;
-            same_parent_directory = g_strcmp0 (parent_uri, current_directory) == 0;
-
-            if (tag_present && same_parent_directory)
-            {
-                conflict_data = g_new (ConflictData, 1);
-                conflict_data->name = g_strdup (new_name->str);
-                conflict_data->index = g_list_index (dialog->selection, l1->data);
-                dialog->duplicates = g_list_prepend (dialog->duplicates,
-                                                     conflict_data);
-
-                have_conflict = TRUE;
-            }
-        }
-
-        g_string_free (file_name, TRUE);
-        g_free (parent_uri);
     }
 
-    g_free (current_directory);
     g_hash_table_destroy (directory_files_table);
-    g_hash_table_destroy (new_names_table);
-    g_hash_table_destroy (names_conflicts_table);
 }
 
 static gboolean
@@ -1204,7 +1083,7 @@ on_file_names_list_has_duplicates (GObject      *object,
 
     self->duplicates = g_list_reverse (self->duplicates);
     self->checking_conflicts = FALSE;
-    update_listbox (self);
+    update_preview (self);
 }
 
 typedef struct
@@ -1470,28 +1349,65 @@ numbering_tag_is_some_added (NautilusBatchRenameDialog *self)
 }
 
 static void
-update_display_text (NautilusBatchRenameDialog *dialog)
+on_new_names_ready (GObject      *object,
+                    GAsyncResult *res,
+                    gpointer      user_data)
 {
-    if (dialog->conflict_cancellable != NULL)
+    NautilusBatchRenameDialog *self;
+    GList *new_names;
+    GList *l;
+    GString *new_name;
+    guint i;
+    g_autoptr (GError) error = NULL;
+
+    self = NAUTILUS_BATCH_RENAME_DIALOG (object);
+    new_names = g_task_propagate_pointer (G_TASK (res), &error);
+
+    /* a newer pattern is being worked on, or the dialog is going away */
+    if (error != NULL)
     {
-        g_cancellable_cancel (dialog->conflict_cancellable);
-        g_clear_object (&dialog->conflict_cancellable);
+        return;
     }
 
-    if(dialog->selection == NULL)
+    self->generating_names = FALSE;
+    g_clear_object (&self->new_names_cancellable);
+
+    clear_conflicts (self);
+
+    g_list_free_full (self->new_names, string_free);
+    self->new_names = new_names;
+
+    g_ptr_array_set_size (self->new_names_array, 0);
+    for (l = self->new_names, i = 0; l != NULL; l = l->next, i++)
+    {
+        new_name = l->data;
+
+        g_ptr_array_add (self->new_names_array, new_name);
+        batch_rename_conflicts_set_new_name (self->name_conflicts, i, new_name->str);
+    }
+
+    if (have_unallowed_character (self))
     {
         return;
     }
 
-    if (dialog->duplicates != NULL)
+    file_names_list_has_duplicates_async (self,
+                                          on_file_names_list_has_duplicates,
+                                          NULL);
+}
+
+static void
+update_display_text (NautilusBatchRenameDialog *dialog)
+{
+    if (dialog->conflict_cancellable != NULL)
     {
-        g_list_free_full (dialog->duplicates, conflict_data_free);
-        dialog->duplicates = NULL;
+        g_cancellable_cancel (dialog->conflict_cancellable);
+        g_clear_object (&dialog->conflict_cancellable);
     }
 
-    if (dialog->new_names != NULL)
+    if(dialog->selection == NULL)
     {
-        g_list_free_full (dialog->new_names, string_free);
+        return;
     }
 
     if (!numbering_tag_is_some_added (dialog))
@@ -1503,16 +1419,10 @@ update_display_text (NautilusBatchRenameDialog *dialog)
         gtk_revealer_set_reveal_child (GTK_REVEALER (dialog->numbering_revealer), TRUE);
     }
 
-    dialog->new_names = batch_rename_dialog_get_new_names (dialog);
-
-    if (have_unallowed_character (dialog))
-    {
-        return;
-    }
+    /* the original names show what is being replaced right away */
+    gtk_widget_queue_draw (dialog->tree_view);
 
-    file_names_list_has_duplicates_async (dialog,
-                                          on_file_names_list_has_duplicates,
-                                          NULL);
+    batch_rename_dialog_get_new_names_async (dialog, on_new_names_ready);
 }
 
 static void
@@ -1643,103 +1553,6 @@ nautilus_batch_rename_dialog_query_finished (NautilusBatchRenameDialog *dialog,
     }
 }
 
-static void
-update_row_shadowing (GtkWidget *row,
-                      gboolean   shown)
-{
-    GtkStyleContext *context;
-    GtkStateFlags flags;
-
-    if (!GTK_IS_LIST_BOX_ROW (row))
-    {
-        return;
-    }
-
-    context = gtk_widget_get_style_context (row);
-    flags = gtk_style_context_get_state (context);
-
-    if (shown)
-    {
-        flags |= GTK_STATE_PRELIGHT;
-    }
-    else
-    {
-        flags &= ~GTK_STATE_PRELIGHT;
-    }
-
-    gtk_style_context_set_state (context, flags);
-}
-
-static gboolean
-on_leave_event (GtkWidget      *widget,
-                GdkEventMotion *event,
-                gpointer        user_data)
-{
-    NautilusBatchRenameDialog *dialog;
-
-    dialog = NAUTILUS_BATCH_RENAME_DIALOG (user_data);
-
-    update_row_shadowing (dialog->preselected_row1, FALSE);
-    update_row_shadowing (dialog->preselected_row2, FALSE);
-
-    dialog->preselected_row1 = NULL;
-    dialog->preselected_row2 = NULL;
-
-    return FALSE;
-}
-
-static gboolean
-on_motion (GtkWidget      *widget,
-           GdkEventMotion *event,
-           gpointer        user_data)
-{
-    GtkListBoxRow *row;
-    NautilusBatchRenameDialog *dialog;
-
-    dialog = NAUTILUS_BATCH_RENAME_DIALOG (user_data);
-
-    if (dialog->preselected_row1 && dialog->preselected_row2)
-    {
-        update_row_shadowing (dialog->preselected_row1, FALSE);
-        update_row_shadowing (dialog->preselected_row2, FALSE);
-    }
-
-    if (widget == dialog->result_listbox)
-    {
-        row = gtk_list_box_get_row_at_y (GTK_LIST_BOX (dialog->original_name_listbox), event->y);
-        update_row_shadowing (GTK_WIDGET (row), TRUE);
-        dialog->preselected_row1 = GTK_WIDGET (row);
-
-        row = gtk_list_box_get_row_at_y (GTK_LIST_BOX (dialog->arrow_listbox), event->y);
-        update_row_shadowing (GTK_WIDGET (row), TRUE);
-        dialog->preselected_row2 = GTK_WIDGET (row);
-    }
-
-    if (widget == dialog->arrow_listbox)
-    {
-        row = gtk_list_box_get_row_at_y (GTK_LIST_BOX (dialog->original_name_listbox), event->y);
-        update_row_shadowing (GTK_WIDGET (row), TRUE);
-        dialog->preselected_row1 = GTK_WIDGET (row);
-
-        row = gtk_list_box_get_row_at_y (GTK_LIST_BOX (dialog->result_listbox), event->y);
-        update_row_shadowing (GTK_WIDGET (row), TRUE);
-        dialog->preselected_row2 = GTK_WIDGET (row);
-    }
-
-    if (widget == dialog->original_name_listbox)
-    {
-        row = gtk_list_box_get_row_at_y (GTK_LIST_BOX (dialog->result_listbox), event->y);
-        update_row_shadowing (GTK_WIDGET (row), TRUE);
-        dialog->preselected_row1 = GTK_WIDGET (row);
-
-        row = gtk_list_box_get_row_at_y (GTK_LIST_BOX (dialog->arrow_listbox), event->y);
-        update_row_shadowing (GTK_WIDGET (row), TRUE);
-        dialog->preselected_row2 = GTK_WIDGET (row);
-    }
-
-    return FALSE;
-}
-
 static void
 nautilus_batch_rename_dialog_initialize_actions (NautilusBatchRenameDialog *dialog)
 {
@@ -1986,8 +1799,6 @@ static void
 nautilus_batch_rename_dialog_finalize (GObject *object)
 {
     NautilusBatchRenameDialog *dialog;
-    GList *l;
-    guint i;
 
     dialog = NAUTILUS_BATCH_RENAME_DIALOG (object);
 
@@ -1997,29 +1808,9 @@ nautilus_batch_rename_dialog_finalize (GObject *object)
         g_clear_object (&dialog->conflict_cancellable);
     }
 
-    g_list_free (dialog->original_name_listbox_rows);
-    g_list_free (dialog->arrow_listbox_rows);
-    g_list_free (dialog->result_listbox_rows);
-    g_list_free (dialog->listbox_labels_new);
-    g_list_free (dialog->listbox_labels_old);
-    g_list_free (dialog->listbox_icons);
-
-    for (l = dialog->selection_metadata; l != NULL; l = l->next)
-    {
-        FileMetadata *file_metadata;
-
-        file_metadata = l->data;
-        for (i = 0; i < G_N_ELEMENTS (file_metadata->metadata); i++)
-        {
-            if (file_metadata->metadata[i])
-            {
-                g_string_free (file_metadata->metadata[i], TRUE);
-            }
-        }
+    g_clear_object (&dialog->new_names_cancellable);
 
-        g_string_free (file_metadata->file_name, TRUE);
-        g_free (file_metadata);
-    }
+    g_list_free_full (dialog->selection_metadata, file_metadata_free);
 
     if (dialog->create_date != NULL)
     {
@@ -2027,13 +1818,22 @@ nautilus_batch_rename_dialog_finalize (GObject *object)
     }
 
     g_list_free_full (dialog->new_names, string_free);
+    g_ptr_array_unref (dialog->new_names_array);
     g_list_free_full (dialog->duplicates, conflict_data_free);
+    g_ptr_array_unref (dialog->conflicts);
+    g_free (dialog->conflict_rows);
 
     nautilus_file_list_free (dialog->selection);
+    if (dialog->files != NULL)
+    {
+        g_ptr_array_unref (dialog->files);
+    }
+    if (dialog->name_conflicts != NULL)
+    {
+        batch_rename_conflicts_free (dialog->name_conflicts);
+    }
     nautilus_directory_unref (dialog->directory);
 
-    g_object_unref (dialog->size_group);
-
     g_hash_table_destroy (dialog->tag_info_table);
 
     G_OBJECT_CLASS (nautilus_batch_rename_dialog_parent_class)->finalize (object);
@@ -2054,9 +1854,7 @@ nautilus_batch_rename_dialog_class_init (NautilusBatchRenameDialogClass *klass)
 
     gtk_widget_class_bind_template_child (widget_class, NautilusBatchRenameDialog, grid);
     gtk_widget_class_bind_template_child (widget_class, NautilusBatchRenameDialog, cancel_button);
-    gtk_widget_class_bind_template_child (widget_class, NautilusBatchRenameDialog, original_name_listbox);
-    gtk_widget_class_bind_template_child (widget_class, NautilusBatchRenameDialog, arrow_listbox);
-    gtk_widget_class_bind_template_child (widget_class, NautilusBatchRenameDialog, result_listbox);
+    gtk_widget_class_bind_template_child (widget_class, NautilusBatchRenameDialog, tree_view);
     gtk_widget_class_bind_template_child (widget_class, NautilusBatchRenameDialog, name_entry);
     gtk_widget_class_bind_template_child (widget_class, NautilusBatchRenameDialog, rename_button);
     gtk_widget_class_bind_template_child (widget_class, NautilusBatchRenameDialog, find_entry);
@@ -2110,6 +1908,9 @@ nautilus_batch_rename_dialog_new (GList             *selection,
     dialog->directory = nautilus_directory_ref (directory);
     dialog->window = window;
 
+    update_file_names (dialog);
+    dialog->conflict_rows = g_new0 (gboolean, dialog->files->len);
+
     gtk_window_set_transient_for (GTK_WINDOW (dialog),
                                   GTK_WINDOW (window));
 
@@ -2167,9 +1968,9 @@ nautilus_batch_rename_dialog_new (GList             *selection,
 
     nautilus_batch_rename_dialog_initialize_actions (dialog);
 
-    update_display_text (dialog);
+    fill_display_model (dialog);
 
-    fill_display_listbox (dialog);
+    update_display_text (dialog);
 
     gdk_window_set_cursor (gtk_widget_get_window (GTK_WIDGET (window)), NULL);
 
@@ -2186,19 +1987,7 @@ nautilus_batch_rename_dialog_init (NautilusBatchRenameDialog *self)
 
     gtk_widget_init_template (GTK_WIDGET (self));
 
-    gtk_list_box_set_header_func (GTK_LIST_BOX (self->original_name_listbox),
-                                  (GtkListBoxUpdateHeaderFunc) listbox_header_func,
-                                  self,
-                                  NULL);
-    gtk_list_box_set_header_func (GTK_LIST_BOX (self->arrow_listbox),
-                                  (GtkListBoxUpdateHeaderFunc) listbox_header_func,
-                                  self,
-                                  NULL);
-    gtk_list_box_set_header_func (GTK_LIST_BOX (self->result_listbox),
-                                  (GtkListBoxUpdateHeaderFunc) listbox_header_func,
-                                  self,
-                                  NULL);
-
+    setup_preview (self);
 
     self->mode = NAUTILUS_BATCH_RENAME_DIALOG_FORMAT;
 
@@ -2213,7 +2002,9 @@ nautilus_batch_rename_dialog_init (NautilusBatchRenameDialog *self)
     gtk_label_set_max_width_chars (GTK_LABEL (self->conflict_label), 1);
 
     self->duplicates = NULL;
+    self->conflicts = g_ptr_array_new ();
     self->new_names = NULL;
+    self->new_names_array = g_ptr_array_new ();
 
     self->checking_conflicts = FALSE;
 
@@ -2252,38 +2043,4 @@ nautilus_batch_rename_dialog_init (NautilusBatchRenameDialog *self)
         tag_data->tag_constants = metadata_tags_constants[i];
         g_hash_table_insert (self->tag_info_table, g_strdup (tag_text_representation), tag_data);
     }
-
-    self->row_height = -1;
-
-    g_signal_connect (self->original_name_listbox, "row-selected", G_CALLBACK (row_selected), self);
-    g_signal_connect (self->arrow_listbox, "row-selected", G_CALLBACK (row_selected), self);
-    g_signal_connect (self->result_listbox, "row-selected", G_CALLBACK (row_selected), self);
-
-    self->size_group = gtk_size_group_new (GTK_SIZE_GROUP_HORIZONTAL);
-
-    g_signal_connect (self->original_name_listbox,
-                      "motion-notify-event",
-                      G_CALLBACK (on_motion),
-                      self);
-    g_signal_connect (self->result_listbox,
-                      "motion-notify-event",
-                      G_CALLBACK (on_motion),
-                      self);
-    g_signal_connect (self->arrow_listbox,
-                      "motion-notify-event",
-                      G_CALLBACK (on_motion),
-                      self);
-
-    g_signal_connect (self->original_name_listbox,
-                      "leave-notify-event",
-                      G_CALLBACK (on_leave_event),
-                      self);
-    g_signal_connect (self->result_listbox,
-                      "leave-notify-event",
-                      G_CALLBACK (on_leave_event),
-                      self);
-    g_signal_connect (self->arrow_listbox,
-                      "leave-notify-event",
-                      G_CALLBACK (on_leave_event),
-                      self);
 }
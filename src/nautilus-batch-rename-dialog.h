@@ -218,6 +218,15 @@ typedef struct {
     GString *metadata [G_N_ELEMENTS (metadata_tags_constants)];
 } FileMetadata;
 
+/* What the new names are made from, copied out of the NautilusFile so
+ * they can be generated in a thread */
+typedef struct
+{
+    gchar *name;
+    gchar *display_name;
+    gchar *extension;
+} FileNames;
+
 #define NAUTILUS_TYPE_BATCH_RENAME_DIALOG (nautilus_batch_rename_dialog_get_type())
 
 G_DECLARE_FINAL_TYPE (NautilusBatchRenameDialog, nautilus_batch_rename_dialog, NAUTILUS, BATCH_RENAME_DIALOG, GtkDialog);
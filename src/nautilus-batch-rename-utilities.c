@@ -32,16 +32,45 @@ typedef struct
     gint position;
 } CreateDateElem;
 
+/* Files asked to Tracker at once, so that the query stays a reasonable
+ * size and the cache fills up as the pages come in */
+#define METADATA_QUERY_PAGE_SIZE 200
+/* The cache is dropped rather than grown past this */
+#define METADATA_CACHE_MAX_FILES 50000
+
+/* What Tracker knows about a file. Kept across dialogs, by uri, for as
+ * long as the file has the same modification time. */
+typedef struct
+{
+    time_t mtime;
+    gint64 creation_time;
+    gchar *metadata[G_N_ELEMENTS (metadata_tags_constants)];
+} CachedMetadata;
+
 typedef struct
 {
     NautilusBatchRenameDialog *dialog;
-    GHashTable *date_order_hash_table;
+    TrackerSparqlConnection *connection;
+
+    /* Uris of the selection, in the same order as selection_metadata */
+    GPtrArray *uris;
+    /* Uri to CachedMetadata, for the files Tracker is asked about. They
+     * move to the cache as the rows come in. */
+    GHashTable *pending;
+    GPtrArray *pending_uris;
+    guint next_page;
 
     GList *selection_metadata;
 
     gboolean has_metadata[G_N_ELEMENTS (metadata_tags_constants)];
 } QueryData;
 
+typedef struct
+{
+    const gchar *file_name;
+    gint64 creation_time;
+} CreationTime;
+
 enum
 {
     FILE_NAME_INDEX,
@@ -59,11 +88,28 @@ enum
     ARTIST_NAME_INDEX,
     TITLE_INDEX,
     ALBUM_NAME_INDEX,
+    URL_INDEX,
 } QueryMetadata;
 
-static void on_cursor_callback (GObject      *object,
-                                GAsyncResult *result,
-                                gpointer      user_data);
+/* The columns that are stored as they come */
+static const struct
+{
+    MetadataType metadata_type;
+    gint column;
+} metadata_columns[] =
+{
+    { EQUIPMENT, CAMERA_MODEL_INDEX },
+    { SEASON_NUMBER, SEASON_INDEX },
+    { EPISODE_NUMBER, EPISODE_NUMBER_INDEX },
+    { TRACK_NUMBER, TRACK_NUMBER_INDEX },
+    { ARTIST_NAME, ARTIST_NAME_INDEX },
+    { TITLE, TITLE_INDEX },
+    { ALBUM_NAME, ALBUM_NAME_INDEX },
+};
+
+static GHashTable *metadata_cache = NULL;
+
+static void query_next_page (QueryData *query_data);
 
 void
 string_free (gpointer mem)
@@ -83,6 +129,48 @@ conflict_data_free (gpointer mem)
     g_free (conflict_data);
 }
 
+FileNames *
+file_names_new (NautilusFile *file)
+{
+    FileNames *file_names;
+
+    file_names = g_new (FileNames, 1);
+    file_names->name = nautilus_file_get_name (file);
+    file_names->display_name = nautilus_file_get_display_name (file);
+    file_names->extension = nautilus_file_get_extension (file);
+
+    return file_names;
+}
+
+void
+file_names_free (gpointer mem)
+{
+    FileNames *file_names = mem;
+
+    g_free (file_names->name);
+    g_free (file_names->display_name);
+    g_free (file_names->extension);
+    g_free (file_names);
+}
+
+void
+file_metadata_free (gpointer mem)
+{
+    FileMetadata *file_metadata = mem;
+    guint i;
+
+    for (i = 0; i < G_N_ELEMENTS (file_metadata->metadata); i++)
+    {
+        if (file_metadata->metadata[i])
+        {
+            g_string_free (file_metadata->metadata[i], TRUE);
+        }
+    }
+
+    g_string_free (file_metadata->file_name, TRUE);
+    g_free (file_metadata);
+}
+
 gchar *
 batch_rename_get_tag_text_representation (TagConstants tag_constants)
 {
@@ -311,7 +399,7 @@ batch_rename_replace_label_text (gchar       *label,
 
 static gchar *
 get_metadata (GList        *selection_metadata,
-              gchar        *file_name,
+              const gchar  *file_name,
               MetadataType  metadata_type)
 {
     GList *l;
@@ -337,23 +425,23 @@ get_metadata (GList        *selection_metadata,
 }
 
 static GString *
-batch_rename_format (NautilusFile *file,
-                     GList        *text_chunks,
-                     GList        *selection_metadata,
-                     gint          count)
+batch_rename_format (FileNames *file,
+                     GList     *text_chunks,
+                     GList     *selection_metadata,
+                     gint       count)
 {
     GList *l;
     GString *tag_string;
     GString *new_name;
     gboolean added_tag;
     MetadataType metadata_type;
-    g_autofree gchar *file_name = NULL;
-    g_autofree gchar *extension = NULL;
+    const gchar *file_name;
+    const gchar *extension;
     gint i;
     gchar *metadata;
 
-    file_name = nautilus_file_get_display_name (file);
-    extension = nautilus_file_get_extension (file);
+    file_name = file->display_name;
+    extension = file->extension;
 
     new_name = g_string_new ("");
 
@@ -477,31 +565,36 @@ batch_rename_format (NautilusFile *file,
     return new_name;
 }
 
+/* Only touches @files and the other arguments, so it can run in a
+ * thread. Returns the new names in reverse order, or NULL if
+ * @cancellable was cancelled. */
 GList *
 batch_rename_dialog_get_new_names_list (NautilusBatchRenameDialogMode  mode,
-                                        GList                         *selection,
+                                        GPtrArray                     *files,
                                         GList                         *text_chunks,
                                         GList                         *selection_metadata,
                                         gchar                         *entry_text,
-                                        gchar                         *replace_text)
+                                        gchar                         *replace_text,
+                                        GCancellable                  *cancellable)
 {
-    GList *l;
     GList *result;
-    GString *file_name;
     GString *new_name;
-    NautilusFile *file;
-    gchar *name;
-    gint count;
+    FileNames *file;
+    guint i;
 
     result = NULL;
-    count = 1;
 
-    for (l = selection; l != NULL; l = l->next)
+    for (i = 0; i < files->len; i++)
     {
-        file = NAUTILUS_FILE (l->data);
+        /* checking on every file would cost more than the names */
+        if (i % 256 == 0 && g_cancellable_is_cancelled (cancellable))
+        {
+            g_list_free_full (result, string_free);
+
+            return NULL;
+        }
 
-        name = nautilus_file_get_name (file);
-        file_name = g_string_new (name);
+        file = g_ptr_array_index (files, i);
 
         /* get the new name here and add it to the list*/
         if (mode == NAUTILUS_BATCH_RENAME_DIALOG_FORMAT)
@@ -509,70 +602,244 @@ batch_rename_dialog_get_new_names_list (NautilusBatchRenameDialogMode  mode,
             new_name = batch_rename_format (file,
                                             text_chunks,
                                             selection_metadata,
-                                            count++);
-            result = g_list_prepend (result, new_name);
+                                            i + 1);
         }
-
-        if (mode == NAUTILUS_BATCH_RENAME_DIALOG_REPLACE)
+        else
         {
-            new_name = batch_rename_replace (file_name->str,
+            new_name = batch_rename_replace (file->name,
                                              entry_text,
                                              replace_text);
-            result = g_list_prepend (result, new_name);
         }
 
-        g_string_free (file_name, TRUE);
-        g_free (name);
+        result = g_list_prepend (result, new_name);
     }
 
     return result;
 }
 
-/* There is a case that a new name for a file conflicts with an existing file name
- * in the directory but it's not a problem because the file in the directory that
- * conflicts is part of the batch renaming selection and it's going to change the name anyway. */
+typedef struct
+{
+    gchar *parent_uri;
+    gchar *old_name;
+    gchar *new_name;
+    /* "parent_uri/name", which can't be ambiguous since names have no
+     * slashes */
+    gchar *old_key;
+    gchar *new_key;
+} ConflictEntry;
+
+struct _BatchRenameConflicts
+{
+    GArray *entries;
+    /* old_key -> index + 1 */
+    GHashTable *old_names;
+    /* new_key -> how many files get that name */
+    GHashTable *new_name_counts;
+    /* parent_uri -> GArray of the indices of the files in it */
+    GHashTable *parents;
+};
+
+static void
+conflict_entry_clear (gpointer data)
+{
+    ConflictEntry *entry = data;
+
+    g_free (entry->parent_uri);
+    g_free (entry->old_name);
+    g_free (entry->new_name);
+    g_free (entry->old_key);
+    g_free (entry->new_key);
+}
+
+BatchRenameConflicts *
+batch_rename_conflicts_new (void)
+{
+    BatchRenameConflicts *conflicts;
+
+    conflicts = g_new0 (BatchRenameConflicts, 1);
+    conflicts->entries = g_array_new (FALSE, TRUE, sizeof (ConflictEntry));
+    g_array_set_clear_func (conflicts->entries, conflict_entry_clear);
+    conflicts->old_names = g_hash_table_new (g_str_hash, g_str_equal);
+    conflicts->new_name_counts = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+    conflicts->parents = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                                g_free, (GDestroyNotify) g_array_unref);
+
+    return conflicts;
+}
+
+void
+batch_rename_conflicts_free (BatchRenameConflicts *conflicts)
+{
+    g_hash_table_destroy (conflicts->old_names);
+    g_hash_table_destroy (conflicts->new_name_counts);
+    g_hash_table_destroy (conflicts->parents);
+    g_array_free (conflicts->entries, TRUE);
+    g_free (conflicts);
+}
+
+/* Returns the index of the file, which is also the order it was added in */
+guint
+batch_rename_conflicts_add_file (BatchRenameConflicts *conflicts,
+                                 const gchar          *parent_uri,
+                                 const gchar          *old_name)
+{
+    ConflictEntry entry = { 0 };
+    GArray *siblings;
+    guint index;
+
+    index = conflicts->entries->len;
+
+    entry.parent_uri = g_strdup (parent_uri);
+    entry.old_name = g_strdup (old_name);
+    entry.old_key = g_strconcat (parent_uri, "/", old_name, NULL);
+    g_array_append_val (conflicts->entries, entry);
+
+    g_hash_table_insert (conflicts->old_names, entry.old_key, GUINT_TO_POINTER (index + 1));
+
+    siblings = g_hash_table_lookup (conflicts->parents, parent_uri);
+    if (siblings == NULL)
+    {
+        siblings = g_array_new (FALSE, FALSE, sizeof (guint));
+        g_hash_table_insert (conflicts->parents, g_strdup (parent_uri), siblings);
+    }
+    g_array_append_val (siblings, index);
+
+    return index;
+}
+
+static void
+new_name_count_add (BatchRenameConflicts *conflicts,
+                    const gchar          *key,
+                    gint                  delta)
+{
+    gint count;
+
+    count = GPOINTER_TO_INT (g_hash_table_lookup (conflicts->new_name_counts, key)) + delta;
+    if (count > 0)
+    {
+        g_hash_table_insert (conflicts->new_name_counts, g_strdup (key), GINT_TO_POINTER (count));
+    }
+    else
+    {
+        g_hash_table_remove (conflicts->new_name_counts, key);
+    }
+}
+
+/* Only the files whose name really changes cost anything, so this can be
+ * called for every file each time the names are generated again */
+void
+batch_rename_conflicts_set_new_name (BatchRenameConflicts *conflicts,
+                                     guint                 index,
+                                     const gchar          *new_name)
+{
+    ConflictEntry *entry;
+
+    g_return_if_fail (index < conflicts->entries->len);
+
+    entry = &g_array_index (conflicts->entries, ConflictEntry, index);
+    if (g_strcmp0 (entry->new_name, new_name) == 0)
+    {
+        return;
+    }
+
+    if (entry->new_key != NULL)
+    {
+        new_name_count_add (conflicts, entry->new_key, -1);
+    }
+
+    g_free (entry->new_name);
+    g_free (entry->new_key);
+    entry->new_name = g_strdup (new_name);
+    entry->new_key = g_strconcat (entry->parent_uri, "/", new_name, NULL);
+
+    new_name_count_add (conflicts, entry->new_key, 1);
+}
+
+const gchar *
+batch_rename_conflicts_get_new_name (BatchRenameConflicts *conflicts,
+                                     guint                 index)
+{
+    g_return_val_if_fail (index < conflicts->entries->len, NULL);
+
+    return g_array_index (conflicts->entries, ConflictEntry, index).new_name;
+}
+
+/* Returns the indices of the files in @parent_uri, or NULL if none is */
+GArray *
+batch_rename_conflicts_get_files_in (BatchRenameConflicts *conflicts,
+                                     const gchar          *parent_uri)
+{
+    return g_hash_table_lookup (conflicts->parents, parent_uri);
+}
+
+/* Whether another file of the selection gets the same new name in the
+ * same directory */
 gboolean
-file_name_conflicts_with_results (GList   *selection,
-                                  GList   *new_names,
-                                  GString *old_name,
-                                  gchar   *parent_uri)
+batch_rename_conflicts_is_duplicate (BatchRenameConflicts *conflicts,
+                                     guint                 index)
 {
-    GList *l1;
-    GList *l2;
-    NautilusFile *selection_file;
-    GString *new_name;
+    ConflictEntry *entry;
+
+    g_return_val_if_fail (index < conflicts->entries->len, FALSE);
 
-    for (l1 = selection, l2 = new_names; l1 != NULL && l2 != NULL; l1 = l1->next, l2 = l2->next)
+    entry = &g_array_index (conflicts->entries, ConflictEntry, index);
+    if (entry->new_key == NULL)
     {
-        g_autofree gchar *name1 = NULL;
-        g_autofree gchar *selection_parent_uri = NULL;
+        return FALSE;
+    }
+
+    return GPOINTER_TO_INT (g_hash_table_lookup (conflicts->new_name_counts, entry->new_key)) > 1;
+}
 
-        selection_file = NAUTILUS_FILE (l1->data);
-        name1 = nautilus_file_get_name (selection_file);
+/**
+ * batch_rename_conflicts_has_conflict:
+ * @conflicts: the files being renamed
+ * @index: the file to check
+ * @existing_names: (nullable): the names of the files now in its directory
+ *
+ * A file conflicts if another file of the selection gets the same new
+ * name in the same directory, or if its new name is taken by a file that
+ * keeps its name. Files of the selection that are renamed to something
+ * else free their names.
+ */
+gboolean
+batch_rename_conflicts_has_conflict (BatchRenameConflicts *conflicts,
+                                     guint                 index,
+                                     GHashTable           *existing_names)
+{
+    ConflictEntry *entry;
+    ConflictEntry *owner;
+    guint owner_index;
 
-        selection_parent_uri = nautilus_file_get_parent_uri (selection_file);
+    g_return_val_if_fail (index < conflicts->entries->len, FALSE);
 
-        if (g_strcmp0 (name1, old_name->str) == 0)
-        {
-            new_name = l2->data;
+    entry = &g_array_index (conflicts->entries, ConflictEntry, index);
+    if (entry->new_name == NULL)
+    {
+        return FALSE;
+    }
 
-            /* if the name didn't change, then there's a conflict */
-            if (g_string_equal (old_name, new_name) &&
-                (parent_uri == NULL || g_strcmp0 (parent_uri, selection_parent_uri) == 0))
-            {
-                return FALSE;
-            }
+    if (batch_rename_conflicts_is_duplicate (conflicts, index))
+    {
+        return TRUE;
+    }
 
+    if (existing_names == NULL ||
+        g_strcmp0 (entry->new_name, entry->old_name) == 0 ||
+        !g_hash_table_contains (existing_names, entry->new_name))
+    {
+        return FALSE;
+    }
 
-            /* if this file exists and it changed it's name, then there's no
-             * conflict */
-            return TRUE;
-        }
+    owner_index = GPOINTER_TO_UINT (g_hash_table_lookup (conflicts->old_names, entry->new_key));
+    if (owner_index == 0)
+    {
+        return TRUE;
     }
 
-    /* the case this function searched for doesn't exist, so the file
-     * has a conlfict */
-    return FALSE;
+    owner = &g_array_index (conflicts->entries, ConflictEntry, owner_index - 1);
+
+    return g_strcmp0 (owner->new_name, owner->old_name) == 0;
 }
 
 static gint
@@ -735,13 +1002,34 @@ nautilus_batch_rename_dialog_sort (GList      *selection,
 }
 
 static void
-cursor_next (QueryData           *query_data,
-             TrackerSparqlCursor *cursor)
+cached_metadata_free (gpointer mem)
 {
-    tracker_sparql_cursor_next_async (cursor,
-                                      NULL,
-                                      on_cursor_callback,
-                                      query_data);
+    CachedMetadata *cached = mem;
+    guint i;
+
+    for (i = 0; i < G_N_ELEMENTS (cached->metadata); i++)
+    {
+        g_free (cached->metadata[i]);
+    }
+
+    g_free (cached);
+}
+
+static void
+query_data_free (QueryData *query_data)
+{
+    if (query_data->dialog != NULL)
+    {
+        g_object_remove_weak_pointer (G_OBJECT (query_data->dialog),
+                                      (gpointer *) &query_data->dialog);
+    }
+
+    g_list_free_full (query_data->selection_metadata, file_metadata_free);
+    g_clear_object (&query_data->connection);
+    g_ptr_array_unref (query_data->uris);
+    g_hash_table_destroy (query_data->pending);
+    g_ptr_array_unref (query_data->pending_uris);
+    g_free (query_data);
 }
 
 static void
@@ -764,223 +1052,224 @@ remove_metadata (QueryData    *query_data,
     query_data->has_metadata[metadata_type] = FALSE;
 }
 
-static GString *
+static gchar *
 format_date_time (GDateTime *date_time)
 {
-    g_autofree gchar *date = NULL;
+    gchar *date;
     GString *formated_date;
 
     date = g_date_time_format (date_time, "%x");
-    if (strstr (date, "/") != NULL)
+    if (strstr (date, "/") == NULL)
     {
-        formated_date = batch_rename_replace (date, "/", "-");
+        return date;
     }
-    else
+
+    formated_date = batch_rename_replace (date, "/", "-");
+    g_free (date);
+
+    return g_string_free (formated_date, FALSE);
+}
+
+static gint
+compare_creation_times (gconstpointer a,
+                        gconstpointer b)
+{
+    const CreationTime *time_a = a;
+    const CreationTime *time_b = b;
+
+    if (time_a->creation_time != time_b->creation_time)
     {
-        formated_date = g_string_new (date);
+        return time_a->creation_time < time_b->creation_time ? -1 : 1;
     }
 
-    return formated_date;
+    return g_strcmp0 (time_a->file_name, time_b->file_name);
 }
 
+/* Gives the dialog the metadata of its selection, now that the cache has
+ * all Tracker knows about it */
 static void
-on_cursor_callback (GObject      *object,
-                    GAsyncResult *result,
-                    gpointer      user_data)
+query_data_finish (QueryData *query_data)
 {
-    TrackerSparqlCursor *cursor;
-    gboolean success;
-    QueryData *query_data;
-    MetadataType metadata_type;
-    GError *error;
-    GList *l;
+    GHashTable *date_order_hash_table;
+    GArray *creation_times;
+    CreationTime creation_time;
+    CachedMetadata *cached;
     FileMetadata *file_metadata;
-    GDateTime *date_time;
-    guint i;
+    MetadataType metadata_type;
     const gchar *current_metadata;
-    const gchar *file_name;
-    const gchar *creation_date;
-    const gchar *year;
-    const gchar *month;
-    const gchar *day;
-    const gchar *hours;
-    const gchar *minutes;
-    const gchar *seconds;
-    const gchar *equipment;
-    const gchar *season_number;
-    const gchar *episode_number;
-    const gchar *track_number;
-    const gchar *artist_name;
-    const gchar *title;
-    const gchar *album_name;
+    GList *l;
+    guint i, j;
 
-    error = NULL;
-    file_metadata = NULL;
+    if (query_data->dialog == NULL)
+    {
+        query_data_free (query_data);
+        return;
+    }
 
-    cursor = TRACKER_SPARQL_CURSOR (object);
-    query_data = user_data;
+    creation_times = g_array_new (FALSE, FALSE, sizeof (CreationTime));
 
-    success = tracker_sparql_cursor_next_finish (cursor, result, &error);
-    if (!success)
+    for (l = query_data->selection_metadata, i = 0; l != NULL; l = l->next, i++)
     {
-        if (error)
+        file_metadata = l->data;
+
+        /* Files Tracker doesn't know about don't get any metadata, but
+         * don't take it away from the others either */
+        cached = g_hash_table_lookup (metadata_cache,
+                                      g_ptr_array_index (query_data->uris, i));
+        if (cached == NULL)
         {
-            g_warning ("Error on batch rename tracker query cursor: %s", error->message);
-            g_error_free (error);
+            continue;
         }
 
-        g_clear_object (&cursor);
-
-        nautilus_batch_rename_dialog_query_finished (query_data->dialog,
-                                                     query_data->date_order_hash_table,
-                                                     query_data->selection_metadata);
+        /* Set metadata when available, and delete for the whole selection when not */
+        for (j = 0; j < G_N_ELEMENTS (metadata_tags_constants); j++)
+        {
+            metadata_type = metadata_tags_constants[j].metadata_type;
+            if (metadata_type == ORIGINAL_FILE_NAME ||
+                !query_data->has_metadata[metadata_type])
+            {
+                continue;
+            }
 
-        g_free (query_data);
+            /* TODO: Figure out how to inform the user of why the metadata is
+             * unavailable when one or more contains the unallowed character "/"
+             */
+            current_metadata = cached->metadata[metadata_type];
+            if (!current_metadata ||
+                (metadata_type != CREATION_DATE && g_strrstr (current_metadata, "/")))
+            {
+                remove_metadata (query_data, metadata_type);
+            }
+            else
+            {
+                file_metadata->metadata[metadata_type] = g_string_new (current_metadata);
+            }
+        }
 
-        return;
+        if (query_data->has_metadata[CREATION_DATE])
+        {
+            creation_time.file_name = file_metadata->file_name->str;
+            creation_time.creation_time = cached->creation_time;
+            g_array_append_val (creation_times, creation_time);
+        }
     }
 
-    creation_date = tracker_sparql_cursor_get_string (cursor, CREATION_DATE_INDEX, NULL);
-
-    year = tracker_sparql_cursor_get_string (cursor, YEAR_INDEX, NULL);
-    month = tracker_sparql_cursor_get_string (cursor, MONTH_INDEX, NULL);
-    day = tracker_sparql_cursor_get_string (cursor, DAY_INDEX, NULL);
-    hours = tracker_sparql_cursor_get_string (cursor, HOURS_INDEX, NULL);
-    minutes = tracker_sparql_cursor_get_string (cursor, MINUTES_INDEX, NULL);
-    seconds = tracker_sparql_cursor_get_string (cursor, SECONDS_INDEX, NULL);
-    equipment = tracker_sparql_cursor_get_string (cursor, CAMERA_MODEL_INDEX, NULL);
-    season_number = tracker_sparql_cursor_get_string (cursor, SEASON_INDEX, NULL);
-    episode_number = tracker_sparql_cursor_get_string (cursor, EPISODE_NUMBER_INDEX, NULL);
-    track_number = tracker_sparql_cursor_get_string (cursor, TRACK_NUMBER_INDEX, NULL);
-    artist_name = tracker_sparql_cursor_get_string (cursor, ARTIST_NAME_INDEX, NULL);
-    title = tracker_sparql_cursor_get_string (cursor, TITLE_INDEX, NULL);
-    album_name = tracker_sparql_cursor_get_string (cursor, ALBUM_NAME_INDEX, NULL);
-
-    /* Search for the metadata object corresponding to the file name */
-    file_name = tracker_sparql_cursor_get_string (cursor, FILE_NAME_INDEX, NULL);
-    for (l = query_data->selection_metadata; l != NULL; l = l->next)
+    date_order_hash_table = NULL;
+    if (query_data->has_metadata[CREATION_DATE])
     {
-        file_metadata = l->data;
-
-        if (g_strcmp0 (file_name, file_metadata->file_name->str) == 0)
+        /* The order the files were created in, for sorting by it */
+        g_array_sort (creation_times, compare_creation_times);
+
+        date_order_hash_table = g_hash_table_new_full (g_str_hash,
+                                                       g_str_equal,
+                                                       (GDestroyNotify) g_free,
+                                                       NULL);
+        for (i = 0; i < creation_times->len; i++)
         {
-            break;
+            g_hash_table_insert (date_order_hash_table,
+                                 g_strdup (g_array_index (creation_times, CreationTime, i).file_name),
+                                 GINT_TO_POINTER (i));
         }
     }
 
-    /* Set metadata when available, and delete for the whole selection when not */
-    for (i = 0; i < G_N_ELEMENTS (metadata_tags_constants); i++)
-    {
-        if (query_data->has_metadata[i])
-        {
-            metadata_type = metadata_tags_constants[i].metadata_type;
-            current_metadata = NULL;
-            switch (metadata_type)
-            {
-                case ORIGINAL_FILE_NAME:
-                {
-                    current_metadata = file_name;
-                }
-                break;
+    g_array_free (creation_times, TRUE);
 
-                case CREATION_DATE:
-                {
-                    current_metadata = creation_date;
-                }
-                break;
+    nautilus_batch_rename_dialog_query_finished (query_data->dialog,
+                                                 date_order_hash_table,
+                                                 query_data->selection_metadata);
+    query_data->selection_metadata = NULL;
 
-                case EQUIPMENT:
-                {
-                    current_metadata = equipment;
-                }
-                break;
+    query_data_free (query_data);
+}
 
-                case SEASON_NUMBER:
-                {
-                    current_metadata = season_number;
-                }
-                break;
+static gboolean
+query_data_finish_idle (gpointer user_data)
+{
+    query_data_finish (user_data);
 
-                case EPISODE_NUMBER:
-                {
-                    current_metadata = episode_number;
-                }
-                break;
+    return G_SOURCE_REMOVE;
+}
 
-                case ARTIST_NAME:
-                {
-                    current_metadata = artist_name;
-                }
-                break;
+static void
+cache_metadata_row (QueryData           *query_data,
+                    TrackerSparqlCursor *cursor)
+{
+    CachedMetadata *cached;
+    GDateTime *date_time;
+    const gchar *url;
+    const gchar *value;
+    gpointer key;
+    guint i;
 
-                case ALBUM_NAME:
-                {
-                    current_metadata = album_name;
-                }
-                break;
+    url = tracker_sparql_cursor_get_string (cursor, URL_INDEX, NULL);
+    if (url == NULL ||
+        !g_hash_table_lookup_extended (query_data->pending, url, &key, (gpointer *) &cached))
+    {
+        return;
+    }
+    g_hash_table_steal (query_data->pending, key);
 
-                case TITLE:
-                {
-                    current_metadata = title;
-                }
-                break;
+    for (i = 0; i < G_N_ELEMENTS (metadata_columns); i++)
+    {
+        value = tracker_sparql_cursor_get_string (cursor, metadata_columns[i].column, NULL);
+        cached->metadata[metadata_columns[i].metadata_type] = g_strdup (value);
+    }
 
-                case TRACK_NUMBER:
-                {
-                    current_metadata = track_number;
-                }
-                break;
+    /* Dates are formatted once, when they come in */
+    if (tracker_sparql_cursor_get_string (cursor, CREATION_DATE_INDEX, NULL) != NULL)
+    {
+        date_time = g_date_time_new_local (atoi (tracker_sparql_cursor_get_string (cursor, YEAR_INDEX, NULL)),
+                                           atoi (tracker_sparql_cursor_get_string (cursor, MONTH_INDEX, NULL)),
+                                           atoi (tracker_sparql_cursor_get_string (cursor, DAY_INDEX, NULL)),
+                                           atoi (tracker_sparql_cursor_get_string (cursor, HOURS_INDEX, NULL)),
+                                           atoi (tracker_sparql_cursor_get_string (cursor, MINUTES_INDEX, NULL)),
+                                           atoi (tracker_sparql_cursor_get_string (cursor, SECONDS_INDEX, NULL)));
+        if (date_time != NULL)
+        {
+            cached->creation_time = g_date_time_to_unix (date_time);
+            cached->metadata[CREATION_DATE] = format_date_time (date_time);
+            g_date_time_unref (date_time);
+        }
+    }
 
-                default:
-                {
-                    g_warn_if_reached ();
-                }
-                break;
-            }
+    g_hash_table_replace (metadata_cache, key, cached);
+}
 
-            /* TODO: Figure out how to inform the user of why the metadata is
-             * unavailable when one or more contains the unallowed character "/"
-             */
-            if (!current_metadata || g_strrstr (current_metadata, "/"))
-            {
-                remove_metadata (query_data,
-                                 metadata_type);
+static void
+on_cursor_callback (GObject      *object,
+                    GAsyncResult *result,
+                    gpointer      user_data)
+{
+    TrackerSparqlCursor *cursor;
+    QueryData *query_data;
+    GError *error;
 
-                if (metadata_type == CREATION_DATE &&
-                    query_data->date_order_hash_table)
-                {
-                    g_hash_table_destroy (query_data->date_order_hash_table);
-                    query_data->date_order_hash_table = NULL;
-                }
-            }
-            else
-            {
-                if (metadata_type == CREATION_DATE)
-                {
-                    /* Add the sort order to the order hash table */
-                    g_hash_table_insert (query_data->date_order_hash_table,
-                                         g_strdup (tracker_sparql_cursor_get_string (cursor, 0, NULL)),
-                                         GINT_TO_POINTER (g_hash_table_size (query_data->date_order_hash_table)));
-
-                    date_time = g_date_time_new_local (atoi (year),
-                                                       atoi (month),
-                                                       atoi (day),
-                                                       atoi (hours),
-                                                       atoi (minutes),
-                                                       atoi (seconds));
-
-                    file_metadata->metadata[metadata_type] = format_date_time (date_time);
-                }
-                else
-                {
-                    file_metadata->metadata[metadata_type] = g_string_new (current_metadata);
-                }
-            }
+    error = NULL;
+
+    cursor = TRACKER_SPARQL_CURSOR (object);
+    query_data = user_data;
+
+    if (!tracker_sparql_cursor_next_finish (cursor, result, &error))
+    {
+        if (error)
+        {
+            g_warning ("Error on batch rename tracker query cursor: %s", error->message);
+            g_error_free (error);
         }
+
+        g_object_unref (cursor);
+
+        query_next_page (query_data);
+
+        return;
     }
 
-    /* Get next */
-    cursor_next (query_data, cursor);
+    cache_metadata_row (query_data, cursor);
+
+    tracker_sparql_cursor_next_async (cursor,
+                                      NULL,
+                                      on_cursor_callback,
+                                      query_data);
 }
 
 static void
@@ -1007,36 +1296,34 @@ batch_rename_dialog_query_callback (GObject      *object,
         g_warning ("Error on batch rename query for metadata: %s", error->message);
         g_error_free (error);
 
-        nautilus_batch_rename_dialog_query_finished (query_data->dialog,
-                                                     query_data->date_order_hash_table,
-                                                     query_data->selection_metadata);
-
-        g_free (query_data);
+        query_data_finish (query_data);
     }
     else
     {
-        cursor_next (query_data, cursor);
+        tracker_sparql_cursor_next_async (cursor,
+                                          NULL,
+                                          on_cursor_callback,
+                                          query_data);
     }
 }
 
-void
-check_metadata_for_selection (NautilusBatchRenameDialog *dialog,
-                              GList                     *selection)
+/* Asks Tracker about the next METADATA_QUERY_PAGE_SIZE files that aren't
+ * cached, or finishes when there are none left */
+static void
+query_next_page (QueryData *query_data)
 {
-    TrackerSparqlConnection *connection;
     GString *query;
-    GList *l;
-    NautilusFile *file;
-    GError *error;
-    QueryData *query_data;
-    gchar *file_name;
-    FileMetadata *file_metadata;
-    GList *selection_metadata;
+    g_autofree gchar *escaped_uri = NULL;
+    guint end;
     guint i;
-    g_autofree gchar *parent_uri = NULL;
 
-    error = NULL;
-    selection_metadata = NULL;
+    /* Nobody is waiting for the rest anymore */
+    if (query_data->dialog == NULL ||
+        query_data->next_page >= query_data->pending_uris->len)
+    {
+        query_data_finish (query_data);
+        return;
+    }
 
     query = g_string_new ("SELECT "
                           "nfo:fileName(?file) "
@@ -1054,50 +1341,54 @@ check_metadata_for_selection (NautilusBatchRenameDialog *dialog,
                           "nmm:artistName(nmm:performer(?file)) "
                           "nie:title(?file) "
                           "nmm:albumTitle(nmm:musicAlbum(?file)) "
-                          "WHERE { ?file a nfo:FileDataObject. ");
-
-    parent_uri = nautilus_file_get_parent_uri (NAUTILUS_FILE (selection->data));
+                          "nie:url(?file) "
+                          "WHERE { ?file a nfo:FileDataObject. "
+                          "FILTER (nie:url(?file) IN (");
 
-    g_string_append_printf (query,
-                            "FILTER(tracker:uri-is-parent('%s', nie:url(?file))) ",
-                            parent_uri);
-
-    for (l = selection; l != NULL; l = l->next)
+    end = MIN (query_data->next_page + METADATA_QUERY_PAGE_SIZE,
+               query_data->pending_uris->len);
+    for (i = query_data->next_page; i < end; i++)
     {
-        file = NAUTILUS_FILE (l->data);
-        file_name = nautilus_file_get_name (file);
+        g_free (escaped_uri);
+        escaped_uri = tracker_sparql_escape_string (g_ptr_array_index (query_data->pending_uris, i));
 
-        if (l == selection)
-        {
-            g_string_append_printf (query,
-                                    "FILTER (nfo:fileName(?file) IN ('%s', ",
-                                    file_name);
-        }
-        else if (l->next == NULL)
-        {
-            g_string_append_printf (query,
-                                    "'%s')) ",
-                                    file_name);
-        }
-        else
-        {
-            g_string_append_printf (query,
-                                    "'%s', ",
-                                    file_name);
-        }
+        g_string_append_printf (query,
+                                i + 1 < end ? "'%s', " : "'%s'",
+                                escaped_uri);
+    }
+    query_data->next_page = end;
 
-        file_metadata = g_new0 (FileMetadata, 1);
-        file_metadata->file_name = g_string_new (file_name);
-        file_metadata->metadata[ORIGINAL_FILE_NAME] = g_string_new (file_name);
+    g_string_append (query, ")) }");
 
-        selection_metadata = g_list_prepend (selection_metadata, file_metadata);
+    /* Make an asynchronous query to the store */
+    tracker_sparql_connection_query_async (query_data->connection,
+                                           query->str,
+                                           NULL,
+                                           batch_rename_dialog_query_callback,
+                                           query_data);
 
-        g_free (file_name);
-    }
+    g_string_free (query, TRUE);
+}
 
-    selection_metadata = g_list_reverse (selection_metadata);
+void
+check_metadata_for_selection (NautilusBatchRenameDialog *dialog,
+                              GList                     *selection)
+{
+    TrackerSparqlConnection *connection;
+    GList *l;
+    NautilusFile *file;
+    GError *error;
+    QueryData *query_data;
+    gchar *file_name;
+    gchar *uri;
+    time_t mtime;
+    FileMetadata *file_metadata;
+    CachedMetadata *cached;
+    GList *selection_metadata;
+    guint i;
 
-    g_string_append (query, "} ORDER BY ASC(nie:contentCreated(?file))");
+    error = NULL;
+    selection_metadata = NULL;
 
     connection = tracker_sparql_connection_get (NULL, &error);
     if (!connection)
@@ -1111,27 +1402,74 @@ check_metadata_for_selection (NautilusBatchRenameDialog *dialog,
         return;
     }
 
-    query_data = g_new (QueryData, 1);
-    query_data->date_order_hash_table = g_hash_table_new_full (g_str_hash,
-                                                               g_str_equal,
-                                                               (GDestroyNotify) g_free,
-                                                               NULL);
+    if (metadata_cache == NULL)
+    {
+        metadata_cache = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                                g_free, cached_metadata_free);
+    }
+    else if (g_hash_table_size (metadata_cache) >= METADATA_CACHE_MAX_FILES)
+    {
+        g_hash_table_remove_all (metadata_cache);
+    }
+
+    query_data = g_new0 (QueryData, 1);
     query_data->dialog = dialog;
-    query_data->selection_metadata = selection_metadata;
+    g_object_add_weak_pointer (G_OBJECT (dialog), (gpointer *) &query_data->dialog);
+    query_data->connection = connection;
+    query_data->uris = g_ptr_array_new_with_free_func (g_free);
+    query_data->pending = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                                 g_free, cached_metadata_free);
+    query_data->pending_uris = g_ptr_array_new ();
     for (i = 0; i < G_N_ELEMENTS (metadata_tags_constants); i++)
     {
         query_data->has_metadata[i] = TRUE;
     }
 
-    /* Make an asynchronous query to the store */
-    tracker_sparql_connection_query_async (connection,
-                                           query->str,
-                                           NULL,
-                                           batch_rename_dialog_query_callback,
-                                           query_data);
+    for (l = selection; l != NULL; l = l->next)
+    {
+        file = NAUTILUS_FILE (l->data);
+        file_name = nautilus_file_get_name (file);
+        uri = nautilus_file_get_uri (file);
+        mtime = nautilus_file_get_mtime (file);
 
-    g_object_unref (connection);
-    g_string_free (query, TRUE);
+        file_metadata = g_new0 (FileMetadata, 1);
+        file_metadata->file_name = g_string_new (file_name);
+        file_metadata->metadata[ORIGINAL_FILE_NAME] = g_string_new (file_name);
+
+        selection_metadata = g_list_prepend (selection_metadata, file_metadata);
+        g_ptr_array_add (query_data->uris, uri);
+
+        /* Only the files that changed since they were cached, or that
+         * Tracker didn't know about back then, are asked for again */
+        cached = g_hash_table_lookup (metadata_cache, uri);
+        if (cached != NULL && cached->mtime != mtime)
+        {
+            g_hash_table_remove (metadata_cache, uri);
+            cached = NULL;
+        }
+
+        if (cached == NULL && !g_hash_table_contains (query_data->pending, uri))
+        {
+            cached = g_new0 (CachedMetadata, 1);
+            cached->mtime = mtime;
+            g_hash_table_insert (query_data->pending, g_strdup (uri), cached);
+            g_ptr_array_add (query_data->pending_uris, uri);
+        }
+
+        g_free (file_name);
+    }
+
+    query_data->selection_metadata = g_list_reverse (selection_metadata);
+
+    if (query_data->pending_uris->len == 0)
+    {
+        /* Still asynchronous, like when Tracker is asked */
+        g_idle_add (query_data_finish_idle, query_data);
+    }
+    else
+    {
+        query_next_page (query_data);
+    }
 }
 
 GList *
@@ -1139,23 +1477,31 @@ batch_rename_files_get_distinct_parents (GList *selection)
 {
     GList *result;
     GList *l1;
+    GHashTable *seen;
     NautilusFile *file;
     NautilusDirectory *directory;
     NautilusFile *parent;
 
     result = NULL;
+    seen = g_hash_table_new (NULL, NULL);
     for (l1 = selection; l1 != NULL; l1 = l1->next)
     {
         file = NAUTILUS_FILE (l1->data);
         parent = nautilus_file_get_parent (file);
         directory = nautilus_directory_get_for_file (parent);
-        if (!g_list_find (result, directory))
+        if (g_hash_table_add (seen, directory))
         {
             result = g_list_prepend (result, directory);
         }
+        else
+        {
+            nautilus_directory_unref (directory);
+        }
 
         nautilus_file_unref (parent);
     }
 
+    g_hash_table_destroy (seen);
+
     return result;
 }
@@ -24,11 +24,17 @@
 #include <tracker-sparql.h>
 
 GList* batch_rename_dialog_get_new_names_list          (NautilusBatchRenameDialogMode  mode,
-                                                        GList                         *selection,
+                                                        GPtrArray                     *files,
                                                         GList                         *tags_list,
                                                         GList                         *selection_metadata,
                                                         gchar                         *entry_text,
-                                                        gchar                         *replace_text);
+                                                        gchar                         *replace_text,
+                                                        GCancellable                  *cancellable);
+
+FileNames* file_names_new                               (NautilusFile *file);
+
+void file_names_free                                    (gpointer mem);
+void file_metadata_free                                 (gpointer mem);
 
 GList* file_names_list_has_duplicates                      (NautilusBatchRenameDialog   *dialog,
                                                             NautilusDirectory           *model,
@@ -52,10 +58,32 @@ void conflict_data_free                         (gpointer mem);
 
 GList* batch_rename_files_get_distinct_parents  (GList *selection);
 
-gboolean file_name_conflicts_with_results       (GList        *selection,
-                                                 GList        *new_names,
-                                                 GString      *old_name,
-                                                 gchar        *parent_uri);
+typedef struct _BatchRenameConflicts BatchRenameConflicts;
+
+BatchRenameConflicts* batch_rename_conflicts_new          (void);
+
+void                  batch_rename_conflicts_free         (BatchRenameConflicts *conflicts);
+
+guint                 batch_rename_conflicts_add_file     (BatchRenameConflicts *conflicts,
+                                                           const gchar          *parent_uri,
+                                                           const gchar          *old_name);
+
+void                  batch_rename_conflicts_set_new_name (BatchRenameConflicts *conflicts,
+                                                           guint                 index,
+                                                           const gchar          *new_name);
+
+const gchar*          batch_rename_conflicts_get_new_name (BatchRenameConflicts *conflicts,
+                                                           guint                 index);
+
+GArray*               batch_rename_conflicts_get_files_in (BatchRenameConflicts *conflicts,
+                                                           const gchar          *parent_uri);
+
+gboolean              batch_rename_conflicts_is_duplicate (BatchRenameConflicts *conflicts,
+                                                           guint                 index);
+
+gboolean              batch_rename_conflicts_has_conflict (BatchRenameConflicts *conflicts,
+                                                           guint                 index,
+                                                           GHashTable           *existing_names);
 
 GString* batch_rename_replace_label_text        (gchar             *label,
                                                  const gchar       *substr);
@@ -351,8 +351,8 @@ drag_data_get_callback (GtkWidget        *widget,
      * the selection data in the right format. Pass it means to
      * iterate all the selected icons.
      */
-    drag_info = &(NAUTILUS_CANVAS_CONTAINER (widget)->details->dnd_info->drag_info);
-    nautilus_drag_drag_data_get_from_cache (drag_info->selection_cache, context, selection_data, info, time);
+    drag_info = NAUTILUS_CANVAS_CONTAINER (widget)->details->dnd_source_info;
+    nautilus_drag_drag_data_get_from_cache (drag_info, context, selection_data, info, time);
 }
 
 
@@ -405,6 +405,7 @@ cache_selection_list (NautilusDragInfo *drag_info)
 
 static void
 nautilus_canvas_container_dropped_canvas_feedback (GtkWidget        *widget,
+                                                   GdkDragContext   *context,
                                                    GtkSelectionData *data,
                                                    int               x,
                                                    int               y)
@@ -429,7 +430,7 @@ nautilus_canvas_container_dropped_canvas_feedback (GtkWidget        *widget,
     }
 
     /* Build the selection list and the shadow. */
-    dnd_info->drag_info.selection_list = nautilus_drag_build_selection_list (data);
+    dnd_info->drag_info.selection_list = nautilus_drag_build_selection_list (context, data);
     cache_selection_list (&dnd_info->drag_info);
     dnd_info->shadow = create_selection_shadow (container, dnd_info->drag_info.selection_list);
     nautilus_canvas_container_position_shadow (container, x, y);
@@ -610,9 +611,8 @@ drag_end_callback (GtkWidget      *widget,
 
     stop_cache_selection_list (&dnd_info->drag_info);
     nautilus_drag_destroy_selection_list (dnd_info->drag_info.selection_list);
-    nautilus_drag_destroy_selection_list (container->details->dnd_source_info->selection_cache);
     dnd_info->drag_info.selection_list = NULL;
-    container->details->dnd_source_info->selection_cache = NULL;
+    nautilus_drag_clear_selection_cache (container->details->dnd_source_info);
 
     nautilus_window_end_dnd (window, context);
 }
@@ -1484,12 +1484,11 @@ drag_begin_callback (GtkWidget      *widget,
     cairo_surface_destroy (surface);
 
     /* cache the data at the beginning since the view may change */
-    drag_info = &(container->details->dnd_info->drag_info);
+    drag_info = container->details->dnd_source_info;
+    nautilus_drag_clear_selection_cache (drag_info);
     drag_info->selection_cache = nautilus_drag_create_selection_cache (widget,
                                                                        each_icon_get_data_binder);
-
-    container->details->dnd_source_info->selection_cache = nautilus_drag_create_selection_cache (widget,
-                                                                                                 each_icon_get_data_binder);
+    drag_info->selection_cache_context = context;
 
     nautilus_window_start_dnd (window, context);
 }
@@ -1801,7 +1800,7 @@ drag_data_received_callback (GtkWidget        *widget,
     {
         case NAUTILUS_ICON_DND_GNOME_ICON_LIST:
         {
-            nautilus_canvas_container_dropped_canvas_feedback (widget, data, x, y);
+            nautilus_canvas_container_dropped_canvas_feedback (widget, context, data, x, y);
         }
         break;
 
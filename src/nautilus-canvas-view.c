@@ -797,6 +797,19 @@ on_clipboard_contents_received (GtkClipboard     *clipboard,
 static void
 update_clipboard_status (NautilusCanvasView *view)
 {
+    GList *files;
+    gboolean cut;
+
+    /* Files cut in this process are already at hand */
+    if (nautilus_clipboard_get_own_contents (nautilus_clipboard_get (GTK_WIDGET (view)),
+                                             &cut, &files, NULL))
+    {
+        nautilus_canvas_container_set_highlighted_for_clipboard (get_canvas_container (view),
+                                                                 cut ? files : NULL);
+        nautilus_file_list_free (files);
+        return;
+    }
+
     g_object_ref (view);     /* Need to keep the object alive until we get the reply */
     gtk_clipboard_request_contents (nautilus_clipboard_get (GTK_WIDGET (view)),
                                     nautilus_clipboard_get_atom (),
@@ -39,8 +39,20 @@ typedef struct
 {
     gboolean cut;
     GList *files;
+    GtkClipboard *clipboard;
+    /* URIs of the files, and the same strings as a set so collisions
+     * can be found without asking the clipboard for its contents */
+    char **uris;
+    GHashTable *uri_set;
+    /* The files as text and as x-special/gnome-copied-files, built the
+     * first time someone asks for them */
+    GBytes *text_payload;
+    GBytes *copied_files_payload;
 } ClipboardInfo;
 
+/* What we last put on a clipboard, until someone replaces it */
+static ClipboardInfo *owned_clipboard_info = NULL;
+
 static GList *
 convert_lines_to_str_list (char **lines)
 {
@@ -60,16 +72,15 @@ convert_lines_to_str_list (char **lines)
     return g_list_reverse (result);
 }
 
-static char *
-convert_file_list_to_string (ClipboardInfo *info,
-                             gboolean       format_for_text,
-                             gsize         *len)
+static GBytes *
+convert_file_list_to_payload (ClipboardInfo *info,
+                              gboolean       format_for_text)
 {
     GString *uris;
-    char *uri, *tmp;
+    char *tmp;
     GFile *f;
+    gsize len;
     guint i;
-    GList *l;
 
     if (format_for_text)
     {
@@ -80,13 +91,17 @@ convert_file_list_to_string (ClipboardInfo *info,
         uris = g_string_new (info->cut ? "cut" : "copy");
     }
 
-    for (i = 0, l = info->files; l != NULL; l = l->next, i++)
+    for (i = 0; info->uris[i] != NULL; i++)
     {
-        uri = nautilus_file_get_uri (l->data);
-
         if (format_for_text)
         {
-            f = g_file_new_for_uri (uri);
+            /* no newline after the last element */
+            if (i > 0)
+            {
+                g_string_append_c (uris, '\n');
+            }
+
+            f = g_file_new_for_uri (info->uris[i]);
             tmp = g_file_get_parse_name (f);
             g_object_unref (f);
 
@@ -97,26 +112,18 @@ convert_file_list_to_string (ClipboardInfo *info,
             }
             else
             {
-                g_string_append (uris, uri);
-            }
-
-            /* skip newline for last element */
-            if (i + 1 < g_list_length (info->files))
-            {
-                g_string_append_c (uris, '\n');
+                g_string_append (uris, info->uris[i]);
             }
         }
         else
         {
             g_string_append_c (uris, '\n');
-            g_string_append (uris, uri);
+            g_string_append (uris, info->uris[i]);
         }
-
-        g_free (uri);
     }
 
-    *len = uris->len;
-    return g_string_free (uris, FALSE);
+    len = uris->len;
+    return g_bytes_new_take (g_string_free (uris, FALSE), len);
 }
 
 static GList *
@@ -174,67 +181,110 @@ void
 nautilus_clipboard_clear_if_colliding_uris (GtkWidget   *widget,
                                             const GList *item_uris)
 {
-    GtkSelectionData *data;
-    GList *clipboard_item_uris, *l;
-    gboolean collision;
-
-    collision = FALSE;
-    data = gtk_clipboard_wait_for_contents (nautilus_clipboard_get (widget),
-                                            copied_files_atom);
-    if (data == NULL)
+    GtkClipboard *clipboard;
+    const GList *l;
+
+    clipboard = nautilus_clipboard_get (widget);
+
+    /* Only contents we own can be cleared, and for those we already
+     * know the URIs */
+    if (owned_clipboard_info == NULL ||
+        owned_clipboard_info->clipboard != clipboard)
     {
         return;
     }
 
-    clipboard_item_uris = nautilus_clipboard_get_uri_list_from_selection_data (data);
-
-    for (l = (GList *) item_uris; l; l = l->next)
+    for (l = item_uris; l != NULL; l = l->next)
     {
-        if (g_list_find_custom ((GList *) item_uris, l->data,
-                                (GCompareFunc) g_strcmp0))
+        if (g_hash_table_contains (owned_clipboard_info->uri_set, l->data))
         {
-            collision = TRUE;
-            break;
+            gtk_clipboard_clear (clipboard);
+            return;
         }
     }
+}
 
-    if (collision)
-    {
-        gtk_clipboard_clear (nautilus_clipboard_get (widget));
-    }
+gboolean
+nautilus_clipboard_is_cut_from_selection_data (GtkSelectionData *selection_data)
+{
+    const char *data;
+    int length;
 
-    if (clipboard_item_uris)
+    if (gtk_selection_data_get_data_type (selection_data) != copied_files_atom)
     {
-        g_list_free_full (clipboard_item_uris, g_free);
+        return FALSE;
     }
+
+    /* Only the first line matters, so don't split the rest */
+    data = (const char *) gtk_selection_data_get_data (selection_data);
+    length = gtk_selection_data_get_length (selection_data);
+
+    return length >= 3 && strncmp (data, "cut", 3) == 0 &&
+           (length == 3 || data[3] == '\n');
 }
 
+/**
+ * nautilus_clipboard_get_own_contents:
+ * @clipboard: a clipboard
+ * @cut: (out) (optional): whether the files were cut rather than copied
+ * @files: (out) (optional) (transfer full): the files on the clipboard
+ * @uris: (out) (optional) (transfer full): their URIs
+ *
+ * Reads what nautilus itself put on @clipboard without going through the
+ * clipboard, which would serialize and parse the whole list.
+ *
+ * Returns: %FALSE, leaving the out parameters alone, if someone else
+ * owns the clipboard.
+ */
 gboolean
-nautilus_clipboard_is_cut_from_selection_data (GtkSelectionData *selection_data)
+nautilus_clipboard_get_own_contents (GtkClipboard  *clipboard,
+                                     gboolean      *cut,
+                                     GList        **files,
+                                     GList        **uris)
 {
-    GList *items;
-    gboolean is_cut_from_selection_data;
+    int i;
 
-    items = get_item_list_from_selection_data (selection_data);
-    is_cut_from_selection_data = items != NULL &&
-                                 g_strcmp0 ((gchar *) items->data, "cut") == 0;
+    if (owned_clipboard_info == NULL ||
+        owned_clipboard_info->clipboard != clipboard)
+    {
+        return FALSE;
+    }
+
+    if (cut != NULL)
+    {
+        *cut = owned_clipboard_info->cut;
+    }
+
+    if (files != NULL)
+    {
+        *files = nautilus_file_list_copy (owned_clipboard_info->files);
+    }
 
-    g_list_free_full (items, g_free);
+    if (uris != NULL)
+    {
+        *uris = NULL;
+        for (i = 0; owned_clipboard_info->uris[i] != NULL; i++)
+        {
+            *uris = g_list_prepend (*uris, g_strdup (owned_clipboard_info->uris[i]));
+        }
+        *uris = g_list_reverse (*uris);
+    }
 
-    return is_cut_from_selection_data;
+    return TRUE;
 }
 
+/* Targets may ask many times for the same contents, so each format is
+ * built once and kept until the clipboard is cleared */
 static void
 on_get_clipboard (GtkClipboard     *clipboard,
                   GtkSelectionData *selection_data,
                   guint             info,
                   gpointer          user_data)
 {
-    char **uris;
-    GList *l;
-    int i;
     ClipboardInfo *clipboard_info;
     GdkAtom target;
+    gconstpointer data;
+    gsize len;
 
     clipboard_info = (ClipboardInfo *) user_data;
 
@@ -242,38 +292,27 @@ on_get_clipboard (GtkClipboard     *clipboard,
 
     if (gtk_targets_include_uri (&target, 1))
     {
-        uris = g_malloc ((g_list_length (clipboard_info->files) + 1) * sizeof (char *));
-        i = 0;
-
-        for (l = clipboard_info->files; l != NULL; l = l->next)
-        {
-            uris[i] = nautilus_file_get_uri (l->data);
-            i++;
-        }
-
-        uris[i] = NULL;
-
-        gtk_selection_data_set_uris (selection_data, uris);
-
-        g_strfreev (uris);
+        gtk_selection_data_set_uris (selection_data, clipboard_info->uris);
     }
     else if (gtk_targets_include_text (&target, 1))
     {
-        char *str;
-        gsize len;
+        if (clipboard_info->text_payload == NULL)
+        {
+            clipboard_info->text_payload = convert_file_list_to_payload (clipboard_info, TRUE);
+        }
 
-        str = convert_file_list_to_string (clipboard_info, TRUE, &len);
-        gtk_selection_data_set_text (selection_data, str, len);
-        g_free (str);
+        data = g_bytes_get_data (clipboard_info->text_payload, &len);
+        gtk_selection_data_set_text (selection_data, data, len);
     }
     else if (target == copied_files_atom)
     {
-        char *str;
-        gsize len;
+        if (clipboard_info->copied_files_payload == NULL)
+        {
+            clipboard_info->copied_files_payload = convert_file_list_to_payload (clipboard_info, FALSE);
+        }
 
-        str = convert_file_list_to_string (clipboard_info, FALSE, &len);
-        gtk_selection_data_set (selection_data, copied_files_atom, 8, (guchar *) str, len);
-        g_free (str);
+        data = g_bytes_get_data (clipboard_info->copied_files_payload, &len);
+        gtk_selection_data_set (selection_data, copied_files_atom, 8, data, len);
     }
 }
 
@@ -283,7 +322,16 @@ on_clear_clipboard (GtkClipboard *clipboard,
 {
     ClipboardInfo *clipboard_info = (ClipboardInfo *) user_data;
 
+    if (owned_clipboard_info == clipboard_info)
+    {
+        owned_clipboard_info = NULL;
+    }
+
     nautilus_file_list_free (clipboard_info->files);
+    g_hash_table_destroy (clipboard_info->uri_set);
+    g_strfreev (clipboard_info->uris);
+    g_clear_pointer (&clipboard_info->text_payload, g_bytes_unref);
+    g_clear_pointer (&clipboard_info->copied_files_payload, g_bytes_unref);
 
     g_free (clipboard_info);
 }
@@ -297,10 +345,21 @@ nautilus_clipboard_prepare_for_files (GtkClipboard *clipboard,
     GtkTargetEntry *targets;
     int n_targets;
     ClipboardInfo *clipboard_info;
+    GList *l;
+    int i;
 
-    clipboard_info = g_new (ClipboardInfo, 1);
+    clipboard_info = g_new0 (ClipboardInfo, 1);
     clipboard_info->cut = cut;
     clipboard_info->files = nautilus_file_list_copy (files);
+    clipboard_info->clipboard = clipboard;
+    clipboard_info->uris = g_new (char *, g_list_length (files) + 1);
+    clipboard_info->uri_set = g_hash_table_new (g_str_hash, g_str_equal);
+    for (l = files, i = 0; l != NULL; l = l->next, i++)
+    {
+        clipboard_info->uris[i] = nautilus_file_get_uri (l->data);
+        g_hash_table_add (clipboard_info->uri_set, clipboard_info->uris[i]);
+    }
+    clipboard_info->uris[i] = NULL;
 
     target_list = gtk_target_list_new (NULL, 0);
     gtk_target_list_add (target_list, copied_files_atom, 0, 0);
@@ -310,10 +369,17 @@ nautilus_clipboard_prepare_for_files (GtkClipboard *clipboard,
     targets = gtk_target_table_new_from_list (target_list, &n_targets);
     gtk_target_list_unref (target_list);
 
-    gtk_clipboard_set_with_data (clipboard,
-                                 targets, n_targets,
-                                 on_get_clipboard, on_clear_clipboard,
-                                 clipboard_info);
+    if (gtk_clipboard_set_with_data (clipboard,
+                                     targets, n_targets,
+                                     on_get_clipboard, on_clear_clipboard,
+                                     clipboard_info))
+    {
+        owned_clipboard_info = clipboard_info;
+    }
+    else
+    {
+        on_clear_clipboard (clipboard, clipboard_info);
+    }
     gtk_target_table_free (targets, n_targets);
 }
 
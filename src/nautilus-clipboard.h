@@ -30,6 +30,10 @@ void nautilus_clipboard_clear_if_colliding_uris    (GtkWidget          *widget,
 GtkClipboard* nautilus_clipboard_get               (GtkWidget          *widget);
 GList* nautilus_clipboard_get_uri_list_from_selection_data (GtkSelectionData   *selection_data);
 gboolean nautilus_clipboard_is_cut_from_selection_data (GtkSelectionData *selection_data);
+gboolean nautilus_clipboard_get_own_contents (GtkClipboard  *clipboard,
+                                              gboolean      *cut,
+                                              GList        **files,
+                                              GList        **uris);
 void nautilus_clipboard_prepare_for_files (GtkClipboard *clipboard,
                                            GList        *files,
                                            gboolean      cut);
@@ -23,6 +23,7 @@
 #include "nautilus-column-utilities.h"
 
 #include <string.h>
+#include <eel/eel-debug.h>
 #include <eel/eel-glib-extensions.h>
 #include <glib/gi18n.h>
 #include <libnautilus-extension/nautilus-column-provider.h>
@@ -155,9 +156,13 @@ get_extension_columns (void)
     {
         NautilusColumnProvider *provider;
         GList *provider_columns;
+        gint64 start;
 
         provider = NAUTILUS_COLUMN_PROVIDER (l->data);
+        start = g_get_monotonic_time ();
         provider_columns = nautilus_column_provider_get_columns (provider);
+        nautilus_module_record_call (provider, "get_columns",
+                                     g_get_monotonic_time () - start);
         columns = g_list_concat (columns, provider_columns);
     }
 
@@ -212,18 +217,44 @@ get_search_columns (void)
     return nautilus_column_list_copy (columns);
 }
 
+/* The common columns are built once and kept until the set of loaded
+ * extensions changes */
+static GList *common_columns = NULL;
+static guint common_columns_serial;
+
+static void
+free_common_columns (void)
+{
+    nautilus_column_list_free (common_columns);
+    common_columns = NULL;
+}
+
 GList *
 nautilus_get_common_columns (void)
 {
-    static GList *columns = NULL;
+    static gboolean registered_shutdown = FALSE;
 
-    if (!columns)
+    if (common_columns != NULL &&
+        common_columns_serial != nautilus_module_get_serial ())
     {
-        columns = g_list_concat (get_builtin_columns (),
-                                 get_extension_columns ());
+        free_common_columns ();
     }
 
-    return nautilus_column_list_copy (columns);
+    if (common_columns == NULL)
+    {
+        common_columns = g_list_concat (get_builtin_columns (),
+                                        get_extension_columns ());
+        /* Read after asking for the providers, which may load modules */
+        common_columns_serial = nautilus_module_get_serial ();
+
+        if (!registered_shutdown)
+        {
+            registered_shutdown = TRUE;
+            eel_debug_call_at_shutdown (free_common_columns);
+        }
+    }
+
+    return nautilus_column_list_copy (common_columns);
 }
 
 GList *
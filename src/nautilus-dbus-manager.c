@@ -26,6 +26,8 @@
 #include "nautilus-generated.h"
 
 #include "nautilus-file-operations.h"
+#include "nautilus-metrics.h"
+#include "nautilus-thumbnails.h"
 
 #define DEBUG_FLAG NAUTILUS_DEBUG_DBUS
 #include "nautilus-debug.h"
@@ -37,6 +39,8 @@ struct _NautilusDBusManager
     GObject parent;
 
     NautilusDBusFileOperations *file_operations;
+    NautilusDBusThumbnails *thumbnails;
+    NautilusDBusMetrics *metrics;
 };
 
 struct _NautilusDBusManagerClass
@@ -57,6 +61,9 @@ nautilus_dbus_manager_dispose (GObject *object)
         self->file_operations = NULL;
     }
 
+    g_clear_object (&self->thumbnails);
+    g_clear_object (&self->metrics);
+
     G_OBJECT_CLASS (nautilus_dbus_manager_parent_class)->dispose (object);
 }
 
@@ -133,6 +140,34 @@ handle_empty_trash (NautilusDBusFileOperations *object,
     return TRUE; /* invocation was handled */
 }
 
+static gboolean
+handle_pregenerate (NautilusDBusThumbnails  *object,
+                    GDBusMethodInvocation   *invocation,
+                    const gchar            **directories)
+{
+    GFile *directory;
+    gint idx;
+
+    for (idx = 0; directories[idx] != NULL; idx++)
+    {
+        directory = g_file_new_for_uri (directories[idx]);
+        nautilus_thumbnail_pregenerate (directory);
+        g_object_unref (directory);
+    }
+
+    nautilus_dbus_thumbnails_complete_pregenerate (object, invocation);
+    return TRUE; /* invocation was handled */
+}
+
+static gboolean
+handle_get_metrics (NautilusDBusMetrics   *object,
+                    GDBusMethodInvocation *invocation)
+{
+    nautilus_dbus_metrics_complete_get_metrics (object, invocation,
+                                                nautilus_metrics_snapshot ());
+    return TRUE; /* invocation was handled */
+}
+
 static void
 nautilus_dbus_manager_init (NautilusDBusManager *self)
 {
@@ -150,6 +185,20 @@ nautilus_dbus_manager_init (NautilusDBusManager *self)
                       "handle-empty-trash",
                       G_CALLBACK (handle_empty_trash),
                       self);
+
+    self->thumbnails = nautilus_dbus_thumbnails_skeleton_new ();
+
+    g_signal_connect (self->thumbnails,
+                      "handle-pregenerate",
+                      G_CALLBACK (handle_pregenerate),
+                      self);
+
+    self->metrics = nautilus_dbus_metrics_skeleton_new ();
+
+    g_signal_connect (self->metrics,
+                      "handle-get-metrics",
+                      G_CALLBACK (handle_get_metrics),
+                      self);
 }
 
 static void
@@ -172,7 +221,19 @@ nautilus_dbus_manager_register (NautilusDBusManager  *self,
                                 GDBusConnection      *connection,
                                 GError              **error)
 {
-    return g_dbus_interface_skeleton_export (G_DBUS_INTERFACE_SKELETON (self->file_operations),
+    if (!g_dbus_interface_skeleton_export (G_DBUS_INTERFACE_SKELETON (self->file_operations),
+                                           connection, "/org/gnome/Nautilus", error))
+    {
+        return FALSE;
+    }
+
+    if (!g_dbus_interface_skeleton_export (G_DBUS_INTERFACE_SKELETON (self->thumbnails),
+                                           connection, "/org/gnome/Nautilus", error))
+    {
+        return FALSE;
+    }
+
+    return g_dbus_interface_skeleton_export (G_DBUS_INTERFACE_SKELETON (self->metrics),
                                              connection, "/org/gnome/Nautilus", error);
 }
 
@@ -180,4 +241,6 @@ void
 nautilus_dbus_manager_unregister (NautilusDBusManager *self)
 {
     g_dbus_interface_skeleton_unexport (G_DBUS_INTERFACE_SKELETON (self->file_operations));
+    g_dbus_interface_skeleton_unexport (G_DBUS_INTERFACE_SKELETON (self->thumbnails));
+    g_dbus_interface_skeleton_unexport (G_DBUS_INTERFACE_SKELETON (self->metrics));
 }
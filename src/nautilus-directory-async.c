@@ -29,12 +29,16 @@
 #include "nautilus-signaller.h"
 #include "nautilus-global-preferences.h"
 #include "nautilus-link.h"
+#include "nautilus-metrics.h"
+#include "nautilus-module.h"
 #include "nautilus-profile.h"
+#include "nautilus-watchdog.h"
 #include <eel/eel-glib-extensions.h>
 #include <gtk/gtk.h>
 #include <libxml/parser.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 /* turn this on to see messages about each load_directory call: */
 #if 0
@@ -78,6 +82,12 @@ struct ThumbnailState
     NautilusFile *file;
     gboolean trying_original;
     gboolean tried_original;
+
+    /* Copied on the main thread for the reader thread */
+    GFile *location;
+    time_t mtime;
+    int max_size;
+    gboolean stale;
 };
 
 struct MountState
@@ -102,6 +112,7 @@ struct DirectoryLoadState
     GHashTable *load_mime_list_hash;
     NautilusFile *load_directory_file;
     int load_file_count;
+    gint64 start_time;
 };
 
 struct MimeListState
@@ -173,13 +184,23 @@ typedef struct
     Request request;
 } Monitor;
 
+/* An update_file_info call that is in flight, for one file or, for
+ * providers that support it, a batch of files. */
 typedef struct
 {
     NautilusDirectory *directory;
     NautilusInfoProvider *provider;
     NautilusOperationHandle *handle;
-    NautilusOperationResult result;
-} InfoProviderResponse;
+    GClosure *update_complete;
+    GList *files; /* entries are NULLed when the file goes away */
+    guint idle_id;
+} ExtensionInfoRequest;
+
+/* Requests in flight per provider and directory. Enough to hide the
+ * latency of a provider that answers asynchronously, without flooding
+ * it with a whole directory's worth of files at once. */
+#define EXTENSION_INFO_MAX_REQUESTS_PER_PROVIDER 4
+#define EXTENSION_INFO_BATCH_SIZE 64
 
 typedef gboolean (*RequestCheck) (Request);
 typedef gboolean (*FileCheck) (NautilusFile *);
@@ -392,6 +413,8 @@ async_job_start (NautilusDirectory *directory,
         g_hash_table_insert (waiting_directories,
                              directory,
                              directory);
+        nautilus_metrics_gauge_set ("directory-waiting",
+                                    g_hash_table_size (waiting_directories));
 
         return FALSE;
     }
@@ -416,6 +439,7 @@ async_job_start (NautilusDirectory *directory,
 #endif
 
     async_job_count += 1;
+    nautilus_metrics_gauge_set ("directory-async-jobs", async_job_count);
     return TRUE;
 }
 
@@ -457,6 +481,7 @@ async_job_end (NautilusDirectory *directory,
 #endif
 
     async_job_count -= 1;
+    nautilus_metrics_gauge_set ("directory-async-jobs", async_job_count);
 }
 
 /* Helper to get one value from a hash table. */
@@ -511,6 +536,8 @@ async_job_wake_up (void)
             break;
         }
         g_hash_table_remove (waiting_directories, value);
+        nautilus_metrics_gauge_set ("directory-waiting",
+                                    g_hash_table_size (waiting_directories));
         nautilus_directory_async_state_changed
             (NAUTILUS_DIRECTORY (value));
     }
@@ -800,6 +827,13 @@ nautilus_directory_monitor_add_internal (NautilusDirectory         *directory,
     /* Replace any current monitor for this client/file pair. */
     remove_monitor (directory, file, client);
 
+    /* A prefetch sets this right before adding the first monitor, so the
+     * load it starts goes easy; anyone after it wants the files for real */
+    if (directory->details->monitor_list != NULL)
+    {
+        directory->details->load_in_background = FALSE;
+    }
+
     /* Add the new monitor. */
     monitor = g_new (Monitor, 1);
     monitor->file = file;
@@ -1093,7 +1127,10 @@ nautilus_directory_schedule_dequeue_pending (NautilusDirectory *directory)
     if (directory->details->dequeue_pending_idle_id == 0)
     {
         directory->details->dequeue_pending_idle_id
-            = g_idle_add (dequeue_pending_idle_callback, directory);
+            = nautilus_watchdog_idle_add ("directory-dequeue-pending",
+                                          G_PRIORITY_DEFAULT_IDLE,
+                                          dequeue_pending_idle_callback,
+                                          directory, NULL);
     }
 }
 
@@ -1144,6 +1181,7 @@ directory_load_cancel (NautilusDirectory *directory)
         state->directory = NULL;
         directory->details->directory_load_in_progress = NULL;
         async_job_end (directory, "file list");
+        nautilus_profile_async_end ("directory-load", directory);
     }
 }
 
@@ -1201,6 +1239,13 @@ directory_load_done (NautilusDirectory *directory,
     }
     dequeue_pending_idle_callback (directory);
 
+    if (directory->details->directory_load_in_progress != NULL)
+    {
+        nautilus_metrics_observe ("directory-load-time",
+                                  g_get_monotonic_time () -
+                                  directory->details->directory_load_in_progress->start_time);
+    }
+
     directory_load_cancel (directory);
 
     g_object_unref (directory);
@@ -1460,6 +1505,8 @@ nautilus_directory_call_when_ready_internal (NautilusDirectory         *director
         return;
     }
 
+    directory->details->load_in_background = FALSE;
+
     /* Add the new callback to the list. */
     directory->details->call_when_ready_list = g_list_prepend
                                                    (directory->details->call_when_ready_list,
@@ -1733,10 +1780,17 @@ nautilus_async_destroying_file (NautilusFile *file)
         directory->details->link_info_read_state->file = NULL;
         changed = TRUE;
     }
-    if (directory->details->extension_info_file == file)
+    for (node = directory->details->extension_info_requests; node != NULL; node = node->next)
     {
-        directory->details->extension_info_file = NULL;
-        changed = TRUE;
+        ExtensionInfoRequest *request = node->data;
+        GList *file_node;
+
+        file_node = g_list_find (request->files, file);
+        if (file_node != NULL)
+        {
+            file_node->data = NULL;
+            changed = TRUE;
+        }
     }
 
     if (directory->details->thumbnail_state != NULL &&
@@ -2023,7 +2077,10 @@ schedule_call_ready_callbacks (NautilusDirectory *directory)
     if (directory->details->call_ready_idle_id == 0)
     {
         directory->details->call_ready_idle_id
-            = g_idle_add (call_ready_callbacks_at_idle, directory);
+            = nautilus_watchdog_idle_add ("directory-call-ready",
+                                          G_PRIORITY_DEFAULT_IDLE,
+                                          call_ready_callbacks_at_idle,
+                                          directory, NULL);
     }
 }
 
@@ -2154,6 +2211,14 @@ directory_load_state_free (DirectoryLoadState *state)
     g_free (state);
 }
 
+/* Checked again for every batch, so a prefetch that the user catches up
+ * with continues at full speed */
+static int
+get_file_list_io_priority (NautilusDirectory *directory)
+{
+    return directory->details->load_in_background ? G_PRIORITY_LOW : G_PRIORITY_DEFAULT;
+}
+
 static void
 more_files_callback (GObject      *source_object,
                      GAsyncResult *res,
@@ -2182,6 +2247,7 @@ more_files_callback (GObject      *source_object,
     error = NULL;
     files = g_file_enumerator_next_files_finish (state->enumerator,
                                                  res, &error);
+    nautilus_profile_counter ("directory-load-batch", g_list_length (files));
 
     for (l = files; l != NULL; l = l->next)
     {
@@ -2199,7 +2265,7 @@ more_files_callback (GObject      *source_object,
     {
         g_file_enumerator_next_files_async (state->enumerator,
                                             DIRECTORY_LOAD_ITEMS_PER_CALLBACK,
-                                            G_PRIORITY_DEFAULT,
+                                            get_file_list_io_priority (directory),
                                             state->cancellable,
                                             more_files_callback,
                                             state);
@@ -2249,7 +2315,7 @@ enumerate_children_callback (GObject      *source_object,
         state->enumerator = enumerator;
         g_file_enumerator_next_files_async (state->enumerator,
                                             DIRECTORY_LOAD_ITEMS_PER_CALLBACK,
-                                            G_PRIORITY_DEFAULT,
+                                            get_file_list_io_priority (state->directory),
                                             state->cancellable,
                                             more_files_callback,
                                             state);
@@ -2288,6 +2354,7 @@ start_monitoring_file_list (NautilusDirectory *directory)
     state->cancellable = g_cancellable_new ();
     state->load_mime_list_hash = istr_set_new ();
     state->load_file_count = 0;
+    state->start_time = g_get_monotonic_time ();
 
     g_assert (directory->details->location != NULL);
     state->load_directory_file =
@@ -2301,10 +2368,12 @@ start_monitoring_file_list (NautilusDirectory *directory)
 
     directory->details->directory_load_in_progress = state;
 
+    nautilus_profile_async_start ("directory-load", directory);
+
     g_file_enumerate_children_async (directory->details->location,
                                      NAUTILUS_FILE_DEFAULT_ATTRIBUTES,
                                      0,     /* flags */
-                                     G_PRIORITY_DEFAULT,     /* prio */
+                                     get_file_list_io_priority (directory),
                                      state->cancellable,
                                      enumerate_children_callback,
                                      state);
@@ -3931,6 +4000,7 @@ static void
 thumbnail_state_free (ThumbnailState *state)
 {
     g_object_unref (state->cancellable);
+    g_clear_object (&state->location);
     g_free (state);
 }
 
@@ -3948,8 +4018,7 @@ thumbnail_loader_size_prepared (GdkPixbufLoader *loader,
 
     aspect_ratio = ((double) width) / height;
 
-    /* cf. nautilus_file_get_icon() */
-    max_thumbnail_size = NAUTILUS_CANVAS_ICON_SIZE_LARGER * cached_thumbnail_size / NAUTILUS_CANVAS_ICON_SIZE_SMALL;
+    max_thumbnail_size = GPOINTER_TO_INT (user_data);
     if (MAX (width, height) > max_thumbnail_size)
     {
         if (width > height)
@@ -3968,33 +4037,30 @@ thumbnail_loader_size_prepared (GdkPixbufLoader *loader,
 }
 
 static GdkPixbuf *
-get_pixbuf_for_content (goffset  file_len,
-                        char    *file_contents)
+get_pixbuf_for_content (const guchar *file_contents,
+                        gsize         file_len,
+                        int           max_size)
 {
     gboolean res;
     GdkPixbuf *pixbuf, *pixbuf2;
     GdkPixbufLoader *loader;
-    gsize chunk_len;
+
     pixbuf = NULL;
 
     loader = gdk_pixbuf_loader_new ();
     g_signal_connect (loader, "size-prepared",
                       G_CALLBACK (thumbnail_loader_size_prepared),
-                      NULL);
+                      GINT_TO_POINTER (max_size));
 
-    /* For some reason we have to write in chunks, or gdk-pixbuf fails */
-    res = TRUE;
-    while (res && file_len > 0)
-    {
-        chunk_len = file_len;
-        res = gdk_pixbuf_loader_write (loader, (guchar *) file_contents, chunk_len, NULL);
-        file_contents += chunk_len;
-        file_len -= chunk_len;
-    }
+    res = gdk_pixbuf_loader_write (loader, file_contents, file_len, NULL);
     if (res)
     {
         res = gdk_pixbuf_loader_close (loader, NULL);
     }
+    else
+    {
+        gdk_pixbuf_loader_close (loader, NULL);
+    }
     if (res)
     {
         pixbuf = g_object_ref (gdk_pixbuf_loader_get_pixbuf (loader));
@@ -4010,6 +4076,158 @@ get_pixbuf_for_content (goffset  file_len,
     return pixbuf;
 }
 
+static const guchar png_signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+
+/* Walks the chunks in front of the image data of a PNG and picks out the
+ * Thumb::MTime key, so a stale thumbnail can be rejected without decoding
+ * it. Returns FALSE if the data is not a PNG.
+ *
+ * Thumb::URI isn't checked: the thumbnail path GIO gives us is already
+ * derived from the uri the thumbnail was made for, which for files shown
+ * through recent:, trash: or search results is the activation uri rather
+ * than ours.
+ */
+static gboolean
+thumbnail_read_mtime (const guchar *data,
+                      gsize         len,
+                      time_t       *thumb_mtime)
+{
+    gsize offset;
+    guint32 chunk_len;
+    const guchar *chunk_type;
+    const char *chunk_data;
+    const char *value;
+    char *mtime_str;
+
+    *thumb_mtime = 0;
+
+    if (len < sizeof (png_signature) ||
+        memcmp (data, png_signature, sizeof (png_signature)) != 0)
+    {
+        return FALSE;
+    }
+
+    /* Every chunk is a 4 byte big endian length, a 4 byte type,
+     * the data and a 4 byte CRC */
+    offset = sizeof (png_signature);
+    while (len - offset >= 12)
+    {
+        chunk_len = ((guint32) data[offset] << 24) |
+                    ((guint32) data[offset + 1] << 16) |
+                    ((guint32) data[offset + 2] << 8) |
+                    ((guint32) data[offset + 3]);
+        chunk_type = data + offset + 4;
+        chunk_data = (const char *) data + offset + 8;
+
+        if (chunk_len > len - offset - 12 ||
+            memcmp (chunk_type, "IDAT", 4) == 0 ||
+            memcmp (chunk_type, "IEND", 4) == 0)
+        {
+            break;
+        }
+
+        if (memcmp (chunk_type, "tEXt", 4) == 0)
+        {
+            value = memchr (chunk_data, '\0', chunk_len);
+            if (value != NULL)
+            {
+                value++;
+
+                if (strcmp (chunk_data, "Thumb::MTime") == 0)
+                {
+                    mtime_str = g_strndup (value, chunk_data + chunk_len - value);
+                    *thumb_mtime = atol (mtime_str);
+                    g_free (mtime_str);
+                }
+            }
+        }
+
+        offset += 12 + (gsize) chunk_len;
+    }
+
+    return TRUE;
+}
+
+static void
+thumbnail_read_thread (GTask        *task,
+                       gpointer      source_object,
+                       gpointer      task_data,
+                       GCancellable *cancellable)
+{
+    ThumbnailState *state;
+    GMappedFile *mapped_file;
+    char *path;
+    char *contents;
+    const guchar *data;
+    gsize len;
+    time_t thumb_mtime;
+    GdkPixbuf *pixbuf;
+
+    state = task_data;
+    mapped_file = NULL;
+    contents = NULL;
+    data = NULL;
+    len = 0;
+    pixbuf = NULL;
+
+    /* Cached thumbnails are local and only ever replaced by rename, so
+     * they can be mapped rather than copied into a heap buffer first.
+     * Originals may be truncated under us, which would fault the mapping,
+     * so those are still read. */
+    path = state->trying_original ? NULL : g_file_get_path (state->location);
+    if (path != NULL)
+    {
+        mapped_file = g_mapped_file_new (path, FALSE, NULL);
+        if (mapped_file != NULL)
+        {
+            data = (const guchar *) g_mapped_file_get_contents (mapped_file);
+            len = g_mapped_file_get_length (mapped_file);
+        }
+        g_free (path);
+    }
+    else if (g_file_load_contents (state->location, cancellable,
+                                   &contents, &len, NULL, NULL))
+    {
+        data = (const guchar *) contents;
+    }
+
+    if (data != NULL && len > 0 && !g_cancellable_is_cancelled (cancellable))
+    {
+        if (!state->trying_original &&
+            thumbnail_read_mtime (data, len, &thumb_mtime))
+        {
+            state->stale = thumb_mtime != 0 && thumb_mtime != state->mtime;
+        }
+
+        if (!state->stale)
+        {
+            pixbuf = get_pixbuf_for_content (data, len, state->max_size);
+        }
+    }
+
+    if (mapped_file != NULL)
+    {
+        g_mapped_file_unref (mapped_file);
+    }
+    g_free (contents);
+
+    g_task_return_pointer (task, pixbuf, g_object_unref);
+}
+
+static void thumbnail_read_callback (GObject      *source_object,
+                                     GAsyncResult *res,
+                                     gpointer      user_data);
+
+static void
+thumbnail_read_start (ThumbnailState *state)
+{
+    GTask *task;
+
+    task = g_task_new (NULL, state->cancellable, thumbnail_read_callback, state);
+    g_task_set_task_data (task, state, NULL);
+    g_task_run_in_thread (task, thumbnail_read_thread);
+    g_object_unref (task);
+}
 
 static void
 thumbnail_read_callback (GObject      *source_object,
@@ -4017,52 +4235,42 @@ thumbnail_read_callback (GObject      *source_object,
                          gpointer      user_data)
 {
     ThumbnailState *state;
-    gsize file_size;
-    char *file_contents;
-    gboolean result;
     NautilusDirectory *directory;
     GdkPixbuf *pixbuf;
-    GFile *location;
 
     state = user_data;
 
+    pixbuf = g_task_propagate_pointer (G_TASK (res), NULL);
+
     if (state->directory == NULL)
     {
         /* Operation was cancelled. Bail out */
+        g_clear_object (&pixbuf);
         thumbnail_state_free (state);
         return;
     }
 
     directory = nautilus_directory_ref (state->directory);
 
-    result = g_file_load_contents_finish (G_FILE (source_object),
-                                          res,
-                                          &file_contents, &file_size,
-                                          NULL, NULL);
-
-    pixbuf = NULL;
-    if (result)
-    {
-        pixbuf = get_pixbuf_for_content (file_size, file_contents);
-        g_free (file_contents);
-    }
-
     if (pixbuf == NULL && state->trying_original)
     {
         state->trying_original = FALSE;
 
-        location = g_file_new_for_path (state->file->details->thumbnail_path);
-        g_file_load_contents_async (location,
-                                    state->cancellable,
-                                    thumbnail_read_callback,
-                                    state);
-        g_object_unref (location);
+        g_object_unref (state->location);
+        state->location = g_file_new_for_path (state->file->details->thumbnail_path);
+        thumbnail_read_start (state);
     }
     else
     {
         state->directory->details->thumbnail_state = NULL;
         async_job_end (state->directory, "thumbnail");
 
+        if (state->stale)
+        {
+            g_free (state->file->details->thumbnail_path);
+            state->file->details->thumbnail_path = NULL;
+        }
+
         thumbnail_got_pixbuf (state->directory, state->file, pixbuf, state->tried_original);
 
         thumbnail_state_free (state);
@@ -4076,7 +4284,6 @@ thumbnail_start (NautilusDirectory *directory,
                  NautilusFile      *file,
                  gboolean          *doing_io)
 {
-    GFile *location;
     ThumbnailState *state;
 
     if (directory->details->thumbnail_state != NULL)
@@ -4102,25 +4309,25 @@ thumbnail_start (NautilusDirectory *directory,
     state->directory = directory;
     state->file = file;
     state->cancellable = g_cancellable_new ();
+    state->mtime = file->details->mtime;
+
+    /* cf. nautilus_file_get_icon() */
+    state->max_size = NAUTILUS_CANVAS_ICON_SIZE_LARGER * cached_thumbnail_size / NAUTILUS_CANVAS_ICON_SIZE_SMALL;
 
     if (file->details->thumbnail_wants_original)
     {
         state->tried_original = TRUE;
         state->trying_original = TRUE;
-        location = nautilus_file_get_location (file);
+        state->location = nautilus_file_get_location (file);
     }
     else
     {
-        location = g_file_new_for_path (file->details->thumbnail_path);
+        state->location = g_file_new_for_path (file->details->thumbnail_path);
     }
 
     directory->details->thumbnail_state = state;
 
-    g_file_load_contents_async (location,
-                                state->cancellable,
-                                thumbnail_read_callback,
-                                state);
-    g_object_unref (location);
+    thumbnail_read_start (state);
 }
 
 static void
@@ -4490,101 +4697,160 @@ filesystem_info_start (NautilusDirectory *directory,
     g_object_unref (location);
 }
 
+static void
+extension_info_request_free (ExtensionInfoRequest *request)
+{
+    if (request->idle_id != 0)
+    {
+        g_source_remove (request->idle_id);
+    }
+
+    /* A provider that calls back after being cancelled must not reach us */
+    g_closure_invalidate (request->update_complete);
+    g_closure_unref (request->update_complete);
+
+    g_object_unref (request->provider);
+    g_list_free (request->files);
+    g_free (request);
+}
+
+static void
+extension_info_request_remove (NautilusDirectory    *directory,
+                               ExtensionInfoRequest *request)
+{
+    directory->details->extension_info_requests =
+        g_list_remove (directory->details->extension_info_requests, request);
+
+    /* All requests of a directory share one async job */
+    if (directory->details->extension_info_requests == NULL)
+    {
+        async_job_end (directory, "extension info");
+    }
+}
+
+static void
+extension_info_request_cancel (NautilusDirectory    *directory,
+                               ExtensionInfoRequest *request)
+{
+    if (request->idle_id == 0 && request->handle != NULL)
+    {
+        nautilus_info_provider_cancel_update (request->provider,
+                                              request->handle);
+    }
+
+    extension_info_request_remove (directory, request);
+    extension_info_request_free (request);
+}
+
 static void
 extension_info_cancel (NautilusDirectory *directory)
 {
-    if (directory->details->extension_info_in_progress != NULL)
+    while (directory->details->extension_info_requests != NULL)
+    {
+        extension_info_request_cancel (directory,
+                                       directory->details->extension_info_requests->data);
+    }
+}
+
+static gboolean
+extension_info_request_is_needed (ExtensionInfoRequest *request)
+{
+    GList *node;
+    NautilusFile *file;
+
+    for (node = request->files; node != NULL; node = node->next)
     {
-        if (directory->details->extension_info_idle)
+        file = node->data;
+        if (file == NULL)
         {
-            g_source_remove (directory->details->extension_info_idle);
+            continue;
         }
-        else
+
+        g_assert (NAUTILUS_IS_FILE (file));
+        g_assert (file->details->directory == request->directory);
+        if (is_needy (file, lacks_extension_info, REQUEST_EXTENSION_INFO))
         {
-            nautilus_info_provider_cancel_update
-                (directory->details->extension_info_provider,
-                directory->details->extension_info_in_progress);
+            return TRUE;
         }
-
-        directory->details->extension_info_in_progress = NULL;
-        directory->details->extension_info_file = NULL;
-        directory->details->extension_info_provider = NULL;
-        directory->details->extension_info_idle = 0;
-
-        async_job_end (directory, "extension info");
     }
+
+    return FALSE;
 }
 
 static void
 extension_info_stop (NautilusDirectory *directory)
 {
-    if (directory->details->extension_info_in_progress != NULL)
+    GList *node, *next;
+    ExtensionInfoRequest *request;
+
+    for (node = directory->details->extension_info_requests; node != NULL; node = next)
     {
-        NautilusFile *file;
+        next = node->next;
+        request = node->data;
 
-        file = directory->details->extension_info_file;
-        if (file != NULL)
+        if (!extension_info_request_is_needed (request))
         {
-            g_assert (NAUTILUS_IS_FILE (file));
-            g_assert (file->details->directory == directory);
-            if (is_needy (file, lacks_extension_info, REQUEST_EXTENSION_INFO))
-            {
-                return;
-            }
+            /* The info is not wanted, so stop it. */
+            extension_info_request_cancel (directory, request);
         }
-
-        /* The info is not wanted, so stop it. */
-        extension_info_cancel (directory);
     }
 }
 
 static void
-finish_info_provider (NautilusDirectory    *directory,
-                      NautilusFile         *file,
+finish_info_provider (NautilusFile         *file,
                       NautilusInfoProvider *provider)
 {
+    GList *node;
+
+    node = g_list_find (file->details->pending_info_providers, provider);
+    if (node == NULL)
+    {
+        return;
+    }
+
     file->details->pending_info_providers =
-        g_list_remove (file->details->pending_info_providers,
-                       provider);
+        g_list_delete_link (file->details->pending_info_providers, node);
     g_object_unref (provider);
 
-    nautilus_directory_async_state_changed (directory);
-
     if (file->details->pending_info_providers == NULL)
     {
         nautilus_file_info_providers_done (file);
     }
 }
 
-
-static gboolean
-info_provider_idle_callback (gpointer user_data)
+static void
+extension_info_request_finish (NautilusDirectory    *directory,
+                               ExtensionInfoRequest *request)
 {
-    InfoProviderResponse *response;
-    NautilusDirectory *directory;
+    GList *node;
+
+    nautilus_directory_ref (directory);
 
-    response = user_data;
-    directory = response->directory;
+    extension_info_request_remove (directory, request);
 
-    if (response->handle != directory->details->extension_info_in_progress
-        || response->provider != directory->details->extension_info_provider)
+    for (node = request->files; node != NULL; node = node->next)
     {
-        g_warning ("Unexpected plugin response.  This probably indicates a bug in a Nautilus extension: handle=%p", response->handle);
+        if (node->data != NULL)
+        {
+            finish_info_provider (node->data, request->provider);
+        }
     }
-    else
-    {
-        NautilusFile *file;
-        async_job_end (directory, "extension info");
 
-        file = directory->details->extension_info_file;
+    extension_info_request_free (request);
 
-        directory->details->extension_info_file = NULL;
-        directory->details->extension_info_provider = NULL;
-        directory->details->extension_info_in_progress = NULL;
-        directory->details->extension_info_idle = 0;
+    nautilus_directory_async_state_changed (directory);
+    nautilus_directory_unref (directory);
+}
 
-        finish_info_provider (directory, file, response->provider);
-    }
+static gboolean
+info_provider_idle_callback (gpointer user_data)
+{
+    ExtensionInfoRequest *request;
+
+    request = user_data;
+    request->idle_id = 0;
+
+    extension_info_request_finish (request->directory, request);
 
     return FALSE;
 }
@@ -4595,75 +4861,220 @@ info_provider_callback (NautilusInfoProvider    *provider,
                         NautilusOperationResult  result,
                         gpointer                 user_data)
 {
-    InfoProviderResponse *response;
+    ExtensionInfoRequest *request;
 
-    response = g_new0 (InfoProviderResponse, 1);
-    response->provider = provider;
-    response->handle = handle;
-    response->result = result;
-    response->directory = NAUTILUS_DIRECTORY (user_data);
+    request = user_data;
 
-    response->directory->details->extension_info_idle =
-        g_idle_add_full (G_PRIORITY_DEFAULT_IDLE,
-                         info_provider_idle_callback, response,
-                         g_free);
+    if (provider != request->provider ||
+        (request->handle != NULL && handle != request->handle) ||
+        request->idle_id != 0)
+    {
+        g_warning ("Unexpected plugin response.  This probably indicates a bug in a Nautilus extension: handle=%p", handle);
+        return;
+    }
+
+    /* Providers may call back from within update_file_info, so always
+     * finish from the main loop. */
+    request->idle_id = g_idle_add_full (G_PRIORITY_DEFAULT_IDLE,
+                                        info_provider_idle_callback,
+                                        request, NULL);
 }
 
-static void
-extension_info_start (NautilusDirectory *directory,
-                      NautilusFile      *file,
-                      gboolean          *doing_io)
+static gboolean
+extension_info_is_in_flight (NautilusDirectory    *directory,
+                             NautilusFile         *file,
+                             NautilusInfoProvider *provider)
 {
-    NautilusInfoProvider *provider;
-    NautilusOperationResult result;
-    NautilusOperationHandle *handle;
-    GClosure *update_complete;
+    GList *node;
+    ExtensionInfoRequest *request;
 
-    if (directory->details->extension_info_in_progress != NULL)
+    for (node = directory->details->extension_info_requests; node != NULL; node = node->next)
     {
-        *doing_io = TRUE;
-        return;
+        request = node->data;
+        if (request->provider == provider &&
+            g_list_find (request->files, file) != NULL)
+        {
+            return TRUE;
+        }
     }
 
-    if (!is_needy (file, lacks_extension_info, REQUEST_EXTENSION_INFO))
+    return FALSE;
+}
+
+static int
+extension_info_count_requests (NautilusDirectory    *directory,
+                               NautilusInfoProvider *provider)
+{
+    GList *node;
+    ExtensionInfoRequest *request;
+    int count;
+
+    count = 0;
+    for (node = directory->details->extension_info_requests; node != NULL; node = node->next)
     {
-        return;
+        request = node->data;
+        if (request->provider == provider)
+        {
+            count++;
+        }
     }
-    *doing_io = TRUE;
 
-    if (!async_job_start (directory, "extension info"))
+    return count;
+}
+
+/* Fills up a batch for @provider with other files of the directory that
+ * are waiting for it, so a batching provider sees them in one call. */
+static GList *
+extension_info_collect_batch (NautilusDirectory    *directory,
+                              NautilusFile         *first_file,
+                              NautilusInfoProvider *provider)
+{
+    GList *files;
+    GList *node;
+    NautilusFile *file;
+    int count;
+
+    files = g_list_prepend (NULL, first_file);
+    count = 1;
+
+    for (node = directory->details->file_list;
+         node != NULL && count < EXTENSION_INFO_BATCH_SIZE;
+         node = node->next)
     {
-        return;
+        file = node->data;
+
+        if (file == first_file ||
+            g_list_find (file->details->pending_info_providers, provider) == NULL ||
+            !is_needy (file, lacks_extension_info, REQUEST_EXTENSION_INFO) ||
+            extension_info_is_in_flight (directory, file, provider))
+        {
+            continue;
+        }
+
+        files = g_list_prepend (files, file);
+        count++;
     }
 
-    provider = file->details->pending_info_providers->data;
+    return g_list_reverse (files);
+}
 
-    update_complete = g_cclosure_new (G_CALLBACK (info_provider_callback),
-                                      directory,
-                                      NULL);
-    g_closure_set_marshal (update_complete,
+static void
+extension_info_request_start (NautilusDirectory    *directory,
+                              NautilusFile         *file,
+                              NautilusInfoProvider *provider)
+{
+    ExtensionInfoRequest *request;
+    NautilusOperationResult result;
+    NautilusOperationHandle *handle;
+    gint64 start;
+
+    request = g_new0 (ExtensionInfoRequest, 1);
+    request->directory = directory;
+    request->provider = g_object_ref (provider);
+
+    request->update_complete = g_cclosure_new (G_CALLBACK (info_provider_callback),
+                                               request,
+                                               NULL);
+    g_closure_set_marshal (request->update_complete,
                            g_cclosure_marshal_generic);
+    g_closure_sink (g_closure_ref (request->update_complete));
 
-    result = nautilus_info_provider_update_file_info
-                 (provider,
-                 NAUTILUS_FILE_INFO (file),
-                 update_complete,
-                 &handle);
+    directory->details->extension_info_requests =
+        g_list_prepend (directory->details->extension_info_requests, request);
 
-    g_closure_unref (update_complete);
+    handle = NULL;
+    start = g_get_monotonic_time ();
+    if (nautilus_info_provider_supports_batch (provider))
+    {
+        request->files = extension_info_collect_batch (directory, file, provider);
+        result = nautilus_info_provider_update_file_info_batch
+                     (provider,
+                     request->files,
+                     request->update_complete,
+                     &handle);
+    }
+    else
+    {
+        request->files = g_list_prepend (NULL, file);
+        result = nautilus_info_provider_update_file_info
+                     (provider,
+                     NAUTILUS_FILE_INFO (file),
+                     request->update_complete,
+                     &handle);
+    }
+    /* Only the synchronous part; asynchronous completion happens off
+     * the main thread's back */
+    nautilus_module_record_call (provider, "update_file_info",
+                                 g_get_monotonic_time () - start);
 
     if (result == NAUTILUS_OPERATION_COMPLETE ||
         result == NAUTILUS_OPERATION_FAILED)
     {
-        finish_info_provider (directory, file, provider);
-        async_job_end (directory, "extension info");
+        extension_info_request_finish (directory, request);
     }
     else
     {
-        directory->details->extension_info_in_progress = handle;
-        directory->details->extension_info_provider = provider;
-        directory->details->extension_info_file = file;
+        request->handle = handle;
+    }
+}
+
+static void
+extension_info_start (NautilusDirectory *directory,
+                      NautilusFile      *file,
+                      gboolean          *doing_io)
+{
+    GList *providers, *node;
+    NautilusInfoProvider *provider;
+
+    if (!is_needy (file, lacks_extension_info, REQUEST_EXTENSION_INFO))
+    {
+        return;
+    }
+
+    /* Requests that complete synchronously edit the pending list */
+    providers = g_list_copy_deep (file->details->pending_info_providers,
+                                  (GCopyFunc) g_object_ref, NULL);
+
+    for (node = providers; node != NULL; node = node->next)
+    {
+        provider = node->data;
+
+        if (g_list_find (file->details->pending_info_providers, provider) == NULL ||
+            extension_info_is_in_flight (directory, file, provider))
+        {
+            continue;
+        }
+
+        /* The provider may have been quarantined since the file was
+         * queued for it */
+        if (nautilus_module_is_quarantined (provider))
+        {
+            finish_info_provider (file, provider);
+            continue;
+        }
+
+        /* Wait for a slot with this provider before moving on to the
+         * next file, so the queue keeps its order. */
+        if (extension_info_count_requests (directory, provider) >= EXTENSION_INFO_MAX_REQUESTS_PER_PROVIDER)
+        {
+            *doing_io = TRUE;
+            continue;
+        }
+
+        if (directory->details->extension_info_requests == NULL &&
+            !async_job_start (directory, "extension info"))
+        {
+            *doing_io = TRUE;
+            break;
+        }
+
+        extension_info_request_start (directory, file, provider);
     }
+
+    g_list_free_full (providers, g_object_unref);
+
+    /* Once everything this file needs is in flight it can leave the
+     * queue; the completions finish it without it being there. */
 }
 
 static void
@@ -4799,6 +5210,8 @@ nautilus_directory_cancel (NautilusDirectory *directory)
     if (waiting_directories != NULL)
     {
         g_hash_table_remove (waiting_directories, directory);
+        nautilus_metrics_gauge_set ("directory-waiting",
+                                    g_hash_table_size (waiting_directories));
     }
 
     /* Check if any directories should wake up. */
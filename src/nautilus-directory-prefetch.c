@@ -0,0 +1,245 @@
+/*
+ *  nautilus-directory-prefetch.c: speculative loading of directories the
+ *  user is likely to open next
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as
+ *  published by the Free Software Foundation; either version 2 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public
+ *  License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include "nautilus-directory-prefetch.h"
+
+#include "nautilus-directory-private.h"
+
+#define DEBUG_FLAG NAUTILUS_DEBUG_DIRECTORY_VIEW
+#include "nautilus-debug.h"
+
+/* A prefetch is nothing more than a file list monitor on the directory,
+ * so the regular directory code does the loading and keeps the result
+ * cached until the monitor goes away. When the user does open the
+ * directory, the view's own monitor finds the files already there.
+ */
+
+/* Directories being enumerated at the same time */
+#define PREFETCH_MAX_LOADING 2
+/* Directories held once loaded */
+#define PREFETCH_MAX_DIRECTORIES 16
+/* Files held across all of them */
+#define PREFETCH_MAX_FILES 20000
+/* Seconds a prefetched directory is kept around waiting to be used */
+#define PREFETCH_UNUSED_TIMEOUT 30
+
+typedef struct
+{
+    NautilusDirectory *directory;
+    GList link;
+    gboolean loading;
+    guint n_files;
+    gulong done_loading_id;
+    guint timeout_id;
+} Prefetch;
+
+/* Most recently requested first */
+static GQueue prefetches = G_QUEUE_INIT;
+
+static void
+prefetch_free (Prefetch *prefetch)
+{
+    g_queue_unlink (&prefetches, &prefetch->link);
+
+    if (prefetch->timeout_id != 0)
+    {
+        g_source_remove (prefetch->timeout_id);
+    }
+    g_signal_handler_disconnect (prefetch->directory, prefetch->done_loading_id);
+
+    /* If nobody else wants the directory, this cancels any load still
+     * in progress and lets it go */
+    prefetch->directory->details->load_in_background = FALSE;
+    nautilus_directory_file_monitor_remove (prefetch->directory, prefetch);
+    nautilus_directory_unref (prefetch->directory);
+
+    g_free (prefetch);
+}
+
+static gboolean
+prefetch_unused_timeout_callback (gpointer user_data)
+{
+    Prefetch *prefetch = user_data;
+
+    prefetch->timeout_id = 0;
+    prefetch_free (prefetch);
+
+    return G_SOURCE_REMOVE;
+}
+
+static void
+restart_unused_timeout (Prefetch *prefetch)
+{
+    if (prefetch->timeout_id != 0)
+    {
+        g_source_remove (prefetch->timeout_id);
+    }
+    prefetch->timeout_id = g_timeout_add_seconds (PREFETCH_UNUSED_TIMEOUT,
+                                                  prefetch_unused_timeout_callback,
+                                                  prefetch);
+}
+
+/* Drops the oldest prefetches until the newest ones fit */
+static void
+enforce_budget (void)
+{
+    GList *l, *prev;
+    Prefetch *prefetch;
+    guint n_loading, n_files;
+
+    n_loading = 0;
+    n_files = 0;
+
+    for (l = prefetches.head; l != NULL; l = l->next)
+    {
+        prefetch = l->data;
+        n_loading += prefetch->loading ? 1 : 0;
+        n_files += prefetch->n_files;
+    }
+
+    for (l = prefetches.tail; l != NULL; l = prev)
+    {
+        prev = l->prev;
+        prefetch = l->data;
+
+        if (n_loading <= PREFETCH_MAX_LOADING &&
+            n_files <= PREFETCH_MAX_FILES &&
+            prefetches.length <= PREFETCH_MAX_DIRECTORIES)
+        {
+            break;
+        }
+
+        n_loading -= prefetch->loading ? 1 : 0;
+        n_files -= prefetch->n_files;
+        prefetch_free (prefetch);
+    }
+}
+
+static void
+done_loading_callback (NautilusDirectory *directory,
+                       gpointer           user_data)
+{
+    Prefetch *prefetch = user_data;
+
+    prefetch->loading = FALSE;
+    prefetch->n_files = g_list_length (directory->details->file_list);
+    directory->details->load_in_background = FALSE;
+
+    enforce_budget ();
+}
+
+static Prefetch *
+find_prefetch (NautilusDirectory *directory)
+{
+    GList *l;
+
+    for (l = prefetches.head; l != NULL; l = l->next)
+    {
+        if (((Prefetch *) l->data)->directory == directory)
+        {
+            return l->data;
+        }
+    }
+
+    return NULL;
+}
+
+void
+nautilus_directory_prefetch_location (GFile *location)
+{
+    NautilusDirectory *directory;
+    Prefetch *prefetch;
+    g_autofree char *uri = NULL;
+
+    g_return_if_fail (G_IS_FILE (location));
+
+    uri = g_file_get_uri (location);
+    DEBUG ("Prefetch requested for %s", uri);
+
+    directory = nautilus_directory_get (location);
+    if (directory == NULL)
+    {
+        return;
+    }
+
+    prefetch = find_prefetch (directory);
+    if (prefetch != NULL)
+    {
+        g_queue_unlink (&prefetches, &prefetch->link);
+        g_queue_push_head_link (&prefetches, &prefetch->link);
+        restart_unused_timeout (prefetch);
+        nautilus_directory_unref (directory);
+        return;
+    }
+
+    /* Already loaded and kept up to date for somebody else */
+    if (nautilus_directory_are_all_files_seen (directory) &&
+        nautilus_directory_is_file_list_monitored (directory))
+    {
+        nautilus_directory_unref (directory);
+        return;
+    }
+
+    prefetch = g_new0 (Prefetch, 1);
+    prefetch->directory = directory;
+    prefetch->link.data = prefetch;
+    prefetch->loading = !nautilus_directory_are_all_files_seen (directory);
+    g_queue_push_head_link (&prefetches, &prefetch->link);
+
+    prefetch->done_loading_id = g_signal_connect (directory, "done-loading",
+                                                  G_CALLBACK (done_loading_callback),
+                                                  prefetch);
+
+    /* Only go easy on the I/O while the prefetch is the sole reason
+     * for the load; any real client turns this off again. Adding the
+     * monitor starts the load, so this has to come first. */
+    if (prefetch->loading &&
+        directory->details->monitor_list == NULL &&
+        directory->details->call_when_ready_list == NULL)
+    {
+        directory->details->load_in_background = TRUE;
+    }
+    nautilus_directory_file_monitor_add (directory, prefetch, TRUE, 0, NULL, NULL);
+
+    /* There won't be a "done-loading" to count them */
+    if (!prefetch->loading)
+    {
+        prefetch->n_files = g_list_length (directory->details->file_list);
+    }
+
+    restart_unused_timeout (prefetch);
+    enforce_budget ();
+}
+
+void
+nautilus_directory_prefetch_file (NautilusFile *file)
+{
+    GFile *location;
+
+    g_return_if_fail (NAUTILUS_IS_FILE (file));
+
+    if (!nautilus_file_is_directory (file))
+    {
+        return;
+    }
+
+    location = nautilus_file_get_location (file);
+    nautilus_directory_prefetch_location (location);
+    g_object_unref (location);
+}
@@ -0,0 +1,34 @@
+/*
+   nautilus-directory-prefetch.h: speculative loading of directories the
+   user is likely to open next
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public
+   License along with this program; if not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef NAUTILUS_DIRECTORY_PREFETCH_H
+#define NAUTILUS_DIRECTORY_PREFETCH_H
+
+#include <gio/gio.h>
+#include "nautilus-file.h"
+
+/* Start loading @location into the directory cache at low priority.
+ * Cheap to call repeatedly; the most recent requests win when the
+ * budget runs out, and prefetches nobody uses are dropped again.
+ */
+void nautilus_directory_prefetch_location (GFile        *location);
+
+/* Same, if @file is a directory */
+void nautilus_directory_prefetch_file     (NautilusFile *file);
+
+#endif /* NAUTILUS_DIRECTORY_PREFETCH_H */
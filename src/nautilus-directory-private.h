@@ -96,6 +96,9 @@ struct NautilusDirectoryDetails
 	gboolean directory_loaded;
 	gboolean directory_loaded_sent_notification;
 	DirectoryLoadState *directory_load_in_progress;
+	/* Set while a speculative prefetch is all that wants the file
+	 * list, so it gets enumerated at low priority */
+	gboolean load_in_background;
 
 	GList *pending_file_info; /* list of GnomeVFSFileInfo's that are pending */
 	int confirmed_file_count;
@@ -113,10 +116,7 @@ struct NautilusDirectoryDetails
 	NautilusFile *get_info_file;
 	GetInfoState *get_info_in_progress;
 
-	NautilusFile *extension_info_file;
-	NautilusInfoProvider *extension_info_provider;
-	NautilusOperationHandle *extension_info_in_progress;
-	guint extension_info_idle;
+	GList *extension_info_requests; /* list of ExtensionInfoRequest * */
 
 	ThumbnailState *thumbnail_state;
 
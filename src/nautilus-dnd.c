@@ -81,7 +81,7 @@ nautilus_drag_finalize (NautilusDragInfo *drag_info)
 {
     gtk_target_list_unref (drag_info->target_list);
     nautilus_drag_destroy_selection_list (drag_info->selection_list);
-    nautilus_drag_destroy_selection_list (drag_info->selection_cache);
+    nautilus_drag_clear_selection_cache (drag_info);
 
     g_free (drag_info);
 }
@@ -185,12 +185,70 @@ nautilus_drag_uri_list_from_array (const char **uris)
     return g_list_reverse (uri_list);
 }
 
+/* The selection of a drag started in this process, or NULL. The source
+ * only caches the selection of the drag it is running, and once it has
+ * served its payload @data is that payload, so it is enough to check that
+ * @context is that drag instead of parsing @data and looking up every
+ * file again. */
+static const GList *
+get_local_selection_cache (GdkDragContext   *context,
+                           GtkSelectionData *data)
+{
+    GtkWidget *source_widget;
+    NautilusDragInfo *source_data;
+
+    source_widget = gtk_drag_get_source_widget (context);
+    if (source_widget == NULL ||
+        !(NAUTILUS_IS_CANVAS_CONTAINER (source_widget) || GTK_IS_TREE_VIEW (source_widget)))
+    {
+        return NULL;
+    }
+
+    source_data = nautilus_drag_get_source_data (context);
+    if (source_data == NULL ||
+        source_data->selection_cache_context != context ||
+        source_data->icon_list_payload == NULL)
+    {
+        return NULL;
+    }
+
+    return source_data->selection_cache;
+}
+
 GList *
-nautilus_drag_build_selection_list (GtkSelectionData *data)
+nautilus_drag_build_selection_list (GdkDragContext   *context,
+                                    GtkSelectionData *data)
 {
     GList *result;
+    const GList *l;
     const guchar *p, *oldp;
     int size;
+    NautilusDragSelectionItem *item, *source_item;
+
+    /* Items dragged from one of our own views are copied from the
+     * source's cache instead of being parsed back out of the payload
+     * and looked up again */
+    l = get_local_selection_cache (context, data);
+    if (l != NULL)
+    {
+        result = NULL;
+        for (; l != NULL; l = l->next)
+        {
+            source_item = l->data;
+
+            item = nautilus_drag_selection_item_new ();
+            item->uri = g_strdup (source_item->uri);
+            item->file = source_item->file != NULL ? g_object_ref (source_item->file) : NULL;
+            item->got_icon_position = TRUE;
+            item->icon_x = source_item->icon_x;
+            item->icon_y = source_item->icon_y;
+            item->icon_width = source_item->icon_width;
+            item->icon_height = source_item->icon_height;
+            result = g_list_prepend (result, item);
+        }
+
+        return g_list_reverse (result);
+    }
 
     result = NULL;
     oldp = gtk_selection_data_get_data (data);
@@ -198,7 +256,6 @@ nautilus_drag_build_selection_list (GtkSelectionData *data)
 
     while (size > 0)
     {
-        NautilusDragSelectionItem *item;
         guint len;
 
         /* The list is in the form:
@@ -730,36 +787,79 @@ nautilus_drag_create_selection_cache (gpointer                             conta
     return cache;
 }
 
+void
+nautilus_drag_clear_selection_cache (NautilusDragInfo *drag_info)
+{
+    nautilus_drag_destroy_selection_list (drag_info->selection_cache);
+    drag_info->selection_cache = NULL;
+    drag_info->selection_cache_context = NULL;
+
+    g_clear_pointer (&drag_info->icon_list_payload, g_bytes_unref);
+    g_clear_pointer (&drag_info->uri_list_payload, g_bytes_unref);
+}
+
+static GBytes *
+serialize_selection_cache (GList                               *cache,
+                           NautilusDragEachSelectedItemDataGet  func)
+{
+    GList *l;
+    GString *result;
+    gsize len;
+
+    result = g_string_new (NULL);
+
+    for (l = cache; l != NULL; l = l->next)
+    {
+        NautilusDragSelectionItem *item = l->data;
+        (*func)(item->uri, item->icon_x, item->icon_y, item->icon_width, item->icon_height, result);
+    }
+
+    len = result->len;
+    return g_bytes_new_take (g_string_free (result, FALSE), len);
+}
+
 /* Common function for drag_data_get_callback calls.
  * Returns FALSE if it doesn't handle drag data */
 gboolean
-nautilus_drag_drag_data_get_from_cache (GList            *cache,
+nautilus_drag_drag_data_get_from_cache (NautilusDragInfo *drag_info,
                                         GdkDragContext   *context,
                                         GtkSelectionData *selection_data,
                                         guint             info,
                                         guint32           time)
 {
-    GList *l;
-    GString *result;
-    NautilusDragEachSelectedItemDataGet func;
+    GBytes *payload;
+    gconstpointer data;
+    gsize len;
 
-    if (cache == NULL)
+    if (drag_info->selection_cache == NULL)
     {
         return FALSE;
     }
 
+    /* Targets usually ask more than once during a drag, so each
+     * serialization is kept until the cache is cleared */
     switch (info)
     {
         case NAUTILUS_ICON_DND_GNOME_ICON_LIST:
         {
-            func = add_one_gnome_icon;
+            if (drag_info->icon_list_payload == NULL)
+            {
+                drag_info->icon_list_payload = serialize_selection_cache (drag_info->selection_cache,
+                                                                          add_one_gnome_icon);
+            }
+            payload = drag_info->icon_list_payload;
         }
         break;
 
         case NAUTILUS_ICON_DND_URI_LIST:
         case NAUTILUS_ICON_DND_TEXT:
         {
-            func = add_one_uri;
+            if (drag_info->uri_list_payload == NULL)
+            {
+                drag_info->uri_list_payload = serialize_selection_cache (drag_info->selection_cache,
+                                                                         add_one_uri);
+            }
+            payload = drag_info->uri_list_payload;
         }
         break;
 
@@ -767,18 +867,10 @@ nautilus_drag_drag_data_get_from_cache (GList            *cache,
             return FALSE;
     }
 
-    result = g_string_new (NULL);
-
-    for (l = cache; l != NULL; l = l->next)
-    {
-        NautilusDragSelectionItem *item = l->data;
-        (*func)(item->uri, item->icon_x, item->icon_y, item->icon_width, item->icon_height, result);
-    }
-
+    data = g_bytes_get_data (payload, &len);
     gtk_selection_data_set (selection_data,
                             gtk_selection_data_get_target (selection_data),
-                            8, (guchar *) result->str, result->len);
-    g_string_free (result, TRUE);
+                            8, data, len);
 
     return TRUE;
 }
@@ -57,6 +57,13 @@ typedef struct {
 
 	/* cache of selected URIs, representing items being dragged */
 	GList *selection_cache;
+	/* the drag selection_cache was made for, compared but not reffed */
+	GdkDragContext *selection_cache_context;
+
+	/* selection_cache serialized as x-special/gnome-icon-list and as
+	 * text/uri-list, built the first time a target asks for them */
+	GBytes *icon_list_payload;
+	GBytes *uri_list_payload;
 
         /* File selection list information request handler, for the call for
          * information (mostly the file system info, in order to know if we want
@@ -96,7 +103,8 @@ void			    nautilus_drag_init				(NautilusDragInfo		      *drag_info,
 void			    nautilus_drag_finalize			(NautilusDragInfo		      *drag_info);
 NautilusDragSelectionItem  *nautilus_drag_selection_item_new		(void);
 void			    nautilus_drag_destroy_selection_list	(GList				      *selection_list);
-GList			   *nautilus_drag_build_selection_list		(GtkSelectionData		      *data);
+GList			   *nautilus_drag_build_selection_list		(GdkDragContext			      *context,
+									 GtkSelectionData		      *data);
 
 GList *			    nautilus_drag_uri_list_from_selection_list	(const GList			      *selection_list);
 
@@ -117,7 +125,8 @@ GdkDragAction		    nautilus_drag_default_drop_action_for_uri_list     (GdkDragCo
 										const char			     *target_uri_string);
 GList			   *nautilus_drag_create_selection_cache	(gpointer			       container_context,
 									 NautilusDragEachSelectedItemIterator  each_selected_item_iterator);
-gboolean		    nautilus_drag_drag_data_get_from_cache	(GList				      *cache,
+void			    nautilus_drag_clear_selection_cache	(NautilusDragInfo		      *drag_info);
+gboolean		    nautilus_drag_drag_data_get_from_cache	(NautilusDragInfo		      *drag_info,
 									 GdkDragContext			      *context,
 									 GtkSelectionData		      *selection_data,
 									 guint				       info,
@@ -0,0 +1,1031 @@
+/*
+ * nautilus-extension-host-proxy: talks to extensions in nautilus-extension-host
+ *
+ * Nautilus is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * Nautilus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/* Extensions that run in nautilus-extension-host are represented here by
+ * proxy objects implementing the same provider interfaces, which
+ * nautilus_module_get_extensions_for_type() hands out like any other
+ * extension. File information is requested asynchronously and in
+ * batches; menus and columns are needed right away, so they are asked
+ * for synchronously but with a timeout well under the extension call
+ * budget in nautilus-module.c. What extensions tell nautilus of their own
+ * accord, "items-updated" and invalidated file info, comes as signals.
+ */
+
+#include <config.h>
+
+#include "nautilus-extension-host-proxy.h"
+#include "nautilus-extension-host-generated.h"
+#include "nautilus-file.h"
+#include "nautilus-module.h"
+#include "nautilus-signaller.h"
+
+#include <libnautilus-extension/nautilus-column-provider.h>
+#include <libnautilus-extension/nautilus-info-provider.h>
+#include <libnautilus-extension/nautilus-menu-provider.h>
+
+#include <gio/gio.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#define HOST_SOCKET_FD 3
+#define HOST_OBJECT_PATH "/org/gnome/Nautilus/ExtensionHost"
+#define HOST_SYNC_CALL_TIMEOUT 150 /* ms */
+
+static GSubprocess *host_process = NULL;
+static NautilusDBusExtensionHost *host_proxy = NULL;
+static gboolean host_started = FALSE;
+/* Modules waiting for the connection to come up */
+static GList *queued_modules = NULL;
+/* Menu provider proxies by the name of the extension on the host side */
+static GHashTable *menu_provider_proxies = NULL;
+
+#define NAUTILUS_TYPE_EXTENSION_PROXY (nautilus_extension_proxy_get_type ())
+#define NAUTILUS_EXTENSION_PROXY(obj) (G_TYPE_CHECK_INSTANCE_CAST ((obj), NAUTILUS_TYPE_EXTENSION_PROXY, NautilusExtensionProxy))
+
+typedef struct
+{
+    GObject parent;
+
+    /* Type name of the extension on the host side */
+    char *extension;
+} NautilusExtensionProxy;
+
+typedef struct
+{
+    GObjectClass parent_class;
+} NautilusExtensionProxyClass;
+
+typedef NautilusExtensionProxy NautilusInfoProviderProxy;
+typedef NautilusExtensionProxyClass NautilusInfoProviderProxyClass;
+typedef NautilusExtensionProxy NautilusMenuProviderProxy;
+typedef NautilusExtensionProxyClass NautilusMenuProviderProxyClass;
+typedef NautilusExtensionProxy NautilusColumnProviderProxy;
+typedef NautilusExtensionProxyClass NautilusColumnProviderProxyClass;
+
+static GType nautilus_extension_proxy_get_type (void);
+static GType nautilus_info_provider_proxy_get_type (void);
+static GType nautilus_menu_provider_proxy_get_type (void);
+static GType nautilus_column_provider_proxy_get_type (void);
+
+static void info_provider_iface_init (NautilusInfoProviderIface *iface);
+static void menu_provider_iface_init (NautilusMenuProviderIface *iface);
+static void column_provider_iface_init (NautilusColumnProviderIface *iface);
+
+G_DEFINE_TYPE (NautilusExtensionProxy, nautilus_extension_proxy, G_TYPE_OBJECT);
+
+G_DEFINE_TYPE_WITH_CODE (NautilusInfoProviderProxy, nautilus_info_provider_proxy,
+                         NAUTILUS_TYPE_EXTENSION_PROXY,
+                         G_IMPLEMENT_INTERFACE (NAUTILUS_TYPE_INFO_PROVIDER,
+                                                info_provider_iface_init));
+
+G_DEFINE_TYPE_WITH_CODE (NautilusMenuProviderProxy, nautilus_menu_provider_proxy,
+                         NAUTILUS_TYPE_EXTENSION_PROXY,
+                         G_IMPLEMENT_INTERFACE (NAUTILUS_TYPE_MENU_PROVIDER,
+                                                menu_provider_iface_init));
+
+G_DEFINE_TYPE_WITH_CODE (NautilusColumnProviderProxy, nautilus_column_provider_proxy,
+                         NAUTILUS_TYPE_EXTENSION_PROXY,
+                         G_IMPLEMENT_INTERFACE (NAUTILUS_TYPE_COLUMN_PROVIDER,
+                                                column_provider_iface_init));
+
+static void
+nautilus_extension_proxy_finalize (GObject *object)
+{
+    NautilusExtensionProxy *proxy;
+
+    proxy = NAUTILUS_EXTENSION_PROXY (object);
+    if (menu_provider_proxies != NULL &&
+        g_hash_table_lookup (menu_provider_proxies, proxy->extension) == proxy)
+    {
+        g_hash_table_remove (menu_provider_proxies, proxy->extension);
+    }
+    g_free (proxy->extension);
+
+    G_OBJECT_CLASS (nautilus_extension_proxy_parent_class)->finalize (object);
+}
+
+static void
+nautilus_extension_proxy_init (NautilusExtensionProxy *proxy)
+{
+}
+
+static void
+nautilus_extension_proxy_class_init (NautilusExtensionProxyClass *class)
+{
+    G_OBJECT_CLASS (class)->finalize = nautilus_extension_proxy_finalize;
+}
+
+static void
+nautilus_info_provider_proxy_init (NautilusInfoProviderProxy *proxy)
+{
+}
+
+static void
+nautilus_info_provider_proxy_class_init (NautilusInfoProviderProxyClass *class)
+{
+}
+
+static void
+nautilus_menu_provider_proxy_init (NautilusMenuProviderProxy *proxy)
+{
+}
+
+static void
+nautilus_menu_provider_proxy_class_init (NautilusMenuProviderProxyClass *class)
+{
+}
+
+static void
+nautilus_column_provider_proxy_init (NautilusColumnProviderProxy *proxy)
+{
+}
+
+static void
+nautilus_column_provider_proxy_class_init (NautilusColumnProviderProxyClass *class)
+{
+}
+
+static void
+add_string (GVariantBuilder *builder,
+            const char      *key,
+            char            *value)
+{
+    g_variant_builder_add (builder, "{sv}", key,
+                           g_variant_new_string (value != NULL ? value : ""));
+    g_free (value);
+}
+
+static GVariant *
+file_to_variant (NautilusFileInfo *file)
+{
+    GVariantBuilder builder;
+
+    g_variant_builder_init (&builder, G_VARIANT_TYPE_VARDICT);
+    add_string (&builder, "uri", nautilus_file_info_get_uri (file));
+    add_string (&builder, "name", nautilus_file_info_get_name (file));
+    add_string (&builder, "mime-type", nautilus_file_info_get_mime_type (file));
+    add_string (&builder, "parent-uri", nautilus_file_info_get_parent_uri (file));
+    add_string (&builder, "activation-uri", nautilus_file_info_get_activation_uri (file));
+    g_variant_builder_add (&builder, "{sv}", "file-type",
+                           g_variant_new_uint32 (nautilus_file_info_get_file_type (file)));
+    g_variant_builder_add (&builder, "{sv}", "can-write",
+                           g_variant_new_boolean (nautilus_file_info_can_write (file)));
+
+    return g_variant_builder_end (&builder);
+}
+
+static GVariant *
+files_to_variant (GList *files)
+{
+    GVariantBuilder builder;
+    GList *l;
+
+    g_variant_builder_init (&builder, G_VARIANT_TYPE ("aa{sv}"));
+    for (l = files; l != NULL; l = l->next)
+    {
+        g_variant_builder_add_value (&builder, file_to_variant (l->data));
+    }
+
+    return g_variant_builder_end (&builder);
+}
+
+typedef struct
+{
+    NautilusInfoProvider *provider;
+    guint id;
+    GList *files;
+    GClosure *update_complete;
+    GCancellable *cancellable;
+} InfoCall;
+
+static guint next_info_call_id = 1;
+
+static void
+info_call_free (InfoCall *call)
+{
+    g_object_unref (call->provider);
+    g_list_free_full (call->files, g_object_unref);
+    g_closure_unref (call->update_complete);
+    g_object_unref (call->cancellable);
+    g_free (call);
+}
+
+static void
+apply_file_info (GList    *files,
+                 GVariant *results)
+{
+    GVariantIter iter;
+    GVariantIter attribute_iter;
+    GVariant *attributes;
+    const char **emblems;
+    const char *name, *value;
+    GList *l;
+    guint i;
+
+    g_variant_iter_init (&iter, results);
+    for (l = files; l != NULL; l = l->next)
+    {
+        if (!g_variant_iter_next (&iter, "(^a&s@a{ss})", &emblems, &attributes))
+        {
+            break;
+        }
+
+        for (i = 0; emblems[i] != NULL; i++)
+        {
+            nautilus_file_info_add_emblem (l->data, emblems[i]);
+        }
+
+        g_variant_iter_init (&attribute_iter, attributes);
+        while (g_variant_iter_next (&attribute_iter, "{&s&s}", &name, &value))
+        {
+            nautilus_file_info_add_string_attribute (l->data, name, value);
+        }
+
+        g_free (emblems);
+        g_variant_unref (attributes);
+    }
+}
+
+static void
+update_file_info_callback (GObject      *source_object,
+                           GAsyncResult *res,
+                           gpointer      user_data)
+{
+    InfoCall *call;
+    GVariant *reply;
+    GVariant *results;
+    NautilusOperationResult result;
+    GError *error;
+
+    call = user_data;
+    error = NULL;
+
+    reply = g_dbus_proxy_call_finish (G_DBUS_PROXY (source_object), res, &error);
+    if (reply == NULL)
+    {
+        if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        {
+            /* The caller has forgotten about us already */
+            g_error_free (error);
+            info_call_free (call);
+            return;
+        }
+
+        g_warning ("Extension %s failed to update file information: %s",
+                   NAUTILUS_EXTENSION_PROXY (call->provider)->extension,
+                   error->message);
+        g_error_free (error);
+        result = NAUTILUS_OPERATION_FAILED;
+    }
+    else
+    {
+        g_variant_get (reply, "(@a(asa{ss}))", &results);
+        apply_file_info (call->files, results);
+        g_variant_unref (results);
+        g_variant_unref (reply);
+        result = NAUTILUS_OPERATION_COMPLETE;
+    }
+
+    nautilus_info_provider_update_complete_invoke (call->update_complete,
+                                                   call->provider,
+                                                   (NautilusOperationHandle *) call,
+                                                   result);
+    info_call_free (call);
+}
+
+static NautilusOperationResult
+info_provider_update_file_info_batch (NautilusInfoProvider     *provider,
+                                      GList                    *files,
+                                      GClosure                 *update_complete,
+                                      NautilusOperationHandle **handle)
+{
+    InfoCall *call;
+
+    if (host_proxy == NULL)
+    {
+        return NAUTILUS_OPERATION_FAILED;
+    }
+
+    call = g_new0 (InfoCall, 1);
+    call->provider = g_object_ref (provider);
+    call->id = next_info_call_id++;
+    call->files = g_list_copy_deep (files, (GCopyFunc) g_object_ref, NULL);
+    call->update_complete = g_closure_ref (update_complete);
+    call->cancellable = g_cancellable_new ();
+
+    /* The extension may be slow to answer for good reasons, and nobody
+     * waits on this, so no timeout */
+    g_dbus_proxy_call (G_DBUS_PROXY (host_proxy),
+                       "UpdateFileInfo",
+                       g_variant_new ("(su@aa{sv})",
+                                      NAUTILUS_EXTENSION_PROXY (provider)->extension,
+                                      call->id,
+                                      files_to_variant (files)),
+                       G_DBUS_CALL_FLAGS_NONE,
+                       G_MAXINT,
+                       call->cancellable,
+                       update_file_info_callback,
+                       call);
+
+    *handle = (NautilusOperationHandle *) call;
+
+    return NAUTILUS_OPERATION_IN_PROGRESS;
+}
+
+static NautilusOperationResult
+info_provider_update_file_info (NautilusInfoProvider     *provider,
+                                NautilusFileInfo         *file,
+                                GClosure                 *update_complete,
+                                NautilusOperationHandle **handle)
+{
+    NautilusOperationResult result;
+    GList *files;
+
+    files = g_list_prepend (NULL, file);
+    result = info_provider_update_file_info_batch (provider, files,
+                                                   update_complete, handle);
+    g_list_free (files);
+
+    return result;
+}
+
+static void
+info_provider_cancel_update (NautilusInfoProvider    *provider,
+                             NautilusOperationHandle *handle)
+{
+    InfoCall *call;
+
+    call = (InfoCall *) handle;
+
+    /* Lets the extension stop working on it, not just us stop waiting */
+    if (host_proxy != NULL)
+    {
+        nautilus_dbus_extension_host_call_cancel_update (host_proxy, call->id,
+                                                         NULL, NULL, NULL);
+    }
+
+    /* Frees the call, once the reply comes in */
+    g_cancellable_cancel (call->cancellable);
+}
+
+static void
+info_provider_iface_init (NautilusInfoProviderIface *iface)
+{
+    iface->update_file_info = info_provider_update_file_info;
+    iface->cancel_update = info_provider_cancel_update;
+    iface->update_file_info_batch = info_provider_update_file_info_batch;
+}
+
+/* A menu the host keeps the items of until we release it, which
+ * happens once all the items built from it are gone. However long
+ * they are cached, activating them still works. */
+typedef struct
+{
+    guint id;
+    guint n_items;
+} HostMenu;
+
+#define HOST_MENU_ITEM_INDEX "nautilus-host-menu-item-index"
+
+static guint next_menu_id = 1;
+
+static void
+release_host_menu (guint menu_id)
+{
+    if (host_proxy != NULL)
+    {
+        nautilus_dbus_extension_host_call_release_menu (host_proxy, menu_id,
+                                                        NULL, NULL, NULL);
+    }
+}
+
+static void
+host_menu_item_finalized (gpointer  data,
+                          GObject  *where_the_object_was)
+{
+    HostMenu *menu;
+
+    menu = data;
+    if (--menu->n_items > 0)
+    {
+        return;
+    }
+
+    release_host_menu (menu->id);
+    g_free (menu);
+}
+
+static void
+menu_item_activate_callback (NautilusMenuItem *item,
+                             gpointer          user_data)
+{
+    HostMenu *menu;
+
+    menu = user_data;
+    if (host_proxy != NULL)
+    {
+        nautilus_dbus_extension_host_call_activate_item (host_proxy,
+                                                         menu->id,
+                                                         GPOINTER_TO_UINT (g_object_get_data (G_OBJECT (item),
+                                                                                              HOST_MENU_ITEM_INDEX)),
+                                                         NULL, NULL, NULL);
+    }
+}
+
+#define HOST_WINDOW_ID "nautilus-extension-host-window-id"
+
+static guint next_window_id = 1;
+
+static void
+window_finalized (gpointer  data,
+                  GObject  *where_the_object_was)
+{
+    if (host_proxy != NULL)
+    {
+        nautilus_dbus_extension_host_call_release_window (host_proxy,
+                                                          GPOINTER_TO_UINT (data),
+                                                          NULL, NULL, NULL);
+    }
+}
+
+/* Identifies @window to the host, which hands its extensions a window
+ * of its own for it */
+static guint
+get_window_id (GtkWidget *window)
+{
+    guint id;
+
+    if (window == NULL)
+    {
+        return 0;
+    }
+
+    id = GPOINTER_TO_UINT (g_object_get_data (G_OBJECT (window), HOST_WINDOW_ID));
+    if (id == 0)
+    {
+        id = next_window_id++;
+        g_object_set_data (G_OBJECT (window), HOST_WINDOW_ID, GUINT_TO_POINTER (id));
+        g_object_weak_ref (G_OBJECT (window), window_finalized, GUINT_TO_POINTER (id));
+    }
+
+    return id;
+}
+
+/* Rebuilds the menu tree the host flattened for us */
+static GList *
+menu_items_from_variant (guint     menu_id,
+                         GVariant *variant)
+{
+    GVariantIter iter;
+    GPtrArray *items;
+    GList *toplevel;
+    HostMenu *host_menu;
+    NautilusMenuItem *item, *parent_item;
+    NautilusMenu *menu;
+    const char *name, *label, *tip, *icon;
+    gboolean sensitive, priority;
+    gint parent;
+
+    host_menu = g_new0 (HostMenu, 1);
+    host_menu->id = menu_id;
+
+    items = g_ptr_array_new ();
+    toplevel = NULL;
+
+    g_variant_iter_init (&iter, variant);
+    while (g_variant_iter_next (&iter, "(i&s&s&s&sbb)",
+                                &parent, &name, &label, &tip, &icon,
+                                &sensitive, &priority))
+    {
+        item = nautilus_menu_item_new (name, label, tip,
+                                       icon[0] != '\0' ? icon : NULL);
+        g_object_set (item,
+                      "sensitive", sensitive,
+                      "priority", priority,
+                      NULL);
+        g_object_set_data (G_OBJECT (item), HOST_MENU_ITEM_INDEX,
+                           GUINT_TO_POINTER (items->len));
+        g_signal_connect (item, "activate",
+                          G_CALLBACK (menu_item_activate_callback),
+                          host_menu);
+        g_object_weak_ref (G_OBJECT (item), host_menu_item_finalized, host_menu);
+        host_menu->n_items++;
+        g_ptr_array_add (items, item);
+
+        if (parent < 0 || (guint) parent >= items->len - 1)
+        {
+            toplevel = g_list_prepend (toplevel, item);
+            continue;
+        }
+
+        parent_item = g_ptr_array_index (items, parent);
+        g_object_get (parent_item, "menu", &menu, NULL);
+        if (menu == NULL)
+        {
+            menu = nautilus_menu_new ();
+            nautilus_menu_item_set_submenu (parent_item, menu);
+        }
+        nautilus_menu_append_item (menu, item);
+        g_object_unref (menu);
+        g_object_unref (item);
+    }
+
+    g_ptr_array_free (items, TRUE);
+
+    /* The host keeps nothing for an empty menu */
+    if (host_menu->n_items == 0)
+    {
+        g_free (host_menu);
+    }
+
+    return g_list_reverse (toplevel);
+}
+
+/* Menus and columns are needed before anything can be shown, so they
+ * are waited for, but only briefly */
+static GVariant *
+call_host_sync (gpointer    provider,
+                const char *method,
+                GVariant   *parameters)
+{
+    GVariant *reply;
+    GError *error;
+
+    error = NULL;
+    reply = g_dbus_proxy_call_sync (G_DBUS_PROXY (host_proxy),
+                                    method,
+                                    parameters,
+                                    G_DBUS_CALL_FLAGS_NONE,
+                                    HOST_SYNC_CALL_TIMEOUT,
+                                    NULL,
+                                    &error);
+    if (reply == NULL)
+    {
+        g_warning ("Extension %s failed to answer %s: %s",
+                   NAUTILUS_EXTENSION_PROXY (provider)->extension,
+                   method, error->message);
+        g_error_free (error);
+    }
+
+    return reply;
+}
+
+static GList *
+menu_items_from_reply (guint     menu_id,
+                       GVariant *reply)
+{
+    GVariant *items;
+    GList *ret;
+
+    if (reply == NULL)
+    {
+        /* The host may still answer after we stopped waiting, and keep
+         * the items nobody will ever release otherwise. It handles the
+         * calls in order, so this comes after the answer. */
+        release_host_menu (menu_id);
+        return NULL;
+    }
+
+    g_variant_get (reply, "(@a(issssbb))", &items);
+    ret = menu_items_from_variant (menu_id, items);
+    g_variant_unref (items);
+    g_variant_unref (reply);
+
+    return ret;
+}
+
+static GList *
+menu_provider_get_file_items (NautilusMenuProvider *provider,
+                              GtkWidget            *window,
+                              GList                *files)
+{
+    guint menu_id;
+
+    if (host_proxy == NULL)
+    {
+        return NULL;
+    }
+
+    menu_id = next_menu_id++;
+
+    return menu_items_from_reply (menu_id,
+                                  call_host_sync (provider, "GetFileItems",
+                                                  g_variant_new ("(suu@aa{sv})",
+                                                                 NAUTILUS_EXTENSION_PROXY (provider)->extension,
+                                                                 get_window_id (window),
+                                                                 menu_id,
+                                                                 files_to_variant (files))));
+}
+
+static GList *
+menu_provider_get_background_items (NautilusMenuProvider *provider,
+                                    GtkWidget            *window,
+                                    NautilusFileInfo     *current_folder)
+{
+    guint menu_id;
+
+    if (host_proxy == NULL)
+    {
+        return NULL;
+    }
+
+    menu_id = next_menu_id++;
+
+    return menu_items_from_reply (menu_id,
+                                  call_host_sync (provider, "GetBackgroundItems",
+                                                  g_variant_new ("(suu@a{sv})",
+                                                                 NAUTILUS_EXTENSION_PROXY (provider)->extension,
+                                                                 get_window_id (window),
+                                                                 menu_id,
+                                                                 file_to_variant (current_folder))));
+}
+
+static void
+menu_provider_iface_init (NautilusMenuProviderIface *iface)
+{
+    iface->get_file_items = menu_provider_get_file_items;
+    iface->get_background_items = menu_provider_get_background_items;
+}
+
+static GList *
+column_provider_get_columns (NautilusColumnProvider *provider)
+{
+    NautilusColumn *column;
+    GVariant *columns;
+    GVariantIter iter;
+    const char *name, *attribute, *label, *description;
+    gdouble xalign;
+    GVariant *reply;
+    GList *ret;
+
+    if (host_proxy == NULL)
+    {
+        return NULL;
+    }
+
+    reply = call_host_sync (provider, "GetColumns",
+                            g_variant_new ("(s)", NAUTILUS_EXTENSION_PROXY (provider)->extension));
+    if (reply == NULL)
+    {
+        return NULL;
+    }
+
+    g_variant_get (reply, "(@a(ssssd))", &columns);
+    g_variant_unref (reply);
+
+    ret = NULL;
+    g_variant_iter_init (&iter, columns);
+    while (g_variant_iter_next (&iter, "(&s&s&s&sd)",
+                                &name, &attribute, &label, &description, &xalign))
+    {
+        column = nautilus_column_new (name, attribute, label, description);
+        g_object_set (column, "xalign", (float) xalign, NULL);
+        ret = g_list_prepend (ret, column);
+    }
+    g_variant_unref (columns);
+
+    return g_list_reverse (ret);
+}
+
+static void
+column_provider_iface_init (NautilusColumnProviderIface *iface)
+{
+    iface->get_columns = column_provider_get_columns;
+}
+
+/* All proxies of one extension go by the name the extension would have
+ * in this process, so they share its call statistics */
+static void
+add_proxy (GType       type,
+           const char *extension,
+           const char *name)
+{
+    NautilusExtensionProxy *proxy;
+
+    proxy = g_object_new (type, NULL);
+    proxy->extension = g_strdup (extension);
+
+    if (type == nautilus_menu_provider_proxy_get_type ())
+    {
+        if (menu_provider_proxies == NULL)
+        {
+            menu_provider_proxies = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                                           g_free, NULL);
+        }
+        g_hash_table_insert (menu_provider_proxies, g_strdup (extension), proxy);
+    }
+
+    nautilus_module_add_extension_object (G_OBJECT (proxy), name);
+}
+
+static void
+load_module_callback (GObject      *source_object,
+                      GAsyncResult *res,
+                      gpointer      user_data)
+{
+    GVariant *reply;
+    GVariant *extensions;
+    GVariantIter iter;
+    const char *extension;
+    const char **interfaces;
+    char *path;
+    char *basename;
+    char *name;
+    GError *error;
+    guint i;
+
+    path = user_data;
+    error = NULL;
+
+    reply = g_dbus_proxy_call_finish (G_DBUS_PROXY (source_object), res, &error);
+    if (reply == NULL)
+    {
+        g_warning ("The extension host could not load %s: %s", path, error->message);
+        g_error_free (error);
+        g_free (path);
+        return;
+    }
+
+    g_variant_get (reply, "(@a(sas))", &extensions);
+    g_variant_unref (reply);
+
+    basename = g_path_get_basename (path);
+
+    g_variant_iter_init (&iter, extensions);
+    while (g_variant_iter_next (&iter, "(&s^a&s)", &extension, &interfaces))
+    {
+        name = g_strdup_printf ("%s (%s)", extension, basename);
+        for (i = 0; interfaces[i] != NULL; i++)
+        {
+            if (g_str_equal (interfaces[i], g_type_name (NAUTILUS_TYPE_INFO_PROVIDER)))
+            {
+                add_proxy (nautilus_info_provider_proxy_get_type (), extension, name);
+            }
+            else if (g_str_equal (interfaces[i], g_type_name (NAUTILUS_TYPE_MENU_PROVIDER)))
+            {
+                add_proxy (nautilus_menu_provider_proxy_get_type (), extension, name);
+            }
+            else if (g_str_equal (interfaces[i], g_type_name (NAUTILUS_TYPE_COLUMN_PROVIDER)))
+            {
+                add_proxy (nautilus_column_provider_proxy_get_type (), extension, name);
+            }
+        }
+        g_free (name);
+        g_free (interfaces);
+    }
+
+    g_variant_unref (extensions);
+    g_free (basename);
+    g_free (path);
+
+    g_signal_emit_by_name (nautilus_signaller_get_current (), "extensions-loaded");
+}
+
+static void
+items_updated_callback (NautilusDBusExtensionHost *proxy,
+                        const char                *extension,
+                        gpointer                   user_data)
+{
+    NautilusMenuProvider *provider;
+
+    provider = menu_provider_proxies != NULL ?
+               g_hash_table_lookup (menu_provider_proxies, extension) : NULL;
+    if (provider != NULL)
+    {
+        nautilus_menu_provider_emit_items_updated_signal (provider);
+    }
+}
+
+static void
+extension_info_invalidated_callback (NautilusDBusExtensionHost *proxy,
+                                     const char                *uri,
+                                     gpointer                   user_data)
+{
+    NautilusFile *file;
+
+    file = nautilus_file_get_existing_by_uri (uri);
+    if (file != NULL)
+    {
+        nautilus_file_info_invalidate_extension_info (NAUTILUS_FILE_INFO (file));
+        nautilus_file_unref (file);
+    }
+}
+
+static void
+request_load_module (const char *path)
+{
+    /* Initializing a module may take a while, starting an interpreter
+     * for instance, and nothing waits on it */
+    g_dbus_proxy_call (G_DBUS_PROXY (host_proxy),
+                       "LoadModule",
+                       g_variant_new ("(s)", path),
+                       G_DBUS_CALL_FLAGS_NONE,
+                       G_MAXINT,
+                       NULL,
+                       load_module_callback,
+                       g_strdup (path));
+}
+
+static void
+host_gone (void)
+{
+    if (host_proxy != NULL)
+    {
+        g_warning ("The extension host went away; extensions running in it "
+                   "are disabled for this session");
+    }
+
+    /* The proxies stay around but do nothing. Starting the host again
+     * could just as well crash it again. */
+    g_clear_object (&host_proxy);
+    g_list_free_full (queued_modules, g_free);
+    queued_modules = NULL;
+}
+
+static void
+connection_closed_callback (GDBusConnection *connection,
+                            gboolean         remote_peer_vanished,
+                            GError          *error,
+                            gpointer         user_data)
+{
+    host_gone ();
+}
+
+static void
+connection_ready_callback (GObject      *source_object,
+                           GAsyncResult *res,
+                           gpointer      user_data)
+{
+    GDBusConnection *connection;
+    GError *error;
+    GList *l;
+
+    error = NULL;
+    connection = g_dbus_connection_new_finish (res, &error);
+    if (connection == NULL)
+    {
+        g_warning ("Could not connect to the extension host: %s", error->message);
+        g_error_free (error);
+        host_gone ();
+        return;
+    }
+
+    g_signal_connect (connection, "closed",
+                      G_CALLBACK (connection_closed_callback), NULL);
+
+    host_proxy = nautilus_dbus_extension_host_proxy_new_sync (connection,
+                                                              G_DBUS_PROXY_FLAGS_DO_NOT_LOAD_PROPERTIES,
+                                                              NULL,
+                                                              HOST_OBJECT_PATH,
+                                                              NULL,
+                                                              &error);
+    /* The proxy holds on to the connection */
+    g_object_unref (connection);
+    if (host_proxy == NULL)
+    {
+        g_warning ("Could not connect to the extension host: %s", error->message);
+        g_error_free (error);
+        host_gone ();
+        return;
+    }
+
+    g_signal_connect (host_proxy, "items-updated",
+                      G_CALLBACK (items_updated_callback), NULL);
+    g_signal_connect (host_proxy, "extension-info-invalidated",
+                      G_CALLBACK (extension_info_invalidated_callback), NULL);
+
+    for (l = queued_modules; l != NULL; l = l->next)
+    {
+        request_load_module (l->data);
+    }
+    g_list_free_full (queued_modules, g_free);
+    queued_modules = NULL;
+}
+
+static void
+host_exited_callback (GObject      *source_object,
+                      GAsyncResult *res,
+                      gpointer      user_data)
+{
+    g_subprocess_wait_finish (G_SUBPROCESS (source_object), res, NULL);
+    g_clear_object (&host_process);
+}
+
+static gboolean
+start_host (void)
+{
+    GSubprocessLauncher *launcher;
+    GSocketConnection *stream;
+    GSocket *socket;
+    const char *host_path;
+    char *guid;
+    int fds[2];
+    GError *error;
+
+    if (socketpair (AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) != 0)
+    {
+        g_warning ("Could not start the extension host: %s", g_strerror (errno));
+        return FALSE;
+    }
+
+    /* Lets the host be run from the build directory */
+    host_path = g_getenv ("NAUTILUS_EXTENSION_HOST");
+    if (host_path == NULL)
+    {
+        host_path = LIBEXECDIR "/nautilus-extension-host";
+    }
+
+    error = NULL;
+    launcher = g_subprocess_launcher_new (G_SUBPROCESS_FLAGS_NONE);
+    g_subprocess_launcher_take_fd (launcher, fds[1], HOST_SOCKET_FD);
+    host_process = g_subprocess_launcher_spawn (launcher, &error, host_path, NULL);
+    g_object_unref (launcher);
+    if (host_process == NULL)
+    {
+        g_warning ("Could not start the extension host: %s", error->message);
+        g_error_free (error);
+        close (fds[0]);
+        return FALSE;
+    }
+
+    g_subprocess_wait_async (host_process, NULL, host_exited_callback, NULL);
+
+    socket = g_socket_new_from_fd (fds[0], &error);
+    if (socket == NULL)
+    {
+        g_warning ("Could not start the extension host: %s", error->message);
+        g_error_free (error);
+        close (fds[0]);
+        g_subprocess_force_exit (host_process);
+        return FALSE;
+    }
+
+    stream = g_socket_connection_factory_create_connection (socket);
+    guid = g_dbus_generate_guid ();
+    g_dbus_connection_new (G_IO_STREAM (stream), guid,
+                           G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_SERVER |
+                           G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_ALLOW_ANONYMOUS,
+                           NULL, NULL,
+                           connection_ready_callback, NULL);
+    g_free (guid);
+    g_object_unref (stream);
+    g_object_unref (socket);
+
+    return TRUE;
+}
+
+/**
+ * nautilus_extension_host_load_module:
+ * @path: the module to load
+ *
+ * Has nautilus-extension-host load @path, starting the host if it is
+ * not running yet. The module's extensions show up among the module
+ * objects once the host has loaded it.
+ *
+ * Returns: %FALSE if the host could not be started, in which case the
+ * caller should load the module itself.
+ */
+gboolean
+nautilus_extension_host_load_module (const char *path)
+{
+    if (!host_started)
+    {
+        host_started = TRUE;
+        if (!start_host ())
+        {
+            return FALSE;
+        }
+    }
+    else if (host_process == NULL && host_proxy == NULL)
+    {
+        /* It has already failed us once */
+        return FALSE;
+    }
+
+    if (host_proxy == NULL)
+    {
+        queued_modules = g_list_append (queued_modules, g_strdup (path));
+    }
+    else
+    {
+        request_load_module (path);
+    }
+
+    return TRUE;
+}
@@ -0,0 +1,30 @@
+/*
+ * nautilus-extension-host-proxy: talks to extensions in nautilus-extension-host
+ *
+ * Nautilus is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * Nautilus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef NAUTILUS_EXTENSION_HOST_PROXY_H
+#define NAUTILUS_EXTENSION_HOST_PROXY_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+gboolean nautilus_extension_host_load_module (const char *path);
+
+G_END_DECLS
+
+#endif /* NAUTILUS_EXTENSION_HOST_PROXY_H */
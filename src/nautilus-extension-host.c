@@ -0,0 +1,954 @@
+/*
+ * nautilus-extension-host: runs nautilus extensions in their own process
+ *
+ * Nautilus is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * Nautilus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/* Nautilus starts this program with one end of a socket pair as file
+ * descriptor 3 and talks to it over a peer-to-peer D-Bus connection on
+ * that socket, see data/extension-host-dbus-interfaces.xml. Extensions
+ * only ever see stand-in NautilusFileInfo objects built from what
+ * nautilus sends; whatever they add to them is sent back.
+ */
+
+#include <config.h>
+
+#include <gtk/gtk.h>
+#include <gio/gio.h>
+
+#include <libnautilus-extension/nautilus-column-provider.h>
+#include <libnautilus-extension/nautilus-file-info.h>
+#include <libnautilus-extension/nautilus-info-provider.h>
+#include <libnautilus-extension/nautilus-menu-provider.h>
+
+#include "nautilus-extension-host-generated.h"
+#include "nautilus-module.h"
+
+#define HOST_SOCKET_FD 3
+#define HOST_OBJECT_PATH "/org/gnome/Nautilus/ExtensionHost"
+
+#define NAUTILUS_TYPE_HOST_FILE  (nautilus_host_file_get_type ())
+#define NAUTILUS_HOST_FILE(obj)  (G_TYPE_CHECK_INSTANCE_CAST ((obj), NAUTILUS_TYPE_HOST_FILE, NautilusHostFile))
+
+typedef struct
+{
+    GObject parent;
+
+    char *uri;
+    char *name;
+    char *mime_type;
+    char *parent_uri;
+    char *activation_uri;
+    GFileType file_type;
+    gboolean can_write;
+
+    /* What the extension added */
+    GPtrArray *emblems;
+    GHashTable *attributes;
+} NautilusHostFile;
+
+typedef struct
+{
+    GObjectClass parent_class;
+} NautilusHostFileClass;
+
+static GType nautilus_host_file_get_type (void);
+static void nautilus_host_file_info_iface_init (NautilusFileInfoIface *iface);
+
+G_DEFINE_TYPE_WITH_CODE (NautilusHostFile, nautilus_host_file, G_TYPE_OBJECT,
+                         G_IMPLEMENT_INTERFACE (NAUTILUS_TYPE_FILE_INFO,
+                                                nautilus_host_file_info_iface_init));
+
+static GMainLoop *loop;
+static NautilusDBusExtensionHost *host_skeleton;
+/* Extension objects by type name */
+static GHashTable *extensions;
+/* The items of every menu nautilus still holds, flattened into a
+ * GPtrArray, by the id nautilus gave the menu */
+static GHashTable *menus;
+/* File info updates in progress, by the id nautilus gave them */
+static GHashTable *update_requests;
+/* Windows standing in for those of nautilus, by the id nautilus gave
+ * them. Only made when there is a display to make them on. */
+static GHashTable *windows;
+static gboolean have_display;
+
+static void
+nautilus_host_file_finalize (GObject *object)
+{
+    NautilusHostFile *file;
+
+    file = NAUTILUS_HOST_FILE (object);
+
+    g_free (file->uri);
+    g_free (file->name);
+    g_free (file->mime_type);
+    g_free (file->parent_uri);
+    g_free (file->activation_uri);
+    g_ptr_array_unref (file->emblems);
+    g_hash_table_destroy (file->attributes);
+
+    G_OBJECT_CLASS (nautilus_host_file_parent_class)->finalize (object);
+}
+
+static void
+nautilus_host_file_init (NautilusHostFile *file)
+{
+    file->emblems = g_ptr_array_new_with_free_func (g_free);
+    file->attributes = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                              g_free, g_free);
+}
+
+static void
+nautilus_host_file_class_init (NautilusHostFileClass *class)
+{
+    G_OBJECT_CLASS (class)->finalize = nautilus_host_file_finalize;
+}
+
+static char *
+lookup_string (GVariant   *dict,
+               const char *key)
+{
+    char *value;
+
+    if (!g_variant_lookup (dict, key, "s", &value))
+    {
+        value = g_strdup ("");
+    }
+
+    return value;
+}
+
+static NautilusHostFile *
+nautilus_host_file_new (GVariant *dict)
+{
+    NautilusHostFile *file;
+    guint32 file_type;
+
+    file = g_object_new (NAUTILUS_TYPE_HOST_FILE, NULL);
+
+    file->uri = lookup_string (dict, "uri");
+    file->name = lookup_string (dict, "name");
+    file->mime_type = lookup_string (dict, "mime-type");
+    file->parent_uri = lookup_string (dict, "parent-uri");
+    file->activation_uri = lookup_string (dict, "activation-uri");
+
+    if (g_variant_lookup (dict, "file-type", "u", &file_type))
+    {
+        file->file_type = file_type;
+    }
+    g_variant_lookup (dict, "can-write", "b", &file->can_write);
+
+    return file;
+}
+
+static gboolean
+host_file_is_gone (NautilusFileInfo *info)
+{
+    return FALSE;
+}
+
+static char *
+host_file_get_name (NautilusFileInfo *info)
+{
+    return g_strdup (NAUTILUS_HOST_FILE (info)->name);
+}
+
+static char *
+host_file_get_uri (NautilusFileInfo *info)
+{
+    return g_strdup (NAUTILUS_HOST_FILE (info)->uri);
+}
+
+static char *
+host_file_get_parent_uri (NautilusFileInfo *info)
+{
+    return g_strdup (NAUTILUS_HOST_FILE (info)->parent_uri);
+}
+
+static char *
+host_file_get_uri_scheme (NautilusFileInfo *info)
+{
+    return g_uri_parse_scheme (NAUTILUS_HOST_FILE (info)->uri);
+}
+
+static char *
+host_file_get_mime_type (NautilusFileInfo *info)
+{
+    return g_strdup (NAUTILUS_HOST_FILE (info)->mime_type);
+}
+
+static gboolean
+host_file_is_mime_type (NautilusFileInfo *info,
+                        const char       *mime_type)
+{
+    return g_content_type_is_a (NAUTILUS_HOST_FILE (info)->mime_type, mime_type);
+}
+
+static gboolean
+host_file_is_directory (NautilusFileInfo *info)
+{
+    return NAUTILUS_HOST_FILE (info)->file_type == G_FILE_TYPE_DIRECTORY;
+}
+
+static void
+host_file_add_emblem (NautilusFileInfo *info,
+                      const char       *emblem_name)
+{
+    NautilusHostFile *file;
+    guint i;
+
+    file = NAUTILUS_HOST_FILE (info);
+
+    for (i = 0; i < file->emblems->len; i++)
+    {
+        if (g_str_equal (g_ptr_array_index (file->emblems, i), emblem_name))
+        {
+            return;
+        }
+    }
+
+    g_ptr_array_add (file->emblems, g_strdup (emblem_name));
+}
+
+static char *
+host_file_get_string_attribute (NautilusFileInfo *info,
+                                const char       *attribute_name)
+{
+    return g_strdup (g_hash_table_lookup (NAUTILUS_HOST_FILE (info)->attributes,
+                                          attribute_name));
+}
+
+static void
+host_file_add_string_attribute (NautilusFileInfo *info,
+                                const char       *attribute_name,
+                                const char       *value)
+{
+    g_hash_table_insert (NAUTILUS_HOST_FILE (info)->attributes,
+                         g_strdup (attribute_name), g_strdup (value));
+}
+
+/* Extensions that keep the file around call this later on, when what
+ * they added is out of date. The file in nautilus is the one to update. */
+static void
+host_file_invalidate_extension_info (NautilusFileInfo *info)
+{
+    nautilus_dbus_extension_host_emit_extension_info_invalidated (host_skeleton,
+                                                                  NAUTILUS_HOST_FILE (info)->uri);
+}
+
+static char *
+host_file_get_activation_uri (NautilusFileInfo *info)
+{
+    NautilusHostFile *file;
+
+    file = NAUTILUS_HOST_FILE (info);
+
+    return g_strdup (file->activation_uri[0] != '\0' ? file->activation_uri : file->uri);
+}
+
+static GFileType
+host_file_get_file_type (NautilusFileInfo *info)
+{
+    return NAUTILUS_HOST_FILE (info)->file_type;
+}
+
+static GFile *
+host_file_get_location (NautilusFileInfo *info)
+{
+    return g_file_new_for_uri (NAUTILUS_HOST_FILE (info)->uri);
+}
+
+static GFile *
+host_file_get_parent_location (NautilusFileInfo *info)
+{
+    NautilusHostFile *file;
+
+    file = NAUTILUS_HOST_FILE (info);
+
+    if (file->parent_uri[0] == '\0')
+    {
+        return NULL;
+    }
+
+    return g_file_new_for_uri (file->parent_uri);
+}
+
+static NautilusFileInfo *
+host_file_get_parent_info (NautilusFileInfo *info)
+{
+    return NULL;
+}
+
+static GMount *
+host_file_get_mount (NautilusFileInfo *info)
+{
+    return NULL;
+}
+
+static gboolean
+host_file_can_write (NautilusFileInfo *info)
+{
+    return NAUTILUS_HOST_FILE (info)->can_write;
+}
+
+static void
+nautilus_host_file_info_iface_init (NautilusFileInfoIface *iface)
+{
+    iface->is_gone = host_file_is_gone;
+    iface->get_name = host_file_get_name;
+    iface->get_file_type = host_file_get_file_type;
+    iface->get_location = host_file_get_location;
+    iface->get_uri = host_file_get_uri;
+    iface->get_parent_location = host_file_get_parent_location;
+    iface->get_parent_uri = host_file_get_parent_uri;
+    iface->get_parent_info = host_file_get_parent_info;
+    iface->get_mount = host_file_get_mount;
+    iface->get_uri_scheme = host_file_get_uri_scheme;
+    iface->get_activation_uri = host_file_get_activation_uri;
+    iface->get_mime_type = host_file_get_mime_type;
+    iface->is_mime_type = host_file_is_mime_type;
+    iface->is_directory = host_file_is_directory;
+    iface->can_write = host_file_can_write;
+    iface->add_emblem = host_file_add_emblem;
+    iface->get_string_attribute = host_file_get_string_attribute;
+    iface->add_string_attribute = host_file_add_string_attribute;
+    iface->invalidate_extension_info = host_file_invalidate_extension_info;
+}
+
+static GList *
+files_from_variant (GVariant *variant)
+{
+    GVariantIter iter;
+    GVariant *dict;
+    GList *files;
+
+    files = NULL;
+    g_variant_iter_init (&iter, variant);
+    while (g_variant_iter_next (&iter, "@a{sv}", &dict))
+    {
+        files = g_list_prepend (files, nautilus_host_file_new (dict));
+        g_variant_unref (dict);
+    }
+
+    return g_list_reverse (files);
+}
+
+static gpointer
+lookup_extension (GDBusMethodInvocation *invocation,
+                  const char            *name,
+                  GType                  iface)
+{
+    GObject *extension;
+
+    extension = g_hash_table_lookup (extensions, name);
+    if (extension == NULL || !G_TYPE_CHECK_INSTANCE_TYPE (extension, iface))
+    {
+        g_dbus_method_invocation_return_error (invocation,
+                                               G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS,
+                                               "No %s named %s",
+                                               g_type_name (iface), name);
+        return NULL;
+    }
+
+    return extension;
+}
+
+static void
+menu_provider_items_updated (NautilusMenuProvider *provider)
+{
+    nautilus_dbus_extension_host_emit_items_updated (host_skeleton,
+                                                     G_OBJECT_TYPE_NAME (provider));
+}
+
+static gboolean
+handle_load_module (NautilusDBusExtensionHost *skeleton,
+                    GDBusMethodInvocation     *invocation,
+                    const char                *path)
+{
+    GVariantBuilder builder;
+    GVariantBuilder interfaces;
+    GList *objects, *l;
+    GType provider_types[] =
+    {
+        NAUTILUS_TYPE_INFO_PROVIDER,
+        NAUTILUS_TYPE_MENU_PROVIDER,
+        NAUTILUS_TYPE_COLUMN_PROVIDER,
+    };
+    guint i;
+
+    objects = nautilus_module_load_for_host (path);
+    if (objects == NULL)
+    {
+        g_dbus_method_invocation_return_error (invocation,
+                                               G_IO_ERROR, G_IO_ERROR_FAILED,
+                                               "Could not load %s", path);
+        return TRUE;
+    }
+
+    g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(sas)"));
+    for (l = objects; l != NULL; l = l->next)
+    {
+        g_variant_builder_init (&interfaces, G_VARIANT_TYPE_STRING_ARRAY);
+        for (i = 0; i < G_N_ELEMENTS (provider_types); i++)
+        {
+            if (G_TYPE_CHECK_INSTANCE_TYPE (l->data, provider_types[i]))
+            {
+                g_variant_builder_add (&interfaces, "s", g_type_name (provider_types[i]));
+            }
+        }
+
+        g_variant_builder_add (&builder, "(sas)", G_OBJECT_TYPE_NAME (l->data), &interfaces);
+        g_hash_table_insert (extensions, g_strdup (G_OBJECT_TYPE_NAME (l->data)), l->data);
+
+        if (NAUTILUS_IS_MENU_PROVIDER (l->data))
+        {
+            g_signal_connect (l->data, "items-updated",
+                              G_CALLBACK (menu_provider_items_updated), NULL);
+        }
+    }
+    g_list_free (objects);
+
+    nautilus_dbus_extension_host_complete_load_module (skeleton, invocation,
+                                                       g_variant_builder_end (&builder));
+
+    return TRUE;
+}
+
+static gboolean
+handle_get_columns (NautilusDBusExtensionHost *skeleton,
+                    GDBusMethodInvocation     *invocation,
+                    const char                *extension)
+{
+    NautilusColumnProvider *provider;
+    GVariantBuilder builder;
+    GList *columns, *l;
+    char *name, *attribute, *label, *description;
+    float xalign;
+
+    provider = lookup_extension (invocation, extension, NAUTILUS_TYPE_COLUMN_PROVIDER);
+    if (provider == NULL)
+    {
+        return TRUE;
+    }
+
+    g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(ssssd)"));
+    columns = nautilus_column_provider_get_columns (provider);
+    for (l = columns; l != NULL; l = l->next)
+    {
+        g_object_get (l->data,
+                      "name", &name,
+                      "attribute", &attribute,
+                      "label", &label,
+                      "description", &description,
+                      "xalign", &xalign,
+                      NULL);
+        g_variant_builder_add (&builder, "(ssssd)",
+                               name, attribute, label,
+                               description != NULL ? description : "",
+                               (gdouble) xalign);
+        g_free (name);
+        g_free (attribute);
+        g_free (label);
+        g_free (description);
+    }
+    g_list_free_full (columns, g_object_unref);
+
+    nautilus_dbus_extension_host_complete_get_columns (skeleton, invocation,
+                                                       g_variant_builder_end (&builder));
+
+    return TRUE;
+}
+
+typedef struct
+{
+    NautilusDBusExtensionHost *skeleton;
+    GDBusMethodInvocation *invocation;
+    guint id;
+    NautilusInfoProvider *provider;
+    GList *files;
+    guint pending;
+    /* Of the calls that are still in progress */
+    GList *handles;
+    GClosure *update_complete;
+} UpdateRequest;
+
+static void
+update_request_free (UpdateRequest *request)
+{
+    g_hash_table_remove (update_requests, GUINT_TO_POINTER (request->id));
+
+    /* Keeps a provider that calls back after all from reaching us */
+    g_closure_invalidate (request->update_complete);
+    g_closure_unref (request->update_complete);
+    g_list_free (request->handles);
+    g_list_free_full (request->files, g_object_unref);
+    g_object_unref (request->provider);
+    g_free (request);
+}
+
+static void
+update_request_finish (UpdateRequest *request)
+{
+    GVariantBuilder builder;
+    GVariantBuilder attributes;
+    NautilusHostFile *file;
+    GHashTableIter iter;
+    gpointer key, value;
+    GList *l;
+
+    g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(asa{ss})"));
+    for (l = request->files; l != NULL; l = l->next)
+    {
+        file = l->data;
+
+        g_variant_builder_init (&attributes, G_VARIANT_TYPE ("a{ss}"));
+        g_hash_table_iter_init (&iter, file->attributes);
+        while (g_hash_table_iter_next (&iter, &key, &value))
+        {
+            g_variant_builder_add (&attributes, "{ss}", key, value);
+        }
+
+        g_ptr_array_add (file->emblems, NULL);
+        g_variant_builder_add (&builder, "(^asa{ss})",
+                               (char **) file->emblems->pdata, &attributes);
+        g_ptr_array_remove_index (file->emblems, file->emblems->len - 1);
+    }
+
+    nautilus_dbus_extension_host_complete_update_file_info (request->skeleton,
+                                                            request->invocation,
+                                                            g_variant_builder_end (&builder));
+
+    update_request_free (request);
+}
+
+static void
+update_complete_callback (NautilusInfoProvider    *provider,
+                          NautilusOperationHandle *handle,
+                          NautilusOperationResult  result,
+                          gpointer                 user_data)
+{
+    UpdateRequest *request;
+
+    request = user_data;
+    request->handles = g_list_remove (request->handles, handle);
+
+    if (--request->pending == 0)
+    {
+        update_request_finish (request);
+    }
+}
+
+static gboolean
+handle_update_file_info (NautilusDBusExtensionHost *skeleton,
+                         GDBusMethodInvocation     *invocation,
+                         const char                *extension,
+                         guint                      id,
+                         GVariant                  *files)
+{
+    NautilusInfoProvider *provider;
+    NautilusOperationHandle *handle;
+    NautilusOperationResult result;
+    UpdateRequest *request;
+    GList *l;
+
+    provider = lookup_extension (invocation, extension, NAUTILUS_TYPE_INFO_PROVIDER);
+    if (provider == NULL)
+    {
+        return TRUE;
+    }
+
+    request = g_new0 (UpdateRequest, 1);
+    request->skeleton = skeleton;
+    request->invocation = invocation;
+    request->id = id;
+    request->provider = g_object_ref (provider);
+    request->files = files_from_variant (files);
+    request->update_complete = g_cclosure_new (G_CALLBACK (update_complete_callback),
+                                               request, NULL);
+    g_closure_set_marshal (request->update_complete, g_cclosure_marshal_generic);
+    g_closure_sink (g_closure_ref (request->update_complete));
+    g_hash_table_insert (update_requests, GUINT_TO_POINTER (id), request);
+
+    /* Holds the request open until every call has been made */
+    request->pending = 1;
+
+    if (nautilus_info_provider_supports_batch (provider))
+    {
+        handle = NULL;
+        request->pending++;
+        result = nautilus_info_provider_update_file_info_batch (provider,
+                                                                request->files,
+                                                                request->update_complete,
+                                                                &handle);
+        if (result == NAUTILUS_OPERATION_IN_PROGRESS)
+        {
+            request->handles = g_list_prepend (request->handles, handle);
+        }
+        else
+        {
+            request->pending--;
+        }
+    }
+    else
+    {
+        for (l = request->files; l != NULL; l = l->next)
+        {
+            handle = NULL;
+            request->pending++;
+            result = nautilus_info_provider_update_file_info (provider,
+                                                              l->data,
+                                                              request->update_complete,
+                                                              &handle);
+            if (result == NAUTILUS_OPERATION_IN_PROGRESS)
+            {
+                request->handles = g_list_prepend (request->handles, handle);
+            }
+            else
+            {
+                request->pending--;
+            }
+        }
+    }
+
+    update_complete_callback (provider, NULL, NAUTILUS_OPERATION_COMPLETE, request);
+
+    return TRUE;
+}
+
+static gboolean
+handle_cancel_update (NautilusDBusExtensionHost *skeleton,
+                      GDBusMethodInvocation     *invocation,
+                      guint                      id)
+{
+    UpdateRequest *request;
+    GList *l;
+
+    /* It may have finished while the cancellation was on its way */
+    request = g_hash_table_lookup (update_requests, GUINT_TO_POINTER (id));
+    if (request != NULL)
+    {
+        for (l = request->handles; l != NULL; l = l->next)
+        {
+            nautilus_info_provider_cancel_update (request->provider, l->data);
+        }
+
+        g_dbus_method_invocation_return_error (request->invocation,
+                                               G_IO_ERROR, G_IO_ERROR_CANCELLED,
+                                               "Cancelled");
+        update_request_free (request);
+    }
+
+    nautilus_dbus_extension_host_complete_cancel_update (skeleton, invocation);
+
+    return TRUE;
+}
+
+static void
+append_menu_items (GVariantBuilder *builder,
+                   GList           *items,
+                   gint             parent,
+                   GPtrArray       *flattened)
+{
+    NautilusMenuItem *item;
+    NautilusMenu *menu;
+    GList *l, *children;
+    char *name, *label, *tip, *icon;
+    gboolean sensitive, priority;
+    gint index;
+
+    for (l = items; l != NULL; l = l->next)
+    {
+        item = l->data;
+
+        g_object_get (item,
+                      "name", &name,
+                      "label", &label,
+                      "tip", &tip,
+                      "icon", &icon,
+                      "sensitive", &sensitive,
+                      "priority", &priority,
+                      "menu", &menu,
+                      NULL);
+
+        g_variant_builder_add (builder, "(issssbb)",
+                               parent,
+                               name != NULL ? name : "",
+                               label != NULL ? label : "",
+                               tip != NULL ? tip : "",
+                               icon != NULL ? icon : "",
+                               sensitive, priority);
+        index = flattened->len;
+        g_ptr_array_add (flattened, g_object_ref (item));
+
+        if (menu != NULL)
+        {
+            children = nautilus_menu_get_items (menu);
+            append_menu_items (builder, children, index, flattened);
+            g_list_free_full (children, g_object_unref);
+            g_object_unref (menu);
+        }
+
+        g_free (name);
+        g_free (label);
+        g_free (tip);
+        g_free (icon);
+    }
+}
+
+/* Keeps the items around until nautilus releases the menu, which it
+ * does when it lets go of the last of them */
+static GVariant *
+menu_items_to_variant (GList *items,
+                       guint  menu_id)
+{
+    GVariantBuilder builder;
+    GPtrArray *flattened;
+
+    flattened = g_ptr_array_new_with_free_func (g_object_unref);
+    g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(issssbb)"));
+    append_menu_items (&builder, items, -1, flattened);
+
+    if (flattened->len == 0 || menu_id == 0)
+    {
+        g_ptr_array_unref (flattened);
+    }
+    else
+    {
+        g_hash_table_insert (menus, GUINT_TO_POINTER (menu_id), flattened);
+    }
+
+    return g_variant_builder_end (&builder);
+}
+
+static GtkWidget *
+get_window (guint window_id)
+{
+    GtkWidget *window;
+
+    if (window_id == 0 || !have_display)
+    {
+        return NULL;
+    }
+
+    window = g_hash_table_lookup (windows, GUINT_TO_POINTER (window_id));
+    if (window == NULL)
+    {
+        /* Never shown; extensions use it to tell windows apart, or as
+         * the parent of what they show */
+        window = gtk_window_new (GTK_WINDOW_TOPLEVEL);
+        g_hash_table_insert (windows, GUINT_TO_POINTER (window_id), window);
+    }
+
+    return window;
+}
+
+static gboolean
+handle_get_file_items (NautilusDBusExtensionHost *skeleton,
+                       GDBusMethodInvocation     *invocation,
+                       const char                *extension,
+                       guint                      window_id,
+                       guint                      menu_id,
+                       GVariant                  *files)
+{
+    NautilusMenuProvider *provider;
+    GList *selection, *items;
+    GVariant *variant;
+
+    provider = lookup_extension (invocation, extension, NAUTILUS_TYPE_MENU_PROVIDER);
+    if (provider == NULL)
+    {
+        return TRUE;
+    }
+
+    selection = files_from_variant (files);
+    items = nautilus_menu_provider_get_file_items (provider, get_window (window_id),
+                                                   selection);
+
+    variant = menu_items_to_variant (items, menu_id);
+    nautilus_dbus_extension_host_complete_get_file_items (skeleton, invocation,
+                                                          variant);
+
+    g_list_free_full (items, g_object_unref);
+    g_list_free_full (selection, g_object_unref);
+
+    return TRUE;
+}
+
+static gboolean
+handle_get_background_items (NautilusDBusExtensionHost *skeleton,
+                             GDBusMethodInvocation     *invocation,
+                             const char                *extension,
+                             guint                      window_id,
+                             guint                      menu_id,
+                             GVariant                  *folder)
+{
+    NautilusMenuProvider *provider;
+    NautilusHostFile *file;
+    GList *items;
+    GVariant *variant;
+
+    provider = lookup_extension (invocation, extension, NAUTILUS_TYPE_MENU_PROVIDER);
+    if (provider == NULL)
+    {
+        return TRUE;
+    }
+
+    file = nautilus_host_file_new (folder);
+    items = nautilus_menu_provider_get_background_items (provider, get_window (window_id),
+                                                         NAUTILUS_FILE_INFO (file));
+
+    variant = menu_items_to_variant (items, menu_id);
+    nautilus_dbus_extension_host_complete_get_background_items (skeleton, invocation,
+                                                                variant);
+
+    g_list_free_full (items, g_object_unref);
+    g_object_unref (file);
+
+    return TRUE;
+}
+
+static gboolean
+handle_activate_item (NautilusDBusExtensionHost *skeleton,
+                      GDBusMethodInvocation     *invocation,
+                      guint                      menu_id,
+                      guint                      index)
+{
+    GPtrArray *flattened;
+
+    flattened = g_hash_table_lookup (menus, GUINT_TO_POINTER (menu_id));
+    if (flattened != NULL && index < flattened->len)
+    {
+        nautilus_menu_item_activate (g_ptr_array_index (flattened, index));
+    }
+
+    nautilus_dbus_extension_host_complete_activate_item (skeleton, invocation);
+
+    return TRUE;
+}
+
+static gboolean
+handle_release_menu (NautilusDBusExtensionHost *skeleton,
+                     GDBusMethodInvocation     *invocation,
+                     guint                      menu_id)
+{
+    g_hash_table_remove (menus, GUINT_TO_POINTER (menu_id));
+
+    nautilus_dbus_extension_host_complete_release_menu (skeleton, invocation);
+
+    return TRUE;
+}
+
+static gboolean
+handle_release_window (NautilusDBusExtensionHost *skeleton,
+                       GDBusMethodInvocation     *invocation,
+                       guint                      window_id)
+{
+    g_hash_table_remove (windows, GUINT_TO_POINTER (window_id));
+
+    nautilus_dbus_extension_host_complete_release_window (skeleton, invocation);
+
+    return TRUE;
+}
+
+static void
+connection_closed_callback (GDBusConnection *connection,
+                            gboolean         remote_peer_vanished,
+                            GError          *error,
+                            gpointer         user_data)
+{
+    /* Nautilus went away, or dropped us */
+    g_main_loop_quit (loop);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+    GDBusConnection *connection;
+    GSocketConnection *stream;
+    GSocket *socket;
+    GError *error;
+
+    /* Extensions may well use GTK+ themselves, but must not need a display */
+    have_display = gtk_init_check (&argc, &argv);
+
+    error = NULL;
+    socket = g_socket_new_from_fd (HOST_SOCKET_FD, &error);
+    if (socket == NULL)
+    {
+        g_printerr ("nautilus-extension-host: %s\n", error->message);
+        g_error_free (error);
+        return 1;
+    }
+
+    stream = g_socket_connection_factory_create_connection (socket);
+    connection = g_dbus_connection_new_sync (G_IO_STREAM (stream), NULL,
+                                             G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT,
+                                             NULL, NULL, &error);
+    g_object_unref (stream);
+    g_object_unref (socket);
+    if (connection == NULL)
+    {
+        g_printerr ("nautilus-extension-host: %s\n", error->message);
+        g_error_free (error);
+        return 1;
+    }
+
+    extensions = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_object_unref);
+    menus = g_hash_table_new_full (NULL, NULL, NULL, (GDestroyNotify) g_ptr_array_unref);
+    update_requests = g_hash_table_new (NULL, NULL);
+    windows = g_hash_table_new_full (NULL, NULL, NULL, (GDestroyNotify) gtk_widget_destroy);
+
+    host_skeleton = nautilus_dbus_extension_host_skeleton_new ();
+    g_signal_connect (host_skeleton, "handle-load-module",
+                      G_CALLBACK (handle_load_module), NULL);
+    g_signal_connect (host_skeleton, "handle-get-columns",
+                      G_CALLBACK (handle_get_columns), NULL);
+    g_signal_connect (host_skeleton, "handle-update-file-info",
+                      G_CALLBACK (handle_update_file_info), NULL);
+    g_signal_connect (host_skeleton, "handle-cancel-update",
+                      G_CALLBACK (handle_cancel_update), NULL);
+    g_signal_connect (host_skeleton, "handle-get-file-items",
+                      G_CALLBACK (handle_get_file_items), NULL);
+    g_signal_connect (host_skeleton, "handle-get-background-items",
+                      G_CALLBACK (handle_get_background_items), NULL);
+    g_signal_connect (host_skeleton, "handle-activate-item",
+                      G_CALLBACK (handle_activate_item), NULL);
+    g_signal_connect (host_skeleton, "handle-release-menu",
+                      G_CALLBACK (handle_release_menu), NULL);
+    g_signal_connect (host_skeleton, "handle-release-window",
+                      G_CALLBACK (handle_release_window), NULL);
+
+    if (!g_dbus_interface_skeleton_export (G_DBUS_INTERFACE_SKELETON (host_skeleton),
+                                           connection, HOST_OBJECT_PATH, &error))
+    {
+        g_printerr ("nautilus-extension-host: %s\n", error->message);
+        g_error_free (error);
+        return 1;
+    }
+
+    loop = g_main_loop_new (NULL, FALSE);
+    g_signal_connect (connection, "closed",
+                      G_CALLBACK (connection_closed_callback), NULL);
+    g_main_loop_run (loop);
+
+    g_dbus_interface_skeleton_unexport (G_DBUS_INTERFACE_SKELETON (host_skeleton));
+    g_object_unref (host_skeleton);
+    g_object_unref (connection);
+    g_main_loop_unref (loop);
+
+    return 0;
+}
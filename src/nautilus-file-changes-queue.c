@@ -21,6 +21,7 @@
 #include "nautilus-file-changes-queue.h"
 
 #include "nautilus-directory-notify.h"
+#include "nautilus-metrics.h"
 
 typedef enum
 {
@@ -46,6 +47,7 @@ typedef struct
 {
     GList *head;
     GList *tail;
+    guint length;
     GMutex mutex;
 } NautilusFileChangesQueue;
 
@@ -85,6 +87,8 @@ nautilus_file_changes_queue_add_common (NautilusFileChangesQueue *queue,
     {
         queue->tail = queue->head;
     }
+    queue->length++;
+    nautilus_metrics_gauge_set ("file-changes-queue", queue->length);
 
     g_mutex_unlock (&queue->mutex);
 }
@@ -202,6 +206,8 @@ nautilus_file_changes_queue_get_change (NautilusFileChangesQueue *queue)
                                           queue->tail);
         g_list_free_1 (queue->tail);
         queue->tail = new_tail;
+        queue->length--;
+        nautilus_metrics_gauge_set ("file-changes-queue", queue->length);
     }
 
     g_mutex_unlock (&queue->mutex);
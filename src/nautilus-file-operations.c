@@ -60,12 +60,16 @@
 #include "nautilus-file-utilities.h"
 #include "nautilus-file-undo-operations.h"
 #include "nautilus-file-undo-manager.h"
+#include "nautilus-metrics.h"
+#include "nautilus-profile.h"
 
 /* TODO: TESTING!!! */
 
 typedef struct
 {
     GTimer *time;
+    /* Unlike time, not paused while waiting for the user */
+    gint64 start_time;
     GtkWindow *parent_window;
     int screen_num;
     guint inhibit_cookie;
@@ -1139,12 +1143,22 @@ init_common (gsize      job_size,
         common->screen_num = gdk_screen_get_number (screen);
     }
 
+    common->start_time = g_get_monotonic_time ();
+    nautilus_metrics_counter_add ("file-operations", 1);
+    nautilus_metrics_gauge_add ("file-operations-active", 1);
+    nautilus_profile_async_start ("file-operation", common);
+
     return common;
 }
 
 static void
 finalize_common (CommonJob *common)
 {
+    nautilus_profile_async_end ("file-operation", common);
+    nautilus_metrics_gauge_add ("file-operations-active", -1);
+    nautilus_metrics_observe ("file-operation-time",
+                              g_get_monotonic_time () - common->start_time);
+
     nautilus_progress_info_finish (common->progress);
 
     if (common->inhibit_cookie != 0)
@@ -2450,6 +2464,8 @@ delete_task_thread_func (GTask        *task,
 
     common = (CommonJob *) job;
 
+    nautilus_profile_start ("%u files", g_list_length (job->files));
+
     nautilus_progress_info_start (job->common.progress);
 
     to_trash_files = NULL;
@@ -2524,6 +2540,8 @@ delete_task_thread_func (GTask        *task,
         /* User has skipped all files, report user cancel */
         job->user_cancel = TRUE;
     }
+
+    nautilus_profile_end (NULL);
 }
 
 static void
@@ -5730,6 +5748,8 @@ copy_task_thread_func (GTask        *task,
 
     dest_fs_id = NULL;
 
+    nautilus_profile_start ("%u files", g_list_length (job->files));
+
     nautilus_progress_info_start (job->common.progress);
 
     scan_sources (job->files,
@@ -5771,6 +5791,7 @@ copy_task_thread_func (GTask        *task,
                 &source_info, &transfer_info);
 
 aborted:
+    nautilus_profile_end (NULL);
 
     g_free (dest_fs_id);
 }
@@ -6367,6 +6388,8 @@ move_task_thread_func (GTask        *task,
 
     fallbacks = NULL;
 
+    nautilus_profile_start ("%u files", g_list_length (job->files));
+
     nautilus_progress_info_start (job->common.progress);
 
     verify_destination (&job->common,
@@ -6417,6 +6440,8 @@ move_task_thread_func (GTask        *task,
                 &source_info, &transfer_info);
 
 aborted:
+    nautilus_profile_end (NULL);
+
     g_list_free_full (fallbacks, g_free);
 
     g_free (dest_fs_id);
@@ -130,6 +130,9 @@ struct NautilusFileDetails
 
 	/* Mount for mountpoint or the references GMount for a "mountable" */
 	GMount *mount;
+
+	/* Bumped every time the changed signal is emitted */
+	guint change_serial;
 	
 	/* boolean fields: bitfield to save space, since there can be
            many NautilusFile objects. */
@@ -248,6 +251,8 @@ gboolean      nautilus_file_update_name                    (NautilusFile
 							    const char             *name);
 gboolean      nautilus_file_update_metadata_from_info      (NautilusFile           *file,
 							    GFileInfo              *info);
+gboolean      nautilus_file_update_metadata_from_changes   (NautilusFile           *file,
+							    GFileInfo              *changes);
 
 gboolean      nautilus_file_update_name_and_directory      (NautilusFile           *file,
 							    const char             *name,
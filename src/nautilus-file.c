@@ -466,6 +466,104 @@ nautilus_file_update_metadata_from_info (NautilusFile *file,
     return changed;
 }
 
+static gboolean
+remove_metadata_id (GHashTable *metadata,
+                    guint       id)
+{
+    gpointer value;
+
+    if (!g_hash_table_lookup_extended (metadata, GUINT_TO_POINTER (id), NULL, &value))
+    {
+        return FALSE;
+    }
+
+    g_hash_table_remove (metadata, GUINT_TO_POINTER (id));
+    foreach_metadata_free (GUINT_TO_POINTER (id), value, NULL);
+
+    return TRUE;
+}
+
+/* Unlike nautilus_file_update_metadata_from_info(), which replaces the
+ * cached metadata with a complete fresh set, this merges in only the keys
+ * present in @changes. Unset keys are removed. */
+gboolean
+nautilus_file_update_metadata_from_changes (NautilusFile *file,
+                                            GFileInfo    *changes)
+{
+    GHashTable *metadata;
+    char **attrs;
+    guint id;
+    int i;
+    GFileAttributeType type;
+    gpointer value, old_value;
+    gboolean changed;
+
+    changed = FALSE;
+
+    attrs = g_file_info_list_attributes (changes, "metadata");
+
+    for (i = 0; attrs[i] != NULL; i++)
+    {
+        id = nautilus_metadata_get_id (attrs[i] + strlen ("metadata::"));
+        if (id == 0)
+        {
+            continue;
+        }
+
+        if (!g_file_info_get_attribute_data (changes, attrs[i],
+                                             &type, &value, NULL))
+        {
+            continue;
+        }
+
+        if (file->details->metadata == NULL)
+        {
+            file->details->metadata = g_hash_table_new (NULL, NULL);
+        }
+        metadata = file->details->metadata;
+
+        if (type == G_FILE_ATTRIBUTE_TYPE_STRING)
+        {
+            old_value = g_hash_table_lookup (metadata, GUINT_TO_POINTER (id));
+            if (old_value != NULL && strcmp (old_value, value) == 0)
+            {
+                continue;
+            }
+
+            remove_metadata_id (metadata, id);
+            remove_metadata_id (metadata, id | METADATA_ID_IS_LIST_MASK);
+            g_hash_table_insert (metadata, GUINT_TO_POINTER (id),
+                                 g_strdup ((char *) value));
+            changed = TRUE;
+        }
+        else if (type == G_FILE_ATTRIBUTE_TYPE_STRINGV)
+        {
+            old_value = g_hash_table_lookup (metadata,
+                                             GUINT_TO_POINTER (id | METADATA_ID_IS_LIST_MASK));
+            if (old_value != NULL && eel_g_strv_equal (old_value, value))
+            {
+                continue;
+            }
+
+            remove_metadata_id (metadata, id);
+            remove_metadata_id (metadata, id | METADATA_ID_IS_LIST_MASK);
+            g_hash_table_insert (metadata, GUINT_TO_POINTER (id | METADATA_ID_IS_LIST_MASK),
+                                 g_strdupv ((char **) value));
+            changed = TRUE;
+        }
+        else
+        {
+            /* Unset */
+            changed |= remove_metadata_id (metadata, id);
+            changed |= remove_metadata_id (metadata, id | METADATA_ID_IS_LIST_MASK);
+        }
+    }
+
+    g_strfreev (attrs);
+
+    return changed;
+}
+
 void
 nautilus_file_clear_info (NautilusFile *file)
 {
@@ -5177,17 +5275,154 @@ apply_emblems_to_icon (NautilusFile          *file,
     }
 }
 
-GIcon *
-nautilus_file_get_gicon (NautilusFile          *file,
-                         NautilusFileIconFlags  flags)
+static GIcon *
+build_icon_with_prepended_names (GIcon                 *icon,
+                                 NautilusFileIconFlags  flags)
 {
     const char * const *names;
     const char *name;
     GPtrArray *prepend_array;
-    GIcon *icon, *emblemed_icon;
+    GIcon *prepended_icon;
     int i;
     gboolean is_folder = FALSE, is_inode_directory = FALSE;
 
+    names = g_themed_icon_get_names (G_THEMED_ICON (icon));
+    prepend_array = g_ptr_array_new ();
+    prepended_icon = NULL;
+
+    for (i = 0; names[i] != NULL; i++)
+    {
+        name = names[i];
+
+        if (strcmp (name, "folder") == 0)
+        {
+            is_folder = TRUE;
+        }
+        if (strcmp (name, "inode-directory") == 0)
+        {
+            is_inode_directory = TRUE;
+        }
+    }
+
+    /* Here, we add icons in reverse order of precedence,
+     * because they are later prepended */
+
+    /* "folder" should override "inode-directory", not the other way around */
+    if (is_inode_directory)
+    {
+        g_ptr_array_add (prepend_array, "folder");
+    }
+    if (is_folder && (flags & NAUTILUS_FILE_ICON_FLAGS_FOR_OPEN_FOLDER))
+    {
+        g_ptr_array_add (prepend_array, "folder-open");
+    }
+    if (is_folder &&
+        (flags & NAUTILUS_FILE_ICON_FLAGS_FOR_DRAG_ACCEPT))
+    {
+        g_ptr_array_add (prepend_array, "folder-drag-accept");
+    }
+
+    if (prepend_array->len)
+    {
+        /* When constructing GThemed Icon, pointers from the array
+         * are reused, but not the array itself, so the cast is safe */
+        prepended_icon = g_themed_icon_new_from_names ((char **) names, -1);
+        g_ptr_array_foreach (prepend_array, (GFunc) prepend_icon_name, prepended_icon);
+    }
+
+    g_ptr_array_free (prepend_array, TRUE);
+
+    if (prepended_icon == NULL)
+    {
+        prepended_icon = g_object_ref (icon);
+    }
+
+    return prepended_icon;
+}
+
+typedef struct
+{
+    GIcon *icon;
+    NautilusFileIconFlags flags;
+} PrependedIconKey;
+
+/* Files of the same type share the same themed name list, so the list
+ * with the folder names prepended only needs to be built once per type
+ * and flag combination. The set of types seen in a session is small; the
+ * bound only guards against pathological trees. */
+#define PREPENDED_ICON_CACHE_MAX 512
+
+static GHashTable *prepended_icon_cache = NULL;
+
+static guint
+prepended_icon_key_hash (const PrependedIconKey *key)
+{
+    return g_icon_hash (key->icon) ^ key->flags;
+}
+
+static gboolean
+prepended_icon_key_equal (const PrependedIconKey *a,
+                          const PrependedIconKey *b)
+{
+    return a->flags == b->flags &&
+           g_icon_equal (a->icon, b->icon);
+}
+
+static void
+prepended_icon_key_free (PrependedIconKey *key)
+{
+    g_object_unref (key->icon);
+    g_slice_free (PrependedIconKey, key);
+}
+
+static GIcon *
+get_icon_with_prepended_names (GIcon                 *icon,
+                               NautilusFileIconFlags  flags)
+{
+    PrependedIconKey lookup_key;
+    PrependedIconKey *key;
+    GIcon *prepended_icon;
+
+    if (prepended_icon_cache == NULL)
+    {
+        prepended_icon_cache =
+            g_hash_table_new_full ((GHashFunc) prepended_icon_key_hash,
+                                   (GEqualFunc) prepended_icon_key_equal,
+                                   (GDestroyNotify) prepended_icon_key_free,
+                                   (GDestroyNotify) g_object_unref);
+    }
+
+    lookup_key.icon = icon;
+    lookup_key.flags = flags & (NAUTILUS_FILE_ICON_FLAGS_FOR_OPEN_FOLDER |
+                                NAUTILUS_FILE_ICON_FLAGS_FOR_DRAG_ACCEPT);
+
+    prepended_icon = g_hash_table_lookup (prepended_icon_cache, &lookup_key);
+    if (prepended_icon != NULL)
+    {
+        return g_object_ref (prepended_icon);
+    }
+
+    if (g_hash_table_size (prepended_icon_cache) >= PREPENDED_ICON_CACHE_MAX)
+    {
+        g_hash_table_remove_all (prepended_icon_cache);
+    }
+
+    prepended_icon = build_icon_with_prepended_names (icon, lookup_key.flags);
+
+    key = g_slice_new (PrependedIconKey);
+    key->icon = g_object_ref (icon);
+    key->flags = lookup_key.flags;
+    g_hash_table_insert (prepended_icon_cache, key, g_object_ref (prepended_icon));
+
+    return prepended_icon;
+}
+
+GIcon *
+nautilus_file_get_gicon (NautilusFile          *file,
+                         NautilusFileIconFlags  flags)
+{
+    GIcon *icon, *emblemed_icon;
+
     if (file == NULL)
     {
         return NULL;
@@ -5211,61 +5446,15 @@ nautilus_file_get_gicon (NautilusFile          *file,
 
     if (file->details->icon)
     {
-        icon = NULL;
-
         if (((flags & NAUTILUS_FILE_ICON_FLAGS_FOR_DRAG_ACCEPT) ||
              (flags & NAUTILUS_FILE_ICON_FLAGS_FOR_OPEN_FOLDER) ||
              (flags & NAUTILUS_FILE_ICON_FLAGS_USE_MOUNT_ICON) ||
              (flags & NAUTILUS_FILE_ICON_FLAGS_USE_EMBLEMS)) &&
             G_IS_THEMED_ICON (file->details->icon))
         {
-            names = g_themed_icon_get_names (G_THEMED_ICON (file->details->icon));
-            prepend_array = g_ptr_array_new ();
-
-            for (i = 0; names[i] != NULL; i++)
-            {
-                name = names[i];
-
-                if (strcmp (name, "folder") == 0)
-                {
-                    is_folder = TRUE;
-                }
-                if (strcmp (name, "inode-directory") == 0)
-                {
-                    is_inode_directory = TRUE;
-                }
-            }
-
-            /* Here, we add icons in reverse order of precedence,
-             * because they are later prepended */
-
-            /* "folder" should override "inode-directory", not the other way around */
-            if (is_inode_directory)
-            {
-                g_ptr_array_add (prepend_array, "folder");
-            }
-            if (is_folder && (flags & NAUTILUS_FILE_ICON_FLAGS_FOR_OPEN_FOLDER))
-            {
-                g_ptr_array_add (prepend_array, "folder-open");
-            }
-            if (is_folder &&
-                (flags & NAUTILUS_FILE_ICON_FLAGS_FOR_DRAG_ACCEPT))
-            {
-                g_ptr_array_add (prepend_array, "folder-drag-accept");
-            }
-
-            if (prepend_array->len)
-            {
-                /* When constructing GThemed Icon, pointers from the array
-                 * are reused, but not the array itself, so the cast is safe */
-                icon = g_themed_icon_new_from_names ((char **) names, -1);
-                g_ptr_array_foreach (prepend_array, (GFunc) prepend_icon_name, icon);
-            }
-
-            g_ptr_array_free (prepend_array, TRUE);
+            icon = get_icon_with_prepended_names (file->details->icon, flags);
         }
-
-        if (icon == NULL)
+        else
         {
             icon = g_object_ref (file->details->icon);
         }
@@ -8468,6 +8657,8 @@ nautilus_file_emit_changed (NautilusFile *file)
 
     g_assert (NAUTILUS_IS_FILE (file));
 
+    file->details->change_serial++;
+
     /* Send out a signal. */
     g_signal_emit (file, signals[CHANGED], 0, file);
 
@@ -8499,6 +8690,14 @@ nautilus_file_is_gone (NautilusFile *file)
     return file->details->is_gone;
 }
 
+guint
+nautilus_file_get_change_serial (NautilusFile *file)
+{
+    g_return_val_if_fail (NAUTILUS_IS_FILE (file), 0);
+
+    return file->details->change_serial;
+}
+
 /**
  * nautilus_file_is_not_yet_confirmed
  *
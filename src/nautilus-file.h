@@ -341,6 +341,11 @@ void                    nautilus_file_cancel                            (Nautilu
  */
 gboolean                nautilus_file_is_gone                           (NautilusFile                   *file);
 
+/* Changes whenever the file emits "changed", so callers can tell whether
+ * something they computed from the file is still current.
+ */
+guint                   nautilus_file_get_change_serial                 (NautilusFile                   *file);
+
 /* Used in subclasses that handles the rename of a file. This handles the case
  * when the file is gone. If this returns TRUE, simply do nothing
  */
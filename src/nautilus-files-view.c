@@ -72,10 +72,12 @@
 #include <eel/eel-string.h>
 #include <eel/eel-vfs-extensions.h>
 
+#include <libnautilus-extension/nautilus-info-provider.h>
 #include <libnautilus-extension/nautilus-menu-provider.h>
 #include "nautilus-clipboard.h"
 #include "nautilus-search-directory.h"
 #include "nautilus-directory.h"
+#include "nautilus-directory-prefetch.h"
 #include "nautilus-dnd.h"
 #include "nautilus-file-attributes.h"
 #include "nautilus-file-changes-queue.h"
@@ -88,6 +90,7 @@
 #include "nautilus-compress-dialog-controller.h"
 #include "nautilus-global-preferences.h"
 #include "nautilus-link.h"
+#include "nautilus-menu-provider-cache.h"
 #include "nautilus-metadata.h"
 #include "nautilus-module.h"
 #include "nautilus-profile.h"
@@ -96,6 +99,8 @@
 #include "nautilus-ui-utilities.h"
 #include "nautilus-signaller.h"
 #include "nautilus-icon-names.h"
+#include "nautilus-thumbnails.h"
+#include "nautilus-watchdog.h"
 
 #include <gdesktop-enums.h>
 
@@ -130,6 +135,10 @@
 
 #define MIN_COMMON_FILENAME_PREFIX_LENGTH 4
 
+/* Menu providers whose last answer took longer than this are only asked
+ * when a context menu is actually opened, never ahead of time */
+#define MENU_PROVIDER_PREFETCH_BUDGET 5000 /* us */
+
 
 enum
 {
@@ -167,6 +176,34 @@ static int scripts_directory_uri_length;
 
 static GHashTable *script_accels = NULL;
 
+typedef struct
+{
+    guint generation;
+    gboolean is_directory;
+    /* Whether the folder item count or the file size is known */
+    gboolean known;
+    /* Items in a folder, bytes in anything else */
+    goffset amount;
+} SelectionEntry;
+
+/* Totals over the selection, kept up to date as files get selected,
+ * deselected or change, so that the status never has to ask every
+ * selected file again */
+typedef struct
+{
+    /* NautilusFile -> SelectionEntry */
+    GHashTable *entries;
+    guint generation;
+
+    guint folder_count;
+    goffset folder_item_count;
+    guint unknown_folder_item_counts;
+
+    guint non_folder_count;
+    goffset non_folder_size;
+    guint known_non_folder_sizes;
+} SelectionSummary;
+
 struct NautilusFilesViewDetails
 {
     /* Main components */
@@ -242,6 +279,8 @@ struct NautilusFilesViewDetails
 
     gboolean selection_was_removed;
 
+    SelectionSummary selection_summary;
+
     gboolean metadata_for_directory_as_file_pending;
     gboolean metadata_for_files_in_directory_pending;
 
@@ -252,6 +291,14 @@ struct NautilusFilesViewDetails
     GMenu *selection_menu;
     GMenu *background_menu;
 
+    /* Extension items are merged into the menus above only when they are
+     * about to be shown; provider answers are cached until the files they
+     * were computed for change or the provider emits "items-updated". */
+    gboolean extension_menus_pending;
+    NautilusMenuProviderCache *selection_menu_provider_cache;
+    NautilusMenuProviderCache *background_menu_provider_cache;
+    guint prefetch_extension_menus_idle_id;
+
     GActionGroup *view_action_group;
 
     GtkWidget *scrolled_window;
@@ -877,22 +924,6 @@ typedef struct
     NautilusFilesView *directory_view;
 } CreateTemplateParameters;
 
-static GList *
-file_and_directory_list_to_files (GList *fad_list)
-{
-    GList *res, *l;
-    FileAndDirectory *fad;
-
-    res = NULL;
-    for (l = fad_list; l != NULL; l = l->next)
-    {
-        fad = l->data;
-        res = g_list_prepend (res, nautilus_file_ref (fad->file));
-    }
-    return g_list_reverse (res);
-}
-
-
 static GList *
 file_and_directory_list_from_files (NautilusDirectory *directory,
                                     GList             *files)
@@ -2300,6 +2331,22 @@ action_new_folder (GSimpleAction *action,
     nautilus_files_view_new_folder (NAUTILUS_FILES_VIEW (user_data), FALSE);
 }
 
+static void
+action_generate_thumbnails (GSimpleAction *action,
+                            GVariant      *state,
+                            gpointer       user_data)
+{
+    NautilusFilesView *view;
+
+    g_assert (NAUTILUS_IS_FILES_VIEW (user_data));
+
+    view = NAUTILUS_FILES_VIEW (user_data);
+    if (view->details->location != NULL)
+    {
+        nautilus_thumbnail_pregenerate (view->details->location);
+    }
+}
+
 static void
 action_new_folder_with_selection (GSimpleAction *action,
                                   GVariant      *state,
@@ -2441,15 +2488,11 @@ action_open_item_new_window (GSimpleAction *action,
 }
 
 static void
-handle_clipboard_data (NautilusFilesView *view,
-                       GtkSelectionData  *selection_data,
-                       char              *destination_uri,
-                       GdkDragAction      action)
+paste_uri_list (NautilusFilesView *view,
+                GList             *item_uris,
+                char              *destination_uri,
+                GdkDragAction      action)
 {
-    GList *item_uris;
-
-    item_uris = nautilus_clipboard_get_uri_list_from_selection_data (selection_data);
-
     if (item_uris != NULL && destination_uri != NULL)
     {
         nautilus_files_view_move_copy_items (view, item_uris, NULL, destination_uri,
@@ -2461,9 +2504,53 @@ handle_clipboard_data (NautilusFilesView *view,
         {
             gtk_clipboard_clear (nautilus_clipboard_get (GTK_WIDGET (view)));
         }
+    }
+}
+
+static void
+handle_clipboard_data (NautilusFilesView *view,
+                       GtkSelectionData  *selection_data,
+                       char              *destination_uri,
+                       GdkDragAction      action)
+{
+    GList *item_uris;
 
-        g_list_free_full (item_uris, g_free);
+    item_uris = nautilus_clipboard_get_uri_list_from_selection_data (selection_data);
+    paste_uri_list (view, item_uris, destination_uri, action);
+    g_list_free_full (item_uris, g_free);
+}
+
+/* When the files were copied or cut in this process, paste them straight
+ * away instead of round-tripping the whole list through the clipboard.
+ * Returns FALSE if the clipboard has to be asked. */
+static gboolean
+paste_own_clipboard_contents (NautilusFilesView *view,
+                              char              *destination_uri,
+                              gboolean           link)
+{
+    GList *item_uris;
+    gboolean cut;
+    GdkDragAction action;
+
+    if (!nautilus_clipboard_get_own_contents (nautilus_clipboard_get (GTK_WIDGET (view)),
+                                              &cut, NULL, &item_uris))
+    {
+        return FALSE;
     }
+
+    if (link)
+    {
+        action = GDK_ACTION_LINK;
+    }
+    else
+    {
+        action = cut ? GDK_ACTION_MOVE : GDK_ACTION_COPY;
+    }
+
+    paste_uri_list (view, item_uris, destination_uri, action);
+    g_list_free_full (item_uris, g_free);
+
+    return TRUE;
 }
 
 static void
@@ -2513,11 +2600,20 @@ action_paste_files (GSimpleAction *action,
                     gpointer       user_data)
 {
     NautilusFilesView *view;
+    char *view_uri;
 
     g_assert (NAUTILUS_IS_FILES_VIEW (user_data));
 
     view = NAUTILUS_FILES_VIEW (user_data);
 
+    view_uri = nautilus_files_view_get_backing_uri (view);
+    if (paste_own_clipboard_contents (view, view_uri, FALSE))
+    {
+        g_free (view_uri);
+        return;
+    }
+    g_free (view_uri);
+
     g_object_ref (view);
     gtk_clipboard_request_contents (nautilus_clipboard_get (GTK_WIDGET (view)),
                                     nautilus_clipboard_get_atom (),
@@ -2553,11 +2649,20 @@ action_create_links (GSimpleAction *action,
                      gpointer       user_data)
 {
     NautilusFilesView *view;
+    char *view_uri;
 
     g_assert (NAUTILUS_IS_FILES_VIEW (user_data));
 
     view = NAUTILUS_FILES_VIEW (user_data);
 
+    view_uri = nautilus_files_view_get_backing_uri (view);
+    if (paste_own_clipboard_contents (view, view_uri, TRUE))
+    {
+        g_free (view_uri);
+        return;
+    }
+    g_free (view_uri);
+
     g_object_ref (view);
     gtk_clipboard_request_contents (nautilus_clipboard_get (GTK_WIDGET (view)),
                                     nautilus_clipboard_get_atom (),
@@ -2982,6 +3087,12 @@ nautilus_files_view_destroy (GtkWidget *object)
     remove_update_context_menus_timeout_callback (view);
     remove_update_status_idle_callback (view);
 
+    if (view->details->prefetch_extension_menus_idle_id != 0)
+    {
+        g_source_remove (view->details->prefetch_extension_menus_idle_id);
+        view->details->prefetch_extension_menus_idle_id = 0;
+    }
+
     if (view->details->display_selection_idle_id != 0)
     {
         g_source_remove (view->details->display_selection_idle_id);
@@ -3055,10 +3166,149 @@ nautilus_files_view_finalize (GObject *object)
 
     g_hash_table_destroy (view->details->non_ready_files);
     g_hash_table_destroy (view->details->pending_reveal);
+    nautilus_menu_provider_cache_free (view->details->selection_menu_provider_cache);
+    nautilus_menu_provider_cache_free (view->details->background_menu_provider_cache);
+    g_hash_table_destroy (view->details->selection_summary.entries);
 
     G_OBJECT_CLASS (nautilus_files_view_parent_class)->finalize (object);
 }
 
+static void
+selection_entry_free (SelectionEntry *entry)
+{
+    g_slice_free (SelectionEntry, entry);
+}
+
+static void
+selection_entry_update (SelectionEntry *entry,
+                        NautilusFile   *file)
+{
+    guint item_count;
+
+    entry->is_directory = nautilus_file_is_directory (file);
+    if (entry->is_directory)
+    {
+        entry->known = nautilus_file_get_directory_item_count (file, &item_count, NULL);
+        entry->amount = entry->known ? item_count : 0;
+    }
+    else
+    {
+        entry->known = !nautilus_file_can_get_size (file);
+        entry->amount = entry->known ? nautilus_file_get_size (file) : 0;
+    }
+}
+
+/* Adds the entry to the totals, or takes it out again if sign is -1 */
+static void
+selection_summary_account (SelectionSummary *summary,
+                           SelectionEntry   *entry,
+                           int               sign)
+{
+    if (entry->is_directory)
+    {
+        summary->folder_count += sign;
+        if (entry->known)
+        {
+            summary->folder_item_count += sign * entry->amount;
+        }
+        else
+        {
+            summary->unknown_folder_item_counts += sign;
+        }
+    }
+    else
+    {
+        summary->non_folder_count += sign;
+        if (entry->known)
+        {
+            summary->non_folder_size += sign * entry->amount;
+            summary->known_non_folder_sizes += sign;
+        }
+    }
+}
+
+/* Only files that were not selected before get looked at, and the
+ * entries are only swept if some files were deselected */
+static void
+selection_summary_set_selection (SelectionSummary *summary,
+                                 GList            *selection)
+{
+    GHashTableIter iter;
+    SelectionEntry *entry;
+    guint still_selected;
+    GList *l;
+
+    summary->generation++;
+    still_selected = 0;
+
+    for (l = selection; l != NULL; l = l->next)
+    {
+        entry = g_hash_table_lookup (summary->entries, l->data);
+        if (entry == NULL)
+        {
+            entry = g_slice_new (SelectionEntry);
+            selection_entry_update (entry, l->data);
+            selection_summary_account (summary, entry, 1);
+            g_hash_table_insert (summary->entries, nautilus_file_ref (l->data), entry);
+            still_selected++;
+        }
+        else if (entry->generation != summary->generation)
+        {
+            still_selected++;
+        }
+        entry->generation = summary->generation;
+    }
+
+    if (g_hash_table_size (summary->entries) == still_selected)
+    {
+        return;
+    }
+
+    g_hash_table_iter_init (&iter, summary->entries);
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &entry))
+    {
+        if (entry->generation != summary->generation)
+        {
+            selection_summary_account (summary, entry, -1);
+            g_hash_table_iter_remove (&iter);
+        }
+    }
+}
+
+static void
+selection_summary_file_changed (SelectionSummary *summary,
+                                NautilusFile     *file)
+{
+    SelectionEntry *entry;
+
+    entry = g_hash_table_lookup (summary->entries, file);
+    if (entry == NULL)
+    {
+        return;
+    }
+
+    selection_summary_account (summary, entry, -1);
+    selection_entry_update (entry, file);
+    selection_summary_account (summary, entry, 1);
+}
+
+static NautilusFile *
+selection_summary_get_single_file (SelectionSummary *summary)
+{
+    GHashTableIter iter;
+    NautilusFile *file;
+
+    if (g_hash_table_size (summary->entries) != 1)
+    {
+        return NULL;
+    }
+
+    g_hash_table_iter_init (&iter, summary->entries);
+    g_hash_table_iter_next (&iter, (gpointer *) &file, NULL);
+
+    return file;
+}
+
 /**
  * nautilus_files_view_display_selection_info:
  *
@@ -3069,13 +3319,11 @@ nautilus_files_view_finalize (GObject *object)
 void
 nautilus_files_view_display_selection_info (NautilusFilesView *view)
 {
-    GList *selection;
+    SelectionSummary *summary;
     goffset non_folder_size;
     gboolean non_folder_size_known;
     guint non_folder_count, folder_count, folder_item_count;
     gboolean folder_item_count_known;
-    guint file_item_count;
-    GList *p;
     char *first_item_name;
     char *non_folder_count_str;
     char *non_folder_item_count_str;
@@ -3087,53 +3335,27 @@ nautilus_files_view_display_selection_info (NautilusFilesView *view)
 
     g_return_if_fail (NAUTILUS_IS_FILES_VIEW (view));
 
-    selection = nautilus_view_get_selection (NAUTILUS_VIEW (view));
+    summary = &view->details->selection_summary;
 
-    folder_item_count_known = TRUE;
-    folder_count = 0;
-    folder_item_count = 0;
-    non_folder_count = 0;
-    non_folder_size_known = FALSE;
-    non_folder_size = 0;
-    first_item_name = NULL;
+    folder_count = summary->folder_count;
+    folder_item_count = summary->folder_item_count;
+    folder_item_count_known = summary->unknown_folder_item_counts == 0;
+    non_folder_count = summary->non_folder_count;
+    non_folder_size = summary->non_folder_size;
+    non_folder_size_known = summary->known_non_folder_sizes > 0;
     folder_count_str = NULL;
     folder_item_count_str = NULL;
     non_folder_count_str = NULL;
     non_folder_item_count_str = NULL;
 
-    for (p = selection; p != NULL; p = p->next)
+    /* The name is only shown when a single item is selected */
+    first_item_name = NULL;
+    file = selection_summary_get_single_file (summary);
+    if (file != NULL)
     {
-        file = p->data;
-        if (nautilus_file_is_directory (file))
-        {
-            folder_count++;
-            if (nautilus_file_get_directory_item_count (file, &file_item_count, NULL))
-            {
-                folder_item_count += file_item_count;
-            }
-            else
-            {
-                folder_item_count_known = FALSE;
-            }
-        }
-        else
-        {
-            non_folder_count++;
-            if (!nautilus_file_can_get_size (file))
-            {
-                non_folder_size_known = TRUE;
-                non_folder_size += nautilus_file_get_size (file);
-            }
-        }
-
-        if (first_item_name == NULL)
-        {
-            first_item_name = nautilus_file_get_display_name (file);
-        }
+        first_item_name = nautilus_file_get_display_name (file);
     }
 
-    nautilus_file_list_free (selection);
-
     /* Break out cases for localization's sake. But note that there are still pieces
      * being assembled in a particular order, which may be a problem for some localizers.
      */
@@ -3734,7 +3956,9 @@ static void
 sort_files (NautilusFilesView  *view,
             GList             **list)
 {
+    nautilus_watchdog_push ("sort-files");
     *list = g_list_sort_with_data (*list, compare_files_cover, view);
+    nautilus_watchdog_pop ();
 }
 
 /* Go through all the new added and changed files.
@@ -3878,7 +4102,6 @@ process_old_files (NautilusFilesView *view)
 {
     GList *files_added, *files_changed, *node;
     FileAndDirectory *pending;
-    GList *selection, *files;
 
     files_added = view->details->old_added_files;
     files_changed = view->details->old_changed_files;
@@ -3930,14 +4153,11 @@ process_old_files (NautilusFilesView *view)
             }
         }
 
-        if (files_changed != NULL)
+        for (node = files_changed; node != NULL && !send_selection_change; node = node->next)
         {
-            selection = nautilus_view_get_selection (NAUTILUS_VIEW (view));
-            files = file_and_directory_list_to_files (files_changed);
-            send_selection_change = eel_g_lists_sort_and_check_for_intersection
-                                        (&files, &selection);
-            nautilus_file_list_free (files);
-            nautilus_file_list_free (selection);
+            pending = node->data;
+            send_selection_change = g_hash_table_contains (view->details->selection_summary.entries,
+                                                           pending->file);
         }
 
         file_and_directory_list_free (view->details->old_added_files);
@@ -4066,8 +4286,9 @@ schedule_idle_display_of_pending_files (NautilusFilesView *view)
      *  to avoid a resort on each add. But we still want to allow repaints
      *  and other hight prio events while we have pending files to show. */
     view->details->display_pending_source_id =
-        g_idle_add_full (G_PRIORITY_DEFAULT_IDLE - 20,
-                         display_pending_callback, view, NULL);
+        nautilus_watchdog_idle_add ("display-pending-files",
+                                    G_PRIORITY_DEFAULT_IDLE - 20,
+                                    display_pending_callback, view, NULL);
 }
 
 static void
@@ -4081,7 +4302,9 @@ schedule_timeout_display_of_pending_files (NautilusFilesView *view,
     }
 
     view->details->display_pending_source_id =
-        g_timeout_add (interval, display_pending_callback, view);
+        nautilus_watchdog_timeout_add ("display-pending-files",
+                                       G_PRIORITY_DEFAULT, interval,
+                                       display_pending_callback, view, NULL);
 }
 
 static void
@@ -4233,6 +4456,7 @@ files_changed_callback (NautilusDirectory *directory,
 {
     NautilusFilesView *view;
     GtkWindow *window;
+    GList *node;
     char *uri;
 
     view = NAUTILUS_FILES_VIEW (callback_data);
@@ -4247,6 +4471,11 @@ files_changed_callback (NautilusDirectory *directory,
 
     queue_pending_files (view, directory, files, &view->details->new_changed_files);
 
+    for (node = files; node != NULL; node = node->next)
+    {
+        selection_summary_file_changed (&view->details->selection_summary, node->data);
+    }
+
     /* The free space or the number of items could have changed */
     schedule_update_status (view);
 
@@ -4300,6 +4529,74 @@ load_error_callback (NautilusDirectory *directory,
         nautilus_files_view_get_containing_window (view));
 }
 
+/* Extension info is what info providers add to a file: emblems and the
+ * values of extension columns. With no info providers loaded there is
+ * nothing to fetch, so don't queue every file for it.
+ */
+static NautilusFileAttributes
+get_extension_info_attributes (void)
+{
+    static guint serial;
+    static gboolean serial_valid = FALSE;
+    static gboolean have_info_providers;
+    GList *providers;
+
+    if (!serial_valid || serial != nautilus_module_get_serial ())
+    {
+        providers = nautilus_module_get_extensions_for_type (NAUTILUS_TYPE_INFO_PROVIDER);
+        have_info_providers = providers != NULL;
+        nautilus_module_extension_list_free (providers);
+
+        serial = nautilus_module_get_serial ();
+        serial_valid = TRUE;
+    }
+
+    return have_info_providers ? NAUTILUS_FILE_ATTRIBUTE_EXTENSION_INFO : 0;
+}
+
+static NautilusFileAttributes
+get_file_monitor_attributes (void)
+{
+    return NAUTILUS_FILE_ATTRIBUTES_FOR_ICON |
+           NAUTILUS_FILE_ATTRIBUTE_DIRECTORY_ITEM_COUNT |
+           NAUTILUS_FILE_ATTRIBUTE_INFO |
+           NAUTILUS_FILE_ATTRIBUTE_LINK_INFO |
+           NAUTILUS_FILE_ATTRIBUTE_MOUNT |
+           get_extension_info_attributes ();
+}
+
+/* Extensions that were still being loaded when the files started being
+ * monitored may want to add info to them, and items to the menus */
+static void
+extensions_loaded_callback (NautilusFilesView *view)
+{
+    GList *l;
+
+    if (get_extension_info_attributes () != 0)
+    {
+        /* Replacing the monitors of the same client only changes what
+         * they ask for */
+        if (view->details->files_added_handler_id != 0)
+        {
+            nautilus_directory_file_monitor_add (view->details->model,
+                                                 &view->details->model,
+                                                 view->details->show_hidden_files,
+                                                 get_file_monitor_attributes (),
+                                                 NULL, NULL);
+        }
+        for (l = view->details->subdirectory_list; l != NULL; l = l->next)
+        {
+            nautilus_directory_file_monitor_add (l->data,
+                                                 &view->details->model,
+                                                 view->details->show_hidden_files,
+                                                 get_file_monitor_attributes (),
+                                                 NULL, NULL);
+        }
+    }
+
+    schedule_update_context_menus (view);
+}
+
 void
 nautilus_files_view_add_subdirectory (NautilusFilesView *view,
                                       NautilusDirectory *directory)
@@ -4310,13 +4607,7 @@ nautilus_files_view_add_subdirectory (NautilusFilesView *view,
 
     nautilus_directory_ref (directory);
 
-    attributes =
-        NAUTILUS_FILE_ATTRIBUTES_FOR_ICON |
-        NAUTILUS_FILE_ATTRIBUTE_DIRECTORY_ITEM_COUNT |
-        NAUTILUS_FILE_ATTRIBUTE_INFO |
-        NAUTILUS_FILE_ATTRIBUTE_LINK_INFO |
-        NAUTILUS_FILE_ATTRIBUTE_MOUNT |
-        NAUTILUS_FILE_ATTRIBUTE_EXTENSION_INFO;
+    attributes = get_file_monitor_attributes ();
 
     nautilus_directory_file_monitor_add (directory,
                                          &view->details->model,
@@ -4563,32 +4854,43 @@ get_menu_icon_for_file (NautilusFile *file,
 }
 
 static GList *
-get_extension_selection_menu_items (NautilusFilesView *view)
+get_extension_menu_items (NautilusFilesView         *view,
+                          NautilusMenuProviderCache *cache,
+                          GList                     *files)
 {
     NautilusWindow *window;
     GList *items;
     GList *providers;
     GList *l;
-    GList *selection;
 
     window = nautilus_files_view_get_window (view);
-    selection = nautilus_view_get_selection (NAUTILUS_VIEW (view));
     providers = nautilus_module_get_extensions_for_type (NAUTILUS_TYPE_MENU_PROVIDER);
     items = NULL;
 
     for (l = providers; l != NULL; l = l->next)
     {
-        NautilusMenuProvider *provider;
-        GList *file_items;
-
-        provider = NAUTILUS_MENU_PROVIDER (l->data);
-        file_items = nautilus_menu_provider_get_file_items (provider,
-                                                            GTK_WIDGET (window),
-                                                            selection);
-        items = g_list_concat (items, file_items);
+        items = g_list_concat (items,
+                               nautilus_menu_provider_cache_get_items (cache,
+                                                                       NAUTILUS_MENU_PROVIDER (l->data),
+                                                                       GTK_WIDGET (window),
+                                                                       files));
     }
 
     nautilus_module_extension_list_free (providers);
+
+    return items;
+}
+
+static GList *
+get_extension_selection_menu_items (NautilusFilesView *view)
+{
+    GList *items;
+    GList *selection;
+
+    selection = nautilus_view_get_selection (NAUTILUS_VIEW (view));
+    items = get_extension_menu_items (view,
+                                      view->details->selection_menu_provider_cache,
+                                      selection);
     nautilus_file_list_free (selection);
 
     return items;
@@ -4597,30 +4899,71 @@ get_extension_selection_menu_items (NautilusFilesView *view)
 static GList *
 get_extension_background_menu_items (NautilusFilesView *view)
 {
-    NautilusWindow *window;
-    GList *items;
-    GList *providers;
-    GList *l;
+    GList files;
 
-    window = nautilus_files_view_get_window (view);
+    if (view->details->directory_as_file == NULL)
+    {
+        return NULL;
+    }
+
+    files.data = view->details->directory_as_file;
+    files.next = NULL;
+    files.prev = NULL;
+
+    return get_extension_menu_items (view,
+                                     view->details->background_menu_provider_cache,
+                                     &files);
+}
+
+/* Asks providers that answered quickly last time for the current
+ * selection, one per iteration, so their items are ready when a menu
+ * is opened. Slow providers wait for the menu. */
+static gboolean
+prefetch_extension_menus_idle_callback (gpointer data)
+{
+    NautilusFilesView *view;
+    GList *providers, *selection, *l;
+    gboolean more;
+
+    view = NAUTILUS_FILES_VIEW (data);
     providers = nautilus_module_get_extensions_for_type (NAUTILUS_TYPE_MENU_PROVIDER);
-    items = NULL;
+    selection = nautilus_view_get_selection (NAUTILUS_VIEW (view));
+    more = FALSE;
 
     for (l = providers; l != NULL; l = l->next)
     {
-        NautilusMenuProvider *provider;
-        GList *file_items;
-
-        provider = NAUTILUS_MENU_PROVIDER (l->data);
-        file_items = nautilus_menu_provider_get_background_items (provider,
-                                                                  GTK_WIDGET (window),
-                                                                  view->details->directory_as_file);
-        items = g_list_concat (items, file_items);
+        if (nautilus_menu_provider_cache_prefetch (view->details->selection_menu_provider_cache,
+                                                   NAUTILUS_MENU_PROVIDER (l->data),
+                                                   GTK_WIDGET (nautilus_files_view_get_window (view)),
+                                                   selection,
+                                                   MENU_PROVIDER_PREFETCH_BUDGET))
+        {
+            more = l->next != NULL;
+            break;
+        }
     }
 
+    nautilus_file_list_free (selection);
     nautilus_module_extension_list_free (providers);
 
-    return items;
+    if (!more)
+    {
+        view->details->prefetch_extension_menus_idle_id = 0;
+    }
+
+    return more;
+}
+
+static void
+schedule_prefetch_extension_menus (NautilusFilesView *view)
+{
+    if (view->details->prefetch_extension_menus_idle_id == 0 &&
+        !nautilus_menu_provider_cache_is_empty (view->details->selection_menu_provider_cache))
+    {
+        view->details->prefetch_extension_menus_idle_id =
+            g_idle_add_full (G_PRIORITY_LOW, prefetch_extension_menus_idle_callback,
+                             view, NULL);
+    }
 }
 
 static void
@@ -4742,6 +5085,12 @@ update_extensions_menus (NautilusFilesView *view)
 {
     GList *selection_items, *background_items;
 
+    if (!view->details->extension_menus_pending)
+    {
+        return;
+    }
+    view->details->extension_menus_pending = FALSE;
+
     selection_items = get_extension_selection_menu_items (view);
     if (selection_items != NULL)
     {
@@ -5840,10 +6189,20 @@ paste_into (NautilusFilesView *view,
             NautilusFile      *target)
 {
     PasteIntoData *data;
+    char *directory_uri;
+    gboolean pasted;
 
     g_assert (NAUTILUS_IS_FILES_VIEW (view));
     g_assert (NAUTILUS_IS_FILE (target));
 
+    directory_uri = nautilus_file_get_activation_uri (target);
+    pasted = paste_own_clipboard_contents (view, directory_uri, FALSE);
+    g_free (directory_uri);
+    if (pasted)
+    {
+        return;
+    }
+
     data = g_new (PasteIntoData, 1);
 
     data->view = g_object_ref (view);
@@ -6656,6 +7015,7 @@ const GActionEntry view_entries[] =
     { "select-all", action_select_all },
     { "paste", action_paste_files },
     { "create-link", action_create_links },
+    { "generate-thumbnails", action_generate_thumbnails },
     { "new-document" },
     /* Selection menu */
     { "scripts" },
@@ -6742,39 +7102,47 @@ can_paste_into_file (NautilusFile *file)
 }
 
 static void
-on_clipboard_contents_received (GtkClipboard     *clipboard,
-                                GtkSelectionData *selection_data,
-                                gpointer          user_data)
+update_create_link_action (NautilusFilesView *view,
+                           gboolean           is_cut)
 {
-    NautilusFilesView *view;
     gboolean can_link_from_copied_files;
     gboolean settings_show_create_link;
     gboolean is_read_only;
     gboolean selection_contains_recent;
     GAction *action;
 
-    view = NAUTILUS_FILES_VIEW (user_data);
-
-    if (view->details->slot == NULL ||
-        !view->details->active)
-    {
-        /* We've been destroyed or became inactive since call */
-        g_object_unref (view);
-        return;
-    }
-
     settings_show_create_link = g_settings_get_boolean (nautilus_preferences,
                                                         NAUTILUS_PREFERENCES_SHOW_CREATE_LINK);
     is_read_only = nautilus_files_view_is_read_only (view);
     selection_contains_recent = showing_recent_directory (view);
-    can_link_from_copied_files = !nautilus_clipboard_is_cut_from_selection_data (selection_data) &&
-                                 !selection_contains_recent && !is_read_only;
+    can_link_from_copied_files = !is_cut && !selection_contains_recent && !is_read_only;
 
     action = g_action_map_lookup_action (G_ACTION_MAP (view->details->view_action_group),
                                          "create-link");
     g_simple_action_set_enabled (G_SIMPLE_ACTION (action),
                                  can_link_from_copied_files &&
                                  settings_show_create_link);
+}
+
+static void
+on_clipboard_contents_received (GtkClipboard     *clipboard,
+                                GtkSelectionData *selection_data,
+                                gpointer          user_data)
+{
+    NautilusFilesView *view;
+
+    view = NAUTILUS_FILES_VIEW (user_data);
+
+    if (view->details->slot == NULL ||
+        !view->details->active)
+    {
+        /* We've been destroyed or became inactive since call */
+        g_object_unref (view);
+        return;
+    }
+
+    update_create_link_action (view,
+                               nautilus_clipboard_is_cut_from_selection_data (selection_data));
 
     g_object_unref (view);
 }
@@ -7042,6 +7410,7 @@ real_update_actions_state (NautilusFilesView *view)
     gboolean can_extract_here;
     gboolean item_opens_in_view;
     gboolean is_read_only;
+    gboolean is_cut;
     GAction *action;
     GActionGroup *view_action_group;
     gboolean show_mount;
@@ -7343,6 +7712,12 @@ real_update_actions_state (NautilusFilesView *view)
                                          "properties");
     g_simple_action_set_enabled (G_SIMPLE_ACTION (action),
                                  TRUE);
+    action = g_action_map_lookup_action (G_ACTION_MAP (view_action_group),
+                                         "generate-thumbnails");
+    g_simple_action_set_enabled (G_SIMPLE_ACTION (action),
+                                 view->details->location != NULL &&
+                                 !nautilus_view_is_searching (NAUTILUS_VIEW (view)) &&
+                                 !selection_contains_recent);
     action = g_action_map_lookup_action (G_ACTION_MAP (view_action_group),
                                          "new-document");
     g_simple_action_set_enabled (G_SIMPLE_ACTION (action),
@@ -7357,11 +7732,19 @@ real_update_actions_state (NautilusFilesView *view)
                                    on_clipboard_targets_received,
                                    view);
 
-    g_object_ref (view);     /* Need to keep the object alive until we get the reply */
-    gtk_clipboard_request_contents (nautilus_clipboard_get (GTK_WIDGET (view)),
-                                    nautilus_clipboard_get_atom (),
-                                    on_clipboard_contents_received,
-                                    view);
+    if (nautilus_clipboard_get_own_contents (nautilus_clipboard_get (GTK_WIDGET (view)),
+                                             &is_cut, NULL, NULL))
+    {
+        update_create_link_action (view, is_cut);
+    }
+    else
+    {
+        g_object_ref (view); /* Need to keep the object alive until we get the reply */
+        gtk_clipboard_request_contents (nautilus_clipboard_get (GTK_WIDGET (view)),
+                                        nautilus_clipboard_get_atom (),
+                                        on_clipboard_contents_received,
+                                        view);
+    }
 
     action = g_action_map_lookup_action (G_ACTION_MAP (view_action_group),
                                          "select-all");
@@ -7682,7 +8065,9 @@ real_update_context_menus (NautilusFilesView *view)
 
     update_selection_menu (view);
     update_background_menu (view);
-    update_extensions_menus (view);
+
+    view->details->extension_menus_pending = TRUE;
+    schedule_prefetch_extension_menus (view);
 
     nautilus_files_view_update_actions_state (view);
 }
@@ -7796,6 +8181,7 @@ nautilus_files_view_pop_up_selection_context_menu  (NautilusFilesView *view,
      * etc. states by forcing menus to update now.
      */
     update_context_menus_if_pending (view);
+    update_extensions_menus (view);
 
     update_context_menu_position_from_event (view, event);
 
@@ -7819,6 +8205,7 @@ nautilus_files_view_pop_up_background_context_menu (NautilusFilesView *view,
      * etc. states by forcing menus to update now.
      */
     update_context_menus_if_pending (view);
+    update_extensions_menus (view);
 
     update_context_menu_position_from_event (view, event);
 
@@ -7888,8 +8275,9 @@ schedule_update_status (NautilusFilesView *view)
     if (view->details->update_status_idle_id == 0)
     {
         view->details->update_status_idle_id =
-            g_idle_add_full (G_PRIORITY_DEFAULT_IDLE - 20,
-                             update_status_idle_callback, view, NULL);
+            nautilus_watchdog_idle_add ("update-status",
+                                        G_PRIORITY_DEFAULT_IDLE - 20,
+                                        update_status_idle_callback, view, NULL);
     }
 }
 
@@ -7912,6 +8300,17 @@ nautilus_files_view_notify_selection_changed (NautilusFilesView *view)
     selection = nautilus_view_get_selection (NAUTILUS_VIEW (view));
     window = nautilus_files_view_get_containing_window (view);
     DEBUG_FILES (selection, "Selection changed in window %p", window);
+
+    /* A folder selected on its own is a good guess for where the user
+     * is going next */
+    if (selection != NULL && selection->next == NULL &&
+        view->details->batching_selection_level == 0)
+    {
+        nautilus_directory_prefetch_file (selection->data);
+    }
+
+    selection_summary_set_selection (&view->details->selection_summary, selection);
+
     nautilus_file_list_free (selection);
 
     view->details->selection_was_removed = FALSE;
@@ -7920,8 +8319,10 @@ nautilus_files_view_notify_selection_changed (NautilusFilesView *view)
     if (view->details->display_selection_idle_id == 0)
     {
         view->details->display_selection_idle_id
-            = g_idle_add (display_selection_info_idle_callback,
-                          view);
+            = nautilus_watchdog_idle_add ("display-selection-info",
+                                          G_PRIORITY_DEFAULT_IDLE,
+                                          display_selection_info_idle_callback,
+                                          view, NULL);
     }
 
     if (view->details->batching_selection_level != 0)
@@ -8087,13 +8488,7 @@ finish_loading (NautilusFilesView *view)
      * attribute is based on that, and the file's metadata
      * and possible custom name.
      */
-    attributes =
-        NAUTILUS_FILE_ATTRIBUTES_FOR_ICON |
-        NAUTILUS_FILE_ATTRIBUTE_DIRECTORY_ITEM_COUNT |
-        NAUTILUS_FILE_ATTRIBUTE_INFO |
-        NAUTILUS_FILE_ATTRIBUTE_LINK_INFO |
-        NAUTILUS_FILE_ATTRIBUTE_MOUNT |
-        NAUTILUS_FILE_ATTRIBUTE_EXTENSION_INFO;
+    attributes = get_file_monitor_attributes ();
 
     nautilus_directory_file_monitor_add (view->details->model,
                                          &view->details->model,
@@ -9152,6 +9547,12 @@ nautilus_files_view_init (NautilusFilesView *view)
                                NULL);
 
     view->details->pending_reveal = g_hash_table_new (NULL, NULL);
+    view->details->selection_summary.entries =
+        g_hash_table_new_full (NULL, NULL,
+                               (GDestroyNotify) nautilus_file_unref,
+                               (GDestroyNotify) selection_entry_free);
+    view->details->selection_menu_provider_cache = nautilus_menu_provider_cache_new (FALSE);
+    view->details->background_menu_provider_cache = nautilus_menu_provider_cache_new (TRUE);
 
     gtk_style_context_set_junction_sides (gtk_widget_get_style_context (GTK_WIDGET (view)),
                                           GTK_JUNCTION_TOP | GTK_JUNCTION_LEFT);
@@ -9193,6 +9594,8 @@ nautilus_files_view_init (NautilusFilesView *view)
     /* Register to menu provider extension signal managing menu updates */
     g_signal_connect_object (nautilus_signaller_get_current (), "popup-menu-changed",
                              G_CALLBACK (schedule_update_context_menus), view, G_CONNECT_SWAPPED);
+    g_signal_connect_object (nautilus_signaller_get_current (), "extensions-loaded",
+                             G_CALLBACK (extensions_loaded_callback), view, G_CONNECT_SWAPPED);
 
     gtk_widget_show (GTK_WIDGET (view));
 
@@ -174,6 +174,9 @@ typedef enum
 #define NAUTILUS_PREFERENCES_SHOW_DELETE_PERMANENTLY "show-delete-permanently"
 #define NAUTILUS_PREFERENCES_SHOW_CREATE_LINK "show-create-link"
 
+/* Extensions to run in nautilus-extension-host */
+#define NAUTILUS_PREFERENCES_OUT_OF_PROCESS_EXTENSIONS "out-of-process-extensions"
+
 void nautilus_global_preferences_init                      (void);
 
 extern GSettings *nautilus_preferences;
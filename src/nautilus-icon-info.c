@@ -20,6 +20,7 @@
 #include "nautilus-icon-info.h"
 #include "nautilus-icon-names.h"
 #include "nautilus-default-file-icon.h"
+#include "nautilus-metrics.h"
 #include <gtk/gtk.h>
 #include <gio/gio.h>
 
@@ -27,8 +28,6 @@ struct _NautilusIconInfo
 {
     GObject parent;
 
-    gboolean sole_owner;
-    gint64 last_use_time;
     GdkPixbuf *pixbuf;
 
     char *icon_name;
@@ -41,8 +40,6 @@ struct _NautilusIconInfoClass
     GObjectClass parent_class;
 };
 
-static void schedule_reap_cache (void);
-
 G_DEFINE_TYPE (NautilusIconInfo,
                nautilus_icon_info,
                G_TYPE_OBJECT);
@@ -50,8 +47,6 @@ G_DEFINE_TYPE (NautilusIconInfo,
 static void
 nautilus_icon_info_init (NautilusIconInfo *icon)
 {
-    icon->last_use_time = g_get_monotonic_time ();
-    icon->sole_owner = TRUE;
 }
 
 gboolean
@@ -60,24 +55,6 @@ nautilus_icon_info_is_fallback (NautilusIconInfo *icon)
     return icon->pixbuf == NULL;
 }
 
-static void
-pixbuf_toggle_notify (gpointer  info,
-                      GObject  *object,
-                      gboolean  is_last_ref)
-{
-    NautilusIconInfo *icon = info;
-
-    if (is_last_ref)
-    {
-        icon->sole_owner = TRUE;
-        g_object_remove_toggle_ref (object,
-                                    pixbuf_toggle_notify,
-                                    info);
-        icon->last_use_time = g_get_monotonic_time ();
-        schedule_reap_cache ();
-    }
-}
-
 static void
 nautilus_icon_info_finalize (GObject *object)
 {
@@ -85,13 +62,6 @@ nautilus_icon_info_finalize (GObject *object)
 
     icon = NAUTILUS_ICON_INFO (object);
 
-    if (!icon->sole_owner && icon->pixbuf)
-    {
-        g_object_remove_toggle_ref (G_OBJECT (icon->pixbuf),
-                                    pixbuf_toggle_notify,
-                                    icon);
-    }
-
     if (icon->pixbuf)
     {
         g_object_unref (icon->pixbuf);
@@ -159,315 +129,411 @@ nautilus_icon_info_new_for_icon_info (GtkIconInfo *icon_info,
 }
 
 
+/* Resolved icons are cached by the GIcon that was asked for (which for
+ * ordinary files is the themed name list derived from the MIME type, plus
+ * any emblems), the size and the scale, so that a hit never touches the
+ * icon theme. Themed lookups are additionally cached by the file they
+ * resolved to, so that the many name lists ending in e.g.
+ * "text-x-generic" share one pixbuf.
+ *
+ * Both tables are bounded together by a byte budget and evicted in least
+ * recently used order when an entry is inserted. Entries are kept on an
+ * intrusive list, so a hit and an eviction are both O(1). A pixbuf is
+ * charged once however many entries share it, and only until the last
+ * of them goes.
+ */
+#define ICON_CACHE_MAX_BYTES (32 * 1024 * 1024)
+#define ICON_CACHE_ENTRY_OVERHEAD 256
+
 typedef struct
 {
     GIcon *icon;
+    char *filename;
     int size;
-} LoadableIconKey;
+    int scale;
+} IconKey;
 
 typedef struct
 {
-    char *filename;
-    int size;
-} ThemedIconKey;
-
-static GHashTable *loadable_icon_cache = NULL;
-static GHashTable *themed_icon_cache = NULL;
-static guint reap_cache_timeout = 0;
-
-#define MICROSEC_PER_SEC ((guint64) 1000000L)
+    IconKey key;
+    GHashTable *table;
+    NautilusIconInfo *icon_info;
+    gsize bytes;
+    GList link;
+} IconCacheEntry;
 
-static guint time_now;
+static GHashTable *icon_cache = NULL;
+static GHashTable *themed_file_cache = NULL;
+static GQueue icon_cache_lru = G_QUEUE_INIT;
+static gsize icon_cache_bytes = 0;
+/* How many entries hold each cached pixbuf */
+static GHashTable *cached_pixbufs = NULL;
 
-static gboolean
-reap_old_icon (gpointer key,
-               gpointer value,
-               gpointer user_info)
+static guint
+icon_key_hash (const IconKey *key)
 {
-    NautilusIconInfo *icon = value;
-    gboolean *reapable_icons_left = user_info;
+    guint hash;
 
-    if (icon->sole_owner)
+    if (key->icon != NULL)
     {
-        if (time_now - icon->last_use_time > 30 * MICROSEC_PER_SEC)
-        {
-            /* This went unused 30 secs ago. reap */
-            return TRUE;
-        }
-        else
-        {
-            /* We can reap this soon */
-            *reapable_icons_left = TRUE;
-        }
+        hash = g_icon_hash (key->icon);
+    }
+    else
+    {
+        hash = g_str_hash (key->filename);
     }
 
-    return FALSE;
+    return hash ^ key->size ^ (key->scale << 16);
 }
 
 static gboolean
-reap_cache (gpointer data)
+icon_key_equal (const IconKey *a,
+                const IconKey *b)
 {
-    gboolean reapable_icons_left;
-
-    reapable_icons_left = TRUE;
-
-    time_now = g_get_monotonic_time ();
-
-    if (loadable_icon_cache)
+    if (a->size != b->size || a->scale != b->scale)
     {
-        g_hash_table_foreach_remove (loadable_icon_cache,
-                                     reap_old_icon,
-                                     &reapable_icons_left);
+        return FALSE;
     }
 
-    if (themed_icon_cache)
+    if (a->icon != NULL)
     {
-        g_hash_table_foreach_remove (themed_icon_cache,
-                                     reap_old_icon,
-                                     &reapable_icons_left);
+        return b->icon != NULL && g_icon_equal (a->icon, b->icon);
     }
 
-    if (reapable_icons_left)
-    {
-        return TRUE;
-    }
-    else
-    {
-        reap_cache_timeout = 0;
-        return FALSE;
-    }
+    return b->filename != NULL && g_str_equal (a->filename, b->filename);
+}
+
+static void
+update_cache_metrics (void)
+{
+    nautilus_metrics_gauge_set ("icon-cache-entries", icon_cache_lru.length);
+    nautilus_metrics_gauge_set ("icon-cache-bytes", icon_cache_bytes);
+}
+
+static gsize
+get_pixbuf_bytes (GdkPixbuf *pixbuf)
+{
+    return (gsize) gdk_pixbuf_get_rowstride (pixbuf) * gdk_pixbuf_get_height (pixbuf);
 }
 
 static void
-schedule_reap_cache (void)
+charge_pixbuf (GdkPixbuf *pixbuf)
 {
-    if (reap_cache_timeout == 0)
+    guint n_entries;
+
+    if (pixbuf == NULL)
     {
-        reap_cache_timeout = g_timeout_add_seconds_full (0, 5,
-                                                         reap_cache,
-                                                         NULL, NULL);
+        return;
     }
+
+    n_entries = GPOINTER_TO_UINT (g_hash_table_lookup (cached_pixbufs, pixbuf));
+    if (n_entries == 0)
+    {
+        icon_cache_bytes += get_pixbuf_bytes (pixbuf);
+    }
+    g_hash_table_insert (cached_pixbufs, pixbuf, GUINT_TO_POINTER (n_entries + 1));
 }
 
-void
-nautilus_icon_info_clear_caches (void)
+static void
+uncharge_pixbuf (GdkPixbuf *pixbuf)
 {
-    if (loadable_icon_cache)
+    guint n_entries;
+
+    if (pixbuf == NULL)
     {
-        g_hash_table_remove_all (loadable_icon_cache);
+        return;
     }
 
-    if (themed_icon_cache)
+    n_entries = GPOINTER_TO_UINT (g_hash_table_lookup (cached_pixbufs, pixbuf));
+    if (n_entries > 1)
     {
-        g_hash_table_remove_all (themed_icon_cache);
+        g_hash_table_insert (cached_pixbufs, pixbuf, GUINT_TO_POINTER (n_entries - 1));
+        return;
     }
+
+    g_hash_table_remove (cached_pixbufs, pixbuf);
+    icon_cache_bytes -= get_pixbuf_bytes (pixbuf);
 }
 
-static guint
-loadable_icon_key_hash (LoadableIconKey *key)
+static void
+icon_cache_entry_free (IconCacheEntry *entry)
 {
-    return g_icon_hash (key->icon) ^ key->size;
+    g_queue_unlink (&icon_cache_lru, &entry->link);
+    icon_cache_bytes -= entry->bytes;
+    uncharge_pixbuf (entry->icon_info->pixbuf);
+    update_cache_metrics ();
+
+    g_clear_object (&entry->key.icon);
+    g_free (entry->key.filename);
+    g_object_unref (entry->icon_info);
+
+    g_slice_free (IconCacheEntry, entry);
 }
 
-static gboolean
-loadable_icon_key_equal (const LoadableIconKey *a,
-                         const LoadableIconKey *b)
+static void
+ensure_icon_caches (void)
 {
-    return a->size == b->size &&
-           g_icon_equal (a->icon, b->icon);
+    if (icon_cache != NULL)
+    {
+        return;
+    }
+
+    /* The entry owns its key, so only the value needs a destroy notify */
+    icon_cache = g_hash_table_new_full ((GHashFunc) icon_key_hash,
+                                        (GEqualFunc) icon_key_equal,
+                                        NULL,
+                                        (GDestroyNotify) icon_cache_entry_free);
+    themed_file_cache = g_hash_table_new_full ((GHashFunc) icon_key_hash,
+                                               (GEqualFunc) icon_key_equal,
+                                               NULL,
+                                               (GDestroyNotify) icon_cache_entry_free);
+    cached_pixbufs = g_hash_table_new (g_direct_hash, g_direct_equal);
 }
 
-static LoadableIconKey *
-loadable_icon_key_new (GIcon *icon,
-                       int    size)
-{
-    LoadableIconKey *key;
+static NautilusIconInfo *
+icon_cache_lookup (GHashTable *table,
+                   GIcon      *icon,
+                   const char *filename,
+                   int         size,
+                   int         scale)
+{
+    IconKey lookup_key;
+    IconCacheEntry *entry;
+
+    lookup_key.icon = icon;
+    lookup_key.filename = (char *) filename;
+    lookup_key.size = size;
+    lookup_key.scale = scale;
+
+    entry = g_hash_table_lookup (table, &lookup_key);
+    if (entry == NULL)
+    {
+        return NULL;
+    }
 
-    key = g_slice_new (LoadableIconKey);
-    key->icon = g_object_ref (icon);
-    key->size = size;
+    /* Most recently used entries live at the head */
+    g_queue_unlink (&icon_cache_lru, &entry->link);
+    g_queue_push_head_link (&icon_cache_lru, &entry->link);
 
-    return key;
+    return g_object_ref (entry->icon_info);
 }
 
 static void
-loadable_icon_key_free (LoadableIconKey *key)
-{
-    g_object_unref (key->icon);
-    g_slice_free (LoadableIconKey, key);
+icon_cache_insert (GHashTable       *table,
+                   GIcon            *icon,
+                   const char       *filename,
+                   int               size,
+                   int               scale,
+                   NautilusIconInfo *icon_info)
+{
+    IconCacheEntry *entry;
+    IconCacheEntry *oldest;
+
+    entry = g_slice_new0 (IconCacheEntry);
+    entry->key.icon = icon != NULL ? g_object_ref (icon) : NULL;
+    entry->key.filename = g_strdup (filename);
+    entry->key.size = size;
+    entry->key.scale = scale;
+    entry->table = table;
+    entry->icon_info = g_object_ref (icon_info);
+    entry->link.data = entry;
+
+    entry->bytes = ICON_CACHE_ENTRY_OVERHEAD;
+
+    /* Replacing an existing entry frees it, which unlinks it from the list */
+    g_hash_table_replace (table, &entry->key, entry);
+    g_queue_push_head_link (&icon_cache_lru, &entry->link);
+    icon_cache_bytes += entry->bytes;
+    charge_pixbuf (icon_info->pixbuf);
+
+    /* Icons still in use by a view keep their pixbuf alive through the
+     * reference the view holds, so evicting them only costs a theme
+     * lookup if they are asked for again. */
+    while (icon_cache_bytes > ICON_CACHE_MAX_BYTES &&
+           icon_cache_lru.tail != &entry->link)
+    {
+        oldest = icon_cache_lru.tail->data;
+        g_hash_table_remove (oldest->table, &oldest->key);
+    }
+
+    update_cache_metrics ();
 }
 
-static guint
-themed_icon_key_hash (ThemedIconKey *key)
+void
+nautilus_icon_info_clear_caches (void)
 {
-    return g_str_hash (key->filename) ^ key->size;
+    if (icon_cache)
+    {
+        g_hash_table_remove_all (icon_cache);
+    }
+
+    if (themed_file_cache)
+    {
+        g_hash_table_remove_all (themed_file_cache);
+    }
 }
 
 static gboolean
-themed_icon_key_equal (const ThemedIconKey *a,
-                       const ThemedIconKey *b)
+icon_is_cacheable (GIcon *icon)
 {
-    return a->size == b->size &&
-           g_str_equal (a->filename, b->filename);
+    /* Only themed icons are shared between files. Thumbnails and custom
+     * icons are pixbufs or loadable icons unique to one file, emblemed or
+     * not; keeping those around would only push shared icons out. */
+    if (G_IS_EMBLEMED_ICON (icon))
+    {
+        icon = g_emblemed_icon_get_icon (G_EMBLEMED_ICON (icon));
+    }
+
+    return G_IS_THEMED_ICON (icon);
 }
 
-static ThemedIconKey *
-themed_icon_key_new (const char *filename,
-                     int         size)
+static NautilusIconInfo *
+lookup_themed_icon (GIcon *icon,
+                    int    size,
+                    int    scale)
 {
-    ThemedIconKey *key;
+    const char * const *names;
+    GtkIconTheme *icon_theme;
+    GtkIconInfo *gtkicon_info;
+    const char *filename;
+    NautilusIconInfo *icon_info;
 
-    key = g_slice_new (ThemedIconKey);
-    key->filename = g_strdup (filename);
-    key->size = size;
+    names = g_themed_icon_get_names (G_THEMED_ICON (icon));
 
-    return key;
-}
+    icon_theme = gtk_icon_theme_get_default ();
+    gtkicon_info = gtk_icon_theme_choose_icon_for_scale (icon_theme, (const char **) names,
+                                                         size, scale, GTK_ICON_LOOKUP_FORCE_SIZE);
 
-static void
-themed_icon_key_free (ThemedIconKey *key)
-{
-    g_free (key->filename);
-    g_slice_free (ThemedIconKey, key);
+    if (gtkicon_info == NULL)
+    {
+        return nautilus_icon_info_new_for_pixbuf (NULL, scale);
+    }
+
+    filename = gtk_icon_info_get_filename (gtkicon_info);
+    if (filename == NULL)
+    {
+        g_object_unref (gtkicon_info);
+        return nautilus_icon_info_new_for_pixbuf (NULL, scale);
+    }
+
+    icon_info = icon_cache_lookup (themed_file_cache, NULL, filename, size, scale);
+    if (icon_info == NULL)
+    {
+        icon_info = nautilus_icon_info_new_for_icon_info (gtkicon_info, scale);
+        icon_cache_insert (themed_file_cache, NULL, filename, size, scale, icon_info);
+    }
+
+    g_object_unref (gtkicon_info);
+
+    return icon_info;
 }
 
-NautilusIconInfo *
-nautilus_icon_info_lookup (GIcon *icon,
-                           int    size,
-                           int    scale)
+static NautilusIconInfo *
+lookup_loadable_icon (GIcon *icon,
+                      int    size,
+                      int    scale)
 {
     NautilusIconInfo *icon_info;
+    GInputStream *stream;
     GdkPixbuf *pixbuf;
 
-    if (G_IS_LOADABLE_ICON (icon))
+    pixbuf = NULL;
+    stream = g_loadable_icon_load (G_LOADABLE_ICON (icon),
+                                   size * scale,
+                                   NULL, NULL, NULL);
+    if (stream)
     {
-        LoadableIconKey lookup_key;
-        LoadableIconKey *key;
-        GInputStream *stream;
-
-        if (loadable_icon_cache == NULL)
-        {
-            loadable_icon_cache =
-                g_hash_table_new_full ((GHashFunc) loadable_icon_key_hash,
-                                       (GEqualFunc) loadable_icon_key_equal,
-                                       (GDestroyNotify) loadable_icon_key_free,
-                                       (GDestroyNotify) g_object_unref);
-        }
+        pixbuf = gdk_pixbuf_new_from_stream_at_scale (stream,
+                                                      size * scale, size * scale,
+                                                      TRUE,
+                                                      NULL, NULL);
+        g_input_stream_close (stream, NULL, NULL);
+        g_object_unref (stream);
+    }
 
-        lookup_key.icon = icon;
-        lookup_key.size = size;
+    icon_info = nautilus_icon_info_new_for_pixbuf (pixbuf, scale);
 
-        icon_info = g_hash_table_lookup (loadable_icon_cache, &lookup_key);
-        if (icon_info)
-        {
-            return g_object_ref (icon_info);
-        }
-
-        pixbuf = NULL;
-        stream = g_loadable_icon_load (G_LOADABLE_ICON (icon),
-                                       size * scale,
-                                       NULL, NULL, NULL);
-        if (stream)
-        {
-            pixbuf = gdk_pixbuf_new_from_stream_at_scale (stream,
-                                                          size * scale, size * scale,
-                                                          TRUE,
-                                                          NULL, NULL);
-            g_input_stream_close (stream, NULL, NULL);
-            g_object_unref (stream);
-        }
+    if (pixbuf != NULL)
+    {
+        g_object_unref (pixbuf);
+    }
 
-        icon_info = nautilus_icon_info_new_for_pixbuf (pixbuf, scale);
+    return icon_info;
+}
 
-        key = loadable_icon_key_new (icon, size);
-        g_hash_table_insert (loadable_icon_cache, key, icon_info);
+static NautilusIconInfo *
+lookup_gicon (GIcon *icon,
+              int    size,
+              int    scale)
+{
+    NautilusIconInfo *icon_info;
+    GtkIconInfo *gtk_icon_info;
+    GdkPixbuf *pixbuf;
 
-        return g_object_ref (icon_info);
+    gtk_icon_info = gtk_icon_theme_lookup_by_gicon_for_scale (gtk_icon_theme_get_default (),
+                                                              icon,
+                                                              size,
+                                                              scale,
+                                                              GTK_ICON_LOOKUP_FORCE_SIZE);
+    if (gtk_icon_info != NULL)
+    {
+        pixbuf = gtk_icon_info_load_icon (gtk_icon_info, NULL);
+        g_object_unref (gtk_icon_info);
     }
-    else if (G_IS_THEMED_ICON (icon))
+    else
     {
-        const char * const *names;
-        ThemedIconKey lookup_key;
-        ThemedIconKey *key;
-        GtkIconTheme *icon_theme;
-        GtkIconInfo *gtkicon_info;
-        const char *filename;
-
-        if (themed_icon_cache == NULL)
-        {
-            themed_icon_cache =
-                g_hash_table_new_full ((GHashFunc) themed_icon_key_hash,
-                                       (GEqualFunc) themed_icon_key_equal,
-                                       (GDestroyNotify) themed_icon_key_free,
-                                       (GDestroyNotify) g_object_unref);
-        }
+        pixbuf = NULL;
+    }
 
-        names = g_themed_icon_get_names (G_THEMED_ICON (icon));
+    icon_info = nautilus_icon_info_new_for_pixbuf (pixbuf, scale);
 
-        icon_theme = gtk_icon_theme_get_default ();
-        gtkicon_info = gtk_icon_theme_choose_icon_for_scale (icon_theme, (const char **) names,
-                                                             size, scale, GTK_ICON_LOOKUP_FORCE_SIZE);
+    if (pixbuf != NULL)
+    {
+        g_object_unref (pixbuf);
+    }
 
-        if (gtkicon_info == NULL)
-        {
-            return nautilus_icon_info_new_for_pixbuf (NULL, scale);
-        }
+    return icon_info;
+}
 
-        filename = gtk_icon_info_get_filename (gtkicon_info);
-        if (filename == NULL)
-        {
-            g_object_unref (gtkicon_info);
-            return nautilus_icon_info_new_for_pixbuf (NULL, scale);
-        }
+NautilusIconInfo *
+nautilus_icon_info_lookup (GIcon *icon,
+                           int    size,
+                           int    scale)
+{
+    NautilusIconInfo *icon_info;
+    gboolean cacheable;
 
-        lookup_key.filename = (char *) filename;
-        lookup_key.size = size;
+    ensure_icon_caches ();
 
-        icon_info = g_hash_table_lookup (themed_icon_cache, &lookup_key);
-        if (icon_info)
+    cacheable = icon_is_cacheable (icon);
+    if (cacheable)
+    {
+        icon_info = icon_cache_lookup (icon_cache, icon, NULL, size, scale);
+        if (icon_info != NULL)
         {
-            g_object_unref (gtkicon_info);
-            return g_object_ref (icon_info);
+            return icon_info;
         }
+    }
 
-        icon_info = nautilus_icon_info_new_for_icon_info (gtkicon_info, scale);
-
-        key = themed_icon_key_new (filename, size);
-        g_hash_table_insert (themed_icon_cache, key, icon_info);
-
-        g_object_unref (gtkicon_info);
-
-        return g_object_ref (icon_info);
+    if (G_IS_LOADABLE_ICON (icon))
+    {
+        icon_info = lookup_loadable_icon (icon, size, scale);
+    }
+    else if (G_IS_THEMED_ICON (icon))
+    {
+        icon_info = lookup_themed_icon (icon, size, scale);
     }
     else
     {
-        GdkPixbuf *pixbuf;
-        GtkIconInfo *gtk_icon_info;
-
-        gtk_icon_info = gtk_icon_theme_lookup_by_gicon_for_scale (gtk_icon_theme_get_default (),
-                                                                  icon,
-                                                                  size,
-                                                                  scale,
-                                                                  GTK_ICON_LOOKUP_FORCE_SIZE);
-        if (gtk_icon_info != NULL)
-        {
-            pixbuf = gtk_icon_info_load_icon (gtk_icon_info, NULL);
-            g_object_unref (gtk_icon_info);
-        }
-        else
-        {
-            pixbuf = NULL;
-        }
-
-        icon_info = nautilus_icon_info_new_for_pixbuf (pixbuf, scale);
-
-        if (pixbuf != NULL)
-        {
-            g_object_unref (pixbuf);
-        }
+        icon_info = lookup_gicon (icon, size, scale);
+    }
 
-        return icon_info;
+    if (cacheable)
+    {
+        icon_cache_insert (icon_cache, icon, NULL, size, scale, icon_info);
     }
+
+    return icon_info;
 }
 
 NautilusIconInfo *
@@ -513,14 +579,6 @@ nautilus_icon_info_get_pixbuf_nodefault (NautilusIconInfo *icon)
     else
     {
         res = g_object_ref (icon->pixbuf);
-
-        if (icon->sole_owner)
-        {
-            icon->sole_owner = FALSE;
-            g_object_add_toggle_ref (G_OBJECT (res),
-                                     pixbuf_toggle_notify,
-                                     icon);
-        }
     }
 
     return res;
@@ -32,22 +32,157 @@
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <errno.h>
 #include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Changes are not saved by rewriting the keyfile. Each one is appended
+ * as a record to "<keyfile>.journal" before it is applied, and the
+ * keyfile itself is only rewritten once enough records have piled up,
+ * once changes stop coming for a while, or at shutdown. Loading replays the journal on top of the keyfile; records are
+ * absolute values, so replaying one that already made it into the
+ * keyfile is harmless.
+ *
+ * A record is one line of tab separated, g_strescape()d fields:
+ *   s <group> <key> <value>
+ *   l <group> <key> <value>...
+ */
+#define JOURNAL_SUFFIX ".journal"
+#define JOURNAL_COMPACT_RECORDS 1024
+#define JOURNAL_COMPACT_DELAY_SECS 30
 
 typedef struct
 {
     GKeyFile *keyfile;
     guint save_in_idle_id;
+    guint compact_timeout_id;
+
+    int journal_fd;
+    guint journal_records;
 } KeyfileMetadataData;
 
 static GHashTable *data_hash = NULL;
 
+#define STRV_TERMINATOR "@x-nautilus-desktop-metadata-term@"
+
+static void
+keyfile_set_stringv (GKeyFile           *keyfile,
+                     const char         *name,
+                     const char         *key,
+                     const char * const *stringv)
+{
+    guint length;
+    const gchar *single_stringv[3];
+
+    /* if we would be setting a single-length strv, append a fake
+     * terminator to the array, to be able to differentiate it later from
+     * the single string case
+     */
+    length = g_strv_length ((gchar **) stringv);
+
+    if (length == 1)
+    {
+        single_stringv[0] = stringv[0];
+        single_stringv[1] = STRV_TERMINATOR;
+        single_stringv[2] = NULL;
+
+        g_key_file_set_string_list (keyfile, name, key, single_stringv, 2);
+    }
+    else
+    {
+        g_key_file_set_string_list (keyfile, name, key,
+                                    (const gchar **) stringv, length);
+    }
+}
+
+static char *
+get_journal_filename (const char *keyfile_filename)
+{
+    return g_strconcat (keyfile_filename, JOURNAL_SUFFIX, NULL);
+}
+
+static void
+journal_replay_record (GKeyFile *keyfile,
+                       char     *record)
+{
+    char **fields;
+    guint n_fields, i;
+
+    fields = g_strsplit (record, "\t", -1);
+    n_fields = g_strv_length (fields);
+
+    if (n_fields < 3)
+    {
+        g_strfreev (fields);
+        return;
+    }
+
+    for (i = 1; i < n_fields; i++)
+    {
+        char *field;
+
+        field = g_strcompress (fields[i]);
+        g_free (fields[i]);
+        fields[i] = field;
+    }
+
+    if (strcmp (fields[0], "s") == 0 && n_fields == 4)
+    {
+        g_key_file_set_string (keyfile, fields[1], fields[2], fields[3]);
+    }
+    else if (strcmp (fields[0], "l") == 0)
+    {
+        keyfile_set_stringv (keyfile, fields[1], fields[2],
+                             (const char * const *) fields + 3);
+    }
+
+    g_strfreev (fields);
+}
+
+static guint
+journal_replay (GKeyFile   *keyfile,
+                const char *journal_filename,
+                gsize      *complete_length)
+{
+    char *contents;
+    char *record, *end;
+    gsize length;
+    guint n_records;
+
+    *complete_length = 0;
+
+    if (!g_file_get_contents (journal_filename, &contents, &length, NULL))
+    {
+        return 0;
+    }
+
+    n_records = 0;
+    record = contents;
+
+    /* A record without its newline was cut short by a crash; skip it */
+    while ((end = memchr (record, '\n', contents + length - record)) != NULL)
+    {
+        *end = '\0';
+        journal_replay_record (keyfile, record);
+        n_records++;
+        record = end + 1;
+    }
+
+    *complete_length = record - contents;
+    g_free (contents);
+
+    return n_records;
+}
+
 static KeyfileMetadataData *
 keyfile_metadata_data_new (const char *keyfile_filename)
 {
     KeyfileMetadataData *data;
     GKeyFile *retval;
     GError *error = NULL;
+    char *journal_filename;
+    gsize complete_length;
 
     retval = g_key_file_new ();
 
@@ -72,6 +207,21 @@ keyfile_metadata_data_new (const char *keyfile_filename)
     data = g_slice_new0 (KeyfileMetadataData);
     data->keyfile = retval;
 
+    journal_filename = get_journal_filename (keyfile_filename);
+    data->journal_records = journal_replay (retval, journal_filename, &complete_length);
+    data->journal_fd = g_open (journal_filename,
+                               O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC,
+                               0666);
+    g_free (journal_filename);
+
+    /* Drop a torn record so that new ones don't get glued onto it */
+    if (data->journal_fd != -1 &&
+        ftruncate (data->journal_fd, complete_length) != 0)
+    {
+        close (data->journal_fd);
+        data->journal_fd = -1;
+    }
+
     return data;
 }
 
@@ -85,11 +235,21 @@ keyfile_metadata_data_free (KeyfileMetadataData *data)
         g_source_remove (data->save_in_idle_id);
     }
 
+    if (data->compact_timeout_id != 0)
+    {
+        g_source_remove (data->compact_timeout_id);
+    }
+
+    if (data->journal_fd != -1)
+    {
+        close (data->journal_fd);
+    }
+
     g_slice_free (KeyfileMetadataData, data);
 }
 
-static GKeyFile *
-get_keyfile (const char *keyfile_filename)
+static KeyfileMetadataData *
+get_keyfile_data (const char *keyfile_filename)
 {
     KeyfileMetadataData *data;
 
@@ -112,19 +272,102 @@ get_keyfile (const char *keyfile_filename)
                              data);
     }
 
-    return data->keyfile;
+    return data;
+}
+
+static GKeyFile *
+get_keyfile (const char *keyfile_filename)
+{
+    return get_keyfile_data (keyfile_filename)->keyfile;
+}
+
+static void
+journal_append_field (GString    *record,
+                      const char *field)
+{
+    char *escaped;
+
+    escaped = g_strescape (field, NULL);
+    g_string_append_c (record, '\t');
+    g_string_append (record, escaped);
+    g_free (escaped);
 }
 
+/* Returns FALSE if the record could not be written, in which case the
+ * change only becomes durable with the next full save. */
 static gboolean
-save_in_idle_cb (const gchar *keyfile_filename)
+journal_append (KeyfileMetadataData *data,
+                char                 kind,
+                const char          *name,
+                const char          *key,
+                const char * const  *values)
+{
+    GString *record;
+    const char *p;
+    gssize written;
+    gsize left;
+    gint i;
+
+    if (data->journal_fd == -1)
+    {
+        return FALSE;
+    }
+
+    record = g_string_new (NULL);
+    g_string_append_c (record, kind);
+    journal_append_field (record, name);
+    journal_append_field (record, key);
+    for (i = 0; values[i] != NULL; i++)
+    {
+        journal_append_field (record, values[i]);
+    }
+    g_string_append_c (record, '\n');
+
+    p = record->str;
+    left = record->len;
+    while (left > 0)
+    {
+        written = write (data->journal_fd, p, left);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            break;
+        }
+        p += written;
+        left -= written;
+    }
+
+    g_string_free (record, TRUE);
+
+    if (left > 0)
+    {
+        /* Don't leave half a record behind for later ones to follow */
+        close (data->journal_fd);
+        data->journal_fd = -1;
+        return FALSE;
+    }
+
+    data->journal_records++;
+
+    return TRUE;
+}
+
+static gboolean
+keyfile_metadata_compact (const char          *keyfile_filename,
+                          KeyfileMetadataData *data)
 {
-    KeyfileMetadataData *data;
     gchar *contents;
     gsize length;
     GError *error = NULL;
 
-    data = g_hash_table_lookup (data_hash, keyfile_filename);
-    data->save_in_idle_id = 0;
+    if (data->compact_timeout_id != 0)
+    {
+        g_source_remove (data->compact_timeout_id);
+        data->compact_timeout_id = 0;
+    }
 
     contents = g_key_file_to_data (data->keyfile, &length, NULL);
 
@@ -141,6 +384,59 @@ save_in_idle_cb (const gchar *keyfile_filename)
         g_warning ("Couldn't save the desktop metadata keyfile to disk: %s",
                    error->message);
         g_error_free (error);
+        return FALSE;
+    }
+
+    /* Everything in the journal is in the keyfile now */
+    if (data->journal_fd != -1 &&
+        ftruncate (data->journal_fd, 0) == 0)
+    {
+        data->journal_records = 0;
+    }
+
+    return TRUE;
+}
+
+static gboolean
+compact_timeout_cb (const gchar *keyfile_filename)
+{
+    KeyfileMetadataData *data;
+
+    data = g_hash_table_lookup (data_hash, keyfile_filename);
+    data->compact_timeout_id = 0;
+
+    keyfile_metadata_compact (keyfile_filename, data);
+
+    return FALSE;
+}
+
+static gboolean
+save_in_idle_cb (const gchar *keyfile_filename)
+{
+    KeyfileMetadataData *data;
+
+    data = g_hash_table_lookup (data_hash, keyfile_filename);
+    data->save_in_idle_id = 0;
+
+    if (data->journal_fd == -1 ||
+        data->journal_records >= JOURNAL_COMPACT_RECORDS)
+    {
+        keyfile_metadata_compact (keyfile_filename, data);
+    }
+    else
+    {
+        fsync (data->journal_fd);
+
+        /* Fold the journal in once the changes stop coming */
+        if (data->compact_timeout_id != 0)
+        {
+            g_source_remove (data->compact_timeout_id);
+        }
+        data->compact_timeout_id = g_timeout_add_seconds_full (G_PRIORITY_DEFAULT_IDLE,
+                                                               JOURNAL_COMPACT_DELAY_SECS,
+                                                               (GSourceFunc) compact_timeout_cb,
+                                                               g_strdup (keyfile_filename),
+                                                               g_free);
     }
 
     return FALSE;
@@ -167,6 +463,33 @@ save_in_idle (const char *keyfile_filename)
                                              g_free);
 }
 
+/* Folds every journal into its keyfile and forgets the loaded keyfiles,
+ * so the next session starts from rewritten keyfiles. */
+void
+nautilus_keyfile_metadata_shutdown (void)
+{
+    GHashTableIter iter;
+    gpointer key, value;
+    KeyfileMetadataData *data;
+
+    if (data_hash == NULL)
+    {
+        return;
+    }
+
+    g_hash_table_iter_init (&iter, data_hash);
+    while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+        data = value;
+        if (data->journal_records > 0 || data->journal_fd == -1)
+        {
+            keyfile_metadata_compact (key, data);
+        }
+    }
+
+    g_clear_pointer (&data_hash, g_hash_table_destroy);
+}
+
 void
 nautilus_keyfile_metadata_set_string (NautilusFile *file,
                                       const char   *keyfile_filename,
@@ -174,11 +497,16 @@ nautilus_keyfile_metadata_set_string (NautilusFile *file,
                                       const gchar  *key,
                                       const gchar  *string)
 {
-    GKeyFile *keyfile;
+    KeyfileMetadataData *data;
+    const char *values[2] = { string, NULL };
 
-    keyfile = get_keyfile (keyfile_filename);
+    g_return_if_fail (string != NULL);
+
+    data = get_keyfile_data (keyfile_filename);
 
-    g_key_file_set_string (keyfile,
+    journal_append (data, 's', name, key, values);
+
+    g_key_file_set_string (data->keyfile,
                            name,
                            key,
                            string);
@@ -191,8 +519,6 @@ nautilus_keyfile_metadata_set_string (NautilusFile *file,
     }
 }
 
-#define STRV_TERMINATOR "@x-nautilus-desktop-metadata-term@"
-
 void
 nautilus_keyfile_metadata_set_stringv (NautilusFile       *file,
                                        const char         *keyfile_filename,
@@ -200,39 +526,13 @@ nautilus_keyfile_metadata_set_stringv (NautilusFile       *file,
                                        const char         *key,
                                        const char * const *stringv)
 {
-    GKeyFile *keyfile;
-    guint length;
-    gchar **actual_stringv = NULL;
-    gboolean free_strv = FALSE;
-
-    keyfile = get_keyfile (keyfile_filename);
-
-    /* if we would be setting a single-length strv, append a fake
-     * terminator to the array, to be able to differentiate it later from
-     * the single string case
-     */
-    length = g_strv_length ((gchar **) stringv);
+    KeyfileMetadataData *data;
 
-    if (length == 1)
-    {
-        actual_stringv = g_malloc0 (3 * sizeof (gchar *));
-        actual_stringv[0] = (gchar *) stringv[0];
-        actual_stringv[1] = STRV_TERMINATOR;
-        actual_stringv[2] = NULL;
+    data = get_keyfile_data (keyfile_filename);
 
-        length = 2;
-        free_strv = TRUE;
-    }
-    else
-    {
-        actual_stringv = (gchar **) stringv;
-    }
+    journal_append (data, 'l', name, key, stringv);
 
-    g_key_file_set_string_list (keyfile,
-                                name,
-                                key,
-                                (const gchar **) actual_stringv,
-                                length);
+    keyfile_set_stringv (data->keyfile, name, key, stringv);
 
     save_in_idle (keyfile_filename);
 
@@ -240,11 +540,6 @@ nautilus_keyfile_metadata_set_stringv (NautilusFile       *file,
     {
         nautilus_file_changed (file);
     }
-
-    if (free_strv)
-    {
-        g_free (actual_stringv);
-    }
 }
 
 gboolean
@@ -43,4 +43,6 @@ gboolean nautilus_keyfile_metadata_update_from_keyfile (NautilusFile *file,
                                                         const char *keyfile_filename,
                                                         const gchar *name);
 
+void nautilus_keyfile_metadata_shutdown (void);
+
 #endif /* __NAUTILUS_KEYFILE_METADATA_H__ */
@@ -54,7 +54,7 @@ drag_data_get_callback (GtkWidget        *widget,
         return;
     }
 
-    nautilus_drag_drag_data_get_from_cache (list_view->details->drag_source_info->selection_cache,
+    nautilus_drag_drag_data_get_from_cache (list_view->details->drag_source_info,
                                             context, selection_data, info, time);
 }
 
@@ -194,6 +194,7 @@ drag_begin_callback (GtkWidget        *widget,
 
     view->details->drag_source_info->selection_cache = nautilus_drag_create_selection_cache (view,
                                                                                              each_item_get_data_binder);
+    view->details->drag_source_info->selection_cache_context = context;
 
     nautilus_window_start_dnd (window, context);
 }
@@ -215,8 +216,7 @@ drag_end_callback (GtkWidget        *widget,
 static void
 drag_info_data_free (NautilusListView *list_view)
 {
-    nautilus_drag_destroy_selection_list (list_view->details->drag_source_info->selection_cache);
-    list_view->details->drag_source_info->selection_cache = NULL;
+    nautilus_drag_clear_selection_cache (list_view->details->drag_source_info);
 
     g_free (list_view->details->drag_source_info);
     list_view->details->drag_source_info = NULL;
@@ -47,11 +47,13 @@
 #include "nautilus-column-chooser.h"
 #include "nautilus-column-utilities.h"
 #include "nautilus-dnd.h"
+#include "nautilus-directory-prefetch.h"
 #include "nautilus-file-utilities.h"
 #include "nautilus-ui-utilities.h"
 #include "nautilus-global-preferences.h"
 #include "nautilus-metadata.h"
 #include "nautilus-module.h"
+#include "nautilus-signaller.h"
 #include "nautilus-tree-view-drag-dest.h"
 #include "nautilus-clipboard.h"
 
@@ -333,6 +335,20 @@ nautilus_list_view_did_not_drag (NautilusListView *view,
     }
 }
 
+static void
+prefetch_hovered_file (NautilusListView *view)
+{
+    NautilusFile *file;
+
+    file = nautilus_list_model_file_for_path (view->details->model,
+                                              view->details->hover_path);
+    if (file != NULL)
+    {
+        nautilus_directory_prefetch_file (file);
+        nautilus_file_unref (file);
+    }
+}
+
 static gboolean
 motion_notify_callback (GtkWidget      *widget,
                         GdkEventMotion *event,
@@ -370,6 +386,14 @@ motion_notify_callback (GtkWidget      *widget,
             }
         }
 
+        /* With single click a hovered folder is one click away */
+        if (view->details->hover_path != NULL &&
+            (old_hover_path == NULL ||
+             gtk_tree_path_compare (old_hover_path, view->details->hover_path) != 0))
+        {
+            prefetch_hovered_file (view);
+        }
+
         if (old_hover_path != NULL)
         {
             gtk_tree_path_free (old_hover_path);
@@ -1807,10 +1831,146 @@ get_icon_scale_callback (NautilusListModel *model,
 }
 
 static void
-create_and_set_up_tree_view (NautilusListView *view)
+add_column (NautilusListView *view,
+            NautilusColumn   *nautilus_column)
 {
     GtkCellRenderer *cell;
     GtkTreeViewColumn *column;
+    int column_num;
+    char *name;
+    char *label;
+    float xalign;
+    GtkSortType sort_order;
+
+    g_object_get (nautilus_column,
+                  "name", &name,
+                  "label", &label,
+                  "xalign", &xalign,
+                  "default-sort-order", &sort_order,
+                  NULL);
+
+    column_num = nautilus_list_model_add_column (view->details->model,
+                                                 nautilus_column);
+
+    /* Created the name column specially, because it
+     * has the icon in it.*/
+    if (!strcmp (name, "name"))
+    {
+        /* Create the file name column */
+        view->details->file_name_column = gtk_tree_view_column_new ();
+        gtk_tree_view_append_column (view->details->tree_view,
+                                     view->details->file_name_column);
+        view->details->file_name_column_num = column_num;
+
+        g_hash_table_insert (view->details->columns,
+                             g_strdup ("name"),
+                             view->details->file_name_column);
+
+        g_signal_connect (gtk_tree_view_column_get_button (view->details->file_name_column),
+                          "button-press-event",
+                          G_CALLBACK (column_header_clicked),
+                          view);
+
+        gtk_tree_view_set_search_column (view->details->tree_view, column_num);
+
+        gtk_tree_view_column_set_sort_column_id (view->details->file_name_column, column_num);
+        gtk_tree_view_column_set_title (view->details->file_name_column, _("Name"));
+        gtk_tree_view_column_set_resizable (view->details->file_name_column, TRUE);
+        gtk_tree_view_column_set_expand (view->details->file_name_column, TRUE);
+
+        /* Initial padding */
+        cell = gtk_cell_renderer_text_new ();
+        gtk_tree_view_column_pack_start (view->details->file_name_column, cell, FALSE);
+        g_object_set (cell, "xpad", 6, NULL);
+        g_settings_bind (nautilus_list_view_preferences, NAUTILUS_PREFERENCES_LIST_VIEW_USE_TREE,
+                         cell, "visible",
+                         G_SETTINGS_BIND_INVERT_BOOLEAN | G_SETTINGS_BIND_GET);
+
+        /* File icon */
+        cell = gtk_cell_renderer_pixbuf_new ();
+        view->details->pixbuf_cell = (GtkCellRendererPixbuf *) cell;
+        set_up_pixbuf_size (view);
+
+        gtk_tree_view_column_pack_start (view->details->file_name_column, cell, FALSE);
+        gtk_tree_view_column_set_attributes (view->details->file_name_column,
+                                             cell,
+                                             "surface", nautilus_list_model_get_column_id_from_zoom_level (view->details->zoom_level),
+                                             NULL);
+
+        cell = gtk_cell_renderer_text_new ();
+        view->details->file_name_cell = (GtkCellRendererText *) cell;
+        g_object_set (cell,
+                      "ellipsize", PANGO_ELLIPSIZE_END,
+                      "single-paragraph-mode", TRUE,
+                      "width-chars", 30,
+                      "xpad", 5,
+                      NULL);
+
+        gtk_tree_view_column_pack_start (view->details->file_name_column, cell, TRUE);
+        gtk_tree_view_column_set_cell_data_func (view->details->file_name_column, cell,
+                                                 (GtkTreeCellDataFunc) filename_cell_data_func,
+                                                 view, NULL);
+    }
+    else
+    {
+        /* We need to use libgd */
+        cell = gd_styled_text_renderer_new ();
+        /* FIXME: should be just dim-label.
+         * See https://bugzilla.gnome.org/show_bug.cgi?id=744397
+         */
+        gd_styled_text_renderer_add_class (GD_STYLED_TEXT_RENDERER (cell),
+                                           "nautilus-list-dim-label");
+
+        g_object_set (cell,
+                      "xalign", xalign,
+                      "xpad", 5,
+                      NULL);
+        if (!strcmp (name, "permissions"))
+        {
+            g_object_set (cell,
+                          "family", "Monospace",
+                          NULL);
+        }
+        view->details->cells = g_list_append (view->details->cells,
+                                              cell);
+        column = gtk_tree_view_column_new_with_attributes (label,
+                                                           cell,
+                                                           "text", column_num,
+                                                           NULL);
+        gtk_tree_view_append_column (view->details->tree_view, column);
+        gtk_tree_view_column_set_sort_column_id (column, column_num);
+        g_hash_table_insert (view->details->columns,
+                             g_strdup (name),
+                             column);
+
+        g_signal_connect (gtk_tree_view_column_get_button (column),
+                          "button-press-event",
+                          G_CALLBACK (column_header_clicked),
+                          view);
+
+        gtk_tree_view_column_set_resizable (column, TRUE);
+        gtk_tree_view_column_set_sort_order (column, sort_order);
+
+        if (!strcmp (name, "where"))
+        {
+            gtk_tree_view_column_set_cell_data_func (column, cell,
+                                                     (GtkTreeCellDataFunc) where_cell_data_func,
+                                                     view, NULL);
+        }
+        else if (!strcmp (name, "trash_orig_path"))
+        {
+            gtk_tree_view_column_set_cell_data_func (column, cell,
+                                                     (GtkTreeCellDataFunc) trash_orig_path_cell_data_func,
+                                                     view, NULL);
+        }
+    }
+    g_free (name);
+    g_free (label);
+}
+
+static void
+create_and_set_up_tree_view (NautilusListView *view)
+{
     AtkObject *atk_obj;
     GList *nautilus_columns;
     GList *l;
@@ -1903,139 +2063,7 @@ create_and_set_up_tree_view (NautilusListView *view)
 
     for (l = nautilus_columns; l != NULL; l = l->next)
     {
-        NautilusColumn *nautilus_column;
-        int column_num;
-        char *name;
-        char *label;
-        float xalign;
-        GtkSortType sort_order;
-
-        nautilus_column = NAUTILUS_COLUMN (l->data);
-
-        g_object_get (nautilus_column,
-                      "name", &name,
-                      "label", &label,
-                      "xalign", &xalign,
-                      "default-sort-order", &sort_order,
-                      NULL);
-
-        column_num = nautilus_list_model_add_column (view->details->model,
-                                                     nautilus_column);
-
-        /* Created the name column specially, because it
-         * has the icon in it.*/
-        if (!strcmp (name, "name"))
-        {
-            /* Create the file name column */
-            view->details->file_name_column = gtk_tree_view_column_new ();
-            gtk_tree_view_append_column (view->details->tree_view,
-                                         view->details->file_name_column);
-            view->details->file_name_column_num = column_num;
-
-            g_hash_table_insert (view->details->columns,
-                                 g_strdup ("name"),
-                                 view->details->file_name_column);
-
-            g_signal_connect (gtk_tree_view_column_get_button (view->details->file_name_column),
-                              "button-press-event",
-                              G_CALLBACK (column_header_clicked),
-                              view);
-
-            gtk_tree_view_set_search_column (view->details->tree_view, column_num);
-
-            gtk_tree_view_column_set_sort_column_id (view->details->file_name_column, column_num);
-            gtk_tree_view_column_set_title (view->details->file_name_column, _("Name"));
-            gtk_tree_view_column_set_resizable (view->details->file_name_column, TRUE);
-            gtk_tree_view_column_set_expand (view->details->file_name_column, TRUE);
-
-            /* Initial padding */
-            cell = gtk_cell_renderer_text_new ();
-            gtk_tree_view_column_pack_start (view->details->file_name_column, cell, FALSE);
-            g_object_set (cell, "xpad", 6, NULL);
-            g_settings_bind (nautilus_list_view_preferences, NAUTILUS_PREFERENCES_LIST_VIEW_USE_TREE,
-                             cell, "visible",
-                             G_SETTINGS_BIND_INVERT_BOOLEAN | G_SETTINGS_BIND_GET);
-
-            /* File icon */
-            cell = gtk_cell_renderer_pixbuf_new ();
-            view->details->pixbuf_cell = (GtkCellRendererPixbuf *) cell;
-            set_up_pixbuf_size (view);
-
-            gtk_tree_view_column_pack_start (view->details->file_name_column, cell, FALSE);
-            gtk_tree_view_column_set_attributes (view->details->file_name_column,
-                                                 cell,
-                                                 "surface", nautilus_list_model_get_column_id_from_zoom_level (view->details->zoom_level),
-                                                 NULL);
-
-            cell = gtk_cell_renderer_text_new ();
-            view->details->file_name_cell = (GtkCellRendererText *) cell;
-            g_object_set (cell,
-                          "ellipsize", PANGO_ELLIPSIZE_END,
-                          "single-paragraph-mode", TRUE,
-                          "width-chars", 30,
-                          "xpad", 5,
-                          NULL);
-
-            gtk_tree_view_column_pack_start (view->details->file_name_column, cell, TRUE);
-            gtk_tree_view_column_set_cell_data_func (view->details->file_name_column, cell,
-                                                     (GtkTreeCellDataFunc) filename_cell_data_func,
-                                                     view, NULL);
-        }
-        else
-        {
-            /* We need to use libgd */
-            cell = gd_styled_text_renderer_new ();
-            /* FIXME: should be just dim-label.
-             * See https://bugzilla.gnome.org/show_bug.cgi?id=744397
-             */
-            gd_styled_text_renderer_add_class (GD_STYLED_TEXT_RENDERER (cell),
-                                               "nautilus-list-dim-label");
-
-            g_object_set (cell,
-                          "xalign", xalign,
-                          "xpad", 5,
-                          NULL);
-            if (!strcmp (name, "permissions"))
-            {
-                g_object_set (cell,
-                              "family", "Monospace",
-                              NULL);
-            }
-            view->details->cells = g_list_append (view->details->cells,
-                                                  cell);
-            column = gtk_tree_view_column_new_with_attributes (label,
-                                                               cell,
-                                                               "text", column_num,
-                                                               NULL);
-            gtk_tree_view_append_column (view->details->tree_view, column);
-            gtk_tree_view_column_set_sort_column_id (column, column_num);
-            g_hash_table_insert (view->details->columns,
-                                 g_strdup (name),
-                                 column);
-
-            g_signal_connect (gtk_tree_view_column_get_button (column),
-                              "button-press-event",
-                              G_CALLBACK (column_header_clicked),
-                              view);
-
-            gtk_tree_view_column_set_resizable (column, TRUE);
-            gtk_tree_view_column_set_sort_order (column, sort_order);
-
-            if (!strcmp (name, "where"))
-            {
-                gtk_tree_view_column_set_cell_data_func (column, cell,
-                                                         (GtkTreeCellDataFunc) where_cell_data_func,
-                                                         view, NULL);
-            }
-            else if (!strcmp (name, "trash_orig_path"))
-            {
-                gtk_tree_view_column_set_cell_data_func (column, cell,
-                                                         (GtkTreeCellDataFunc) trash_orig_path_cell_data_func,
-                                                         view, NULL);
-            }
-        }
-        g_free (name);
-        g_free (label);
+        add_column (view, NAUTILUS_COLUMN (l->data));
     }
     nautilus_column_list_free (nautilus_columns);
 
@@ -3194,6 +3222,29 @@ default_column_order_changed_callback (gpointer callback_data)
     set_columns_settings_from_metadata_and_preferences (list_view);
 }
 
+/* Column providers that were still being loaded when the tree view was
+ * set up get their columns now */
+static void
+extensions_loaded_callback (NautilusListView *list_view)
+{
+    GList *nautilus_columns, *l;
+    char *name;
+
+    nautilus_columns = nautilus_get_all_columns ();
+    for (l = nautilus_columns; l != NULL; l = l->next)
+    {
+        g_object_get (l->data, "name", &name, NULL);
+        if (g_hash_table_lookup (list_view->details->columns, name) == NULL)
+        {
+            add_column (list_view, NAUTILUS_COLUMN (l->data));
+        }
+        g_free (name);
+    }
+    nautilus_column_list_free (nautilus_columns);
+
+    set_columns_settings_from_metadata_and_preferences (list_view);
+}
+
 static void
 nautilus_list_view_sort_directories_first_changed (NautilusFilesView *view)
 {
@@ -3416,6 +3467,19 @@ on_clipboard_contents_received (GtkClipboard     *clipboard,
 static void
 update_clipboard_status (NautilusListView *view)
 {
+    GList *files;
+    gboolean cut;
+
+    /* Files cut in this process are already at hand */
+    if (nautilus_clipboard_get_own_contents (nautilus_clipboard_get (GTK_WIDGET (view)),
+                                             &cut, &files, NULL))
+    {
+        nautilus_list_model_set_highlight_for_files (view->details->model,
+                                                     cut ? files : NULL);
+        nautilus_file_list_free (files);
+        return;
+    }
+
     g_object_ref (view);     /* Need to keep the object alive until we get the reply */
     gtk_clipboard_request_contents (nautilus_clipboard_get (GTK_WIDGET (view)),
                                     nautilus_clipboard_get_atom (),
@@ -3559,6 +3623,9 @@ nautilus_list_view_init (NautilusListView *list_view)
                               "changed::" NAUTILUS_PREFERENCES_LIST_VIEW_DEFAULT_COLUMN_ORDER,
                               G_CALLBACK (default_column_order_changed_callback),
                               list_view);
+    g_signal_connect_object (nautilus_signaller_get_current (), "extensions-loaded",
+                             G_CALLBACK (extensions_loaded_callback), list_view,
+                             G_CONNECT_SWAPPED);
 
     /* React to clipboard changes */
     clipboard = gtk_clipboard_get (GDK_SELECTION_CLIPBOARD);
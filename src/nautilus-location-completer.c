@@ -0,0 +1,572 @@
+/*
+ * nautilus-location-completer: completes folder names in the location entry
+ *
+ * Nautilus is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * Nautilus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <config.h>
+
+#include "nautilus-location-completer.h"
+
+#include "nautilus-directory-private.h"
+#include "nautilus-file.h"
+
+#include <string.h>
+
+/* Directories whose names are kept, most recently used first */
+#define MAX_INDEXES 4
+/* Names that nothing keeps up to date, because they were read here or
+ * nobody is monitoring their directory any more, are only trusted for a
+ * while */
+#define ENUMERATED_INDEX_LIFETIME (10 * G_USEC_PER_SEC)
+#define ENUMERATE_BATCH_SIZE 100
+
+typedef struct
+{
+    GFile *location;
+    /* Sorted by strcmp(), so the names starting with a given prefix are
+     * next to each other */
+    GPtrArray *names;
+    /* The loaded directory the names were taken from, if any, and not
+     * reffed. While someone monitors it, its signals tell when the names
+     * need taking again. */
+    NautilusDirectory *directory;
+    gboolean stale;
+    gint64 read_time;
+} NameIndex;
+
+struct _NautilusLocationCompleter
+{
+    GObject parent_instance;
+
+    GList *indexes;
+
+    /* Reading a directory that nobody has loaded */
+    GFile *enumerating;
+    GCancellable *cancellable;
+    GPtrArray *enumerated_names;
+};
+
+enum
+{
+    GOT_COMPLETION_DATA,
+    LAST_SIGNAL
+};
+
+static guint signals[LAST_SIGNAL];
+
+G_DEFINE_TYPE (NautilusLocationCompleter, nautilus_location_completer, G_TYPE_OBJECT)
+
+static gint
+compare_names (gconstpointer a,
+               gconstpointer b)
+{
+    return strcmp (*(const char **) a, *(const char **) b);
+}
+
+/* The first name at or after @start that doesn't come before @prefix, or
+ * with @past_prefix, the first one that doesn't start with it either */
+static guint
+name_index_search (NameIndex  *index,
+                   const char *prefix,
+                   guint       start,
+                   gboolean    past_prefix)
+{
+    guint low, high, middle;
+    const char *name;
+    gboolean before;
+
+    low = start;
+    high = index->names->len;
+    while (low < high)
+    {
+        middle = low + (high - low) / 2;
+        name = g_ptr_array_index (index->names, middle);
+
+        before = past_prefix ? g_str_has_prefix (name, prefix) : strcmp (name, prefix) < 0;
+        if (before)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    return low;
+}
+
+static gboolean
+name_index_contains (NameIndex  *index,
+                     const char *name)
+{
+    guint i;
+
+    i = name_index_search (index, name, 0, FALSE);
+
+    return i < index->names->len &&
+           strcmp (g_ptr_array_index (index->names, i), name) == 0;
+}
+
+/* Only a folder that appears, goes away or gets another name changes the
+ * names; the rest of what "files-changed" reports doesn't */
+static void
+directory_files_callback (NautilusDirectory *directory,
+                          GList             *files,
+                          gpointer           callback_data)
+{
+    NameIndex *index;
+    NautilusFile *file;
+    GList *l;
+    char *name;
+
+    index = callback_data;
+
+    for (l = files; l != NULL && !index->stale; l = l->next)
+    {
+        file = NAUTILUS_FILE (l->data);
+        name = nautilus_file_get_name (file);
+
+        if (nautilus_file_is_gone (file))
+        {
+            index->stale = name_index_contains (index, name);
+        }
+        else if (nautilus_file_is_directory (file))
+        {
+            index->stale = !name_index_contains (index, name);
+        }
+
+        g_free (name);
+    }
+}
+
+static NameIndex *
+name_index_new (GFile             *location,
+                GPtrArray         *names,
+                NautilusDirectory *directory)
+{
+    NameIndex *index;
+
+    index = g_new0 (NameIndex, 1);
+    index->location = g_object_ref (location);
+    index->names = names;
+    g_ptr_array_sort (index->names, compare_names);
+    index->read_time = g_get_monotonic_time ();
+
+    if (directory != NULL)
+    {
+        index->directory = directory;
+        g_object_add_weak_pointer (G_OBJECT (directory), (gpointer *) &index->directory);
+        g_signal_connect (directory, "files-added",
+                          G_CALLBACK (directory_files_callback), index);
+        g_signal_connect (directory, "files-changed",
+                          G_CALLBACK (directory_files_callback), index);
+    }
+
+    return index;
+}
+
+static NameIndex *
+name_index_new_for_directory (GFile             *location,
+                              NautilusDirectory *directory)
+{
+    GPtrArray *names;
+    GList *files, *l;
+    NautilusFile *file;
+
+    names = g_ptr_array_new_with_free_func (g_free);
+
+    files = nautilus_directory_get_file_list (directory);
+    for (l = files; l != NULL; l = l->next)
+    {
+        file = NAUTILUS_FILE (l->data);
+        if (nautilus_file_is_directory (file))
+        {
+            g_ptr_array_add (names, nautilus_file_get_name (file));
+        }
+    }
+    nautilus_file_list_free (files);
+
+    return name_index_new (location, names, directory);
+}
+
+static void
+name_index_free (gpointer data)
+{
+    NameIndex *index;
+
+    index = data;
+
+    if (index->directory != NULL)
+    {
+        g_signal_handlers_disconnect_by_data (index->directory, index);
+        g_object_remove_weak_pointer (G_OBJECT (index->directory),
+                                      (gpointer *) &index->directory);
+    }
+    g_object_unref (index->location);
+    g_ptr_array_unref (index->names);
+    g_free (index);
+}
+
+static gboolean
+name_index_is_valid (NameIndex *index)
+{
+    if (index->stale)
+    {
+        return FALSE;
+    }
+
+    if (index->directory != NULL &&
+        nautilus_directory_is_anyone_monitoring_file_list (index->directory))
+    {
+        return TRUE;
+    }
+
+    return g_get_monotonic_time () - index->read_time < ENUMERATED_INDEX_LIFETIME;
+}
+
+/* What all the names starting with @prefix have in common after it, and
+ * a slash too when only one does */
+static char *
+name_index_complete (NameIndex  *index,
+                     const char *prefix)
+{
+    const char *first, *last, *end;
+    guint first_match, end_match;
+    gsize prefix_length, length;
+
+    first_match = name_index_search (index, prefix, 0, FALSE);
+    end_match = name_index_search (index, prefix, first_match, TRUE);
+    if (first_match == end_match)
+    {
+        return NULL;
+    }
+
+    prefix_length = strlen (prefix);
+    first = (const char *) g_ptr_array_index (index->names, first_match) + prefix_length;
+
+    if (end_match - first_match == 1)
+    {
+        return g_strconcat (first, "/", NULL);
+    }
+
+    /* In sorted order, whatever the first and last match share, all the
+     * ones between them share too */
+    last = (const char *) g_ptr_array_index (index->names, end_match - 1) + prefix_length;
+    for (length = 0; first[length] != '\0' && first[length] == last[length]; length++)
+    {
+    }
+
+    /* Don't stop in the middle of a character */
+    g_utf8_validate (first, (gssize) length, &end);
+    length = end - first;
+
+    return length > 0 ? g_strndup (first, length) : NULL;
+}
+
+static void
+add_index (NautilusLocationCompleter *completer,
+           NameIndex                 *index)
+{
+    GList *last;
+
+    completer->indexes = g_list_prepend (completer->indexes, index);
+
+    if (g_list_length (completer->indexes) > MAX_INDEXES)
+    {
+        last = g_list_last (completer->indexes);
+        name_index_free (last->data);
+        completer->indexes = g_list_delete_link (completer->indexes, last);
+    }
+}
+
+static void
+cancel_enumeration (NautilusLocationCompleter *completer)
+{
+    if (completer->cancellable != NULL)
+    {
+        g_cancellable_cancel (completer->cancellable);
+        g_clear_object (&completer->cancellable);
+    }
+    g_clear_object (&completer->enumerating);
+    g_clear_pointer (&completer->enumerated_names, g_ptr_array_unref);
+}
+
+static void
+enumeration_done (NautilusLocationCompleter *completer)
+{
+    add_index (completer, name_index_new (completer->enumerating,
+                                          completer->enumerated_names,
+                                          NULL));
+    completer->enumerated_names = NULL;
+
+    cancel_enumeration (completer);
+
+    g_signal_emit (completer, signals[GOT_COMPLETION_DATA], 0);
+}
+
+static void
+next_files_callback (GObject      *source_object,
+                     GAsyncResult *res,
+                     gpointer      user_data)
+{
+    NautilusLocationCompleter *completer;
+    GFileEnumerator *enumerator;
+    GFileInfo *info;
+    GList *infos, *l;
+    GError *error;
+
+    enumerator = G_FILE_ENUMERATOR (source_object);
+    error = NULL;
+
+    infos = g_file_enumerator_next_files_finish (enumerator, res, &error);
+    if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    {
+        g_error_free (error);
+        g_object_unref (enumerator);
+        return;
+    }
+
+    completer = NAUTILUS_LOCATION_COMPLETER (user_data);
+
+    for (l = infos; l != NULL; l = l->next)
+    {
+        info = l->data;
+        if (g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY)
+        {
+            g_ptr_array_add (completer->enumerated_names,
+                             g_strdup (g_file_info_get_name (info)));
+        }
+    }
+
+    if (infos == NULL)
+    {
+        /* Done, or as done as it gets */
+        g_clear_error (&error);
+        g_file_enumerator_close_async (enumerator, G_PRIORITY_DEFAULT, NULL, NULL, NULL);
+        g_object_unref (enumerator);
+        enumeration_done (completer);
+        return;
+    }
+
+    g_list_free_full (infos, g_object_unref);
+
+    g_file_enumerator_next_files_async (enumerator,
+                                        ENUMERATE_BATCH_SIZE,
+                                        G_PRIORITY_DEFAULT,
+                                        completer->cancellable,
+                                        next_files_callback,
+                                        completer);
+}
+
+static void
+enumerate_children_callback (GObject      *source_object,
+                             GAsyncResult *res,
+                             gpointer      user_data)
+{
+    NautilusLocationCompleter *completer;
+    GFileEnumerator *enumerator;
+    GError *error;
+
+    error = NULL;
+
+    enumerator = g_file_enumerate_children_finish (G_FILE (source_object), res, &error);
+    if (enumerator == NULL)
+    {
+        if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        {
+            /* Remember there is nothing to complete, rather than asking
+             * again on every key press */
+            enumeration_done (NAUTILUS_LOCATION_COMPLETER (user_data));
+        }
+        g_error_free (error);
+        return;
+    }
+
+    completer = NAUTILUS_LOCATION_COMPLETER (user_data);
+
+    g_file_enumerator_next_files_async (enumerator,
+                                        ENUMERATE_BATCH_SIZE,
+                                        G_PRIORITY_DEFAULT,
+                                        completer->cancellable,
+                                        next_files_callback,
+                                        completer);
+}
+
+static void
+start_enumeration (NautilusLocationCompleter *completer,
+                   GFile                     *location)
+{
+    if (completer->enumerating != NULL &&
+        g_file_equal (completer->enumerating, location))
+    {
+        return;
+    }
+
+    cancel_enumeration (completer);
+
+    completer->enumerating = g_object_ref (location);
+    completer->cancellable = g_cancellable_new ();
+    completer->enumerated_names = g_ptr_array_new_with_free_func (g_free);
+
+    g_file_enumerate_children_async (location,
+                                     G_FILE_ATTRIBUTE_STANDARD_NAME ","
+                                     G_FILE_ATTRIBUTE_STANDARD_TYPE,
+                                     G_FILE_QUERY_INFO_NONE,
+                                     G_PRIORITY_DEFAULT,
+                                     completer->cancellable,
+                                     enumerate_children_callback,
+                                     completer);
+}
+
+/* The names in @location, if they are known already */
+static NameIndex *
+get_index (NautilusLocationCompleter *completer,
+           GFile                     *location)
+{
+    NautilusDirectory *directory;
+    NameIndex *index;
+    GList *l;
+
+    for (l = completer->indexes; l != NULL; l = l->next)
+    {
+        index = l->data;
+        if (!g_file_equal (index->location, location))
+        {
+            continue;
+        }
+
+        completer->indexes = g_list_delete_link (completer->indexes, l);
+        if (name_index_is_valid (index))
+        {
+            completer->indexes = g_list_prepend (completer->indexes, index);
+            return index;
+        }
+
+        name_index_free (index);
+        break;
+    }
+
+    /* A directory that is being viewed has all the names already */
+    directory = nautilus_directory_get (location);
+    if (nautilus_directory_are_all_files_seen (directory))
+    {
+        index = name_index_new_for_directory (location, directory);
+        add_index (completer, index);
+    }
+    else
+    {
+        index = NULL;
+        start_enumeration (completer, location);
+    }
+    nautilus_directory_unref (directory);
+
+    return index;
+}
+
+char *
+nautilus_location_completer_get_completion_suffix (NautilusLocationCompleter *completer,
+                                                   const char                *initial_text)
+{
+    const char *basename;
+    char *dirname, *prefix, *suffix, *escaped;
+    gboolean is_uri;
+    GFile *location;
+    NameIndex *index;
+
+    g_return_val_if_fail (NAUTILUS_IS_LOCATION_COMPLETER (completer), NULL);
+    g_return_val_if_fail (initial_text != NULL, NULL);
+
+    basename = strrchr (initial_text, '/');
+    if (basename == NULL)
+    {
+        return NULL;
+    }
+    basename++;
+
+    dirname = g_strndup (initial_text, basename - initial_text);
+    location = g_file_parse_name (dirname);
+    g_free (dirname);
+
+    /* Names in uris are escaped, like GFilenameCompleter does */
+    is_uri = !g_path_is_absolute (initial_text) && initial_text[0] != '~';
+    prefix = is_uri ? g_uri_unescape_string (basename, NULL) : NULL;
+    if (prefix == NULL)
+    {
+        prefix = g_strdup (basename);
+    }
+
+    suffix = NULL;
+    index = get_index (completer, location);
+    if (index != NULL)
+    {
+        suffix = name_index_complete (index, prefix);
+    }
+
+    if (suffix != NULL && is_uri)
+    {
+        escaped = g_uri_escape_string (suffix, G_URI_RESERVED_CHARS_ALLOWED_IN_PATH, TRUE);
+        g_free (suffix);
+        suffix = escaped;
+    }
+
+    g_free (prefix);
+    g_object_unref (location);
+
+    return suffix;
+}
+
+static void
+nautilus_location_completer_finalize (GObject *object)
+{
+    NautilusLocationCompleter *completer;
+
+    completer = NAUTILUS_LOCATION_COMPLETER (object);
+
+    cancel_enumeration (completer);
+    g_list_free_full (completer->indexes, name_index_free);
+
+    G_OBJECT_CLASS (nautilus_location_completer_parent_class)->finalize (object);
+}
+
+static void
+nautilus_location_completer_class_init (NautilusLocationCompleterClass *class)
+{
+    GObjectClass *object_class;
+
+    object_class = G_OBJECT_CLASS (class);
+    object_class->finalize = nautilus_location_completer_finalize;
+
+    signals[GOT_COMPLETION_DATA] =
+        g_signal_new ("got-completion-data",
+                      G_TYPE_FROM_CLASS (class),
+                      G_SIGNAL_RUN_LAST,
+                      0,
+                      NULL, NULL,
+                      g_cclosure_marshal_VOID__VOID,
+                      G_TYPE_NONE, 0);
+}
+
+static void
+nautilus_location_completer_init (NautilusLocationCompleter *completer)
+{
+}
+
+NautilusLocationCompleter *
+nautilus_location_completer_new (void)
+{
+    return g_object_new (NAUTILUS_TYPE_LOCATION_COMPLETER, NULL);
+}
@@ -0,0 +1,44 @@
+/*
+ * nautilus-location-completer: completes folder names in the location entry
+ *
+ * Nautilus is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * Nautilus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Works like a GFilenameCompleter that only completes directories, but
+ * takes the names from the NautilusDirectory when it is already loaded,
+ * and keeps a sorted index of the names of the last few directories so
+ * that every key press is a couple of binary searches.
+ */
+
+#ifndef NAUTILUS_LOCATION_COMPLETER_H
+#define NAUTILUS_LOCATION_COMPLETER_H
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+#define NAUTILUS_TYPE_LOCATION_COMPLETER (nautilus_location_completer_get_type ())
+
+G_DECLARE_FINAL_TYPE (NautilusLocationCompleter, nautilus_location_completer, NAUTILUS, LOCATION_COMPLETER, GObject)
+
+NautilusLocationCompleter *nautilus_location_completer_new                   (void);
+
+/* Returns what can be added to @initial_text, or NULL. When the names of
+ * the directory aren't known yet they are read in the background, and
+ * "got-completion-data" is emitted once they are. */
+char *                     nautilus_location_completer_get_completion_suffix (NautilusLocationCompleter *completer,
+                                                                              const char                *initial_text);
+
+G_END_DECLS
+
+#endif /* NAUTILUS_LOCATION_COMPLETER_H */
@@ -31,6 +31,7 @@
 #include "nautilus-location-entry.h"
 
 #include "nautilus-application.h"
+#include "nautilus-location-completer.h"
 #include "nautilus-window.h"
 #include <gtk/gtk.h>
 #include <gdk/gdkkeysyms.h>
@@ -69,7 +70,7 @@ static const GtkTargetEntry drop_types [] =
 typedef struct _NautilusLocationEntryPrivate
 {
     char *current_directory;
-    GFilenameCompleter *completer;
+    NautilusLocationCompleter *completer;
 
     guint idle_id;
 
@@ -377,14 +378,14 @@ try_to_expand_path (gpointer callback_data)
     if (!g_path_is_absolute (user_location) && uri_scheme == NULL && user_location[0] != '~')
     {
         absolute_location = g_build_filename (priv->current_directory, user_location, NULL);
-        suffix = g_filename_completer_get_completion_suffix (priv->completer,
-                                                             absolute_location);
+        suffix = nautilus_location_completer_get_completion_suffix (priv->completer,
+                                                                    absolute_location);
         g_free (absolute_location);
     }
     else
     {
-        suffix = g_filename_completer_get_completion_suffix (priv->completer,
-                                                             user_location);
+        suffix = nautilus_location_completer_get_completion_suffix (priv->completer,
+                                                                    user_location);
     }
 
     g_free (user_location);
@@ -466,8 +467,8 @@ position_and_selection_are_at_end (GtkEditable *editable)
 }
 
 static void
-got_completion_data_callback (GFilenameCompleter    *completer,
-                              NautilusLocationEntry *entry)
+got_completion_data_callback (NautilusLocationCompleter *completer,
+                              NautilusLocationEntry     *entry)
 {
     NautilusLocationEntryPrivate *priv;
 
@@ -830,8 +831,7 @@ nautilus_location_entry_init (NautilusLocationEntry *entry)
 
     priv = nautilus_location_entry_get_instance_private (entry);
 
-    priv->completer = g_filename_completer_new ();
-    g_filename_completer_set_dirs_only (priv->completer, TRUE);
+    priv->completer = nautilus_location_completer_new ();
 
     gtk_entry_set_icon_from_icon_name (GTK_ENTRY (entry), GTK_ENTRY_ICON_PRIMARY, "folder-symbolic");
     gtk_entry_set_icon_activatable (GTK_ENTRY (entry), GTK_ENTRY_ICON_PRIMARY, FALSE);
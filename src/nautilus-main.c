@@ -31,6 +31,8 @@
 #include "nautilus-resources.h"
 
 #include "nautilus-debug.h"
+#include "nautilus-profile.h"
+#include "nautilus-watchdog.h"
 #include <eel/eel-debug.h>
 
 #include <glib/gi18n.h>
@@ -86,6 +88,9 @@ main (int   argc,
 
     g_set_prgname ("nautilus");
 
+    nautilus_profile_init ();
+    nautilus_watchdog_init ();
+
 #ifdef HAVE_EXEMPI
     xmp_init ();
 #endif
@@ -106,5 +111,8 @@ main (int   argc,
 
     eel_debug_shut_down ();
 
+    nautilus_watchdog_shutdown ();
+    nautilus_profile_shutdown ();
+
     return retval;
 }
@@ -0,0 +1,225 @@
+/*
+ * nautilus-menu-provider-cache: what menu providers answered last time
+ *
+ * Nautilus is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * Nautilus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <config.h>
+
+#include "nautilus-menu-provider-cache.h"
+
+#include "nautilus-file.h"
+#include "nautilus-module.h"
+
+#define DEBUG_FLAG NAUTILUS_DEBUG_DIRECTORY_VIEW
+#include "nautilus-debug.h"
+
+struct _NautilusMenuProviderCache
+{
+    gboolean background;
+    /* NautilusMenuProvider to Entry, which holds the ref on the provider */
+    GHashTable *entries;
+};
+
+typedef struct
+{
+    NautilusMenuProvider *provider;
+    gulong items_updated_id;
+
+    GList *files;
+    guint *serials;
+    GList *items;
+    gint64 cost; /* us, -1 until the provider has been asked once */
+} Entry;
+
+static void
+entry_free (Entry *entry)
+{
+    g_signal_handler_disconnect (entry->provider, entry->items_updated_id);
+    g_object_unref (entry->provider);
+    nautilus_file_list_free (entry->files);
+    g_free (entry->serials);
+    g_list_free_full (entry->items, g_object_unref);
+    g_free (entry);
+}
+
+/* Whatever it answered is out of date, and so is how long it took */
+static void
+provider_items_updated (NautilusMenuProvider *provider,
+                        gpointer              user_data)
+{
+    NautilusMenuProviderCache *cache;
+
+    cache = user_data;
+    g_hash_table_remove (cache->entries, provider);
+}
+
+static Entry *
+lookup_entry (NautilusMenuProviderCache *cache,
+              NautilusMenuProvider      *provider)
+{
+    Entry *entry;
+
+    entry = g_hash_table_lookup (cache->entries, provider);
+    if (entry == NULL)
+    {
+        entry = g_new0 (Entry, 1);
+        entry->provider = g_object_ref (provider);
+        entry->cost = -1;
+        entry->items_updated_id = g_signal_connect (provider, "items-updated",
+                                                    G_CALLBACK (provider_items_updated),
+                                                    cache);
+        g_hash_table_insert (cache->entries, provider, entry);
+    }
+
+    return entry;
+}
+
+/* The cached items are only good for exactly the same files, none of
+ * which may have changed since */
+static gboolean
+entry_is_current (Entry *entry,
+                  GList *files)
+{
+    GList *l, *cached;
+    guint i;
+
+    if (entry->cost < 0)
+    {
+        return FALSE;
+    }
+
+    for (l = files, cached = entry->files, i = 0;
+         l != NULL && cached != NULL;
+         l = l->next, cached = cached->next, i++)
+    {
+        if (l->data != cached->data ||
+            nautilus_file_get_change_serial (l->data) != entry->serials[i])
+        {
+            return FALSE;
+        }
+    }
+
+    return l == NULL && cached == NULL;
+}
+
+static void
+entry_update (NautilusMenuProviderCache *cache,
+              Entry                     *entry,
+              GtkWidget                 *window,
+              GList                     *files)
+{
+    GList *l;
+    gint64 start;
+    guint i;
+
+    nautilus_file_list_free (entry->files);
+    g_free (entry->serials);
+    g_list_free_full (entry->items, g_object_unref);
+
+    entry->files = nautilus_file_list_copy (files);
+    entry->serials = g_new (guint, g_list_length (files));
+    for (l = files, i = 0; l != NULL; l = l->next, i++)
+    {
+        entry->serials[i] = nautilus_file_get_change_serial (l->data);
+    }
+
+    start = g_get_monotonic_time ();
+    if (cache->background)
+    {
+        entry->items = nautilus_menu_provider_get_background_items (entry->provider,
+                                                                    window,
+                                                                    files->data);
+    }
+    else
+    {
+        entry->items = nautilus_menu_provider_get_file_items (entry->provider,
+                                                              window,
+                                                              files);
+    }
+    entry->cost = g_get_monotonic_time () - start;
+    nautilus_module_record_call (entry->provider,
+                                 cache->background ? "get_background_items" : "get_file_items",
+                                 entry->cost);
+
+    DEBUG ("Menu provider %s took %" G_GINT64_FORMAT " us for %s items",
+           G_OBJECT_TYPE_NAME (entry->provider), entry->cost,
+           cache->background ? "background" : "selection");
+}
+
+NautilusMenuProviderCache *
+nautilus_menu_provider_cache_new (gboolean background)
+{
+    NautilusMenuProviderCache *cache;
+
+    cache = g_new0 (NautilusMenuProviderCache, 1);
+    cache->background = background;
+    cache->entries = g_hash_table_new_full (NULL, NULL, NULL,
+                                            (GDestroyNotify) entry_free);
+
+    return cache;
+}
+
+void
+nautilus_menu_provider_cache_free (NautilusMenuProviderCache *cache)
+{
+    g_hash_table_destroy (cache->entries);
+    g_free (cache);
+}
+
+GList *
+nautilus_menu_provider_cache_get_items (NautilusMenuProviderCache *cache,
+                                        NautilusMenuProvider      *provider,
+                                        GtkWidget                 *window,
+                                        GList                     *files)
+{
+    Entry *entry;
+
+    entry = lookup_entry (cache, provider);
+    if (!entry_is_current (entry, files))
+    {
+        entry_update (cache, entry, window, files);
+    }
+
+    return g_list_copy_deep (entry->items, (GCopyFunc) g_object_ref, NULL);
+}
+
+gboolean
+nautilus_menu_provider_cache_prefetch (NautilusMenuProviderCache *cache,
+                                       NautilusMenuProvider      *provider,
+                                       GtkWidget                 *window,
+                                       GList                     *files,
+                                       gint64                     budget)
+{
+    Entry *entry;
+
+    entry = g_hash_table_lookup (cache->entries, provider);
+    if (entry == NULL ||
+        entry->cost < 0 || entry->cost > budget ||
+        entry_is_current (entry, files))
+    {
+        return FALSE;
+    }
+
+    entry_update (cache, entry, window, files);
+
+    return TRUE;
+}
+
+gboolean
+nautilus_menu_provider_cache_is_empty (NautilusMenuProviderCache *cache)
+{
+    return g_hash_table_size (cache->entries) == 0;
+}
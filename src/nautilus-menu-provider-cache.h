@@ -0,0 +1,57 @@
+/*
+ * nautilus-menu-provider-cache: what menu providers answered last time
+ *
+ * Nautilus is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * Nautilus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * A provider's items are reused while they are asked for exactly the
+ * same files, none of which has emitted "changed" since, and the provider
+ * hasn't emitted "items-updated".
+ */
+
+#ifndef NAUTILUS_MENU_PROVIDER_CACHE_H
+#define NAUTILUS_MENU_PROVIDER_CACHE_H
+
+#include <gtk/gtk.h>
+#include <libnautilus-extension/nautilus-menu-provider.h>
+
+G_BEGIN_DECLS
+
+typedef struct _NautilusMenuProviderCache NautilusMenuProviderCache;
+
+/* With @background, providers are asked for the background items of the
+ * single file they are given */
+NautilusMenuProviderCache *nautilus_menu_provider_cache_new       (gboolean                   background);
+void                       nautilus_menu_provider_cache_free      (NautilusMenuProviderCache *cache);
+
+/* Returns: (transfer full): the items of @provider for @files, asking it
+ * only if what it answered last time is out of date */
+GList *                    nautilus_menu_provider_cache_get_items (NautilusMenuProviderCache *cache,
+                                                                   NautilusMenuProvider      *provider,
+                                                                   GtkWidget                 *window,
+                                                                   GList                     *files);
+
+/* Asks @provider ahead of time, if its items for @files are out of date
+ * and it took no longer than @budget microseconds last time. Returns
+ * whether it was asked. */
+gboolean                   nautilus_menu_provider_cache_prefetch  (NautilusMenuProviderCache *cache,
+                                                                   NautilusMenuProvider      *provider,
+                                                                   GtkWidget                 *window,
+                                                                   GList                     *files,
+                                                                   gint64                     budget);
+
+gboolean                   nautilus_menu_provider_cache_is_empty  (NautilusMenuProviderCache *cache);
+
+G_END_DECLS
+
+#endif /* NAUTILUS_MENU_PROVIDER_CACHE_H */
@@ -0,0 +1,198 @@
+/*
+ * nautilus-metrics: counters, gauges and latency histograms
+ *
+ * Nautilus is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * Nautilus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <config.h>
+
+#include "nautilus-metrics.h"
+
+/* Bucket i counts durations below 2^i microseconds that did not fit in
+ * bucket i - 1; the last one also takes everything longer. 2^26 us is
+ * a bit over a minute. */
+#define HISTOGRAM_BUCKETS 27
+
+typedef enum
+{
+    METRIC_COUNTER,
+    METRIC_GAUGE,
+    METRIC_HISTOGRAM,
+} MetricKind;
+
+typedef struct
+{
+    MetricKind kind;
+    /* The counter's total, the gauge's value or the number of
+     * observations */
+    gint64 value;
+    /* Sum of the observations */
+    gint64 sum;
+    /* Highest gauge value or longest observation seen */
+    gint64 max;
+    guint64 buckets[HISTOGRAM_BUCKETS];
+} Metric;
+
+/* Updates are rare compared to the work they describe, so a single
+ * lock is cheap enough */
+static GMutex metrics_mutex;
+static GHashTable *metrics = NULL;
+
+static const char *kind_names[] =
+{
+    "counter",
+    "gauge",
+    "histogram",
+};
+
+/* Call with metrics_mutex held */
+static Metric *
+get_metric (const char *name,
+            MetricKind  kind)
+{
+    Metric *metric;
+
+    if (metrics == NULL)
+    {
+        metrics = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, g_free);
+    }
+
+    metric = g_hash_table_lookup (metrics, name);
+    if (metric == NULL)
+    {
+        metric = g_new0 (Metric, 1);
+        metric->kind = kind;
+        g_hash_table_insert (metrics, (gpointer) name, metric);
+    }
+
+    g_warn_if_fail (metric->kind == kind);
+
+    return metric;
+}
+
+void
+nautilus_metrics_counter_add (const char *name,
+                              gint64      delta)
+{
+    Metric *metric;
+
+    g_mutex_lock (&metrics_mutex);
+    metric = get_metric (name, METRIC_COUNTER);
+    metric->value += delta;
+    g_mutex_unlock (&metrics_mutex);
+}
+
+static void
+gauge_update (Metric *metric,
+              gint64  value)
+{
+    metric->value = value;
+    metric->max = MAX (metric->max, value);
+}
+
+void
+nautilus_metrics_gauge_set (const char *name,
+                            gint64      value)
+{
+    g_mutex_lock (&metrics_mutex);
+    gauge_update (get_metric (name, METRIC_GAUGE), value);
+    g_mutex_unlock (&metrics_mutex);
+}
+
+void
+nautilus_metrics_gauge_add (const char *name,
+                            gint64      delta)
+{
+    Metric *metric;
+
+    g_mutex_lock (&metrics_mutex);
+    metric = get_metric (name, METRIC_GAUGE);
+    gauge_update (metric, metric->value + delta);
+    g_mutex_unlock (&metrics_mutex);
+}
+
+void
+nautilus_metrics_observe (const char *name,
+                          gint64      duration)
+{
+    Metric *metric;
+    guint bucket;
+
+    duration = MAX (duration, 0);
+
+    bucket = 0;
+    while (bucket < HISTOGRAM_BUCKETS - 1 &&
+           duration >= ((gint64) 1 << bucket))
+    {
+        bucket++;
+    }
+
+    g_mutex_lock (&metrics_mutex);
+    metric = get_metric (name, METRIC_HISTOGRAM);
+    metric->value++;
+    metric->sum += duration;
+    metric->max = MAX (metric->max, duration);
+    metric->buckets[bucket]++;
+    g_mutex_unlock (&metrics_mutex);
+}
+
+/**
+ * nautilus_metrics_snapshot:
+ *
+ * Returns: (transfer floating): all metrics, as an array of (name, kind,
+ * value, sum, max, buckets), sorted by name. Only histograms have a sum
+ * and buckets.
+ */
+GVariant *
+nautilus_metrics_snapshot (void)
+{
+    GVariantBuilder builder;
+    GVariantBuilder buckets;
+    GList *names, *l;
+    Metric *metric;
+    guint i;
+
+    g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(ssxxxat)"));
+
+    g_mutex_lock (&metrics_mutex);
+
+    names = metrics != NULL ? g_hash_table_get_keys (metrics) : NULL;
+    names = g_list_sort (names, (GCompareFunc) g_strcmp0);
+
+    for (l = names; l != NULL; l = l->next)
+    {
+        metric = g_hash_table_lookup (metrics, l->data);
+
+        g_variant_builder_init (&buckets, G_VARIANT_TYPE ("at"));
+        if (metric->kind == METRIC_HISTOGRAM)
+        {
+            for (i = 0; i < HISTOGRAM_BUCKETS; i++)
+            {
+                g_variant_builder_add (&buckets, "t", metric->buckets[i]);
+            }
+        }
+
+        g_variant_builder_add (&builder, "(ssxxxat)",
+                               l->data, kind_names[metric->kind],
+                               metric->value, metric->sum, metric->max,
+                               &buckets);
+    }
+
+    g_mutex_unlock (&metrics_mutex);
+
+    g_list_free (names);
+
+    return g_variant_builder_end (&builder);
+}
@@ -0,0 +1,45 @@
+/*
+ * nautilus-metrics: counters, gauges and latency histograms
+ *
+ * Nautilus is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * Nautilus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef NAUTILUS_METRICS_H
+#define NAUTILUS_METRICS_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Metrics are created the first time they are updated and are named by
+ * static strings. All functions may be called from any thread. The
+ * current values can be read over D-Bus, see the
+ * org.gnome.Nautilus.Metrics interface. */
+
+void      nautilus_metrics_counter_add (const char *name,
+                                        gint64      delta);
+void      nautilus_metrics_gauge_set   (const char *name,
+                                        gint64      value);
+void      nautilus_metrics_gauge_add   (const char *name,
+                                        gint64      delta);
+/* Durations are in microseconds */
+void      nautilus_metrics_observe     (const char *name,
+                                        gint64      duration);
+
+GVariant *nautilus_metrics_snapshot    (void);
+
+G_END_DECLS
+
+#endif /* NAUTILUS_METRICS_H */
@@ -23,8 +23,15 @@
 #include <config.h>
 #include "nautilus-module.h"
 
+#include "nautilus-extension-host-proxy.h"
+#include "nautilus-global-preferences.h"
+#include "nautilus-metrics.h"
+#include "nautilus-signaller.h"
+
 #include <eel/eel-debug.h>
 #include <gmodule.h>
+#include <glib/gstdio.h>
+#include <string.h>
 
 #define NAUTILUS_TYPE_MODULE            (nautilus_module_get_type ())
 #define NAUTILUS_MODULE(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), NAUTILUS_TYPE_MODULE, NautilusModule))
@@ -55,7 +62,74 @@ struct _NautilusModuleClass
     GTypeModuleClass parent;
 };
 
+/* What a module provides is recorded in a manifest, keyed by the
+ * module's path and validated by its mtime and size. At startup only
+ * modules that are new or have changed are opened; the rest are opened
+ * the first time someone asks for a provider type they implement.
+ *
+ * Loaders such as nautilus-python register types for whatever scripts
+ * they find, so what they provide can change while the module itself
+ * doesn't. Those are recognized by their types not belonging to the
+ * module, and are always opened at startup.
+ *
+ * Entries written with another MANIFEST_VERSION are not trusted.
+ */
+#define MANIFEST_VERSION 2
+#define MANIFEST_KEY_VERSION "version"
+#define MANIFEST_KEY_MTIME "mtime"
+#define MANIFEST_KEY_SIZE "size"
+#define MANIFEST_KEY_INTERFACES "interfaces"
+#define MANIFEST_KEY_DYNAMIC_TYPES "dynamic-types"
+
+/* The key file a module can install next to itself, see
+ * nautilus-extension-types.h */
+#define SIDECAR_SUFFIX ".nautilus-extension"
+#define SIDECAR_GROUP "Nautilus Extension"
+#define SIDECAR_KEY_EXTENSION_HOST "ExtensionHost"
+
+typedef struct
+{
+    char *path;
+    char **interfaces;
+} PendingModule;
+
 static GList *module_objects = NULL;
+static GList *pending_modules = NULL;
+/* Bumped whenever module_objects changes */
+static guint module_objects_serial = 0;
+
+/* Extensions are called on the main thread, so a slow one stalls every
+ * window. Callers time each call and report it with
+ * nautilus_module_record_call(). An extension that goes over the
+ * budget QUARANTINE_STRIKES times within QUARANTINE_WINDOW is no longer
+ * handed out by nautilus_module_get_extensions_for_type() for the rest
+ * of the session.
+ */
+#define EXTENSION_CALL_BUDGET 200000 /* us */
+#define QUARANTINE_STRIKES 3
+#define QUARANTINE_WINDOW 60000000 /* us */
+
+typedef struct
+{
+    /* The key it is kept under in extension_call_stats */
+    const char *name;
+    /* The histogram of the extension's call times in nautilus-metrics */
+    const char *metric_name;
+    guint slow_calls;
+    /* When the last QUARANTINE_STRIKES slow calls happened */
+    gint64 strikes[QUARANTINE_STRIKES];
+    guint next_strike;
+    gboolean quarantined;
+} ExtensionCallStats;
+
+/* Extension name to ExtensionCallStats. Each extension object points
+ * to its own in its qdata, so the checks done for every file don't
+ * need to build the name. */
+static GHashTable *extension_call_stats = NULL;
+static GQuark extension_name_quark = 0;
+static GQuark call_stats_quark = 0;
+static NautilusModuleQuarantineFunc quarantine_func = NULL;
+static gpointer quarantine_func_data = NULL;
 
 static GType nautilus_module_get_type (void);
 
@@ -165,17 +239,28 @@ module_object_weak_notify (gpointer  user_data,
                            GObject  *object)
 {
     module_objects = g_list_remove (module_objects, object);
+    module_objects_serial++;
 }
 
-static void
-add_module_objects (NautilusModule *module)
+/* Returns whether the module's types are registered by someone other
+ * than the module, which loaders do for the scripts they find */
+static gboolean
+add_module_objects (NautilusModule *module,
+                    GPtrArray      *interfaces)
 {
     const GType *types;
     int num_types;
     int i;
+    GType *type_interfaces;
+    guint n_type_interfaces, j, k;
+    const char *name;
+    gboolean dynamic_types;
 
     module->list_types (&types, &num_types);
 
+    /* Nothing to remember either */
+    dynamic_types = num_types == 0;
+
     for (i = 0; i < num_types; i++)
     {
         if (types[i] == 0)           /* Work around broken extensions */
@@ -183,56 +268,354 @@ add_module_objects (NautilusModule *module)
             break;
         }
         nautilus_module_add_type (types[i]);
+
+        if (g_type_get_plugin (types[i]) != G_TYPE_PLUGIN (module))
+        {
+            dynamic_types = TRUE;
+        }
+
+        if (interfaces == NULL)
+        {
+            continue;
+        }
+
+        type_interfaces = g_type_interfaces (types[i], &n_type_interfaces);
+        for (j = 0; j < n_type_interfaces; j++)
+        {
+            name = g_type_name (type_interfaces[j]);
+            for (k = 0; k < interfaces->len; k++)
+            {
+                if (g_str_equal (g_ptr_array_index (interfaces, k), name))
+                {
+                    break;
+                }
+            }
+            if (k == interfaces->len)
+            {
+                g_ptr_array_add (interfaces, g_strdup (name));
+            }
+        }
+        g_free (type_interfaces);
     }
+
+    return dynamic_types;
 }
 
+/* @dynamic_types, if not %NULL, is set to whether what the module
+ * provides can change without the module changing. Modules that fail to
+ * load count as such, so that they are tried again. */
 static NautilusModule *
-nautilus_module_load_file (const char *filename)
+nautilus_module_load_file (const char *filename,
+                           GPtrArray  *interfaces,
+                           gboolean   *dynamic_types)
 {
     NautilusModule *module;
+    gboolean dynamic;
 
     module = g_object_new (NAUTILUS_TYPE_MODULE, NULL);
     module->path = g_strdup (filename);
 
     if (g_type_module_use (G_TYPE_MODULE (module)))
     {
-        add_module_objects (module);
+        dynamic = add_module_objects (module, interfaces);
         g_type_module_unuse (G_TYPE_MODULE (module));
-        return module;
     }
     else
     {
-        g_object_unref (module);
-        return NULL;
+        g_clear_object (&module);
+        dynamic = TRUE;
+    }
+
+    if (dynamic_types != NULL)
+    {
+        *dynamic_types = dynamic;
     }
+
+    return module;
+}
+
+static char *
+get_manifest_filename (void)
+{
+    return g_build_filename (g_get_user_cache_dir (), "nautilus",
+                             "extension-manifest", NULL);
+}
+
+static gboolean
+manifest_entry_is_current (GKeyFile   *manifest,
+                           const char *filename,
+                           GStatBuf   *statbuf)
+{
+    return g_key_file_has_group (manifest, filename) &&
+           g_key_file_get_integer (manifest, filename, MANIFEST_KEY_VERSION, NULL) == MANIFEST_VERSION &&
+           g_key_file_get_int64 (manifest, filename, MANIFEST_KEY_MTIME, NULL) == statbuf->st_mtime &&
+           g_key_file_get_int64 (manifest, filename, MANIFEST_KEY_SIZE, NULL) == statbuf->st_size &&
+           g_key_file_has_key (manifest, filename, MANIFEST_KEY_INTERFACES, NULL);
 }
 
+/* Everything load_module_dir() needs from disk, gathered so that it can
+ * be done away from the main thread */
+typedef struct
+{
+    GKeyFile *manifest;
+    GList *files;
+} ModuleScan;
+
+typedef struct
+{
+    char *filename;
+    GStatBuf statbuf;
+    gboolean wants_host;
+} ScannedModule;
+
 static void
-load_module_dir (const char *dirname)
+scanned_module_free (ScannedModule *scanned)
+{
+    g_free (scanned->filename);
+    g_free (scanned);
+}
+
+static void
+module_scan_free (ModuleScan *scan)
+{
+    g_key_file_unref (scan->manifest);
+    g_list_free_full (scan->files, (GDestroyNotify) scanned_module_free);
+    g_free (scan);
+}
+
+/* Whether the module asks to run in nautilus-extension-host. Opening
+ * the module to look for something in it would run its constructors in
+ * this process, so it says so in a key file next to it instead. */
+static gboolean
+module_wants_extension_host (const char *filename)
 {
+    GKeyFile *key_file;
+    char *stem;
+    char *sidecar;
+    gboolean ret;
+
+    stem = g_strndup (filename, strlen (filename) - strlen ("." G_MODULE_SUFFIX));
+    sidecar = g_strconcat (stem, SIDECAR_SUFFIX, NULL);
+
+    key_file = g_key_file_new ();
+    ret = g_key_file_load_from_file (key_file, sidecar, G_KEY_FILE_NONE, NULL) &&
+          g_key_file_get_boolean (key_file, SIDECAR_GROUP, SIDECAR_KEY_EXTENSION_HOST, NULL);
+
+    g_key_file_unref (key_file);
+    g_free (sidecar);
+    g_free (stem);
+
+    return ret;
+}
+
+static ModuleScan *
+scan_module_dir (const char *dirname)
+{
+    ModuleScan *scan;
+    ScannedModule *scanned;
     GDir *dir;
+    const char *name;
+    char *manifest_filename;
 
-    dir = g_dir_open (dirname, 0, NULL);
+    scan = g_new0 (ModuleScan, 1);
+    scan->manifest = g_key_file_new ();
 
-    if (dir)
+    dir = g_dir_open (dirname, 0, NULL);
+    if (dir == NULL)
     {
-        const char *name;
+        return scan;
+    }
+
+    manifest_filename = get_manifest_filename ();
+    g_key_file_load_from_file (scan->manifest, manifest_filename, G_KEY_FILE_NONE, NULL);
+    g_free (manifest_filename);
 
-        while ((name = g_dir_read_name (dir)))
+    while ((name = g_dir_read_name (dir)))
+    {
+        if (g_str_has_suffix (name, "." G_MODULE_SUFFIX))
         {
-            if (g_str_has_suffix (name, "." G_MODULE_SUFFIX))
+            scanned = g_new0 (ScannedModule, 1);
+            scanned->filename = g_build_filename (dirname, name, NULL);
+            if (g_stat (scanned->filename, &scanned->statbuf) != 0)
             {
-                char *filename;
-
-                filename = g_build_filename (dirname,
-                                             name,
-                                             NULL);
-                nautilus_module_load_file (filename);
-                g_free (filename);
+                scanned_module_free (scanned);
+                continue;
             }
+            scanned->wants_host = module_wants_extension_host (scanned->filename);
+            scan->files = g_list_prepend (scan->files, scanned);
         }
+    }
+    scan->files = g_list_reverse (scan->files);
+
+    g_dir_close (dir);
 
-        g_dir_close (dir);
+    return scan;
+}
+
+
+/* Whether the user asked for the module to run in nautilus-extension-host */
+static gboolean
+module_configured_for_extension_host (const char *filename)
+{
+    char **names;
+    char *basename;
+    gboolean ret;
+
+    if (nautilus_preferences == NULL)
+    {
+        return FALSE;
+    }
+
+    names = g_settings_get_strv (nautilus_preferences,
+                                 NAUTILUS_PREFERENCES_OUT_OF_PROCESS_EXTENSIONS);
+    basename = g_path_get_basename (filename);
+    ret = g_strv_contains ((const char * const *) names, basename);
+    g_free (basename);
+    g_strfreev (names);
+
+    return ret;
+}
+
+static void
+load_module_file (ScannedModule *scanned,
+                  GKeyFile      *old_manifest,
+                  GKeyFile      *new_manifest,
+                  gboolean      *manifest_changed)
+{
+    const char *filename;
+    PendingModule *pending;
+    GPtrArray *interfaces;
+    char **names;
+    gsize n_names;
+    gboolean current;
+    gboolean dynamic_types;
+
+    filename = scanned->filename;
+
+    current = manifest_entry_is_current (old_manifest, filename, &scanned->statbuf);
+    if (!current)
+    {
+        *manifest_changed = TRUE;
+    }
+
+    names = NULL;
+    dynamic_types = FALSE;
+    if ((scanned->wants_host || module_configured_for_extension_host (filename)) &&
+        nautilus_extension_host_load_module (filename))
+    {
+        /* What it provides is only known to the host */
+        names = g_new0 (char *, 1);
+        n_names = 0;
+    }
+    else if (current &&
+             !g_key_file_get_boolean (old_manifest, filename, MANIFEST_KEY_DYNAMIC_TYPES, NULL))
+    {
+        names = g_key_file_get_string_list (old_manifest, filename,
+                                            MANIFEST_KEY_INTERFACES,
+                                            &n_names, NULL);
+        /* An empty list is one written for the host */
+        if (names != NULL && n_names > 0)
+        {
+            pending = g_new0 (PendingModule, 1);
+            pending->path = g_strdup (filename);
+            pending->interfaces = g_strdupv (names);
+            pending_modules = g_list_prepend (pending_modules, pending);
+        }
+        else
+        {
+            g_clear_pointer (&names, g_strfreev);
+        }
+    }
+
+    if (names == NULL)
+    {
+        /* New, changed or a loader: open it now to learn what it provides */
+        interfaces = g_ptr_array_new ();
+        nautilus_module_load_file (filename, interfaces, &dynamic_types);
+        n_names = interfaces->len;
+        g_ptr_array_add (interfaces, NULL);
+        names = (char **) g_ptr_array_free (interfaces, FALSE);
+
+        /* What a loader provides is never read back, so there is no
+         * need to write it down again */
+        if (!current || !dynamic_types)
+        {
+            *manifest_changed = TRUE;
+        }
+    }
+
+    g_key_file_set_integer (new_manifest, filename, MANIFEST_KEY_VERSION, MANIFEST_VERSION);
+    g_key_file_set_int64 (new_manifest, filename, MANIFEST_KEY_MTIME, scanned->statbuf.st_mtime);
+    g_key_file_set_int64 (new_manifest, filename, MANIFEST_KEY_SIZE, scanned->statbuf.st_size);
+    g_key_file_set_string_list (new_manifest, filename, MANIFEST_KEY_INTERFACES,
+                                (const char * const *) names, n_names);
+    g_key_file_set_boolean (new_manifest, filename, MANIFEST_KEY_DYNAMIC_TYPES, dynamic_types);
+
+    g_strfreev (names);
+}
+
+static void
+load_module_dir (ModuleScan *scan)
+{
+    GKeyFile *new_manifest;
+    char *manifest_filename;
+    char *manifest_dir;
+    gboolean manifest_changed;
+    GList *l;
+    gsize n_old_modules;
+
+    new_manifest = g_key_file_new ();
+    manifest_changed = FALSE;
+
+    for (l = scan->files; l != NULL; l = l->next)
+    {
+        load_module_file (l->data, scan->manifest, new_manifest, &manifest_changed);
+    }
+
+    /* Also catches modules that were removed */
+    g_strfreev (g_key_file_get_groups (scan->manifest, &n_old_modules));
+    if (manifest_changed || g_list_length (scan->files) != n_old_modules)
+    {
+        manifest_filename = get_manifest_filename ();
+        manifest_dir = g_path_get_dirname (manifest_filename);
+        g_mkdir_with_parents (manifest_dir, 0700);
+        g_key_file_save_to_file (new_manifest, manifest_filename, NULL);
+        g_free (manifest_dir);
+        g_free (manifest_filename);
+    }
+
+    g_key_file_unref (new_manifest);
+}
+
+static void
+pending_module_free (PendingModule *pending)
+{
+    g_free (pending->path);
+    g_strfreev (pending->interfaces);
+    g_free (pending);
+}
+
+/* Opens the modules that the manifest says provide @type */
+static void
+load_pending_modules_for_type (GType type)
+{
+    GList *l, *next;
+    PendingModule *pending;
+    const char *type_name;
+
+    type_name = g_type_name (type);
+
+    for (l = pending_modules; l != NULL; l = next)
+    {
+        next = l->next;
+        pending = l->data;
+
+        if (g_strv_contains ((const char * const *) pending->interfaces, type_name))
+        {
+            pending_modules = g_list_delete_link (pending_modules, l);
+            nautilus_module_load_file (pending->path, NULL, NULL);
+            pending_module_free (pending);
+        }
     }
 }
 
@@ -248,21 +631,110 @@ free_module_objects (void)
     }
 
     g_list_free (module_objects);
+
+    g_list_free_full (pending_modules, (GDestroyNotify) pending_module_free);
+    pending_modules = NULL;
+
+    g_clear_pointer (&extension_call_stats, g_hash_table_destroy);
+}
+
+static gboolean initialized = FALSE;
+static gboolean scan_in_progress = FALSE;
+
+static const char *
+get_extension_dir (void)
+{
+    const char *dirname;
+
+    /* Lets extensions be tried out without installing them */
+    dirname = g_getenv ("NAUTILUS_EXTENSION_DIR");
+
+    return dirname != NULL ? dirname : NAUTILUS_EXTENSIONDIR;
+}
+
+static void
+finish_setup (ModuleScan *scan)
+{
+    initialized = TRUE;
+
+    load_module_dir (scan);
+
+    eel_debug_call_at_shutdown (free_module_objects);
 }
 
 void
 nautilus_module_setup (void)
 {
-    static gboolean initialized = FALSE;
+    ModuleScan *scan;
 
     if (!initialized)
     {
-        initialized = TRUE;
+        scan = scan_module_dir (get_extension_dir ());
+        finish_setup (scan);
+        module_scan_free (scan);
+    }
+}
 
-        load_module_dir (NAUTILUS_EXTENSIONDIR);
+static void
+scan_module_dir_thread (GTask        *task,
+                        gpointer      source_object,
+                        gpointer      task_data,
+                        GCancellable *cancellable)
+{
+    g_task_return_pointer (task,
+                           scan_module_dir (task_data),
+                           (GDestroyNotify) module_scan_free);
+}
 
-        eel_debug_call_at_shutdown (free_module_objects);
+static void
+scan_module_dir_done (GObject      *source_object,
+                      GAsyncResult *res,
+                      gpointer      user_data)
+{
+    ModuleScan *scan;
+
+    scan_in_progress = FALSE;
+    scan = g_task_propagate_pointer (G_TASK (res), NULL);
+
+    /* Somebody may have set things up synchronously before we got here */
+    if (!initialized)
+    {
+        finish_setup (scan);
+
+        /* Whoever asked for extensions in the meantime only got the
+         * built-in ones */
+        g_signal_emit_by_name (nautilus_signaller_get_current (),
+                               "extensions-loaded");
     }
+
+    module_scan_free (scan);
+}
+
+/**
+ * nautilus_module_setup_in_background:
+ *
+ * Like nautilus_module_setup(), but reads the extension directory and
+ * the manifest in a worker thread. Modules are registered back on the
+ * main thread, after which "extensions-loaded" is emitted on the
+ * #NautilusSignaller. Until then, asking for extensions only returns
+ * those that are already there.
+ */
+void
+nautilus_module_setup_in_background (void)
+{
+    GTask *task;
+
+    if (initialized || scan_in_progress)
+    {
+        return;
+    }
+
+    scan_in_progress = TRUE;
+
+    task = g_task_new (NULL, NULL, scan_module_dir_done, NULL);
+    g_task_set_task_data (task, g_strdup (get_extension_dir ()), g_free);
+    g_task_run_in_thread (task, scan_module_dir_thread);
+    g_object_unref (task);
 }
 
 GList *
@@ -271,10 +743,18 @@ nautilus_module_get_extensions_for_type (GType type)
     GList *l;
     GList *ret = NULL;
 
+    /* Don't wait for a scan that is running in the background */
+    if (!scan_in_progress)
+    {
+        nautilus_module_setup ();
+    }
+    load_pending_modules_for_type (type);
+
     for (l = module_objects; l != NULL; l = l->next)
     {
         if (G_TYPE_CHECK_INSTANCE_TYPE (G_OBJECT (l->data),
-                                        type))
+                                        type) &&
+            !nautilus_module_is_quarantined (l->data))
         {
             g_object_ref (l->data);
             ret = g_list_prepend (ret, l->data);
@@ -300,12 +780,226 @@ nautilus_module_extension_list_free (GList *extensions)
 void
 nautilus_module_add_type (GType type)
 {
-    GObject *object;
+    nautilus_module_add_object (g_object_new (type, NULL));
+}
+
+/* Like nautilus_module_add_object(), for objects whose type doesn't
+ * tell which extension they stand for */
+void
+nautilus_module_add_extension_object (GObject    *object,
+                                      const char *extension_name)
+{
+    if (extension_name_quark == 0)
+    {
+        extension_name_quark = g_quark_from_static_string ("nautilus-module-extension-name");
+    }
+
+    g_object_set_qdata_full (object, extension_name_quark,
+                             g_strdup (extension_name), g_free);
+    nautilus_module_add_object (object);
+}
+
+static ExtensionCallStats *get_call_stats (GObject *extension);
+
+/* Takes over @object, which lives until shutdown */
+void
+nautilus_module_add_object (GObject *object)
+{
+    get_call_stats (object);
 
-    object = g_object_new (type, NULL);
     g_object_weak_ref (object,
                        (GWeakNotify) module_object_weak_notify,
                        NULL);
 
     module_objects = g_list_prepend (module_objects, object);
+    module_objects_serial++;
+}
+
+/**
+ * nautilus_module_load_for_host:
+ * @filename: the module to load
+ *
+ * Loads @filename into this process, wherever it asked to be run. This
+ * is what nautilus-extension-host uses.
+ *
+ * Returns: (transfer full): the extension objects the module provides,
+ * or %NULL if it could not be loaded
+ */
+GList *
+nautilus_module_load_for_host (const char *filename)
+{
+    GList *old_objects, *l;
+    GList *ret = NULL;
+
+    old_objects = module_objects;
+    nautilus_module_load_file (filename, NULL, NULL);
+
+    /* New objects are prepended */
+    for (l = module_objects; l != old_objects; l = l->next)
+    {
+        ret = g_list_prepend (ret, g_object_ref (l->data));
+    }
+
+    return ret;
+}
+
+/* Names the extension @extension belongs to, for the log and for the
+ * user. Everything an extension provides shares the name, which is also
+ * what its call statistics are kept under. */
+static char *
+get_extension_name (GObject *extension)
+{
+    const char *name;
+    GTypePlugin *plugin;
+    char *basename;
+    char *ret;
+
+    name = g_object_get_qdata (extension, extension_name_quark);
+    if (name != NULL)
+    {
+        return g_strdup (name);
+    }
+
+    plugin = g_type_get_plugin (G_OBJECT_TYPE (extension));
+    if (plugin == NULL || !NAUTILUS_IS_MODULE (plugin))
+    {
+        return g_strdup (G_OBJECT_TYPE_NAME (extension));
+    }
+
+    basename = g_path_get_basename (NAUTILUS_MODULE (plugin)->path);
+    ret = g_strdup_printf ("%s (%s)", G_OBJECT_TYPE_NAME (extension), basename);
+    g_free (basename);
+
+    return ret;
+}
+
+static ExtensionCallStats *
+get_call_stats (GObject *extension)
+{
+    ExtensionCallStats *stats;
+    char *name;
+    char *metric_name;
+
+    if (call_stats_quark == 0)
+    {
+        call_stats_quark = g_quark_from_static_string ("nautilus-module-call-stats");
+    }
+
+    stats = g_object_get_qdata (extension, call_stats_quark);
+    if (stats != NULL)
+    {
+        return stats;
+    }
+
+    if (extension_call_stats == NULL)
+    {
+        extension_call_stats = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                                      g_free, g_free);
+    }
+
+    /* Other objects of the same extension may have made them already */
+    name = get_extension_name (extension);
+    stats = g_hash_table_lookup (extension_call_stats, name);
+    if (stats == NULL)
+    {
+        stats = g_new0 (ExtensionCallStats, 1);
+        stats->name = name;
+        /* Metrics keep their names for good */
+        metric_name = g_strdup_printf ("extension-call-time:%s", name);
+        stats->metric_name = g_intern_string (metric_name);
+        g_free (metric_name);
+        g_hash_table_insert (extension_call_stats, name, stats);
+    }
+    else
+    {
+        g_free (name);
+    }
+
+    /* The table owns them, and outlives the extension objects */
+    g_object_set_qdata (extension, call_stats_quark, stats);
+
+    return stats;
+}
+
+/**
+ * nautilus_module_record_call:
+ * @extension: the extension object that was called
+ * @call: what was called, for the log
+ * @duration: how long the call took, in microseconds
+ *
+ * Accounts a synchronous call into an extension, and quarantines the
+ * extension if it keeps going over the latency budget.
+ */
+void
+nautilus_module_record_call (gpointer    extension,
+                             const char *call,
+                             gint64      duration)
+{
+    ExtensionCallStats *stats;
+    gint64 oldest;
+
+    g_return_if_fail (G_IS_OBJECT (extension));
+
+    stats = get_call_stats (extension);
+    nautilus_metrics_observe (stats->metric_name, duration);
+
+    if (duration <= EXTENSION_CALL_BUDGET)
+    {
+        return;
+    }
+
+    stats->slow_calls++;
+    g_message ("Extension %s took %" G_GINT64_FORMAT " ms in %s",
+               stats->name, duration / 1000, call);
+
+    stats->strikes[stats->next_strike] = g_get_monotonic_time ();
+    stats->next_strike = (stats->next_strike + 1) % QUARANTINE_STRIKES;
+
+    /* The slot we will overwrite next holds the oldest strike */
+    oldest = stats->strikes[stats->next_strike];
+    if (!stats->quarantined && stats->slow_calls >= QUARANTINE_STRIKES &&
+        g_get_monotonic_time () - oldest <= QUARANTINE_WINDOW)
+    {
+        stats->quarantined = TRUE;
+        g_warning ("Extension %s keeps blocking the user interface and has been "
+                   "disabled for this session", stats->name);
+        module_objects_serial++;
+
+        if (quarantine_func != NULL)
+        {
+            quarantine_func (stats->name, quarantine_func_data);
+        }
+    }
+}
+
+gboolean
+nautilus_module_is_quarantined (gpointer extension)
+{
+    ExtensionCallStats *stats;
+
+    /* Every extension object gets its stats when it is added */
+    stats = call_stats_quark != 0 ? g_object_get_qdata (extension, call_stats_quark) : NULL;
+
+    return stats != NULL && stats->quarantined;
+}
+
+/* Lets the application tell the user when an extension gets disabled */
+void
+nautilus_module_set_quarantine_func (NautilusModuleQuarantineFunc func,
+                                     gpointer                     user_data)
+{
+    quarantine_func = func;
+    quarantine_func_data = user_data;
+}
+
+/**
+ * nautilus_module_get_serial:
+ *
+ * Returns: a number that changes whenever an extension object is added
+ * or goes away, for callers caching what they built from the extensions.
+ */
+guint
+nautilus_module_get_serial (void)
+{
+    return module_objects_serial;
 }
@@ -27,14 +27,33 @@
 
 G_BEGIN_DECLS
 
+typedef void (*NautilusModuleQuarantineFunc) (const char *extension_name,
+                                              gpointer    user_data);
+
 void   nautilus_module_setup                   (void);
+void   nautilus_module_setup_in_background     (void);
 GList *nautilus_module_get_extensions_for_type (GType  type);
 void   nautilus_module_extension_list_free     (GList *list);
+guint  nautilus_module_get_serial              (void);
+
+/* Watchdog for synchronous calls into extensions */
+void     nautilus_module_record_call         (gpointer                      extension,
+                                              const char                   *call,
+                                              gint64                        duration);
+gboolean nautilus_module_is_quarantined      (gpointer                      extension);
+void     nautilus_module_set_quarantine_func (NautilusModuleQuarantineFunc  func,
+                                              gpointer                      user_data);
 
 
 /* Add a type to the module interface - allows nautilus to add its own modules
  * without putting them in separate shared libraries */
 void   nautilus_module_add_type                (GType  type);
+void   nautilus_module_add_object              (GObject *object);
+void   nautilus_module_add_extension_object    (GObject    *object,
+                                                const char *extension_name);
+
+/* For nautilus-extension-host */
+GList *nautilus_module_load_for_host           (const char *filename);
 
 G_END_DECLS
 
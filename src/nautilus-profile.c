@@ -20,50 +20,395 @@
 
 #include "config.h"
 
-#include <stdio.h>
-#include <string.h>
-#include <stdarg.h>
 #include <signal.h>
-#include <time.h>
+#include <stdarg.h>
+#include <string.h>
 #include <unistd.h>
 
 #include <glib.h>
 #include <glib/gstdio.h>
+#include <glib-unix.h>
 
 #include "nautilus-profile.h"
 
+/* Must be a power of two, so that the ring index survives the event
+ * counter wrapping around */
+#define TRACE_BUFFER_SIZE 4096
+#define TRACE_DETAIL_SIZE 64
+/* Events this close to being overwritten are left out of a dump, as a
+ * busy thread may be rewriting them while we read */
+#define TRACE_DUMP_SLACK 64
+
+typedef struct
+{
+    gint64 time;
+    /* Static string, usually G_STRFUNC; NULL for plain messages */
+    const char *name;
+    gint64 value;
+    char phase;
+    char detail[TRACE_DETAIL_SIZE];
+} TraceEvent;
+
+/* Written only by the thread that owns it, so recording takes no locks.
+ * Buffers of threads that have exited are handed to new threads rather
+ * than freed, which keeps their events around for the next dump. */
+typedef struct
+{
+    guint id;
+    const char *thread_name;
+    /* Events written so far; published after each event is complete */
+    guint written;
+    TraceEvent events[TRACE_BUFFER_SIZE];
+} TraceBuffer;
+
+gboolean _nautilus_profile_enabled = FALSE;
+
+static gint64 trace_start_time;
+static GThread *main_thread;
+static guint next_buffer_id = 1;
+/* Protects the lists below, not the buffers */
+static GMutex trace_mutex;
+static GList *trace_buffers = NULL;
+static GList *retired_buffers = NULL;
+
+static void
+retire_buffer (gpointer data)
+{
+    g_mutex_lock (&trace_mutex);
+    retired_buffers = g_list_prepend (retired_buffers, data);
+    g_mutex_unlock (&trace_mutex);
+}
+
+static GPrivate thread_buffer = G_PRIVATE_INIT (retire_buffer);
+
+static TraceBuffer *
+get_thread_buffer (void)
+{
+    TraceBuffer *buffer;
+
+    buffer = g_private_get (&thread_buffer);
+    if (G_LIKELY (buffer != NULL))
+    {
+        return buffer;
+    }
+
+    g_mutex_lock (&trace_mutex);
+    if (retired_buffers != NULL)
+    {
+        buffer = retired_buffers->data;
+        retired_buffers = g_list_delete_link (retired_buffers, retired_buffers);
+    }
+    else
+    {
+        buffer = g_new0 (TraceBuffer, 1);
+        buffer->id = next_buffer_id++;
+        buffer->thread_name = g_thread_self () == main_thread ? "main" : "worker";
+        trace_buffers = g_list_prepend (trace_buffers, buffer);
+    }
+    g_mutex_unlock (&trace_mutex);
+
+    g_private_set (&thread_buffer, buffer);
+
+    return buffer;
+}
+
+static TraceEvent *
+begin_event (TraceBuffer *buffer,
+             const char  *name,
+             char         phase)
+{
+    TraceEvent *event;
+
+    event = &buffer->events[buffer->written % TRACE_BUFFER_SIZE];
+    event->time = g_get_monotonic_time ();
+    event->name = name;
+    event->phase = phase;
+
+    return event;
+}
+
+static void
+end_event (TraceBuffer *buffer)
+{
+    g_atomic_int_inc ((gint *) &buffer->written);
+}
+
 void
-_nautilus_profile_log (const char *func,
-                       const char *note,
+_nautilus_profile_log (const char *name,
+                       char        phase,
                        const char *format,
                        ...)
 {
+    TraceBuffer *buffer;
+    TraceEvent *event;
     va_list args;
-    char *str;
-    char *formatted;
+
+    buffer = get_thread_buffer ();
+    event = begin_event (buffer, name, phase);
+    event->value = 0;
 
     if (format == NULL)
     {
-        formatted = g_strdup ("");
+        event->detail[0] = '\0';
     }
     else
     {
         va_start (args, format);
-        formatted = g_strdup_vprintf (format, args);
+        g_vsnprintf (event->detail, TRACE_DETAIL_SIZE, format, args);
         va_end (args);
     }
 
-    if (func != NULL)
+    end_event (buffer);
+}
+
+void
+_nautilus_profile_value (const char *name,
+                         char        phase,
+                         gint64      value)
+{
+    TraceBuffer *buffer;
+    TraceEvent *event;
+
+    buffer = get_thread_buffer ();
+    event = begin_event (buffer, name, phase);
+    event->value = value;
+    event->detail[0] = '\0';
+
+    end_event (buffer);
+}
+
+static void
+append_json_string (GString    *json,
+                    const char *str)
+{
+    const char *end;
+    const char *p;
+
+    /* The detail may have been cut short in the middle of a character */
+    g_utf8_validate (str, -1, &end);
+
+    g_string_append_c (json, '"');
+    for (p = str; p < end; p++)
+    {
+        if (*p == '"' || *p == '\\')
+        {
+            g_string_append_c (json, '\\');
+            g_string_append_c (json, *p);
+        }
+        else if ((guchar) p[0] < 0x20)
+        {
+            g_string_append_printf (json, "\\u%04x", (guchar) p[0]);
+        }
+        else
+        {
+            g_string_append_c (json, *p);
+        }
+    }
+    g_string_append_c (json, '"');
+}
+
+static void
+append_event (GString     *json,
+              TraceBuffer *buffer,
+              TraceEvent  *event)
+{
+    g_string_append (json, ",\n{\"name\":");
+    append_json_string (json, event->name != NULL ? event->name : event->detail);
+    g_string_append_printf (json,
+                            ",\"cat\":\"nautilus\",\"ph\":\"%c\",\"ts\":%" G_GINT64_FORMAT
+                            ",\"pid\":%d,\"tid\":%u",
+                            event->phase, event->time - trace_start_time,
+                            (int) getpid (), buffer->id);
+
+    switch (event->phase)
+    {
+        case 'b':
+        case 'e':
+        {
+            g_string_append_printf (json, ",\"id\":\"0x%" G_GINT64_MODIFIER "x\"", event->value);
+        }
+        break;
+
+        case 'C':
+        {
+            g_string_append_printf (json, ",\"args\":{\"value\":%" G_GINT64_FORMAT "}", event->value);
+        }
+        break;
+
+        case 'i':
+        {
+            g_string_append (json, ",\"s\":\"t\"");
+        }
+        break;
+
+        default:
+        {
+            if (event->detail[0] != '\0')
+            {
+                g_string_append (json, ",\"args\":{\"detail\":");
+                append_json_string (json, event->detail);
+                g_string_append_c (json, '}');
+            }
+        }
+        break;
+    }
+
+    g_string_append_c (json, '}');
+}
+
+static void
+append_buffer (GString     *json,
+               TraceBuffer *buffer)
+{
+    guint written, n_events, i;
+
+    g_string_append_printf (json,
+                            ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%u,"
+                            "\"args\":{\"name\":\"%s\"}}",
+                            (int) getpid (), buffer->id, buffer->thread_name);
+
+    written = (guint) g_atomic_int_get ((gint *) &buffer->written);
+    n_events = MIN (written, TRACE_BUFFER_SIZE - TRACE_DUMP_SLACK);
+
+    for (i = written - n_events; i != written; i++)
+    {
+        append_event (json, buffer, &buffer->events[i % TRACE_BUFFER_SIZE]);
+    }
+}
+
+/**
+ * nautilus_profile_dump:
+ * @filename: where to write the trace
+ * @error: return location for an error
+ *
+ * Writes out what the buffers of all threads hold, as a Chrome
+ * trace-event JSON file with one event per line.
+ */
+gboolean
+nautilus_profile_dump (const char  *filename,
+                       GError     **error)
+{
+    GString *json;
+    GList *l;
+    gboolean ret;
+
+    json = g_string_new ("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    g_string_append_printf (json,
+                            "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,"
+                            "\"args\":{\"name\":\"%s\"}}",
+                            (int) getpid (), g_get_prgname ());
+
+    g_mutex_lock (&trace_mutex);
+    for (l = trace_buffers; l != NULL; l = l->next)
+    {
+        append_buffer (json, l->data);
+    }
+    g_mutex_unlock (&trace_mutex);
+
+    g_string_append (json, "\n]}\n");
+
+    ret = g_file_set_contents (filename, json->str, json->len, error);
+    g_string_free (json, TRUE);
+
+    return ret;
+}
+
+void
+nautilus_profile_set_enabled (gboolean enabled)
+{
+    _nautilus_profile_enabled = enabled;
+}
+
+static char *
+get_trace_filename (void)
+{
+    const char *filename;
+    char *basename;
+    char *ret;
+
+    filename = g_getenv ("NAUTILUS_TRACE");
+    if (filename != NULL && filename[0] != '\0')
+    {
+        return g_strdup (filename);
+    }
+
+    basename = g_strdup_printf ("trace-%d.json", (int) getpid ());
+    ret = g_build_filename (g_get_user_cache_dir (), "nautilus", basename, NULL);
+    g_free (basename);
+
+    return ret;
+}
+
+static gboolean
+dump_signal_callback (gpointer user_data)
+{
+    char *filename;
+    char *dirname;
+    GError *error;
+
+    if (!_nautilus_profile_enabled)
     {
-        str = g_strdup_printf ("MARK: %s %s: %s %s", g_get_prgname (), func, note ? note : "", formatted);
+        g_message ("Recording a trace; send SIGUSR1 again to write it out");
+        nautilus_profile_set_enabled (TRUE);
+        return G_SOURCE_CONTINUE;
+    }
+
+    filename = get_trace_filename ();
+    dirname = g_path_get_dirname (filename);
+    g_mkdir_with_parents (dirname, 0700);
+
+    error = NULL;
+    if (nautilus_profile_dump (filename, &error))
+    {
+        g_message ("Trace written to %s", filename);
     }
     else
     {
-        str = g_strdup_printf ("MARK: %s: %s %s", g_get_prgname (), note ? note : "", formatted);
+        g_warning ("Could not write trace: %s", error->message);
+        g_error_free (error);
+    }
+
+    g_free (dirname);
+    g_free (filename);
+
+    return G_SOURCE_CONTINUE;
+}
+
+/* Call early from main() */
+void
+nautilus_profile_init (void)
+{
+    const char *filename;
+
+    trace_start_time = g_get_monotonic_time ();
+    main_thread = g_thread_self ();
+
+    filename = g_getenv ("NAUTILUS_TRACE");
+    if (filename != NULL && filename[0] != '\0')
+    {
+        nautilus_profile_set_enabled (TRUE);
     }
 
-    g_free (formatted);
+    g_unix_signal_add (SIGUSR1, dump_signal_callback, NULL);
+}
 
-    g_access (str, F_OK);
-    g_free (str);
+/* Writes the trace out if NAUTILUS_TRACE asked for it */
+void
+nautilus_profile_shutdown (void)
+{
+    const char *filename;
+    GError *error;
+
+    filename = g_getenv ("NAUTILUS_TRACE");
+    if (!_nautilus_profile_enabled || filename == NULL || filename[0] == '\0')
+    {
+        return;
+    }
+
+    error = NULL;
+    if (!nautilus_profile_dump (filename, &error))
+    {
+        g_warning ("Could not write trace: %s", error->message);
+        g_error_free (error);
+    }
 }
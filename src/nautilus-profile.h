@@ -16,11 +16,15 @@
  *
  * Authors: William Jon McCann <mccann@jhu.edu>
  *
- * Can be profiled like so:
- *       strace -ttt -f -o /tmp/logfile.strace nautilus
- *       python plot-timeline.py -o prettygraph.png /tmp/logfile.strace
+ * Events are recorded into per-thread ring buffers and written out as
+ * Chrome trace-event JSON, which chrome://tracing and similar viewers
+ * can load. Recording is off unless turned on:
  *
- *       See: http://www.gnome.org/~federico/news-2006-03.html#09
+ *       NAUTILUS_TRACE=/tmp/nautilus-trace.json nautilus
+ *
+ * records from startup and writes the file at exit. Sending SIGUSR1 to
+ * a running nautilus starts recording, and once recording writes the
+ * buffers out, to $NAUTILUS_TRACE or to a file in the user cache dir.
  */
 
 #ifndef __NAUTILUS_PROFILE_H
@@ -30,26 +34,53 @@
 
 G_BEGIN_DECLS
 
+/* Read without synchronization; a thread may record a few events late
+ * or miss a few after recording is toggled, which is fine */
+extern gboolean _nautilus_profile_enabled;
+
+#define NAUTILUS_PROFILE_EVENT(call) \
+    G_STMT_START { if (G_UNLIKELY (_nautilus_profile_enabled)) call; } G_STMT_END
+
 #ifdef ENABLE_PROFILING
 #ifdef G_HAVE_ISO_VARARGS
-#define nautilus_profile_start(...) _nautilus_profile_log (G_STRFUNC, "start", __VA_ARGS__)
-#define nautilus_profile_end(...)   _nautilus_profile_log (G_STRFUNC, "end", __VA_ARGS__)
-#define nautilus_profile_msg(...)   _nautilus_profile_log (NULL, NULL, __VA_ARGS__)
+#define nautilus_profile_start(...) NAUTILUS_PROFILE_EVENT (_nautilus_profile_log (G_STRFUNC, 'B', __VA_ARGS__))
+#define nautilus_profile_end(...)   NAUTILUS_PROFILE_EVENT (_nautilus_profile_log (G_STRFUNC, 'E', __VA_ARGS__))
+#define nautilus_profile_msg(...)   NAUTILUS_PROFILE_EVENT (_nautilus_profile_log (NULL, 'i', __VA_ARGS__))
 #elif defined(G_HAVE_GNUC_VARARGS)
-#define nautilus_profile_start(format...) _nautilus_profile_log (G_STRFUNC, "start", format)
-#define nautilus_profile_end(format...)   _nautilus_profile_log (G_STRFUNC, "end", format)
-#define nautilus_profile_msg(format...)   _nautilus_profile_log (NULL, NULL, format)
+#define nautilus_profile_start(format...) NAUTILUS_PROFILE_EVENT (_nautilus_profile_log (G_STRFUNC, 'B', format))
+#define nautilus_profile_end(format...)   NAUTILUS_PROFILE_EVENT (_nautilus_profile_log (G_STRFUNC, 'E', format))
+#define nautilus_profile_msg(format...)   NAUTILUS_PROFILE_EVENT (_nautilus_profile_log (NULL, 'i', format))
 #endif
+/* For work that starts and finishes in different places; @name must be
+ * a static string and @id tells overlapping instances apart */
+#define nautilus_profile_async_start(name, id) \
+    NAUTILUS_PROFILE_EVENT (_nautilus_profile_value (name, 'b', GPOINTER_TO_SIZE (id)))
+#define nautilus_profile_async_end(name, id) \
+    NAUTILUS_PROFILE_EVENT (_nautilus_profile_value (name, 'e', GPOINTER_TO_SIZE (id)))
+#define nautilus_profile_counter(name, value) \
+    NAUTILUS_PROFILE_EVENT (_nautilus_profile_value (name, 'C', value))
 #else
 #define nautilus_profile_start(...)
 #define nautilus_profile_end(...)
 #define nautilus_profile_msg(...)
+#define nautilus_profile_async_start(name, id)
+#define nautilus_profile_async_end(name, id)
+#define nautilus_profile_counter(name, value)
 #endif
 
-void            _nautilus_profile_log    (const char *func,
-                                          const char *note,
+void            nautilus_profile_init         (void);
+void            nautilus_profile_shutdown     (void);
+void            nautilus_profile_set_enabled  (gboolean     enabled);
+gboolean        nautilus_profile_dump         (const char  *filename,
+                                               GError     **error);
+
+void            _nautilus_profile_log    (const char *name,
+                                          char        phase,
                                           const char *format,
                                           ...) G_GNUC_PRINTF (3, 4);
+void            _nautilus_profile_value  (const char *name,
+                                          char        phase,
+                                          gint64      value);
 
 G_END_DECLS
 
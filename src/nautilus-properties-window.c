@@ -4730,11 +4730,15 @@ append_extension_pages (NautilusPropertiesWindow *window)
         NautilusPropertyPageProvider *provider;
         GList *pages;
         GList *l;
+        gint64 start;
 
         provider = NAUTILUS_PROPERTY_PAGE_PROVIDER (p->data);
 
+        start = g_get_monotonic_time ();
         pages = nautilus_property_page_provider_get_pages
                     (provider, window->details->original_files);
+        nautilus_module_record_call (provider, "get_pages",
+                                     g_get_monotonic_time () - start);
 
         for (l = pages; l != NULL; l = l->next)
         {
@@ -26,6 +26,7 @@
 #include "nautilus-search-engine.h"
 #include "nautilus-search-engine-simple.h"
 #include "nautilus-search-engine-model.h"
+#include "nautilus-profile.h"
 #define DEBUG_FLAG NAUTILUS_DEBUG_SEARCH
 #include "nautilus-debug.h"
 
@@ -100,6 +101,8 @@ search_engine_start_real (NautilusSearchEngine *engine)
 
     DEBUG ("Search engine start real");
 
+    nautilus_profile_async_start ("search", engine);
+
     g_object_ref (engine);
 
 #ifdef ENABLE_TRACKER
@@ -210,6 +213,8 @@ search_provider_hits_added (NautilusSearchProvider *provider,
         }
         g_hash_table_replace (priv->uris, g_strdup (uri), GINT_TO_POINTER (++count));
     }
+    nautilus_profile_counter ("search-hits", g_hash_table_size (priv->uris));
+
     if (added != NULL)
     {
         added = g_list_reverse (added);
@@ -232,6 +237,8 @@ check_providers_status (NautilusSearchEngine *engine)
         return;
     }
 
+    nautilus_profile_async_end ("search", engine);
+
     if (num_finished == priv->providers_error)
     {
         DEBUG ("Search engine error");
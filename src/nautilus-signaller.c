@@ -36,6 +36,7 @@ enum
     HISTORY_LIST_CHANGED,
     POPUP_MENU_CHANGED,
     MIME_DATA_CHANGED,
+    EXTENSIONS_LOADED,
     LAST_SIGNAL
 };
 
@@ -90,4 +91,12 @@ nautilus_signaller_class_init (NautilusSignallerClass *class)
                       NULL, NULL,
                       g_cclosure_marshal_VOID__VOID,
                       G_TYPE_NONE, 0);
+    signals[EXTENSIONS_LOADED] =
+        g_signal_new ("extensions-loaded",
+                      G_TYPE_FROM_CLASS (class),
+                      G_SIGNAL_RUN_LAST,
+                      0,
+                      NULL, NULL,
+                      g_cclosure_marshal_VOID__VOID,
+                      G_TYPE_NONE, 0);
 }
@@ -28,20 +28,30 @@
 #include "nautilus-directory-notify.h"
 #include "nautilus-global-preferences.h"
 #include "nautilus-file-utilities.h"
+#include "nautilus-metrics.h"
+#include "nautilus-progress-info.h"
+#include "nautilus-profile.h"
 #include <math.h>
 #include <eel/eel-graphic-effects.h>
 #include <eel/eel-string.h>
 #include <eel/eel-debug.h>
 #include <eel/eel-vfs-extensions.h>
 #include <gtk/gtk.h>
+#include <glib/gi18n.h>
 #include <errno.h>
 #include <stdio.h>
 #include <string.h>
 #include <sys/wait.h>
+#include <sys/syscall.h>
 #include <unistd.h>
 #include <signal.h>
 #include <libgnome-desktop/gnome-desktop-thumbnail.h>
 
+#ifdef HAVE_EXIF
+  #include <libexif/exif-data.h>
+  #include <libexif/exif-utils.h>
+#endif
+
 #include "nautilus-file-private.h"
 
 /* turn this on to see messages about thumbnail creation */
@@ -55,10 +65,72 @@
 /* Cool-off period between last file modification time and thumbnail creation */
 #define THUMBNAIL_CREATION_DELAY_SECS 3
 
+/* Size of the thumbnails produced by our factory, see get_thumbnail_factory() */
+#define THUMBNAIL_FACTORY_SIZE 256
+
+#define FAST_PATH_READ_BUFFER_SIZE 65536
+
+/* Background pre-generation yields to interactive thumbnail requests, and
+ * only resumes once none arrived for this long. */
+#define PREGENERATION_RESUME_DELAY_SECS 2
+
+/* Minimum time between two writes of the pre-generation checkpoint file */
+#define PREGENERATION_CHECKPOINT_INTERVAL_SECS 5
+
+#define PREGENERATION_ATTRIBUTES \
+    G_FILE_ATTRIBUTE_STANDARD_TYPE "," \
+    G_FILE_ATTRIBUTE_STANDARD_NAME "," \
+    G_FILE_ATTRIBUTE_STANDARD_IS_HIDDEN "," \
+    G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE "," \
+    G_FILE_ATTRIBUTE_STANDARD_SIZE "," \
+    G_FILE_ATTRIBUTE_TIME_MODIFIED "," \
+    G_FILE_ATTRIBUTE_THUMBNAIL_PATH "," \
+    G_FILE_ATTRIBUTE_THUMBNAILING_FAILED "," \
+    G_FILE_ATTRIBUTE_THUMBNAIL_IS_VALID
+
+/* Linux only, glibc has no wrapper for these */
+#if defined (__linux__) && defined (SYS_ioprio_set) && defined (SYS_ioprio_get)
+#define HAVE_IOPRIO 1
+#define IOPRIO_CLASS_SHIFT 13
+#define IOPRIO_CLASS_IDLE 3
+#define IOPRIO_WHO_PROCESS 1
+#endif
+
 static void thumbnail_thread_func (GTask        *task,
                                    gpointer      source_object,
                                    gpointer      task_data,
                                    GCancellable *cancellable);
+static gboolean pregeneration_batch_done_cb (gpointer data);
+
+typedef struct
+{
+    GFile *root;
+    char *root_uri;
+    NautilusProgressInfo *progress;
+    GCancellable *cancellable;
+    gulong cancelled_id;
+    guint64 size_limit;
+
+    /* Folders left to walk, and the one being walked. The main loop only
+     * touches these between the scans of two folders. */
+    GQueue folders;
+    GFile *folder;
+    gboolean folder_completed;
+    gboolean checkpoint_loaded;
+
+    /* Thumbnails queued by this job and not done yet, whether the job is
+     * waiting for them, and how many thumbnails were made.
+     * Lock thumbnails_mutex when accessing these. */
+    guint pending;
+    gboolean waiting;
+    guint made;
+
+    guint folders_scanned;
+
+    /* Folders whose files have all been thumbnailed, kept across runs */
+    GHashTable *completed_folders;
+    gint64 last_checkpoint_time;
+} PregenerationJob;
 
 /* structure used for making thumbnails, associating a uri with where the thumbnail is to be stored */
 
@@ -67,6 +139,8 @@ typedef struct
     char *image_uri;
     char *mime_type;
     time_t original_file_mtime;
+    /* The pre-generation job that queued this, NULL for interactive requests */
+    PregenerationJob *job;
 } NautilusThumbnailInfo;
 
 /*
@@ -97,6 +171,17 @@ static GHashTable *thumbnails_to_make_hash = NULL;
  * to avoid adding it again. Lock thumbnails_mutex when accessing this. */
 static NautilusThumbnailInfo *currently_thumbnailing = NULL;
 
+/* Thumbnails queued by pre-generation jobs. They are only made while
+ *  thumbnails_to_make is empty. Lock thumbnails_mutex when accessing these. */
+static GQueue background_thumbnails_to_make = G_QUEUE_INIT;
+static GHashTable *background_thumbnails_hash = NULL;
+
+/* Monotonic time of the last interactive request, and whether a timeout is
+ *  pending to resume background work. Lock thumbnails_mutex when accessing
+ *  these. */
+static gint64 last_interactive_request_time = 0;
+static gboolean background_resume_scheduled = FALSE;
+
 static GnomeDesktopThumbnailFactory *thumbnail_factory = NULL;
 
 static gboolean
@@ -135,6 +220,37 @@ free_thumbnail_info (NautilusThumbnailInfo *info)
     g_free (info);
 }
 
+/* Called with thumbnails_mutex locked */
+static void
+update_queue_metric (void)
+{
+    nautilus_metrics_gauge_set ("thumbnail-queue",
+                                g_queue_get_length ((GQueue *) &thumbnails_to_make) +
+                                g_queue_get_length (&background_thumbnails_to_make));
+}
+
+/* Called with thumbnails_mutex locked */
+static void
+remove_background_thumbnail (GList *node)
+{
+    NautilusThumbnailInfo *info;
+
+    info = node->data;
+    g_hash_table_remove (background_thumbnails_hash, info->image_uri);
+    g_queue_delete_link (&background_thumbnails_to_make, node);
+    update_queue_metric ();
+
+    info->job->pending--;
+    if (info->job->pending == 0 && info->job->waiting)
+    {
+        /* The job goes on with the next folder from the main loop */
+        info->job->waiting = FALSE;
+        g_idle_add (pregeneration_batch_done_cb, info->job);
+    }
+
+    free_thumbnail_info (info);
+}
+
 static GnomeDesktopThumbnailFactory *
 get_thumbnail_factory (void)
 {
@@ -142,6 +258,7 @@ get_thumbnail_factory (void)
 
     if (thumbnail_factory == NULL)
     {
+        /* Keep THUMBNAIL_FACTORY_SIZE in sync with this */
         thumbnail_factory = gnome_desktop_thumbnail_factory_new (GNOME_DESKTOP_THUMBNAIL_SIZE_LARGE);
     }
 
@@ -205,6 +322,17 @@ nautilus_thumbnail_remove_from_queue (const char *file_uri)
             g_hash_table_remove (thumbnails_to_make_hash, file_uri);
             free_thumbnail_info (node->data);
             g_queue_delete_link ((GQueue *) &thumbnails_to_make, node);
+            update_queue_metric ();
+        }
+    }
+
+    if (background_thumbnails_hash)
+    {
+        node = g_hash_table_lookup (background_thumbnails_hash, file_uri);
+
+        if (node && node->data != currently_thumbnailing)
+        {
+            remove_background_thumbnail (node);
         }
     }
 
@@ -221,6 +349,7 @@ nautilus_thumbnail_remove_from_queue (const char *file_uri)
 void
 nautilus_thumbnail_prioritize (const char *file_uri)
 {
+    NautilusThumbnailInfo *info, *background_info;
     GList *node;
 
 #ifdef DEBUG_THUMBNAILS
@@ -243,6 +372,39 @@ nautilus_thumbnail_prioritize (const char *file_uri)
         }
     }
 
+    /* A file a pre-generation job queued is being looked at now, so it
+     *  becomes an interactive request, ahead of the others */
+    node = background_thumbnails_hash != NULL ?
+           g_hash_table_lookup (background_thumbnails_hash, file_uri) : NULL;
+    if (node && node->data != currently_thumbnailing)
+    {
+        background_info = node->data;
+
+        info = g_new0 (NautilusThumbnailInfo, 1);
+        info->image_uri = g_strdup (background_info->image_uri);
+        info->mime_type = g_strdup (background_info->mime_type);
+        info->original_file_mtime = background_info->original_file_mtime;
+        remove_background_thumbnail (node);
+
+        if (thumbnails_to_make_hash == NULL)
+        {
+            thumbnails_to_make_hash = g_hash_table_new (g_str_hash,
+                                                        g_str_equal);
+        }
+        g_queue_push_head ((GQueue *) &thumbnails_to_make, info);
+        g_hash_table_insert (thumbnails_to_make_hash,
+                             info->image_uri,
+                             g_queue_peek_head_link ((GQueue *) &thumbnails_to_make));
+        update_queue_metric ();
+        last_interactive_request_time = g_get_monotonic_time ();
+
+        if (thumbnail_thread_is_running == FALSE &&
+            thumbnail_thread_starter_id == 0)
+        {
+            thumbnail_thread_starter_id = g_idle_add_full (G_PRIORITY_LOW, thumbnail_thread_starter_cb, NULL, NULL);
+        }
+    }
+
     /*********************************
      * MUTEX UNLOCKED
      *********************************/
@@ -258,6 +420,69 @@ nautilus_thumbnail_prioritize (const char *file_uri)
  * Thumbnail Thread Functions.
  ***************************************************************************/
 
+/* Puts the calling thread, and the thumbnailers it spawns, in the idle I/O
+ *  class. Returns the previous priority for thread_restore_io_priority(),
+ *  or -1 if it could not be changed. */
+static int
+thread_set_io_priority_idle (void)
+{
+#ifdef HAVE_IOPRIO
+    int old_priority;
+
+    old_priority = syscall (SYS_ioprio_get, IOPRIO_WHO_PROCESS, 0);
+    if (old_priority < 0)
+    {
+        return -1;
+    }
+
+    if (syscall (SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0,
+                 IOPRIO_CLASS_IDLE << IOPRIO_CLASS_SHIFT) < 0)
+    {
+        return -1;
+    }
+
+    return old_priority;
+#else
+    return -1;
+#endif
+}
+
+static void
+thread_restore_io_priority (int old_priority)
+{
+#ifdef HAVE_IOPRIO
+    if (old_priority >= 0)
+    {
+        syscall (SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, old_priority);
+    }
+#endif
+}
+
+/* Called from the main loop with thumbnails_mutex locked */
+static void
+start_background_thumbnails (void)
+{
+    if (!g_queue_is_empty (&background_thumbnails_to_make) &&
+        thumbnail_thread_is_running == FALSE &&
+        thumbnail_thread_starter_id == 0)
+    {
+        thumbnail_thread_starter_id = g_idle_add_full (G_PRIORITY_LOW, thumbnail_thread_starter_cb, NULL, NULL);
+    }
+}
+
+static gboolean
+resume_background_thumbnails_cb (gpointer data)
+{
+    g_mutex_lock (&thumbnails_mutex);
+
+    background_resume_scheduled = FALSE;
+    start_background_thumbnails ();
+
+    g_mutex_unlock (&thumbnails_mutex);
+
+    return FALSE;
+}
+
 
 /* This is a one-shot idle callback called from the main loop to call
  *  notify_file_changed() for a thumbnail. It frees the uri afterwards.
@@ -353,6 +578,276 @@ nautilus_thumbnail_is_mimetype_limited_by_size (const char *mime_type)
     return pixbuf_can_load_type (mime_type);
 }
 
+static gboolean
+mime_type_is_jpeg (const char *mime_type)
+{
+    return g_strcmp0 (mime_type, "image/jpeg") == 0 ||
+           g_strcmp0 (mime_type, "image/pjpeg") == 0;
+}
+
+gboolean
+nautilus_thumbnail_has_fast_path (const char *mime_type)
+{
+    if (mime_type == NULL)
+    {
+        return FALSE;
+    }
+
+    /* This is called from the thumbnail thread, so don't touch the lazily
+     * built types table here. A missing JPEG loader is handled when
+     * creating the GdkPixbufLoader instead.
+     *
+     * Camera raw formats are left to the factory: most are TIFF based and
+     * keep their previews in IFDs that libexif does not hand out. */
+    return mime_type_is_jpeg (mime_type);
+}
+
+static void
+fast_path_size_prepared (GdkPixbufLoader *loader,
+                         int              width,
+                         int              height,
+                         gpointer         user_data)
+{
+    int size;
+    double scale;
+
+    size = GPOINTER_TO_INT (user_data);
+    if (MAX (width, height) <= size)
+    {
+        return;
+    }
+
+    /* Asking for a smaller size before the first scanline is decoded makes
+     * the JPEG loader pick a libjpeg scale_denom, so most of the DCT work
+     * for the full resolution image is never done. */
+    scale = (double) size / MAX (width, height);
+    gdk_pixbuf_loader_set_size (loader,
+                                MAX (width * scale, 1),
+                                MAX (height * scale, 1));
+}
+
+#ifdef HAVE_EXIF
+static void
+embedded_preview_size_prepared (GdkPixbufLoader *loader,
+                                int              width,
+                                int              height,
+                                gpointer         user_data)
+{
+    /* Most cameras only embed a 160x120 preview. Upscaling that would give
+     * a visibly worse thumbnail than the factory, so only use previews that
+     * are at least as large as the thumbnail we are asked for, and stop
+     * before decoding the others. */
+    if (MAX (width, height) < GPOINTER_TO_INT (user_data))
+    {
+        gdk_pixbuf_loader_set_size (loader, 0, 0);
+        return;
+    }
+
+    fast_path_size_prepared (loader, width, height, user_data);
+}
+#endif /*HAVE_EXIF*/
+
+static GdkPixbuf *
+scale_to_thumbnail_size (GdkPixbuf *pixbuf,
+                         int        size)
+{
+    GdkPixbuf *scaled;
+    int width, height;
+    double scale;
+
+    width = gdk_pixbuf_get_width (pixbuf);
+    height = gdk_pixbuf_get_height (pixbuf);
+    if (MAX (width, height) <= size)
+    {
+        return pixbuf;
+    }
+
+    scale = (double) size / MAX (width, height);
+    scaled = gdk_pixbuf_scale_simple (pixbuf,
+                                      MAX (width * scale, 1),
+                                      MAX (height * scale, 1),
+                                      GDK_INTERP_BILINEAR);
+    g_object_unref (pixbuf);
+
+    return scaled;
+}
+
+static GdkPixbuf *
+load_scaled_jpeg (const char   *image_uri,
+                  int           size,
+                  GCancellable *cancellable)
+{
+    GFile *location;
+    GInputStream *stream;
+    GdkPixbufLoader *loader;
+    GdkPixbuf *pixbuf, *oriented;
+    guchar *buffer;
+    gssize bytes_read;
+    gboolean res;
+
+    location = g_file_new_for_uri (image_uri);
+    stream = G_INPUT_STREAM (g_file_read (location, cancellable, NULL));
+    g_object_unref (location);
+    if (stream == NULL)
+    {
+        return NULL;
+    }
+
+    loader = gdk_pixbuf_loader_new_with_mime_type ("image/jpeg", NULL);
+    if (loader == NULL)
+    {
+        g_object_unref (stream);
+        return NULL;
+    }
+    g_signal_connect (loader, "size-prepared",
+                      G_CALLBACK (fast_path_size_prepared),
+                      GINT_TO_POINTER (size));
+
+    buffer = g_malloc (FAST_PATH_READ_BUFFER_SIZE);
+    res = TRUE;
+    while (res)
+    {
+        bytes_read = g_input_stream_read (stream, buffer,
+                                          FAST_PATH_READ_BUFFER_SIZE,
+                                          cancellable, NULL);
+        if (bytes_read <= 0)
+        {
+            res = bytes_read == 0;
+            break;
+        }
+        res = gdk_pixbuf_loader_write (loader, buffer, bytes_read, NULL);
+    }
+    g_free (buffer);
+    g_object_unref (stream);
+
+    /* Always close the loader, it warns when finalized otherwise */
+    if (!gdk_pixbuf_loader_close (loader, NULL))
+    {
+        res = FALSE;
+    }
+
+    pixbuf = NULL;
+    if (res && gdk_pixbuf_loader_get_pixbuf (loader) != NULL)
+    {
+        pixbuf = g_object_ref (gdk_pixbuf_loader_get_pixbuf (loader));
+    }
+    g_object_unref (loader);
+
+    if (pixbuf == NULL)
+    {
+        return NULL;
+    }
+
+    oriented = gdk_pixbuf_apply_embedded_orientation (pixbuf);
+    g_object_unref (pixbuf);
+
+    return scale_to_thumbnail_size (oriented, size);
+}
+
+#ifdef HAVE_EXIF
+static GdkPixbuf *
+load_embedded_preview (const char *image_uri,
+                       int         size)
+{
+    ExifData *exif_data;
+    ExifEntry *entry;
+    GdkPixbufLoader *loader;
+    GdkPixbuf *pixbuf, *oriented;
+    char *path;
+    char *orientation;
+    gboolean res;
+
+    path = g_filename_from_uri (image_uri, NULL, NULL);
+    if (path == NULL)
+    {
+        return NULL;
+    }
+
+    exif_data = exif_data_new_from_file (path);
+    g_free (path);
+    if (exif_data == NULL)
+    {
+        return NULL;
+    }
+
+    if (exif_data->data == NULL || exif_data->size == 0)
+    {
+        exif_data_unref (exif_data);
+        return NULL;
+    }
+
+    loader = gdk_pixbuf_loader_new ();
+    g_signal_connect (loader, "size-prepared",
+                      G_CALLBACK (embedded_preview_size_prepared),
+                      GINT_TO_POINTER (size));
+    res = gdk_pixbuf_loader_write (loader, exif_data->data, exif_data->size, NULL);
+    if (!gdk_pixbuf_loader_close (loader, NULL))
+    {
+        res = FALSE;
+    }
+
+    pixbuf = NULL;
+    if (res && gdk_pixbuf_loader_get_pixbuf (loader) != NULL)
+    {
+        pixbuf = g_object_ref (gdk_pixbuf_loader_get_pixbuf (loader));
+    }
+    g_object_unref (loader);
+
+    if (pixbuf != NULL)
+    {
+        /* The preview itself has no orientation tag, the parent image has */
+        entry = exif_data_get_entry (exif_data, EXIF_TAG_ORIENTATION);
+        if (entry != NULL && entry->format == EXIF_FORMAT_SHORT)
+        {
+            orientation = g_strdup_printf ("%d",
+                                           exif_get_short (entry->data,
+                                                           exif_data_get_byte_order (exif_data)));
+            gdk_pixbuf_set_option (pixbuf, "orientation", orientation);
+            g_free (orientation);
+        }
+
+        oriented = gdk_pixbuf_apply_embedded_orientation (pixbuf);
+        g_object_unref (pixbuf);
+        pixbuf = scale_to_thumbnail_size (oriented, size);
+    }
+
+    exif_data_unref (exif_data);
+
+    return pixbuf;
+}
+#endif /*HAVE_EXIF*/
+
+/* Tries to make a thumbnail without going through the thumbnail factory,
+ * which runs an external thumbnailer that decodes the whole image. Returns
+ * NULL if there is no fast path for the file, in which case the caller
+ * should fall back to the factory. */
+GdkPixbuf *
+nautilus_thumbnail_generate_fast (const char   *image_uri,
+                                  const char   *mime_type,
+                                  int           size,
+                                  GCancellable *cancellable)
+{
+    GdkPixbuf *pixbuf;
+
+    if (!nautilus_thumbnail_has_fast_path (mime_type))
+    {
+        return NULL;
+    }
+
+    pixbuf = NULL;
+
+#ifdef HAVE_EXIF
+    pixbuf = load_embedded_preview (image_uri, size);
+#endif
+
+    if (pixbuf == NULL)
+    {
+        pixbuf = load_scaled_jpeg (image_uri, size, cancellable);
+    }
+
+    return pixbuf;
+}
+
 gboolean
 nautilus_can_thumbnail (NautilusFile *file)
 {
@@ -422,6 +917,19 @@ nautilus_create_thumbnail (NautilusFile *file)
                                                     g_str_equal);
     }
 
+    /* Pre-generation pauses while the user is looking at thumbnails */
+    last_interactive_request_time = g_get_monotonic_time ();
+
+    /* If a pre-generation job queued this file already, take it over */
+    if (background_thumbnails_hash != NULL)
+    {
+        node = g_hash_table_lookup (background_thumbnails_hash, info->image_uri);
+        if (node != NULL && node->data != currently_thumbnailing)
+        {
+            remove_background_thumbnail (node);
+        }
+    }
+
     /* Check if it is already in the list of thumbnails to make. */
     existing = g_hash_table_lookup (thumbnails_to_make_hash, info->image_uri);
     if (existing == NULL)
@@ -436,6 +944,7 @@ nautilus_create_thumbnail (NautilusFile *file)
         g_hash_table_insert (thumbnails_to_make_hash,
                              info->image_uri,
                              node);
+        update_queue_metric ();
         /* If the thumbnail thread isn't running, and we haven't
          *  scheduled an idle function to start it up, do that now.
          *  We don't want to start it until all the other work is done,
@@ -480,6 +989,9 @@ thumbnail_thread_func (GTask        *task,
     time_t current_orig_mtime = 0;
     time_t current_time;
     GList *node;
+    int io_priority;
+    gint64 start_time;
+    gboolean made_thumbnail = FALSE;
 
     /* We loop until there are no more thumbails to make, at which point
      *  we exit the thread. */
@@ -501,8 +1013,19 @@ thumbnail_thread_func (GTask        *task,
          *  Don't pop the thumbnail off the queue if the original file
          *  mtime of the request changed. Then we need to redo the thumbnail.
          */
-        if (currently_thumbnailing &&
-            currently_thumbnailing->original_file_mtime == current_orig_mtime)
+        if (currently_thumbnailing && currently_thumbnailing->job != NULL)
+        {
+            g_assert (info == currently_thumbnailing);
+            if (made_thumbnail)
+            {
+                info->job->made++;
+            }
+            node = g_hash_table_lookup (background_thumbnails_hash, info->image_uri);
+            g_assert (node != NULL);
+            remove_background_thumbnail (node);
+        }
+        else if (currently_thumbnailing &&
+                 currently_thumbnailing->original_file_mtime == current_orig_mtime)
         {
             g_assert (info == currently_thumbnailing);
             node = g_hash_table_lookup (thumbnails_to_make_hash, info->image_uri);
@@ -510,13 +1033,15 @@ thumbnail_thread_func (GTask        *task,
             g_hash_table_remove (thumbnails_to_make_hash, info->image_uri);
             free_thumbnail_info (info);
             g_queue_delete_link ((GQueue *) &thumbnails_to_make, node);
+            update_queue_metric ();
         }
         currently_thumbnailing = NULL;
 
         /* If there are no more thumbnails to make, reset the
          *  thumbnail_thread_is_running flag, unlock the mutex, and
          *  exit the thread. */
-        if (g_queue_is_empty ((GQueue *) &thumbnails_to_make))
+        if (g_queue_is_empty ((GQueue *) &thumbnails_to_make) &&
+            g_queue_is_empty (&background_thumbnails_to_make))
         {
 #ifdef DEBUG_THUMBNAILS
             g_message ("(Thumbnail Thread) Exiting\n");
@@ -526,12 +1051,41 @@ thumbnail_thread_func (GTask        *task,
             return;
         }
 
+        /* Only pre-generated thumbnails are left. Don't compete with the
+         *  user for I/O if they were just browsing, come back later. */
+        if (g_queue_is_empty ((GQueue *) &thumbnails_to_make) &&
+            g_get_monotonic_time () - last_interactive_request_time <
+            PREGENERATION_RESUME_DELAY_SECS * G_USEC_PER_SEC)
+        {
+#ifdef DEBUG_THUMBNAILS
+            g_message ("(Thumbnail Thread) Pausing background thumbnails\n");
+#endif
+            thumbnail_thread_is_running = FALSE;
+            if (!background_resume_scheduled)
+            {
+                background_resume_scheduled = TRUE;
+                g_timeout_add_seconds (PREGENERATION_RESUME_DELAY_SECS,
+                                       resume_background_thumbnails_cb,
+                                       NULL);
+            }
+            g_mutex_unlock (&thumbnails_mutex);
+            return;
+        }
+
         /* Get the next one to make. We leave it on the list until it
          *  is created so the main thread doesn't add it again while we
-         *  are creating it. */
-        info = g_queue_peek_head ((GQueue *) &thumbnails_to_make);
+         *  are creating it. Interactive requests always go first. */
+        if (!g_queue_is_empty ((GQueue *) &thumbnails_to_make))
+        {
+            info = g_queue_peek_head ((GQueue *) &thumbnails_to_make);
+        }
+        else
+        {
+            info = g_queue_peek_head (&background_thumbnails_to_make);
+        }
         currently_thumbnailing = info;
         current_orig_mtime = info->original_file_mtime;
+        made_thumbnail = FALSE;
         /*********************************
          * MUTEX UNLOCKED
          *********************************/
@@ -564,9 +1118,25 @@ thumbnail_thread_func (GTask        *task,
                    info->image_uri);
 #endif
 
-        pixbuf = gnome_desktop_thumbnail_factory_generate_thumbnail (thumbnail_factory,
-                                                                     info->image_uri,
-                                                                     info->mime_type);
+        nautilus_profile_start ("%s", info->mime_type);
+        start_time = g_get_monotonic_time ();
+
+        io_priority = -1;
+        if (info->job != NULL)
+        {
+            io_priority = thread_set_io_priority_idle ();
+        }
+
+        pixbuf = nautilus_thumbnail_generate_fast (info->image_uri,
+                                                   info->mime_type,
+                                                   THUMBNAIL_FACTORY_SIZE,
+                                                   NULL);
+        if (pixbuf == NULL)
+        {
+            pixbuf = gnome_desktop_thumbnail_factory_generate_thumbnail (thumbnail_factory,
+                                                                         info->image_uri,
+                                                                         info->mime_type);
+        }
 
         if (pixbuf)
         {
@@ -579,6 +1149,7 @@ thumbnail_thread_func (GTask        *task,
                                                             info->image_uri,
                                                             current_orig_mtime);
             g_object_unref (pixbuf);
+            made_thumbnail = TRUE;
         }
         else
         {
@@ -590,6 +1161,16 @@ thumbnail_thread_func (GTask        *task,
                                                                      info->image_uri,
                                                                      current_orig_mtime);
         }
+
+        if (info->job != NULL)
+        {
+            thread_restore_io_priority (io_priority);
+        }
+
+        nautilus_metrics_observe ("thumbnail-time",
+                                  g_get_monotonic_time () - start_time);
+        nautilus_profile_end (NULL);
+
         /* We need to call nautilus_file_changed(), but I don't think that is
          *  thread safe. So add an idle handler and do it from the main loop. */
         g_idle_add_full (G_PRIORITY_HIGH_IDLE,
@@ -597,3 +1178,524 @@ thumbnail_thread_func (GTask        *task,
                          g_strdup (info->image_uri), NULL);
     }
 }
+
+
+/***************************************************************************
+ * Background pre-generation.
+ ***************************************************************************/
+
+/* Jobs by root uri, so the same tree isn't walked twice at once */
+static GHashTable *pregeneration_jobs = NULL;
+
+/* Serializes access to the checkpoint file between concurrent jobs */
+static GMutex checkpoint_mutex;
+
+static char *
+get_checkpoint_path (void)
+{
+    return g_build_filename (g_get_user_cache_dir (), "nautilus",
+                             "thumbnail-pregeneration", NULL);
+}
+
+static void
+pregeneration_load_checkpoint (PregenerationJob *job)
+{
+    GKeyFile *key_file;
+    char *path;
+    char **folders;
+    int i;
+
+    g_mutex_lock (&checkpoint_mutex);
+
+    key_file = g_key_file_new ();
+    path = get_checkpoint_path ();
+    if (g_key_file_load_from_file (key_file, path, G_KEY_FILE_NONE, NULL))
+    {
+        folders = g_key_file_get_string_list (key_file, job->root_uri,
+                                              "completed-folders", NULL, NULL);
+        for (i = 0; folders != NULL && folders[i] != NULL; i++)
+        {
+            /* The table takes ownership of the strings */
+            g_hash_table_add (job->completed_folders, folders[i]);
+        }
+        g_free (folders);
+    }
+    g_key_file_free (key_file);
+    g_free (path);
+
+    g_mutex_unlock (&checkpoint_mutex);
+}
+
+static void
+pregeneration_save_checkpoint (PregenerationJob *job,
+                               gboolean          finished)
+{
+    GKeyFile *key_file;
+    char *path, *dirname;
+    char *data;
+    gsize length;
+    const char **folders;
+    guint n_folders;
+
+    g_mutex_lock (&checkpoint_mutex);
+
+    key_file = g_key_file_new ();
+    path = get_checkpoint_path ();
+    g_key_file_load_from_file (key_file, path, G_KEY_FILE_NONE, NULL);
+
+    if (finished)
+    {
+        g_key_file_remove_group (key_file, job->root_uri, NULL);
+    }
+    else
+    {
+        folders = (const char **) g_hash_table_get_keys_as_array (job->completed_folders,
+                                                                  &n_folders);
+        g_key_file_set_string_list (key_file, job->root_uri, "completed-folders",
+                                    folders, n_folders);
+        g_free (folders);
+    }
+
+    data = g_key_file_to_data (key_file, &length, NULL);
+    dirname = g_path_get_dirname (path);
+    if (g_mkdir_with_parents (dirname, 0700) == 0)
+    {
+        g_file_set_contents (path, data, length, NULL);
+    }
+
+    g_free (dirname);
+    g_free (data);
+    g_key_file_free (key_file);
+    g_free (path);
+
+    g_mutex_unlock (&checkpoint_mutex);
+
+    job->last_checkpoint_time = g_get_monotonic_time ();
+}
+
+static gboolean
+pregeneration_needs_thumbnail (PregenerationJob *job,
+                               GFileInfo        *info,
+                               const char       *uri)
+{
+    const char *mime_type;
+    time_t mtime;
+
+    if (g_file_info_get_file_type (info) != G_FILE_TYPE_REGULAR)
+    {
+        return FALSE;
+    }
+
+    if (g_file_info_get_attribute_boolean (info, G_FILE_ATTRIBUTE_THUMBNAILING_FAILED))
+    {
+        return FALSE;
+    }
+
+    /* Backends that don't report validity only return valid thumbnails */
+    if (g_file_info_get_attribute_byte_string (info, G_FILE_ATTRIBUTE_THUMBNAIL_PATH) != NULL &&
+        (!g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_THUMBNAIL_IS_VALID) ||
+         g_file_info_get_attribute_boolean (info, G_FILE_ATTRIBUTE_THUMBNAIL_IS_VALID)))
+    {
+        return FALSE;
+    }
+
+    mime_type = g_file_info_get_content_type (info);
+    if (mime_type == NULL)
+    {
+        return FALSE;
+    }
+
+    /* Same rule as nautilus_file_should_show_thumbnail() */
+    if (nautilus_thumbnail_is_mimetype_limited_by_size (mime_type) &&
+        g_file_info_get_size (info) > job->size_limit)
+    {
+        return FALSE;
+    }
+
+    mtime = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED);
+
+    return gnome_desktop_thumbnail_factory_can_thumbnail (thumbnail_factory,
+                                                          uri,
+                                                          mime_type,
+                                                          mtime);
+}
+
+static void
+pregeneration_queue_thumbnail (PregenerationJob *job,
+                               GFileInfo        *file_info,
+                               const char       *uri)
+{
+    NautilusThumbnailInfo *info;
+    GList *node;
+
+    info = g_new0 (NautilusThumbnailInfo, 1);
+    info->image_uri = g_strdup (uri);
+    info->mime_type = g_strdup (g_file_info_get_content_type (file_info));
+    info->original_file_mtime = g_file_info_get_attribute_uint64 (file_info,
+                                                                  G_FILE_ATTRIBUTE_TIME_MODIFIED);
+    info->job = job;
+
+    g_mutex_lock (&thumbnails_mutex);
+
+    if (background_thumbnails_hash == NULL)
+    {
+        background_thumbnails_hash = g_hash_table_new (g_str_hash,
+                                                       g_str_equal);
+    }
+
+    /* Already requested by a view or by another job, or this job was
+     * cancelled and dropped what it had queued */
+    if (g_cancellable_is_cancelled (job->cancellable) ||
+        (thumbnails_to_make_hash != NULL &&
+         g_hash_table_contains (thumbnails_to_make_hash, info->image_uri)) ||
+        g_hash_table_contains (background_thumbnails_hash, info->image_uri))
+    {
+        free_thumbnail_info (info);
+    }
+    else
+    {
+        g_queue_push_tail (&background_thumbnails_to_make, info);
+        node = g_queue_peek_tail_link (&background_thumbnails_to_make);
+        g_hash_table_insert (background_thumbnails_hash,
+                             info->image_uri,
+                             node);
+        update_queue_metric ();
+        job->pending++;
+    }
+
+    g_mutex_unlock (&thumbnails_mutex);
+}
+
+/* Drops what the job still has queued. If the job's thumbnail is being
+ * made, the batch ends once it is done. */
+static void
+pregeneration_cancelled (GCancellable *cancellable,
+                         gpointer      user_data)
+{
+    PregenerationJob *job;
+    NautilusThumbnailInfo *info;
+    GList *l, *next;
+
+    job = user_data;
+
+    g_mutex_lock (&thumbnails_mutex);
+
+    for (l = background_thumbnails_to_make.head; l != NULL; l = next)
+    {
+        next = l->next;
+        info = l->data;
+        if (info->job == job && info != currently_thumbnailing)
+        {
+            remove_background_thumbnail (l);
+        }
+    }
+
+    g_mutex_unlock (&thumbnails_mutex);
+}
+
+static void
+pregeneration_update_progress (PregenerationJob *job)
+{
+    guint made;
+
+    g_mutex_lock (&thumbnails_mutex);
+    made = job->made;
+    g_mutex_unlock (&thumbnails_mutex);
+
+    nautilus_progress_info_take_details (job->progress,
+                                         g_strdup_printf (ngettext ("%'u folder scanned, %'u thumbnails generated",
+                                                                    "%'u folders scanned, %'u thumbnails generated",
+                                                                    job->folders_scanned),
+                                                          job->folders_scanned,
+                                                          made));
+    nautilus_progress_info_pulse_progress (job->progress);
+}
+
+/* Lists one folder, queueing the thumbnails its files need and adding
+ * its subfolders to the walk. Nothing waits here for the thumbnails;
+ * the job goes on from the main loop once they are done. */
+static void
+pregeneration_scan_thread_func (GTask        *task,
+                                gpointer      source_object,
+                                gpointer      task_data,
+                                GCancellable *cancellable)
+{
+    PregenerationJob *job;
+    GFile *child;
+    GFileEnumerator *enumerator;
+    GFileInfo *info;
+    char *folder_uri, *uri;
+    int io_priority;
+
+    job = task_data;
+
+    /* Enumerating a large tree competes with browsing just as much as
+     * thumbnailing it does */
+    io_priority = thread_set_io_priority_idle ();
+
+    if (!job->checkpoint_loaded)
+    {
+        pregeneration_load_checkpoint (job);
+        job->checkpoint_loaded = TRUE;
+    }
+    else if (g_get_monotonic_time () - job->last_checkpoint_time >
+             PREGENERATION_CHECKPOINT_INTERVAL_SECS * G_USEC_PER_SEC)
+    {
+        pregeneration_save_checkpoint (job, FALSE);
+    }
+
+    folder_uri = g_file_get_uri (job->folder);
+    /* A completed folder has all its files done, but its subfolders
+     * might not, so it is still walked. */
+    job->folder_completed = g_hash_table_contains (job->completed_folders, folder_uri);
+    g_free (folder_uri);
+
+    enumerator = g_file_enumerate_children (job->folder, PREGENERATION_ATTRIBUTES,
+                                            G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+                                            job->cancellable, NULL);
+    while (enumerator != NULL &&
+           (info = g_file_enumerator_next_file (enumerator, job->cancellable, NULL)) != NULL)
+    {
+        if (g_file_info_get_is_hidden (info))
+        {
+            g_object_unref (info);
+            continue;
+        }
+
+        child = g_file_get_child (job->folder, g_file_info_get_name (info));
+        if (g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY)
+        {
+            g_queue_push_tail (&job->folders, g_object_ref (child));
+        }
+        else if (!job->folder_completed)
+        {
+            uri = g_file_get_uri (child);
+            if (pregeneration_needs_thumbnail (job, info, uri))
+            {
+                pregeneration_queue_thumbnail (job, info, uri);
+            }
+            g_free (uri);
+        }
+
+        g_object_unref (child);
+        g_object_unref (info);
+    }
+    g_clear_object (&enumerator);
+
+    thread_restore_io_priority (io_priority);
+
+    g_task_return_boolean (task, TRUE);
+}
+
+static void
+pregeneration_finish_thread_func (GTask        *task,
+                                  gpointer      source_object,
+                                  gpointer      task_data,
+                                  GCancellable *cancellable)
+{
+    PregenerationJob *job;
+
+    job = task_data;
+
+    /* Cancelled before the first folder, the checkpoint of the last run
+     * still needs keeping */
+    if (!job->checkpoint_loaded)
+    {
+        pregeneration_load_checkpoint (job);
+        job->checkpoint_loaded = TRUE;
+    }
+
+    /* A finished tree starts from scratch next time, a cancelled one
+     * resumes where it stopped. */
+    pregeneration_save_checkpoint (job, !g_cancellable_is_cancelled (job->cancellable));
+
+    g_task_return_boolean (task, TRUE);
+}
+
+static void
+pregeneration_job_free (PregenerationJob *job)
+{
+    g_cancellable_disconnect (job->cancellable, job->cancelled_id);
+    g_queue_foreach (&job->folders, (GFunc) g_object_unref, NULL);
+    g_queue_clear (&job->folders);
+    g_clear_object (&job->folder);
+    g_object_unref (job->root);
+    g_free (job->root_uri);
+    g_object_unref (job->progress);
+    g_object_unref (job->cancellable);
+    g_hash_table_destroy (job->completed_folders);
+    g_free (job);
+}
+
+static void
+pregeneration_done (GObject      *source_object,
+                    GAsyncResult *res,
+                    gpointer      user_data)
+{
+    PregenerationJob *job;
+    GApplication *application;
+
+    job = user_data;
+
+    g_hash_table_remove (pregeneration_jobs, job->root_uri);
+    nautilus_progress_info_finish (job->progress);
+    pregeneration_job_free (job);
+
+    application = g_application_get_default ();
+    if (application != NULL)
+    {
+        g_application_release (application);
+    }
+}
+
+static void pregeneration_scan_done (GObject      *source_object,
+                                     GAsyncResult *res,
+                                     gpointer      user_data);
+
+/* Scans the next folder, or saves the checkpoint and finishes once there
+ * are none left */
+static void
+pregeneration_scan_next (PregenerationJob *job)
+{
+    GTask *task;
+
+    if (g_cancellable_is_cancelled (job->cancellable))
+    {
+        g_queue_foreach (&job->folders, (GFunc) g_object_unref, NULL);
+        g_queue_clear (&job->folders);
+    }
+
+    job->folder = g_queue_pop_head (&job->folders);
+    if (job->folder != NULL)
+    {
+        task = g_task_new (NULL, NULL, pregeneration_scan_done, job);
+        g_task_set_task_data (task, job, NULL);
+        g_task_run_in_thread (task, pregeneration_scan_thread_func);
+    }
+    else
+    {
+        task = g_task_new (NULL, NULL, pregeneration_done, job);
+        g_task_set_task_data (task, job, NULL);
+        g_task_run_in_thread (task, pregeneration_finish_thread_func);
+    }
+    g_object_unref (task);
+}
+
+static void
+pregeneration_folder_done (PregenerationJob *job)
+{
+    job->folders_scanned++;
+    if (!job->folder_completed && !g_cancellable_is_cancelled (job->cancellable))
+    {
+        g_hash_table_add (job->completed_folders, g_file_get_uri (job->folder));
+    }
+    g_clear_object (&job->folder);
+
+    pregeneration_update_progress (job);
+    pregeneration_scan_next (job);
+}
+
+static gboolean
+pregeneration_batch_done_cb (gpointer data)
+{
+    pregeneration_folder_done (data);
+
+    return FALSE;
+}
+
+static void
+pregeneration_scan_done (GObject      *source_object,
+                         GAsyncResult *res,
+                         gpointer      user_data)
+{
+    PregenerationJob *job;
+    gboolean wait;
+
+    job = user_data;
+
+    /* One folder at a time keeps the queue short, so interactive
+     * requests never wait behind a whole tree, and makes the
+     * checkpoint exact. The thumbnail thread calls back once the
+     * folder's thumbnails are done. */
+    g_mutex_lock (&thumbnails_mutex);
+    wait = job->pending > 0;
+    job->waiting = wait;
+    if (wait)
+    {
+        start_background_thumbnails ();
+    }
+    g_mutex_unlock (&thumbnails_mutex);
+
+    if (!wait)
+    {
+        pregeneration_folder_done (job);
+    }
+}
+
+/* Walks the tree under @root in the background and makes all the missing
+ *  thumbnails, using the same thumbnail thread as the views but with lower
+ *  priority. Progress is shown like a file operation, and cancelling it there
+ *  keeps a checkpoint so that the next run over the same tree resumes. */
+void
+nautilus_thumbnail_pregenerate (GFile *root)
+{
+    PregenerationJob *job;
+    GApplication *application;
+    char *root_uri;
+    char *basename, *display_name;
+
+    if (pregeneration_jobs == NULL)
+    {
+        pregeneration_jobs = g_hash_table_new (g_str_hash, g_str_equal);
+    }
+
+    root_uri = g_file_get_uri (root);
+    if (g_hash_table_contains (pregeneration_jobs, root_uri))
+    {
+        g_free (root_uri);
+        return;
+    }
+
+    /* Both are created lazily, which is not thread safe */
+    if (thumbnail_factory == NULL)
+    {
+        thumbnail_factory = get_thumbnail_factory ();
+    }
+    get_types_table ();
+
+    job = g_new0 (PregenerationJob, 1);
+    job->root = g_object_ref (root);
+    job->root_uri = root_uri;
+    job->progress = nautilus_progress_info_new ();
+    job->cancellable = g_object_ref (nautilus_progress_info_get_cancellable (job->progress));
+    job->completed_folders = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                                    g_free, NULL);
+    job->last_checkpoint_time = g_get_monotonic_time ();
+    g_settings_get (nautilus_preferences,
+                    NAUTILUS_PREFERENCES_FILE_THUMBNAIL_LIMIT,
+                    "t", &job->size_limit);
+
+    basename = g_file_get_basename (root);
+    display_name = g_filename_display_name (basename);
+    nautilus_progress_info_take_status (job->progress,
+                                        g_strdup_printf (_("Generating thumbnails in “%s”"),
+                                                         display_name));
+    g_free (display_name);
+    g_free (basename);
+    nautilus_progress_info_start (job->progress);
+
+    g_hash_table_insert (pregeneration_jobs, job->root_uri, job);
+
+    /* Keep running when started from the command line without a window */
+    application = g_application_get_default ();
+    if (application != NULL)
+    {
+        g_application_hold (application);
+    }
+
+    job->cancelled_id = g_cancellable_connect (job->cancellable,
+                                               G_CALLBACK (pregeneration_cancelled),
+                                               job, NULL);
+    g_queue_push_tail (&job->folders, g_object_ref (root));
+    pregeneration_scan_next (job);
+}
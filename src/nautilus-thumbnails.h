@@ -32,9 +32,19 @@ gboolean   nautilus_can_thumbnail_internally        (NautilusFile *file);
 gboolean   nautilus_thumbnail_is_mimetype_limited_by_size
 						    (const char *mime_type);
 
+/* In-process thumbnailing of JPEG photos, bypassing the thumbnail factory */
+gboolean   nautilus_thumbnail_has_fast_path         (const char   *mime_type);
+GdkPixbuf *nautilus_thumbnail_generate_fast         (const char   *image_uri,
+						     const char   *mime_type,
+						     int           size,
+						     GCancellable *cancellable);
+
 /* Queue handling: */
 void       nautilus_thumbnail_remove_from_queue     (const char   *file_uri);
 void       nautilus_thumbnail_prioritize            (const char   *file_uri);
 
+/* Background generation of all missing thumbnails under a folder */
+void       nautilus_thumbnail_pregenerate           (GFile        *root);
+
 
 #endif /* NAUTILUS_THUMBNAILS_H */
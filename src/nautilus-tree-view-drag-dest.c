@@ -990,7 +990,7 @@ drag_data_received_callback (GtkWidget        *widget,
         if (info == NAUTILUS_ICON_DND_GNOME_ICON_LIST)
         {
             dest->details->drag_list =
-                nautilus_drag_build_selection_list (selection_data);
+                nautilus_drag_build_selection_list (context, selection_data);
         }
     }
 
@@ -27,7 +27,6 @@
 
 #include <gio/gio.h>
 #include <gtk/gtk.h>
-#include <libgd/gd.h>
 #include <string.h>
 #include <glib/gi18n.h>
 
@@ -266,20 +265,246 @@ nautilus_escape_action_name (const char *action_name,
 #define NAUTILUS_THUMBNAIL_FRAME_RIGHT 3
 #define NAUTILUS_THUMBNAIL_FRAME_BOTTOM 3
 
+/* Stretched edges are cached per length. Thumbnails of a grid share a
+ * handful of lengths, so this is only a guard against unbounded growth. */
+#define FRAME_EDGE_CACHE_MAX_LENGTHS 128
+
+typedef enum
+{
+    FRAME_SLICE_TOP_LEFT,
+    FRAME_SLICE_TOP,
+    FRAME_SLICE_TOP_RIGHT,
+    FRAME_SLICE_LEFT,
+    FRAME_SLICE_RIGHT,
+    FRAME_SLICE_BOTTOM_LEFT,
+    FRAME_SLICE_BOTTOM,
+    FRAME_SLICE_BOTTOM_RIGHT,
+    FRAME_N_SLICES
+} FrameSlice;
+
+/* thumbnail_frame.png cut into the nine-patch slices (without the center,
+ * which the frame never draws), and the edges stretched to a given length,
+ * keyed by length. The top and bottom edges are stored side by side in a
+ * single pixbuf, as are the left and right ones. */
+static GdkPixbuf *frame_slices[FRAME_N_SLICES];
+static GHashTable *frame_horizontal_edges = NULL;
+static GHashTable *frame_vertical_edges = NULL;
+
+static gboolean
+ensure_frame_slices (void)
+{
+    GdkPixbuf *frame, *with_alpha;
+    int width, height;
+    int center_width, center_height;
+
+    if (frame_slices[FRAME_SLICE_TOP_LEFT] != NULL)
+    {
+        return TRUE;
+    }
+
+    frame = gdk_pixbuf_new_from_resource ("/org/gnome/nautilus/icons/thumbnail_frame.png", NULL);
+    if (frame == NULL)
+    {
+        return FALSE;
+    }
+
+    with_alpha = gdk_pixbuf_add_alpha (frame, FALSE, 0, 0, 0);
+    g_object_unref (frame);
+
+    width = gdk_pixbuf_get_width (with_alpha);
+    height = gdk_pixbuf_get_height (with_alpha);
+    center_width = width - NAUTILUS_THUMBNAIL_FRAME_LEFT - NAUTILUS_THUMBNAIL_FRAME_RIGHT;
+    center_height = height - NAUTILUS_THUMBNAIL_FRAME_TOP - NAUTILUS_THUMBNAIL_FRAME_BOTTOM;
+    if (center_width <= 0 || center_height <= 0)
+    {
+        g_object_unref (with_alpha);
+        return FALSE;
+    }
+
+    frame_slices[FRAME_SLICE_TOP_LEFT] =
+        gdk_pixbuf_new_subpixbuf (with_alpha, 0, 0,
+                                  NAUTILUS_THUMBNAIL_FRAME_LEFT, NAUTILUS_THUMBNAIL_FRAME_TOP);
+    frame_slices[FRAME_SLICE_TOP] =
+        gdk_pixbuf_new_subpixbuf (with_alpha,
+                                  NAUTILUS_THUMBNAIL_FRAME_LEFT, 0,
+                                  center_width, NAUTILUS_THUMBNAIL_FRAME_TOP);
+    frame_slices[FRAME_SLICE_TOP_RIGHT] =
+        gdk_pixbuf_new_subpixbuf (with_alpha,
+                                  width - NAUTILUS_THUMBNAIL_FRAME_RIGHT, 0,
+                                  NAUTILUS_THUMBNAIL_FRAME_RIGHT, NAUTILUS_THUMBNAIL_FRAME_TOP);
+    frame_slices[FRAME_SLICE_LEFT] =
+        gdk_pixbuf_new_subpixbuf (with_alpha,
+                                  0, NAUTILUS_THUMBNAIL_FRAME_TOP,
+                                  NAUTILUS_THUMBNAIL_FRAME_LEFT, center_height);
+    frame_slices[FRAME_SLICE_RIGHT] =
+        gdk_pixbuf_new_subpixbuf (with_alpha,
+                                  width - NAUTILUS_THUMBNAIL_FRAME_RIGHT, NAUTILUS_THUMBNAIL_FRAME_TOP,
+                                  NAUTILUS_THUMBNAIL_FRAME_RIGHT, center_height);
+    frame_slices[FRAME_SLICE_BOTTOM_LEFT] =
+        gdk_pixbuf_new_subpixbuf (with_alpha,
+                                  0, height - NAUTILUS_THUMBNAIL_FRAME_BOTTOM,
+                                  NAUTILUS_THUMBNAIL_FRAME_LEFT, NAUTILUS_THUMBNAIL_FRAME_BOTTOM);
+    frame_slices[FRAME_SLICE_BOTTOM] =
+        gdk_pixbuf_new_subpixbuf (with_alpha,
+                                  NAUTILUS_THUMBNAIL_FRAME_LEFT, height - NAUTILUS_THUMBNAIL_FRAME_BOTTOM,
+                                  center_width, NAUTILUS_THUMBNAIL_FRAME_BOTTOM);
+    frame_slices[FRAME_SLICE_BOTTOM_RIGHT] =
+        gdk_pixbuf_new_subpixbuf (with_alpha,
+                                  width - NAUTILUS_THUMBNAIL_FRAME_RIGHT, height - NAUTILUS_THUMBNAIL_FRAME_BOTTOM,
+                                  NAUTILUS_THUMBNAIL_FRAME_RIGHT, NAUTILUS_THUMBNAIL_FRAME_BOTTOM);
+
+    /* The subpixbufs keep the frame alive */
+    g_object_unref (with_alpha);
+
+    frame_horizontal_edges = g_hash_table_new_full (NULL, NULL, NULL, g_object_unref);
+    frame_vertical_edges = g_hash_table_new_full (NULL, NULL, NULL, g_object_unref);
+
+    return TRUE;
+}
+
+/* Stretches @first and @second along one axis to @length, smoothly like
+ * the default "stretch" of a CSS border-image, and returns them packed
+ * next to each other across the other axis. */
+static GdkPixbuf *
+get_stretched_edges (GHashTable *cache,
+                     GdkPixbuf  *first,
+                     GdkPixbuf  *second,
+                     int         length,
+                     gboolean    horizontal)
+{
+    GdkPixbuf *edges;
+    int first_size, second_size;
+    int source_length;
+    double scale;
+
+    edges = g_hash_table_lookup (cache, GINT_TO_POINTER (length));
+    if (edges != NULL)
+    {
+        return edges;
+    }
+
+    if (g_hash_table_size (cache) >= FRAME_EDGE_CACHE_MAX_LENGTHS)
+    {
+        g_hash_table_remove_all (cache);
+    }
+
+    if (horizontal)
+    {
+        first_size = gdk_pixbuf_get_height (first);
+        second_size = gdk_pixbuf_get_height (second);
+        source_length = gdk_pixbuf_get_width (first);
+        scale = (double) length / source_length;
+
+        edges = gdk_pixbuf_new (GDK_COLORSPACE_RGB, TRUE, 8,
+                                length, first_size + second_size);
+        gdk_pixbuf_scale (first, edges, 0, 0, length, first_size,
+                          0, 0, scale, 1, GDK_INTERP_BILINEAR);
+        gdk_pixbuf_scale (second, edges, 0, first_size, length, second_size,
+                          0, first_size, scale, 1, GDK_INTERP_BILINEAR);
+    }
+    else
+    {
+        first_size = gdk_pixbuf_get_width (first);
+        second_size = gdk_pixbuf_get_width (second);
+        source_length = gdk_pixbuf_get_height (first);
+        scale = (double) length / source_length;
+
+        edges = gdk_pixbuf_new (GDK_COLORSPACE_RGB, TRUE, 8,
+                                first_size + second_size, length);
+        gdk_pixbuf_scale (first, edges, 0, 0, first_size, length,
+                          0, 0, 1, scale, GDK_INTERP_BILINEAR);
+        gdk_pixbuf_scale (second, edges, first_size, 0, second_size, length,
+                          first_size, 0, 1, scale, GDK_INTERP_BILINEAR);
+    }
+
+    g_hash_table_insert (cache, GINT_TO_POINTER (length), edges);
+
+    return edges;
+}
+
 void
 nautilus_ui_frame_image (GdkPixbuf **pixbuf)
 {
-    GtkBorder border;
     GdkPixbuf *pixbuf_with_frame;
+    GdkPixbuf *horizontal, *vertical;
+    int width, height;
+    int frame_width, frame_height;
+
+    if (!ensure_frame_slices ())
+    {
+        return;
+    }
 
-    border.left = NAUTILUS_THUMBNAIL_FRAME_LEFT;
-    border.top = NAUTILUS_THUMBNAIL_FRAME_TOP;
-    border.right = NAUTILUS_THUMBNAIL_FRAME_RIGHT;
-    border.bottom = NAUTILUS_THUMBNAIL_FRAME_BOTTOM;
+    width = gdk_pixbuf_get_width (*pixbuf);
+    height = gdk_pixbuf_get_height (*pixbuf);
+    frame_width = width + NAUTILUS_THUMBNAIL_FRAME_LEFT + NAUTILUS_THUMBNAIL_FRAME_RIGHT;
+    frame_height = height + NAUTILUS_THUMBNAIL_FRAME_TOP + NAUTILUS_THUMBNAIL_FRAME_BOTTOM;
+
+    /* Only the border is touched per image. The expensive parts, loading
+     * and slicing the frame and stretching its edges, are done once. */
+    pixbuf_with_frame = gdk_pixbuf_new (GDK_COLORSPACE_RGB, TRUE, 8,
+                                        frame_width, frame_height);
+    gdk_pixbuf_fill (pixbuf_with_frame, 0x00000000);
+
+    gdk_pixbuf_copy_area (frame_slices[FRAME_SLICE_TOP_LEFT],
+                          0, 0,
+                          NAUTILUS_THUMBNAIL_FRAME_LEFT, NAUTILUS_THUMBNAIL_FRAME_TOP,
+                          pixbuf_with_frame,
+                          0, 0);
+    gdk_pixbuf_copy_area (frame_slices[FRAME_SLICE_TOP_RIGHT],
+                          0, 0,
+                          NAUTILUS_THUMBNAIL_FRAME_RIGHT, NAUTILUS_THUMBNAIL_FRAME_TOP,
+                          pixbuf_with_frame,
+                          frame_width - NAUTILUS_THUMBNAIL_FRAME_RIGHT, 0);
+    gdk_pixbuf_copy_area (frame_slices[FRAME_SLICE_BOTTOM_LEFT],
+                          0, 0,
+                          NAUTILUS_THUMBNAIL_FRAME_LEFT, NAUTILUS_THUMBNAIL_FRAME_BOTTOM,
+                          pixbuf_with_frame,
+                          0, frame_height - NAUTILUS_THUMBNAIL_FRAME_BOTTOM);
+    gdk_pixbuf_copy_area (frame_slices[FRAME_SLICE_BOTTOM_RIGHT],
+                          0, 0,
+                          NAUTILUS_THUMBNAIL_FRAME_RIGHT, NAUTILUS_THUMBNAIL_FRAME_BOTTOM,
+                          pixbuf_with_frame,
+                          frame_width - NAUTILUS_THUMBNAIL_FRAME_RIGHT,
+                          frame_height - NAUTILUS_THUMBNAIL_FRAME_BOTTOM);
+
+    horizontal = get_stretched_edges (frame_horizontal_edges,
+                                      frame_slices[FRAME_SLICE_TOP],
+                                      frame_slices[FRAME_SLICE_BOTTOM],
+                                      width, TRUE);
+    gdk_pixbuf_copy_area (horizontal,
+                          0, 0,
+                          width, NAUTILUS_THUMBNAIL_FRAME_TOP,
+                          pixbuf_with_frame,
+                          NAUTILUS_THUMBNAIL_FRAME_LEFT, 0);
+    gdk_pixbuf_copy_area (horizontal,
+                          0, NAUTILUS_THUMBNAIL_FRAME_TOP,
+                          width, NAUTILUS_THUMBNAIL_FRAME_BOTTOM,
+                          pixbuf_with_frame,
+                          NAUTILUS_THUMBNAIL_FRAME_LEFT, frame_height - NAUTILUS_THUMBNAIL_FRAME_BOTTOM);
+
+    vertical = get_stretched_edges (frame_vertical_edges,
+                                    frame_slices[FRAME_SLICE_LEFT],
+                                    frame_slices[FRAME_SLICE_RIGHT],
+                                    height, FALSE);
+    gdk_pixbuf_copy_area (vertical,
+                          0, 0,
+                          NAUTILUS_THUMBNAIL_FRAME_LEFT, height,
+                          pixbuf_with_frame,
+                          0, NAUTILUS_THUMBNAIL_FRAME_TOP);
+    gdk_pixbuf_copy_area (vertical,
+                          NAUTILUS_THUMBNAIL_FRAME_LEFT, 0,
+                          NAUTILUS_THUMBNAIL_FRAME_RIGHT, height,
+                          pixbuf_with_frame,
+                          frame_width - NAUTILUS_THUMBNAIL_FRAME_RIGHT, NAUTILUS_THUMBNAIL_FRAME_TOP);
+
+    /* The frame has no center, so the image just replaces it */
+    gdk_pixbuf_copy_area (*pixbuf,
+                          0, 0,
+                          width, height,
+                          pixbuf_with_frame,
+                          NAUTILUS_THUMBNAIL_FRAME_LEFT, NAUTILUS_THUMBNAIL_FRAME_TOP);
 
-    pixbuf_with_frame = gd_embed_image_in_frame (*pixbuf,
-                                                 "resource:///org/gnome/nautilus/icons/thumbnail_frame.png",
-                                                 &border, &border);
     g_object_unref (*pixbuf);
 
     *pixbuf = pixbuf_with_frame;
@@ -288,6 +513,11 @@ nautilus_ui_frame_image (GdkPixbuf **pixbuf)
 static GdkPixbuf *filmholes_left = NULL;
 static GdkPixbuf *filmholes_right = NULL;
 
+/* filmholes_left and filmholes_right tiled vertically, grown on demand to
+ * the tallest thumbnail seen, so each side is a single composite. */
+static GdkPixbuf *filmholes_left_strip = NULL;
+static GdkPixbuf *filmholes_right_strip = NULL;
+
 static gboolean
 ensure_filmholes (void)
 {
@@ -304,12 +534,57 @@ ensure_filmholes (void)
     return (filmholes_left && filmholes_right);
 }
 
+static GdkPixbuf *
+tile_filmholes (GdkPixbuf *holes,
+                int        height)
+{
+    GdkPixbuf *strip;
+    int holes_width, holes_height;
+    int i;
+
+    holes_width = gdk_pixbuf_get_width (holes);
+    holes_height = gdk_pixbuf_get_height (holes);
+
+    strip = gdk_pixbuf_new (GDK_COLORSPACE_RGB,
+                            gdk_pixbuf_get_has_alpha (holes), 8,
+                            holes_width, height);
+    for (i = 0; i < height; i += holes_height)
+    {
+        gdk_pixbuf_copy_area (holes, 0, 0,
+                              holes_width, MIN (height - i, holes_height),
+                              strip, 0, i);
+    }
+
+    return strip;
+}
+
+static void
+ensure_filmholes_strips (int height)
+{
+    int holes_height;
+    int strip_height;
+
+    if (filmholes_left_strip != NULL &&
+        gdk_pixbuf_get_height (filmholes_left_strip) >= height)
+    {
+        return;
+    }
+
+    /* Round up to whole holes, so a taller strip tiles the same way */
+    holes_height = gdk_pixbuf_get_height (filmholes_left);
+    strip_height = ((height + holes_height - 1) / holes_height) * holes_height;
+
+    g_clear_object (&filmholes_left_strip);
+    g_clear_object (&filmholes_right_strip);
+    filmholes_left_strip = tile_filmholes (filmholes_left, strip_height);
+    filmholes_right_strip = tile_filmholes (filmholes_right, strip_height);
+}
+
 void
 nautilus_ui_frame_video (GdkPixbuf **pixbuf)
 {
     int width, height;
-    int holes_width, holes_height;
-    int i;
+    int holes_width;
 
     if (!ensure_filmholes ())
     {
@@ -319,25 +594,17 @@ nautilus_ui_frame_video (GdkPixbuf **pixbuf)
     width = gdk_pixbuf_get_width (*pixbuf);
     height = gdk_pixbuf_get_height (*pixbuf);
     holes_width = gdk_pixbuf_get_width (filmholes_left);
-    holes_height = gdk_pixbuf_get_height (filmholes_left);
 
-    for (i = 0; i < height; i += holes_height)
-    {
-        gdk_pixbuf_composite (filmholes_left, *pixbuf, 0, i,
-                              MIN (width, holes_width),
-                              MIN (height - i, holes_height),
-                              0, i, 1, 1, GDK_INTERP_NEAREST, 255);
-    }
+    ensure_filmholes_strips (height);
 
-    for (i = 0; i < height; i += holes_height)
-    {
-        gdk_pixbuf_composite (filmholes_right, *pixbuf,
-                              width - holes_width, i,
-                              MIN (width, holes_width),
-                              MIN (height - i, holes_height),
-                              width - holes_width, i,
-                              1, 1, GDK_INTERP_NEAREST, 255);
-    }
+    gdk_pixbuf_composite (filmholes_left_strip, *pixbuf, 0, 0,
+                          MIN (width, holes_width), height,
+                          0, 0, 1, 1, GDK_INTERP_NEAREST, 255);
+    gdk_pixbuf_composite (filmholes_right_strip, *pixbuf,
+                          width - holes_width, 0,
+                          MIN (width, holes_width), height,
+                          width - holes_width, 0,
+                          1, 1, GDK_INTERP_NEAREST, 255);
 }
 
 gboolean
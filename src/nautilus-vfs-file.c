@@ -78,6 +78,29 @@ vfs_file_check_if_ready (NautilusFile           *file,
                file_attributes);
 }
 
+/* Metadata writes are collected per file and flushed shortly after, so
+ * that the keys set on a file in one go (position, zoom, sort order...)
+ * become a single write, and a burst over many files does not turn into
+ * a burst of store round trips. The cached metadata is updated straight
+ * away, so readers don't wait for the write.
+ */
+#define METADATA_FLUSH_DELAY_MSEC 100
+#define METADATA_MAX_WRITES_IN_FLIGHT 8
+
+typedef struct
+{
+    GFileInfo *info;
+    gboolean changed;
+} PendingMetadata;
+
+static GHashTable *pending_metadata = NULL;       /* NautilusFile -> PendingMetadata */
+static GQueue pending_metadata_files = G_QUEUE_INIT;
+static GHashTable *metadata_files_writing = NULL; /* set of NautilusFile */
+static int metadata_writes_in_flight = 0;
+static guint metadata_flush_id = 0;
+
+static void schedule_metadata_flush (guint delay_msec);
+
 static void
 set_metadata_get_info_callback (GObject      *source_object,
                                 GAsyncResult *res,
@@ -93,7 +116,7 @@ set_metadata_get_info_callback (GObject      *source_object,
     new_info = g_file_query_info_finish (G_FILE (source_object), res, &error);
     if (new_info != NULL)
     {
-        if (nautilus_file_update_info (file, new_info))
+        if (nautilus_file_update_metadata_from_info (file, new_info))
         {
             nautilus_file_changed (file);
         }
@@ -123,20 +146,148 @@ set_metadata_callback (GObject      *source_object,
                                         NULL,
                                         &error);
 
+    metadata_writes_in_flight--;
+    g_hash_table_remove (metadata_files_writing, file);
+
     if (res)
     {
+        nautilus_file_unref (file);
+    }
+    else
+    {
+        /* The cached copy was updated ahead of the write, so bring it
+         * back in line with what the store actually has. */
         g_file_query_info_async (G_FILE (source_object),
-                                 NAUTILUS_FILE_DEFAULT_ATTRIBUTES,
+                                 "metadata::*",
                                  0,
                                  G_PRIORITY_DEFAULT,
                                  NULL,
                                  set_metadata_get_info_callback, file);
+        g_error_free (error);
     }
-    else
+
+    if (!g_queue_is_empty (&pending_metadata_files))
     {
-        nautilus_file_unref (file);
-        g_error_free (error);
+        schedule_metadata_flush (0);
+    }
+}
+
+static gboolean
+flush_pending_metadata (gpointer user_data)
+{
+    NautilusFile *file;
+    PendingMetadata *pending;
+    GFile *location;
+    GList *busy, *l;
+
+    metadata_flush_id = 0;
+    busy = NULL;
+
+    while (metadata_writes_in_flight < METADATA_MAX_WRITES_IN_FLIGHT &&
+           (file = g_queue_pop_head (&pending_metadata_files)) != NULL)
+    {
+        /* Keep writes to one file in order */
+        if (g_hash_table_contains (metadata_files_writing, file))
+        {
+            busy = g_list_prepend (busy, file);
+            continue;
+        }
+
+        pending = g_hash_table_lookup (pending_metadata, file);
+        g_hash_table_remove (pending_metadata, file);
+
+        if (pending->changed)
+        {
+            nautilus_file_changed (file);
+        }
+
+        metadata_writes_in_flight++;
+        g_hash_table_add (metadata_files_writing, file);
+
+        /* The reference held by the queue goes to the callback */
+        location = nautilus_file_get_location (file);
+        g_file_set_attributes_async (location,
+                                     pending->info,
+                                     0,
+                                     G_PRIORITY_DEFAULT,
+                                     NULL,
+                                     set_metadata_callback,
+                                     file);
+        g_object_unref (location);
+
+        g_object_unref (pending->info);
+        g_free (pending);
     }
+
+    /* busy is reversed, so pushing to the head restores the order */
+    for (l = busy; l != NULL; l = l->next)
+    {
+        g_queue_push_head (&pending_metadata_files, l->data);
+    }
+    g_list_free (busy);
+
+    return G_SOURCE_REMOVE;
+}
+
+static void
+schedule_metadata_flush (guint delay_msec)
+{
+    if (metadata_flush_id == 0)
+    {
+        metadata_flush_id = g_timeout_add (delay_msec, flush_pending_metadata, NULL);
+    }
+}
+
+static void
+merge_metadata_change (GFileInfo *pending,
+                       GFileInfo *change)
+{
+    char **attrs;
+    GFileAttributeType type;
+    gpointer value;
+    int i;
+
+    attrs = g_file_info_list_attributes (change, "metadata");
+    for (i = 0; attrs[i] != NULL; i++)
+    {
+        if (g_file_info_get_attribute_data (change, attrs[i], &type, &value, NULL))
+        {
+            g_file_info_set_attribute (pending, attrs[i], type, value);
+        }
+    }
+    g_strfreev (attrs);
+}
+
+static void
+queue_metadata_change (NautilusFile *file,
+                       GFileInfo    *change)
+{
+    PendingMetadata *pending;
+
+    if (pending_metadata == NULL)
+    {
+        pending_metadata = g_hash_table_new (NULL, NULL);
+        metadata_files_writing = g_hash_table_new (NULL, NULL);
+    }
+
+    pending = g_hash_table_lookup (pending_metadata, file);
+    if (pending == NULL)
+    {
+        pending = g_new0 (PendingMetadata, 1);
+        pending->info = g_file_info_new ();
+        g_hash_table_insert (pending_metadata, file, pending);
+        g_queue_push_tail (&pending_metadata_files, nautilus_file_ref (file));
+    }
+
+    /* A later value for the same key replaces the earlier one */
+    merge_metadata_change (pending->info, change);
+
+    if (nautilus_file_update_metadata_from_changes (file, change))
+    {
+        pending->changed = TRUE;
+    }
+
+    schedule_metadata_flush (METADATA_FLUSH_DELAY_MSEC);
 }
 
 static void
@@ -145,7 +296,6 @@ vfs_file_set_metadata (NautilusFile *file,
                        const char   *value)
 {
     GFileInfo *info;
-    GFile *location;
     char *gio_key;
 
     info = g_file_info_new ();
@@ -164,15 +314,7 @@ vfs_file_set_metadata (NautilusFile *file,
     }
     g_free (gio_key);
 
-    location = nautilus_file_get_location (file);
-    g_file_set_attributes_async (location,
-                                 info,
-                                 0,
-                                 G_PRIORITY_DEFAULT,
-                                 NULL,
-                                 set_metadata_callback,
-                                 nautilus_file_ref (file));
-    g_object_unref (location);
+    queue_metadata_change (file, info);
     g_object_unref (info);
 }
 
@@ -181,7 +323,6 @@ vfs_file_set_metadata_as_list (NautilusFile  *file,
                                const char    *key,
                                char         **value)
 {
-    GFile *location;
     GFileInfo *info;
     char *gio_key;
 
@@ -191,16 +332,8 @@ vfs_file_set_metadata_as_list (NautilusFile  *file,
     g_file_info_set_attribute_stringv (info, gio_key, value);
     g_free (gio_key);
 
-    location = nautilus_file_get_location (file);
-    g_file_set_attributes_async (location,
-                                 info,
-                                 0,
-                                 G_PRIORITY_DEFAULT,
-                                 NULL,
-                                 set_metadata_callback,
-                                 nautilus_file_ref (file));
+    queue_metadata_change (file, info);
     g_object_unref (info);
-    g_object_unref (location);
 }
 
 static gboolean
@@ -0,0 +1,427 @@
+/*
+ * nautilus-watchdog: reports callbacks that block the main loop
+ *
+ * Nautilus is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * Nautilus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <config.h>
+
+#include "nautilus-watchdog.h"
+
+#include "nautilus-metrics.h"
+#include "nautilus-profile.h"
+
+/* Deeper tags are counted but not recorded */
+#define MAX_TAGS 16
+
+typedef struct
+{
+    const char *name;
+    GSourceFunc function;
+    gpointer data;
+    GDestroyNotify notify;
+} TaggedSource;
+
+gboolean _nautilus_watchdog_enabled = FALSE;
+
+static gint64 threshold;
+static GThread *main_thread;
+static GThread *watchdog_thread;
+static GSource *iteration_source;
+
+/* Protects everything below */
+static GMutex watchdog_mutex;
+static GCond watchdog_cond;
+static gboolean watchdog_quit;
+/* When the main loop started dispatching, or 0 while it is waiting for
+ * something to do */
+static gint64 dispatch_start;
+/* Whether the current dispatch has been blamed on a tag already */
+static gboolean dispatch_attributed;
+/* How long the current dispatch may run before the watchdog thread
+ * reports it (again) */
+static gint64 next_live_report;
+static const char *tags[MAX_TAGS];
+static gint64 tag_start[MAX_TAGS];
+static guint n_tags;
+
+static const char *
+get_metric_name (const char *tag)
+{
+    const char *ret;
+    char *name;
+
+    if (tag == NULL)
+    {
+        return "main-loop-stall-time:untagged";
+    }
+
+    /* Metrics want static names; there are only so many tags */
+    name = g_strconcat ("main-loop-stall-time:", tag, NULL);
+    ret = g_intern_string (name);
+    g_free (name);
+
+    return ret;
+}
+
+static void
+report_stall (const char *tag,
+              gint64      duration)
+{
+    g_message ("Main loop blocked for %" G_GINT64_FORMAT " ms by %s",
+               duration / 1000, tag != NULL ? tag : "an untagged callback");
+
+    nautilus_metrics_observe ("main-loop-stall-time", duration);
+    nautilus_metrics_observe (get_metric_name (tag), duration);
+    nautilus_profile_msg ("main loop blocked by %s", tag != NULL ? tag : "untagged");
+}
+
+/* Call with watchdog_mutex held */
+static char *
+describe_tags (void)
+{
+    GString *str;
+    guint i;
+
+    if (n_tags == 0)
+    {
+        return g_strdup ("an untagged callback");
+    }
+
+    str = g_string_new (NULL);
+    for (i = 0; i < MIN (n_tags, MAX_TAGS); i++)
+    {
+        if (i > 0)
+        {
+            g_string_append (str, " > ");
+        }
+        g_string_append (str, tags[i]);
+    }
+
+    if (n_tags > MAX_TAGS)
+    {
+        g_string_append (str, " > ...");
+    }
+
+    return g_string_free (str, FALSE);
+}
+
+/* Runs right before the main loop goes back to waiting, which ends the
+ * dispatch that the check below started */
+static gboolean
+iteration_source_prepare (GSource *source,
+                          gint    *timeout)
+{
+    gint64 duration;
+    gboolean stalled;
+
+    duration = 0;
+    stalled = FALSE;
+
+    g_mutex_lock (&watchdog_mutex);
+    if (dispatch_start != 0)
+    {
+        duration = g_get_monotonic_time () - dispatch_start;
+        stalled = duration >= threshold && !dispatch_attributed;
+        dispatch_start = 0;
+    }
+    g_mutex_unlock (&watchdog_mutex);
+
+    if (stalled)
+    {
+        report_stall (NULL, duration);
+    }
+
+    *timeout = -1;
+    return FALSE;
+}
+
+/* Runs right after the main loop wakes up, before any source is
+ * dispatched */
+static gboolean
+iteration_source_check (GSource *source)
+{
+    g_mutex_lock (&watchdog_mutex);
+    dispatch_start = g_get_monotonic_time ();
+    dispatch_attributed = FALSE;
+    next_live_report = threshold;
+    g_mutex_unlock (&watchdog_mutex);
+
+    return FALSE;
+}
+
+static gboolean
+iteration_source_dispatch (GSource     *source,
+                           GSourceFunc  callback,
+                           gpointer     user_data)
+{
+    /* Never ready, so never dispatched */
+    return G_SOURCE_CONTINUE;
+}
+
+static GSourceFuncs iteration_source_funcs =
+{
+    iteration_source_prepare,
+    iteration_source_check,
+    iteration_source_dispatch,
+    NULL
+};
+
+static gpointer
+watchdog_thread_func (gpointer data)
+{
+    gint64 now;
+    char *description;
+
+    g_mutex_lock (&watchdog_mutex);
+
+    while (!watchdog_quit)
+    {
+        g_cond_wait_until (&watchdog_cond, &watchdog_mutex,
+                           g_get_monotonic_time () + MAX (threshold / 2, 10 * 1000));
+
+        now = g_get_monotonic_time ();
+        if (watchdog_quit ||
+            dispatch_start == 0 ||
+            now - dispatch_start < next_live_report)
+        {
+            continue;
+        }
+
+        /* Back off, so that a hang is reported a few times rather than
+         * on every wake up */
+        next_live_report *= 2;
+
+        description = describe_tags ();
+        g_message ("Main loop not responding for %" G_GINT64_FORMAT " ms, in %s",
+                   (now - dispatch_start) / 1000, description);
+        g_free (description);
+    }
+
+    g_mutex_unlock (&watchdog_mutex);
+
+    return NULL;
+}
+
+void
+_nautilus_watchdog_push (const char *tag)
+{
+    if (g_thread_self () != main_thread)
+    {
+        return;
+    }
+
+    g_mutex_lock (&watchdog_mutex);
+    if (n_tags < MAX_TAGS)
+    {
+        tags[n_tags] = tag;
+        tag_start[n_tags] = g_get_monotonic_time ();
+    }
+    n_tags++;
+    g_mutex_unlock (&watchdog_mutex);
+}
+
+void
+_nautilus_watchdog_pop (void)
+{
+    const char *tag;
+    gint64 duration;
+
+    if (g_thread_self () != main_thread)
+    {
+        return;
+    }
+
+    tag = NULL;
+    duration = 0;
+
+    g_mutex_lock (&watchdog_mutex);
+    if (n_tags == 0)
+    {
+        g_mutex_unlock (&watchdog_mutex);
+        g_warning ("nautilus_watchdog_pop() without a matching push");
+        return;
+    }
+    n_tags--;
+    /* The innermost tag that ran too long gets the blame, so the ones
+     * around it do not report the same stall again */
+    if (n_tags < MAX_TAGS && !dispatch_attributed)
+    {
+        duration = g_get_monotonic_time () - tag_start[n_tags];
+        if (duration >= threshold)
+        {
+            tag = tags[n_tags];
+            dispatch_attributed = TRUE;
+        }
+    }
+    g_mutex_unlock (&watchdog_mutex);
+
+    if (tag != NULL)
+    {
+        report_stall (tag, duration);
+    }
+}
+
+static gboolean
+tagged_source_dispatch (gpointer user_data)
+{
+    TaggedSource *tagged;
+    gboolean ret;
+
+    tagged = user_data;
+
+    _nautilus_watchdog_push (tagged->name);
+    ret = tagged->function (tagged->data);
+    _nautilus_watchdog_pop ();
+
+    return ret;
+}
+
+static void
+tagged_source_free (gpointer user_data)
+{
+    TaggedSource *tagged;
+
+    tagged = user_data;
+    if (tagged->notify != NULL)
+    {
+        tagged->notify (tagged->data);
+    }
+
+    g_slice_free (TaggedSource, tagged);
+}
+
+static TaggedSource *
+tagged_source_new (const char     *name,
+                   GSourceFunc     function,
+                   gpointer        data,
+                   GDestroyNotify  notify)
+{
+    TaggedSource *tagged;
+
+    tagged = g_slice_new (TaggedSource);
+    tagged->name = name;
+    tagged->function = function;
+    tagged->data = data;
+    tagged->notify = notify;
+
+    return tagged;
+}
+
+guint
+nautilus_watchdog_idle_add (const char     *name,
+                            gint            priority,
+                            GSourceFunc     function,
+                            gpointer        data,
+                            GDestroyNotify  notify)
+{
+    guint id;
+
+    if (_nautilus_watchdog_enabled)
+    {
+        id = g_idle_add_full (priority, tagged_source_dispatch,
+                              tagged_source_new (name, function, data, notify),
+                              tagged_source_free);
+    }
+    else
+    {
+        id = g_idle_add_full (priority, function, data, notify);
+    }
+
+    g_source_set_name_by_id (id, name);
+
+    return id;
+}
+
+guint
+nautilus_watchdog_timeout_add (const char     *name,
+                               gint            priority,
+                               guint           interval,
+                               GSourceFunc     function,
+                               gpointer        data,
+                               GDestroyNotify  notify)
+{
+    guint id;
+
+    if (_nautilus_watchdog_enabled)
+    {
+        id = g_timeout_add_full (priority, interval, tagged_source_dispatch,
+                                 tagged_source_new (name, function, data, notify),
+                                 tagged_source_free);
+    }
+    else
+    {
+        id = g_timeout_add_full (priority, interval, function, data, notify);
+    }
+
+    g_source_set_name_by_id (id, name);
+
+    return id;
+}
+
+void
+nautilus_watchdog_init (void)
+{
+    const char *value;
+    guint64 milliseconds;
+
+    value = g_getenv ("NAUTILUS_STALL_THRESHOLD");
+    if (value == NULL)
+    {
+        return;
+    }
+
+    milliseconds = g_ascii_strtoull (value, NULL, 10);
+    if (milliseconds == 0)
+    {
+        g_warning ("NAUTILUS_STALL_THRESHOLD should be a number of milliseconds");
+        return;
+    }
+
+    threshold = milliseconds * 1000;
+    main_thread = g_thread_self ();
+
+    /* High priority, so it is prepared and checked on every iteration
+     * however busy the lower priorities are */
+    iteration_source = g_source_new (&iteration_source_funcs, sizeof (GSource));
+    g_source_set_priority (iteration_source, G_PRIORITY_HIGH);
+    g_source_set_name (iteration_source, "nautilus-watchdog");
+    g_source_attach (iteration_source, NULL);
+
+    watchdog_thread = g_thread_new ("nautilus-watchdog", watchdog_thread_func, NULL);
+
+    _nautilus_watchdog_enabled = TRUE;
+}
+
+void
+nautilus_watchdog_shutdown (void)
+{
+    if (watchdog_thread == NULL)
+    {
+        return;
+    }
+
+    g_mutex_lock (&watchdog_mutex);
+    watchdog_quit = TRUE;
+    g_cond_signal (&watchdog_cond);
+    g_mutex_unlock (&watchdog_mutex);
+
+    g_thread_join (watchdog_thread);
+    watchdog_thread = NULL;
+
+    g_source_destroy (iteration_source);
+    g_source_unref (iteration_source);
+    iteration_source = NULL;
+}
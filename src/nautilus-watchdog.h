@@ -0,0 +1,67 @@
+/*
+ * nautilus-watchdog: reports callbacks that block the main loop
+ *
+ * Nautilus is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * Nautilus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * The watchdog is off unless a threshold is given:
+ *
+ *       NAUTILUS_STALL_THRESHOLD=100 nautilus
+ *
+ * logs every main loop dispatch that takes longer than 100 ms, naming
+ * the innermost tagged callback that was running, and records the
+ * durations in the "main-loop-stall-time" histograms of
+ * nautilus-metrics. A thread also logs stalls while they are still
+ * going on, so hangs that never return get reported too.
+ */
+
+#ifndef NAUTILUS_WATCHDOG_H
+#define NAUTILUS_WATCHDOG_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Set once at startup */
+extern gboolean _nautilus_watchdog_enabled;
+
+/* Tags the main thread work between them; @tag must be a static string.
+ * Tags nest, and must be popped in the order they were pushed. */
+#define nautilus_watchdog_push(tag) \
+    G_STMT_START { if (G_UNLIKELY (_nautilus_watchdog_enabled)) _nautilus_watchdog_push (tag); } G_STMT_END
+#define nautilus_watchdog_pop() \
+    G_STMT_START { if (G_UNLIKELY (_nautilus_watchdog_enabled)) _nautilus_watchdog_pop (); } G_STMT_END
+
+void  nautilus_watchdog_init     (void);
+void  nautilus_watchdog_shutdown (void);
+
+/* Like g_idle_add_full() and g_timeout_add_full(), but the callback is
+ * tagged with @name, which is also given to the source */
+guint nautilus_watchdog_idle_add    (const char     *name,
+                                     gint            priority,
+                                     GSourceFunc     function,
+                                     gpointer        data,
+                                     GDestroyNotify  notify);
+guint nautilus_watchdog_timeout_add (const char     *name,
+                                     gint            priority,
+                                     guint           interval,
+                                     GSourceFunc     function,
+                                     gpointer        data,
+                                     GDestroyNotify  notify);
+
+void  _nautilus_watchdog_push (const char *tag);
+void  _nautilus_watchdog_pop  (void);
+
+G_END_DECLS
+
+#endif /* NAUTILUS_WATCHDOG_H */
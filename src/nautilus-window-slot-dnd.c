@@ -493,7 +493,7 @@ slot_proxy_drag_data_received (GtkWidget        *widget,
 
     if (info == NAUTILUS_ICON_DND_GNOME_ICON_LIST)
     {
-        drag_info->data.selection_list = nautilus_drag_build_selection_list (data);
+        drag_info->data.selection_list = nautilus_drag_build_selection_list (context, data);
 
         drag_info->have_valid_data = drag_info->data.selection_list != NULL;
     }
@@ -38,6 +38,7 @@
 #include <glib/gi18n.h>
 #include <eel/eel-stock-dialogs.h>
 
+#include "nautilus-directory-prefetch.h"
 #include "nautilus-file.h"
 #include "nautilus-file-utilities.h"
 #include "nautilus-global-preferences.h"
@@ -2374,6 +2375,7 @@ slot_add_extension_extra_widgets (NautilusWindowSlot *self)
     GtkWidget *widget;
     char *uri;
     NautilusWindow *window;
+    gint64 start;
 
     providers = nautilus_module_get_extensions_for_type (NAUTILUS_TYPE_LOCATION_WIDGET_PROVIDER);
     window = nautilus_window_slot_get_window (self);
@@ -2384,7 +2386,10 @@ slot_add_extension_extra_widgets (NautilusWindowSlot *self)
         NautilusLocationWidgetProvider *provider;
 
         provider = NAUTILUS_LOCATION_WIDGET_PROVIDER (l->data);
+        start = g_get_monotonic_time ();
         widget = nautilus_location_widget_provider_get_widget (provider, uri, GTK_WIDGET (window));
+        nautilus_module_record_call (provider, "get_widget",
+                                     g_get_monotonic_time () - start);
         if (widget != NULL)
         {
             nautilus_window_slot_add_extra_location_widget (self, widget);
@@ -2450,6 +2455,38 @@ view_started_loading (NautilusWindowSlot *self,
     nautilus_window_slot_set_loading (self, TRUE);
 }
 
+/* How many pathbar ancestors of the current location to load ahead */
+#define PREFETCH_ANCESTORS 2
+
+static void
+prefetch_ancestors (NautilusWindowSlot *self)
+{
+    NautilusWindowSlotPrivate *priv;
+    GFile *location, *parent;
+    int i;
+
+    priv = nautilus_window_slot_get_instance_private (self);
+    if (priv->location == NULL)
+    {
+        return;
+    }
+
+    location = g_object_ref (priv->location);
+    for (i = 0; i < PREFETCH_ANCESTORS; i++)
+    {
+        parent = g_file_get_parent (location);
+        g_object_unref (location);
+        if (parent == NULL)
+        {
+            return;
+        }
+
+        nautilus_directory_prefetch_location (parent);
+        location = parent;
+    }
+    g_object_unref (location);
+}
+
 static void
 view_ended_loading (NautilusWindowSlot *self,
                     NautilusView       *view)
@@ -2465,6 +2502,10 @@ view_ended_loading (NautilusWindowSlot *self,
         }
 
         end_location_change (self);
+
+        /* Going up is the most likely next step, and the current
+         * location no longer competes for I/O */
+        prefetch_ancestors (self);
     }
 
     if (priv->needs_reload)
@@ -0,0 +1,13 @@
+#ifndef BATCH_RENAME_SYNTHETIC_H
+#define BATCH_RENAME_SYNTHETIC_H
+
+#include <glib.h>
+
+/* Synthetic batch renames of many files spread over this many directories,
+ * for checking how the conflict check scales */
+#define N_DIRECTORIES 100
+
+guint check_synthetic_files (guint   n_files,
+                             gint64 *duration);
+
+#endif /* BATCH_RENAME_SYNTHETIC_H */
@@ -0,0 +1,31 @@
+#!/bin/sh
+#
+# Measures time to first window: from the start of main() until the
+# "First window mapped" profiling mark. Needs a build with profiling
+# enabled (the default); the mark is read from the trace nautilus
+# writes at exit when NAUTILUS_TRACE is set.
+#
+#   benchmark-startup.sh [nautilus binary] [runs] [seconds to wait]
+
+NAUTILUS=${1:-../src/nautilus}
+RUNS=${2:-5}
+SETTLE=${3:-3}
+LOG=$(mktemp)
+
+trap 'rm -f "$LOG"' EXIT
+
+# A running instance would just get asked for a window over D-Bus
+"$NAUTILUS" --quit >/dev/null 2>&1
+
+for run in $(seq "$RUNS"); do
+    : > "$LOG"
+    NAUTILUS_TRACE="$LOG" "$NAUTILUS" --new-window >/dev/null 2>&1 &
+
+    sleep "$SETTLE"
+    "$NAUTILUS" --quit >/dev/null 2>&1
+    wait
+
+    # Trace timestamps are in microseconds since main()
+    sed -n 's/.*"name":"First window mapped".*"ts":\([0-9]*\).*/\1/p' "$LOG" |
+        awk -v run="$run" '{ printf "run %d: first window after %.1f ms\n", run, $1 / 1000 }'
+done
@@ -0,0 +1,141 @@
+#include <libnautilus-extension/nautilus-info-provider.h>
+#include <libnautilus-extension/nautilus-menu-provider.h>
+
+/* A near do-nothing extension, copied N times by
+ * test-nautilus-module-startup to stand in for installed extensions,
+ * and loaded into nautilus-extension-host by test-nautilus-extension-host.
+ * Its one file item is labelled with how many of its items are alive,
+ * and it never finishes updating file info until cancelled. */
+
+static GType dummy_type = 0;
+
+static guint n_live_items = 0;
+
+static void
+dummy_menu_item_finalized (gpointer  data,
+                           GObject  *where_the_object_was)
+{
+    n_live_items--;
+}
+
+static GList *
+dummy_menu_provider_get_file_items (NautilusMenuProvider *provider,
+                                    GtkWidget            *window,
+                                    GList                *files)
+{
+    NautilusMenuItem *item;
+    char *label;
+
+    n_live_items++;
+    label = g_strdup_printf ("%u", n_live_items);
+    item = nautilus_menu_item_new ("NautilusDummyExtension::item", label, NULL, NULL);
+    g_object_weak_ref (G_OBJECT (item), dummy_menu_item_finalized, NULL);
+    g_free (label);
+
+    return g_list_prepend (NULL, item);
+}
+
+static void
+dummy_menu_provider_iface_init (NautilusMenuProviderIface *iface)
+{
+    iface->get_file_items = dummy_menu_provider_get_file_items;
+}
+
+static NautilusOperationResult
+dummy_info_provider_update_file_info (NautilusInfoProvider     *provider,
+                                      NautilusFileInfo         *file,
+                                      GClosure                 *update_complete,
+                                      NautilusOperationHandle **handle)
+{
+    /* Any non-NULL pointer will do, nothing ever completes it */
+    *handle = (NautilusOperationHandle *) provider;
+
+    return NAUTILUS_OPERATION_IN_PROGRESS;
+}
+
+static void
+dummy_info_provider_cancel_update (NautilusInfoProvider    *provider,
+                                   NautilusOperationHandle *handle)
+{
+}
+
+static void
+dummy_info_provider_iface_init (NautilusInfoProviderIface *iface)
+{
+    iface->update_file_info = dummy_info_provider_update_file_info;
+    iface->cancel_update = dummy_info_provider_cancel_update;
+}
+
+void
+nautilus_module_initialize (GTypeModule *module)
+{
+    static const GTypeInfo info =
+    {
+        sizeof (GObjectClass),
+        NULL,
+        NULL,
+        NULL,
+        NULL,
+        NULL,
+        sizeof (GObject),
+        0,
+        NULL,
+    };
+    static const GInterfaceInfo menu_provider_iface_info =
+    {
+        (GInterfaceInitFunc) dummy_menu_provider_iface_init,
+        NULL,
+        NULL
+    };
+    static const GInterfaceInfo info_provider_iface_info =
+    {
+        (GInterfaceInitFunc) dummy_info_provider_iface_init,
+        NULL,
+        NULL
+    };
+    char *type_name;
+    int i;
+
+    /* Every copy ends up in the same process, so each needs its own name */
+    for (i = 0;; i++)
+    {
+        type_name = g_strdup_printf ("NautilusDummyExtension%d", i);
+        if (g_type_from_name (type_name) == 0)
+        {
+            break;
+        }
+        g_free (type_name);
+    }
+
+    dummy_type = g_type_module_register_type (module,
+                                              G_TYPE_OBJECT,
+                                              type_name,
+                                              &info, 0);
+    g_type_module_add_interface (module,
+                                 dummy_type,
+                                 NAUTILUS_TYPE_MENU_PROVIDER,
+                                 &menu_provider_iface_info);
+    g_type_module_add_interface (module,
+                                 dummy_type,
+                                 NAUTILUS_TYPE_INFO_PROVIDER,
+                                 &info_provider_iface_info);
+
+    g_free (type_name);
+}
+
+void
+nautilus_module_shutdown (void)
+{
+}
+
+void
+nautilus_module_list_types (const GType **types,
+                            int          *num_types)
+{
+    static GType type_list[1];
+
+    type_list[0] = dummy_type;
+    *types = type_list;
+
+    *num_types = 1;
+}
@@ -0,0 +1,136 @@
+#include <gio/gio.h>
+#include <stdlib.h>
+
+/* Prints the metrics of the running nautilus instance, see the
+ * org.gnome.Nautilus.Metrics interface. With --watch it keeps printing
+ * them every few seconds. */
+
+static int watch_interval = 0;
+
+static GOptionEntry entries[] =
+{
+    { "watch", 'w', 0, G_OPTION_ARG_INT, &watch_interval,
+      "Print the metrics again every SECONDS", "SECONDS" },
+    { NULL }
+};
+
+/* Upper bound, in microseconds, of the bucket holding the given
+ * fraction of the observations */
+static guint64
+histogram_quantile (GVariant *buckets,
+                    gint64    count,
+                    double    fraction)
+{
+    gsize n_buckets, i;
+    const guint64 *values;
+    guint64 seen;
+
+    values = g_variant_get_fixed_array (buckets, &n_buckets, sizeof (guint64));
+
+    seen = 0;
+    for (i = 0; i < n_buckets; i++)
+    {
+        seen += values[i];
+        if (seen >= count * fraction)
+        {
+            return (guint64) 1 << i;
+        }
+    }
+
+    return 0;
+}
+
+static gboolean
+print_metrics (GDBusConnection *connection)
+{
+    GVariant *reply;
+    GVariant *buckets;
+    GVariantIter *iter;
+    const char *name, *kind;
+    gint64 value, sum, max;
+    GError *error = NULL;
+
+    reply = g_dbus_connection_call_sync (connection,
+                                         "org.gnome.Nautilus",
+                                         "/org/gnome/Nautilus",
+                                         "org.gnome.Nautilus.Metrics",
+                                         "GetMetrics",
+                                         NULL,
+                                         G_VARIANT_TYPE ("(a(ssxxxat))"),
+                                         G_DBUS_CALL_FLAGS_NO_AUTO_START,
+                                         -1, NULL, &error);
+    if (reply == NULL)
+    {
+        g_printerr ("Could not get metrics: %s\n", error->message);
+        g_error_free (error);
+        return FALSE;
+    }
+
+    g_print ("%-28s %-10s %12s %12s %10s %10s\n",
+             "NAME", "KIND", "VALUE", "MAX", "P50 (us)", "P99 (us)");
+
+    g_variant_get (reply, "(a(ssxxxat))", &iter);
+    while (g_variant_iter_next (iter, "(&s&sxxx@at)",
+                                &name, &kind, &value, &sum, &max, &buckets))
+    {
+        if (g_str_equal (kind, "histogram") && value > 0)
+        {
+            g_print ("%-28s %-10s %12" G_GINT64_FORMAT " %12" G_GINT64_FORMAT
+                     " %10" G_GUINT64_FORMAT " %10" G_GUINT64_FORMAT "\n",
+                     name, kind, value, max,
+                     histogram_quantile (buckets, value, 0.5),
+                     histogram_quantile (buckets, value, 0.99));
+        }
+        else
+        {
+            g_print ("%-28s %-10s %12" G_GINT64_FORMAT " %12" G_GINT64_FORMAT "\n",
+                     name, kind, value, max);
+        }
+        g_variant_unref (buckets);
+    }
+    g_variant_iter_free (iter);
+    g_variant_unref (reply);
+
+    return TRUE;
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+    GOptionContext *context;
+    GDBusConnection *connection;
+    GError *error = NULL;
+
+    context = g_option_context_new ("- print the metrics of a running nautilus");
+    g_option_context_add_main_entries (context, entries, NULL);
+    if (!g_option_context_parse (context, &argc, &argv, &error))
+    {
+        g_printerr ("%s\n", error->message);
+        return EXIT_FAILURE;
+    }
+    g_option_context_free (context);
+
+    connection = g_bus_get_sync (G_BUS_TYPE_SESSION, NULL, &error);
+    if (connection == NULL)
+    {
+        g_printerr ("Could not connect to the session bus: %s\n", error->message);
+        return EXIT_FAILURE;
+    }
+
+    while (print_metrics (connection))
+    {
+        if (watch_interval <= 0)
+        {
+            g_object_unref (connection);
+            return EXIT_SUCCESS;
+        }
+
+        g_usleep (watch_interval * G_USEC_PER_SEC);
+        g_print ("\n");
+    }
+
+    g_object_unref (connection);
+
+    return EXIT_FAILURE;
+}
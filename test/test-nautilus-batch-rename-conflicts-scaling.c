@@ -0,0 +1,59 @@
+#include <glib.h>
+#include <stdlib.h>
+
+#include "batch-rename-synthetic.h"
+
+/* Prints how long checking a batch rename for conflicts takes for growing
+ * numbers of files, e.g.
+ *   test-nautilus-batch-rename-conflicts-scaling 50000
+ * Each step has four times the files of the previous one, so a linear
+ * check takes about four times as long and a quadratic one sixteen. */
+
+#define DEFAULT_N_FILES 50000
+
+int
+main (int   argc,
+      char *argv[])
+{
+    guint n_files;
+    guint n;
+    guint n_conflicts;
+    gint64 previous;
+    gint64 duration;
+
+    if (argc > 2)
+    {
+        g_printerr ("Usage: %s [N_FILES]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    n_files = argc == 2 ? (guint) strtoul (argv[1], NULL, 10) : DEFAULT_N_FILES;
+    if (n_files < N_DIRECTORIES)
+    {
+        n_files = N_DIRECTORIES;
+    }
+
+    previous = 0;
+    for (n = MAX (n_files / 64, N_DIRECTORIES); n <= n_files; n *= 4)
+    {
+        n_conflicts = check_synthetic_files (n, &duration);
+        if (n_conflicts != 0)
+        {
+            g_printerr ("%u files: %u unexpected conflicts\n", n, n_conflicts);
+            return EXIT_FAILURE;
+        }
+
+        if (previous > 0)
+        {
+            g_print ("%8u files: %10" G_GINT64_FORMAT " us, %5.1fx the previous step\n",
+                     n, duration, (double) duration / previous);
+        }
+        else
+        {
+            g_print ("%8u files: %10" G_GINT64_FORMAT " us\n", n, duration);
+        }
+        previous = MAX (duration, 1);
+    }
+
+    return EXIT_SUCCESS;
+}
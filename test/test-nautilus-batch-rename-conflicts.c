@@ -0,0 +1,127 @@
+#include <glib.h>
+
+#include "batch-rename-synthetic.h"
+
+#include "src/nautilus-batch-rename-dialog.h"
+#include "src/nautilus-batch-rename-utilities.h"
+
+static GHashTable *
+names_set_new (const gchar *first_name,
+               ...)
+{
+    GHashTable *names;
+    const gchar *name;
+    va_list args;
+
+    names = g_hash_table_new (g_str_hash, g_str_equal);
+
+    va_start (args, first_name);
+    for (name = first_name; name != NULL; name = va_arg (args, const gchar *))
+    {
+        g_hash_table_add (names, (gpointer) name);
+    }
+    va_end (args);
+
+    return names;
+}
+
+static void
+test_duplicate_new_names (void)
+{
+    BatchRenameConflicts *conflicts;
+    guint a, b, c;
+
+    conflicts = batch_rename_conflicts_new ();
+    a = batch_rename_conflicts_add_file (conflicts, "file:///dir", "a.txt");
+    b = batch_rename_conflicts_add_file (conflicts, "file:///dir", "b.txt");
+    c = batch_rename_conflicts_add_file (conflicts, "file:///other", "c.txt");
+
+    batch_rename_conflicts_set_new_name (conflicts, a, "new.txt");
+    batch_rename_conflicts_set_new_name (conflicts, b, "new.txt");
+    batch_rename_conflicts_set_new_name (conflicts, c, "new.txt");
+
+    g_assert_true (batch_rename_conflicts_has_conflict (conflicts, a, NULL));
+    g_assert_true (batch_rename_conflicts_has_conflict (conflicts, b, NULL));
+    /* same name, but somewhere else */
+    g_assert_false (batch_rename_conflicts_has_conflict (conflicts, c, NULL));
+
+    /* counts follow the names as they change */
+    batch_rename_conflicts_set_new_name (conflicts, b, "other.txt");
+    g_assert_false (batch_rename_conflicts_has_conflict (conflicts, a, NULL));
+    g_assert_false (batch_rename_conflicts_has_conflict (conflicts, b, NULL));
+
+    batch_rename_conflicts_free (conflicts);
+}
+
+static void
+test_existing_files (void)
+{
+    BatchRenameConflicts *conflicts;
+    GHashTable *existing;
+    guint a, b;
+
+    existing = names_set_new ("a.txt", "b.txt", "taken.txt", NULL);
+
+    conflicts = batch_rename_conflicts_new ();
+    a = batch_rename_conflicts_add_file (conflicts, "file:///dir", "a.txt");
+    b = batch_rename_conflicts_add_file (conflicts, "file:///dir", "b.txt");
+
+    /* taken by a file that isn't being renamed */
+    batch_rename_conflicts_set_new_name (conflicts, a, "taken.txt");
+    batch_rename_conflicts_set_new_name (conflicts, b, "b.txt");
+    g_assert_true (batch_rename_conflicts_has_conflict (conflicts, a, existing));
+    g_assert_false (batch_rename_conflicts_has_conflict (conflicts, b, existing));
+
+    /* taken by a file of the selection that keeps its name */
+    batch_rename_conflicts_set_new_name (conflicts, a, "b.txt");
+    g_assert_true (batch_rename_conflicts_has_conflict (conflicts, a, existing));
+
+    /* freed by a file of the selection that gets another name */
+    batch_rename_conflicts_set_new_name (conflicts, b, "c.txt");
+    g_assert_false (batch_rename_conflicts_has_conflict (conflicts, a, existing));
+    g_assert_false (batch_rename_conflicts_has_conflict (conflicts, b, existing));
+
+    /* swapping names is fine too */
+    batch_rename_conflicts_set_new_name (conflicts, b, "a.txt");
+    g_assert_false (batch_rename_conflicts_has_conflict (conflicts, a, existing));
+    g_assert_false (batch_rename_conflicts_has_conflict (conflicts, b, existing));
+
+    batch_rename_conflicts_free (conflicts);
+    g_hash_table_destroy (existing);
+}
+
+static void
+test_many_files (void)
+{
+    gint64 quarter, full;
+
+    g_assert_cmpuint (check_synthetic_files (50000 / 4, &quarter), ==, 0);
+    g_assert_cmpuint (check_synthetic_files (50000, &full), ==, 0);
+
+    /* Four times the files should take about four times as long; checking
+     * every file against every other would take sixteen. The floor keeps
+     * timer noise on a fast run from failing it. */
+    g_assert_cmpint (full, <, 10 * MAX (quarter, 1000));
+}
+
+static void
+setup_test_suite (void)
+{
+    g_test_add_func ("/batch-rename-conflicts/duplicate-new-names",
+                     test_duplicate_new_names);
+    g_test_add_func ("/batch-rename-conflicts/existing-files",
+                     test_existing_files);
+    g_test_add_func ("/batch-rename-conflicts/many-files",
+                     test_many_files);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+    g_test_init (&argc, &argv, NULL);
+
+    setup_test_suite ();
+
+    return g_test_run ();
+}
@@ -0,0 +1,262 @@
+#include <gio/gio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+
+#include "src/nautilus-extension-host-generated.h"
+
+/* Talks to the nautilus-extension-host that NAUTILUS_EXTENSION_HOST
+ * points at, the way nautilus does, with libnautilus-dummy-extension
+ * loaded into it. */
+
+#define HOST_SOCKET_FD 3
+#define HOST_OBJECT_PATH "/org/gnome/Nautilus/ExtensionHost"
+#define DUMMY_EXTENSION DUMMY_EXTENSION_DIR "/libnautilus-dummy-extension.so"
+
+static GSubprocess *host_process;
+static NautilusDBusExtensionHost *host_proxy;
+static char *dummy_extension_name;
+
+static NautilusDBusExtensionHost *
+start_host (const char *host_path)
+{
+    GSubprocessLauncher *launcher;
+    GSocketConnection *stream;
+    GSocket *socket;
+    GDBusConnection *connection;
+    NautilusDBusExtensionHost *proxy;
+    char *guid;
+    int fds[2];
+    GError *error = NULL;
+
+    g_assert_cmpint (socketpair (AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds), ==, 0);
+
+    launcher = g_subprocess_launcher_new (G_SUBPROCESS_FLAGS_NONE);
+    g_subprocess_launcher_take_fd (launcher, fds[1], HOST_SOCKET_FD);
+    host_process = g_subprocess_launcher_spawn (launcher, &error, host_path, NULL);
+    g_assert_no_error (error);
+    g_object_unref (launcher);
+
+    socket = g_socket_new_from_fd (fds[0], &error);
+    g_assert_no_error (error);
+    stream = g_socket_connection_factory_create_connection (socket);
+
+    guid = g_dbus_generate_guid ();
+    connection = g_dbus_connection_new_sync (G_IO_STREAM (stream), guid,
+                                             G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_SERVER |
+                                             G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_ALLOW_ANONYMOUS,
+                                             NULL, NULL, &error);
+    g_assert_no_error (error);
+
+    proxy = nautilus_dbus_extension_host_proxy_new_sync (connection,
+                                                         G_DBUS_PROXY_FLAGS_DO_NOT_LOAD_PROPERTIES,
+                                                         NULL,
+                                                         HOST_OBJECT_PATH,
+                                                         NULL,
+                                                         &error);
+    g_assert_no_error (error);
+
+    g_free (guid);
+    g_object_unref (connection);
+    g_object_unref (stream);
+    g_object_unref (socket);
+
+    return proxy;
+}
+
+static GVariant *
+get_test_files (void)
+{
+    GVariantBuilder builder;
+
+    g_variant_builder_init (&builder, G_VARIANT_TYPE ("aa{sv}"));
+    g_variant_builder_open (&builder, G_VARIANT_TYPE_VARDICT);
+    g_variant_builder_add (&builder, "{sv}", "uri",
+                           g_variant_new_string ("file:///nowhere/file.txt"));
+    g_variant_builder_add (&builder, "{sv}", "name",
+                           g_variant_new_string ("file.txt"));
+    g_variant_builder_add (&builder, "{sv}", "mime-type",
+                           g_variant_new_string ("text/plain"));
+    g_variant_builder_close (&builder);
+
+    return g_variant_builder_end (&builder);
+}
+
+static void
+test_load_module (void)
+{
+    GVariant *extensions;
+    const char **interfaces;
+    GError *error = NULL;
+
+    nautilus_dbus_extension_host_call_load_module_sync (host_proxy, DUMMY_EXTENSION,
+                                                        &extensions, NULL, &error);
+    g_assert_no_error (error);
+
+    g_assert_cmpuint (g_variant_n_children (extensions), ==, 1);
+    g_variant_get_child (extensions, 0, "(s^a&s)", &dummy_extension_name, &interfaces);
+    g_assert (g_str_has_prefix (dummy_extension_name, "NautilusDummyExtension"));
+    g_assert (g_strv_contains ((const char * const *) interfaces, "NautilusMenuProvider"));
+    g_assert (g_strv_contains ((const char * const *) interfaces, "NautilusInfoProvider"));
+    g_assert (!g_strv_contains ((const char * const *) interfaces, "NautilusColumnProvider"));
+
+    g_free (interfaces);
+    g_variant_unref (extensions);
+
+    /* Loading something that is not a module fails rather than crashing */
+    nautilus_dbus_extension_host_call_load_module_sync (host_proxy, "/nowhere/nothing.so",
+                                                        &extensions, NULL, &error);
+    g_assert_error (error, G_IO_ERROR, G_IO_ERROR_FAILED);
+    g_clear_error (&error);
+}
+
+/* The dummy extension labels its item with how many of its items are
+ * alive, this one included */
+static guint
+get_live_items (guint menu_id)
+{
+    GVariant *items;
+    const char *label;
+    guint n_items;
+    GError *error = NULL;
+
+    nautilus_dbus_extension_host_call_get_file_items_sync (host_proxy,
+                                                           dummy_extension_name,
+                                                           0,
+                                                           menu_id,
+                                                           get_test_files (),
+                                                           &items, NULL, &error);
+    g_assert_no_error (error);
+
+    g_assert_cmpuint (g_variant_n_children (items), ==, 1);
+    g_variant_get_child (items, 0, "(i&s&s&s&sbb)",
+                         NULL, NULL, &label, NULL, NULL, NULL, NULL);
+    n_items = (guint) g_ascii_strtoull (label, NULL, 10);
+
+    g_variant_unref (items);
+
+    return n_items;
+}
+
+static void
+release_menu (guint menu_id)
+{
+    GError *error = NULL;
+
+    nautilus_dbus_extension_host_call_release_menu_sync (host_proxy, menu_id, NULL, &error);
+    g_assert_no_error (error);
+}
+
+static void
+test_file_items_release (void)
+{
+    g_assert_nonnull (dummy_extension_name);
+
+    /* Nothing is kept for menu 0, so its item is gone by the next call */
+    g_assert_cmpuint (get_live_items (0), ==, 1);
+    g_assert_cmpuint (get_live_items (0), ==, 1);
+
+    /* Every other menu keeps its items until it is released */
+    g_assert_cmpuint (get_live_items (1), ==, 1);
+    g_assert_cmpuint (get_live_items (2), ==, 2);
+    g_assert_cmpuint (get_live_items (3), ==, 3);
+
+    release_menu (2);
+    g_assert_cmpuint (get_live_items (0), ==, 3);
+
+    release_menu (1);
+    release_menu (3);
+    g_assert_cmpuint (get_live_items (0), ==, 1);
+
+    /* Releasing an unknown menu, or one twice, is harmless */
+    release_menu (1);
+    release_menu (42);
+    g_assert_cmpuint (get_live_items (0), ==, 1);
+}
+
+static void
+update_file_info_callback (GObject      *source_object,
+                           GAsyncResult *res,
+                           gpointer      user_data)
+{
+    GError **error;
+    GVariant *results;
+
+    error = user_data;
+    if (nautilus_dbus_extension_host_call_update_file_info_finish (host_proxy, &results,
+                                                                   res, error))
+    {
+        /* Leaves nothing to wait for */
+        g_variant_unref (results);
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED, "The update finished");
+    }
+}
+
+static void
+test_update_cancel (void)
+{
+    GError *update_error = NULL;
+    GError *error = NULL;
+
+    g_assert_nonnull (dummy_extension_name);
+
+    /* The dummy extension never finishes on its own */
+    nautilus_dbus_extension_host_call_update_file_info (host_proxy,
+                                                        dummy_extension_name,
+                                                        7,
+                                                        get_test_files (),
+                                                        NULL,
+                                                        update_file_info_callback,
+                                                        &update_error);
+
+    /* Cancelling something that is not running is harmless */
+    nautilus_dbus_extension_host_call_cancel_update_sync (host_proxy, 8, NULL, &error);
+    g_assert_no_error (error);
+    g_main_context_iteration (NULL, FALSE);
+    g_assert_null (update_error);
+
+    nautilus_dbus_extension_host_call_cancel_update_sync (host_proxy, 7, NULL, &error);
+    g_assert_no_error (error);
+
+    /* The host answers the update before the cancellation */
+    while (update_error == NULL)
+    {
+        g_main_context_iteration (NULL, TRUE);
+    }
+    g_assert_error (update_error, G_IO_ERROR, G_IO_ERROR_CANCELLED);
+    g_clear_error (&update_error);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+    const char *host_path;
+    int ret;
+
+    g_test_init (&argc, &argv, NULL);
+
+    host_path = g_getenv ("NAUTILUS_EXTENSION_HOST");
+    if (host_path == NULL)
+    {
+        g_printerr ("NAUTILUS_EXTENSION_HOST is not set, skipping\n");
+        return 77;
+    }
+
+    host_proxy = start_host (host_path);
+
+    g_test_add_func ("/extension-host/load-module", test_load_module);
+    g_test_add_func ("/extension-host/file-items-release", test_file_items_release);
+    g_test_add_func ("/extension-host/update-cancel", test_update_cancel);
+
+    ret = g_test_run ();
+
+    /* The host quits once the connection goes */
+    g_dbus_connection_close_sync (g_dbus_proxy_get_connection (G_DBUS_PROXY (host_proxy)),
+                                  NULL, NULL);
+    g_object_unref (host_proxy);
+    g_subprocess_wait (host_process, NULL, NULL);
+    g_object_unref (host_process);
+    g_free (dummy_extension_name);
+
+    return ret;
+}
@@ -0,0 +1,204 @@
+#include <src/nautilus-file.h>
+#include <src/nautilus-global-preferences.h>
+#include <src/nautilus-keyfile-metadata.h>
+#include <src/nautilus-metadata.h>
+#include <glib/gstdio.h>
+#include <unistd.h>
+
+/* Checks that a process that dies before the keyfile is ever rewritten
+ * loses none of 10k small metadata updates: the journal has to bring
+ * every update back on the next load. Shutting down has to fold the
+ * journal into the keyfile. Run with -m perf to also time the updates. */
+
+#define N_UPDATES 10000
+#define N_GROUPS 100
+
+static char *test_dir;
+static char *keyfile_filename;
+
+static NautilusFile *
+get_test_file (void)
+{
+    NautilusFile *file;
+    GFile *location;
+
+    location = g_file_new_for_path (test_dir);
+    file = nautilus_file_get (location);
+    g_object_unref (location);
+
+    return file;
+}
+
+static void
+make_updates (const char *filename)
+{
+    NautilusFile *file;
+    char group[32], value[32];
+    const char *list[3];
+    int i;
+
+    file = get_test_file ();
+
+    for (i = 0; i < N_UPDATES; i++)
+    {
+        g_snprintf (group, sizeof (group), "file-%d", i % N_GROUPS);
+        g_snprintf (value, sizeof (value), "%d", i);
+
+        if (i % 10 == 0)
+        {
+            list[0] = value;
+            list[1] = "with\ttab and\nnewline";
+            list[2] = NULL;
+            nautilus_keyfile_metadata_set_stringv (file, filename, group,
+                                                   NAUTILUS_METADATA_KEY_EMBLEMS, list);
+        }
+        else
+        {
+            nautilus_keyfile_metadata_set_string (file, filename, group,
+                                                  NAUTILUS_METADATA_KEY_ICON_POSITION, value);
+        }
+    }
+
+    nautilus_file_unref (file);
+}
+
+static void
+run_updates (void)
+{
+    make_updates (keyfile_filename);
+
+    /* Die without running the idle that would sync or compact */
+    _exit (0);
+}
+
+static void
+test_update_timing (void)
+{
+    char *filename;
+    char *journal_filename;
+    gint64 start, elapsed;
+
+    filename = g_build_filename (test_dir, "timing", NULL);
+
+    start = g_get_monotonic_time ();
+    make_updates (filename);
+    elapsed = g_get_monotonic_time () - start;
+
+    g_test_minimized_result ((double) elapsed / N_UPDATES,
+                             "%d updates in %.1f ms (%.2f us per update)",
+                             N_UPDATES, elapsed / 1000.0, (double) elapsed / N_UPDATES);
+
+    journal_filename = g_strconcat (filename, ".journal", NULL);
+    g_unlink (journal_filename);
+    g_unlink (filename);
+    g_free (journal_filename);
+    g_free (filename);
+}
+
+static void
+test_replay_after_crash (void)
+{
+    NautilusFile *file;
+    char *value;
+    GList *list;
+
+    g_test_trap_subprocess ("/keyfile-metadata/updates", 0, 0);
+    g_test_trap_assert_passed ();
+
+    g_assert_false (g_file_test (keyfile_filename, G_FILE_TEST_EXISTS));
+
+    file = get_test_file ();
+
+    /* The last write to file-99 was update 9999, a position */
+    nautilus_keyfile_metadata_update_from_keyfile (file, keyfile_filename, "file-99");
+    value = nautilus_file_get_metadata (file, NAUTILUS_METADATA_KEY_ICON_POSITION, NULL);
+    g_assert_cmpstr (value, ==, "9999");
+    g_free (value);
+
+    /* The last write to file-90 was update 9990, a list of emblems */
+    nautilus_keyfile_metadata_update_from_keyfile (file, keyfile_filename, "file-90");
+    list = nautilus_file_get_metadata_list (file, NAUTILUS_METADATA_KEY_EMBLEMS);
+    g_assert_cmpint (g_list_length (list), ==, 2);
+    g_assert_cmpstr (list->data, ==, "9990");
+    g_assert_cmpstr (list->next->data, ==, "with\ttab and\nnewline");
+    g_list_free_full (list, g_free);
+
+    nautilus_file_unref (file);
+}
+
+static void
+test_compact_on_shutdown (void)
+{
+    GKeyFile *keyfile;
+    char *journal_filename;
+    char *contents;
+    char *value;
+    gsize length;
+
+    /* The journal replayed by the previous test is still loaded */
+    nautilus_keyfile_metadata_shutdown ();
+
+    journal_filename = g_strconcat (keyfile_filename, ".journal", NULL);
+    g_assert_true (g_file_get_contents (journal_filename, &contents, &length, NULL));
+    g_assert_cmpuint (length, ==, 0);
+    g_free (contents);
+    g_free (journal_filename);
+
+    keyfile = g_key_file_new ();
+    g_assert_true (g_key_file_load_from_file (keyfile, keyfile_filename, G_KEY_FILE_NONE, NULL));
+    value = g_key_file_get_string (keyfile, "file-99", NAUTILUS_METADATA_KEY_ICON_POSITION, NULL);
+    g_assert_cmpstr (value, ==, "9999");
+    g_free (value);
+    g_key_file_unref (keyfile);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+    int ret;
+    char *journal_filename;
+
+    g_test_init (&argc, &argv, NULL);
+
+    nautilus_global_preferences_init ();
+
+    if (g_test_subprocess ())
+    {
+        test_dir = g_strdup (g_getenv ("NAUTILUS_TEST_DIR"));
+    }
+    else
+    {
+        test_dir = g_dir_make_tmp ("nautilus-keyfile-metadata-XXXXXX", NULL);
+        g_setenv ("NAUTILUS_TEST_DIR", test_dir, TRUE);
+    }
+    keyfile_filename = g_build_filename (test_dir, "metadata", NULL);
+
+    /* Only ever run in a child, since it exits without cleaning up */
+    if (g_test_subprocess ())
+    {
+        g_test_add_func ("/keyfile-metadata/updates", run_updates);
+    }
+    g_test_add_func ("/keyfile-metadata/replay-after-crash", test_replay_after_crash);
+    g_test_add_func ("/keyfile-metadata/compact-on-shutdown", test_compact_on_shutdown);
+    if (g_test_perf ())
+    {
+        g_test_add_func ("/keyfile-metadata/update-timing", test_update_timing);
+    }
+
+    ret = g_test_run ();
+
+    if (!g_test_subprocess ())
+    {
+        journal_filename = g_strconcat (keyfile_filename, ".journal", NULL);
+        g_unlink (journal_filename);
+        g_unlink (keyfile_filename);
+        g_rmdir (test_dir);
+        g_free (journal_filename);
+    }
+
+    g_free (keyfile_filename);
+    g_free (test_dir);
+
+    return ret;
+}
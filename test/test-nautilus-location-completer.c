@@ -0,0 +1,231 @@
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "src/nautilus-location-completer.h"
+
+/* Completes names in a directory of folders made for the test, which the
+ * completer has to read itself since nothing else has loaded it. */
+
+static const char *folders[] =
+{
+    "alpha",
+    "beta-one",
+    "beta-two",
+    /* The same first byte of two different characters */
+    "caf\xc3\xa9-x",
+    "caf\xc3\xa8-y",
+    "with space",
+    NULL
+};
+
+/* Only folders get completed */
+#define PLAIN_FILE "alpine.txt"
+
+static char *test_dir;
+static NautilusLocationCompleter *completer;
+
+static char *
+complete (const char *text)
+{
+    return nautilus_location_completer_get_completion_suffix (completer, text);
+}
+
+static char *
+complete_path (const char *basename)
+{
+    char *text;
+    char *suffix;
+
+    text = g_strconcat (test_dir, "/", basename, NULL);
+    suffix = complete (text);
+    g_free (text);
+
+    return suffix;
+}
+
+static void
+got_completion_data_callback (NautilusLocationCompleter *completer,
+                              gpointer                   user_data)
+{
+    g_main_loop_quit (user_data);
+}
+
+/* The first completion in a directory nobody has loaded reads it in
+ * the background */
+static void
+read_test_dir (void)
+{
+    GMainLoop *loop;
+    char *suffix;
+
+    loop = g_main_loop_new (NULL, FALSE);
+    g_signal_connect (completer, "got-completion-data",
+                      G_CALLBACK (got_completion_data_callback), loop);
+
+    suffix = complete_path ("al");
+    g_assert_null (suffix);
+    g_main_loop_run (loop);
+
+    g_signal_handlers_disconnect_by_func (completer, got_completion_data_callback, loop);
+    g_main_loop_unref (loop);
+}
+
+static void
+assert_completion (const char *text,
+                   const char *expected)
+{
+    char *suffix;
+
+    suffix = complete (text);
+    g_assert_cmpstr (suffix, ==, expected);
+    g_free (suffix);
+}
+
+static void
+assert_path_completion (const char *basename,
+                        const char *expected)
+{
+    char *suffix;
+
+    suffix = complete_path (basename);
+    g_assert_cmpstr (suffix, ==, expected);
+    g_free (suffix);
+}
+
+static void
+test_no_match (void)
+{
+    assert_path_completion ("gamma", NULL);
+    assert_path_completion ("alphas", NULL);
+    /* Sorts after every name */
+    assert_path_completion ("zzz", NULL);
+    /* Sorts before every name */
+    assert_path_completion ("Alpha", NULL);
+}
+
+static void
+test_single_match (void)
+{
+    /* "alpine.txt" is a plain file, so "alpha" is the only match */
+    assert_path_completion ("al", "pha/");
+    assert_path_completion ("beta-t", "wo/");
+    /* Already complete */
+    assert_path_completion ("alpha", "/");
+}
+
+static void
+test_several_matches (void)
+{
+    assert_path_completion ("b", "eta-");
+    /* Nothing in common beyond what was typed */
+    assert_path_completion ("beta-", NULL);
+    /* Everything matches the empty name */
+    assert_path_completion ("", NULL);
+}
+
+static void
+test_utf8 (void)
+{
+    /* The names share the first byte of "é" and "è", which is not a
+     * character on its own */
+    assert_path_completion ("c", "af");
+    assert_path_completion ("caf", NULL);
+    assert_path_completion ("caf\xc3\xa9", "-x/");
+}
+
+static void
+test_uri_escaping (void)
+{
+    char *uri;
+    char *text;
+
+    uri = g_filename_to_uri (test_dir, NULL, NULL);
+
+    /* What gets added is escaped */
+    text = g_strconcat (uri, "/wi", NULL);
+    assert_completion (text, "th%20space/");
+    g_free (text);
+
+    /* and so is what was typed */
+    text = g_strconcat (uri, "/with%20", NULL);
+    assert_completion (text, "space/");
+    g_free (text);
+
+    text = g_strconcat (uri, "/c", NULL);
+    assert_completion (text, "af");
+    g_free (text);
+
+    text = g_strconcat (uri, "/caf%C3%A9", NULL);
+    assert_completion (text, "-x/");
+    g_free (text);
+
+    g_free (uri);
+}
+
+static void
+make_test_dir (void)
+{
+    char *path;
+    guint i;
+
+    test_dir = g_dir_make_tmp ("nautilus-location-completer-XXXXXX", NULL);
+    g_assert_nonnull (test_dir);
+
+    for (i = 0; folders[i] != NULL; i++)
+    {
+        path = g_build_filename (test_dir, folders[i], NULL);
+        g_assert_cmpint (g_mkdir (path, 0700), ==, 0);
+        g_free (path);
+    }
+
+    path = g_build_filename (test_dir, PLAIN_FILE, NULL);
+    g_assert_true (g_file_set_contents (path, "", 0, NULL));
+    g_free (path);
+}
+
+static void
+remove_test_dir (void)
+{
+    char *path;
+    guint i;
+
+    for (i = 0; folders[i] != NULL; i++)
+    {
+        path = g_build_filename (test_dir, folders[i], NULL);
+        g_rmdir (path);
+        g_free (path);
+    }
+
+    path = g_build_filename (test_dir, PLAIN_FILE, NULL);
+    g_unlink (path);
+    g_free (path);
+
+    g_rmdir (test_dir);
+    g_free (test_dir);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+    int ret;
+
+    g_test_init (&argc, &argv, NULL);
+
+    make_test_dir ();
+    completer = nautilus_location_completer_new ();
+    read_test_dir ();
+
+    g_test_add_func ("/location-completer/no-match", test_no_match);
+    g_test_add_func ("/location-completer/single-match", test_single_match);
+    g_test_add_func ("/location-completer/several-matches", test_several_matches);
+    g_test_add_func ("/location-completer/utf8", test_utf8);
+    g_test_add_func ("/location-completer/uri-escaping", test_uri_escaping);
+
+    ret = g_test_run ();
+
+    g_object_unref (completer);
+    remove_test_dir ();
+
+    return ret;
+}
@@ -0,0 +1,150 @@
+#include <glib.h>
+
+#include "src/nautilus-file.h"
+#include "src/nautilus-menu-provider-cache.h"
+#include <libnautilus-extension/nautilus-menu-item.h>
+
+/* A menu provider whose single item is named after @label, and which
+ * counts how many times it has been asked */
+#define TEST_TYPE_MENU_PROVIDER (test_menu_provider_get_type ())
+G_DECLARE_FINAL_TYPE (TestMenuProvider, test_menu_provider, TEST, MENU_PROVIDER, GObject)
+
+struct _TestMenuProvider
+{
+    GObject parent_instance;
+
+    const char *label;
+    guint n_calls;
+};
+
+static GList *
+test_menu_provider_get_items (TestMenuProvider *self)
+{
+    self->n_calls++;
+
+    return g_list_prepend (NULL, nautilus_menu_item_new (self->label, self->label,
+                                                         NULL, NULL));
+}
+
+static GList *
+test_menu_provider_get_file_items (NautilusMenuProvider *provider,
+                                   GtkWidget            *window,
+                                   GList                *files)
+{
+    return test_menu_provider_get_items (TEST_MENU_PROVIDER (provider));
+}
+
+static GList *
+test_menu_provider_get_background_items (NautilusMenuProvider *provider,
+                                         GtkWidget            *window,
+                                         NautilusFileInfo     *current_folder)
+{
+    return test_menu_provider_get_items (TEST_MENU_PROVIDER (provider));
+}
+
+static void
+test_menu_provider_iface_init (NautilusMenuProviderIface *iface)
+{
+    iface->get_file_items = test_menu_provider_get_file_items;
+    iface->get_background_items = test_menu_provider_get_background_items;
+}
+
+G_DEFINE_TYPE_WITH_CODE (TestMenuProvider, test_menu_provider, G_TYPE_OBJECT,
+                         G_IMPLEMENT_INTERFACE (NAUTILUS_TYPE_MENU_PROVIDER,
+                                                test_menu_provider_iface_init))
+
+static void
+test_menu_provider_class_init (TestMenuProviderClass *klass)
+{
+}
+
+static void
+test_menu_provider_init (TestMenuProvider *self)
+{
+    self->label = "first";
+}
+
+static char *
+get_only_item_name (GList *items)
+{
+    char *name;
+
+    g_assert_cmpuint (g_list_length (items), ==, 1);
+    g_object_get (items->data, "name", &name, NULL);
+    g_list_free_full (items, g_object_unref);
+
+    return name;
+}
+
+static void
+check_items_updated (gboolean background)
+{
+    NautilusMenuProviderCache *cache;
+    TestMenuProvider *provider;
+    GList *files;
+    char *name;
+
+    cache = nautilus_menu_provider_cache_new (background);
+    provider = g_object_new (TEST_TYPE_MENU_PROVIDER, NULL);
+    files = g_list_prepend (NULL, nautilus_file_get_by_uri ("file:///"));
+
+    name = get_only_item_name (nautilus_menu_provider_cache_get_items (cache,
+                                                                       NAUTILUS_MENU_PROVIDER (provider),
+                                                                       NULL, files));
+    g_assert_cmpstr (name, ==, "first");
+    g_free (name);
+
+    /* Same files, nothing changed: the provider isn't asked again */
+    name = get_only_item_name (nautilus_menu_provider_cache_get_items (cache,
+                                                                       NAUTILUS_MENU_PROVIDER (provider),
+                                                                       NULL, files));
+    g_assert_cmpstr (name, ==, "first");
+    g_assert_cmpuint (provider->n_calls, ==, 1);
+    g_free (name);
+
+    /* The provider changes its mind without any of the files changing */
+    provider->label = "second";
+    nautilus_menu_provider_emit_items_updated_signal (NAUTILUS_MENU_PROVIDER (provider));
+    g_assert_true (nautilus_menu_provider_cache_is_empty (cache));
+
+    name = get_only_item_name (nautilus_menu_provider_cache_get_items (cache,
+                                                                       NAUTILUS_MENU_PROVIDER (provider),
+                                                                       NULL, files));
+    g_assert_cmpstr (name, ==, "second");
+    g_assert_cmpuint (provider->n_calls, ==, 2);
+    g_free (name);
+
+    /* The cache lets go of the provider once it is freed */
+    nautilus_menu_provider_cache_free (cache);
+    g_object_add_weak_pointer (G_OBJECT (provider), (gpointer *) &provider);
+    g_object_unref (provider);
+    g_assert_null (provider);
+
+    nautilus_file_list_free (files);
+}
+
+static void
+test_file_items_updated (void)
+{
+    check_items_updated (FALSE);
+}
+
+static void
+test_background_items_updated (void)
+{
+    check_items_updated (TRUE);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+    g_test_init (&argc, &argv, NULL);
+
+    g_test_add_func ("/menu-provider-cache/file-items-updated",
+                     test_file_items_updated);
+    g_test_add_func ("/menu-provider-cache/background-items-updated",
+                     test_background_items_updated);
+
+    return g_test_run ();
+}
@@ -0,0 +1,126 @@
+#include <src/nautilus-module.h>
+#include <libnautilus-extension/nautilus-menu-provider.h>
+#include <libnautilus-extension/nautilus-column-provider.h>
+#include <gio/gio.h>
+#include <gmodule.h>
+#include <glib/gstdio.h>
+#include <stdlib.h>
+
+/* Times nautilus_module_setup() with N copies of a dummy extension
+ * installed, first without an extension manifest and then with the one
+ * the first run left behind, e.g.
+ *   test-nautilus-module-startup 200
+ * Each run happens in a fresh process, as a real startup would. */
+
+#define DEFAULT_N_MODULES 50
+
+static void
+run_child (void)
+{
+    GList *providers;
+    gint64 start, setup, lookup;
+
+    start = g_get_monotonic_time ();
+    nautilus_module_setup ();
+    setup = g_get_monotonic_time () - start;
+
+    /* Nothing implements this one, so nothing should get loaded */
+    start = g_get_monotonic_time ();
+    providers = nautilus_module_get_extensions_for_type (NAUTILUS_TYPE_COLUMN_PROVIDER);
+    nautilus_module_extension_list_free (providers);
+    lookup = g_get_monotonic_time () - start;
+
+    g_print ("  setup: %8.2f ms, column providers: %8.2f ms",
+             setup / 1000.0, lookup / 1000.0);
+
+    start = g_get_monotonic_time ();
+    providers = nautilus_module_get_extensions_for_type (NAUTILUS_TYPE_MENU_PROVIDER);
+    lookup = g_get_monotonic_time () - start;
+
+    g_print (", menu providers (%u): %8.2f ms\n",
+             g_list_length (providers), lookup / 1000.0);
+    nautilus_module_extension_list_free (providers);
+}
+
+static void
+spawn_child (const char *self,
+             const char *label)
+{
+    char *argv[] = { (char *) self, "--child", NULL };
+    GError *error = NULL;
+
+    g_print ("%s\n", label);
+    if (!g_spawn_sync (NULL, argv, NULL, G_SPAWN_DEFAULT,
+                       NULL, NULL, NULL, NULL, NULL, &error))
+    {
+        g_printerr ("Could not run %s: %s\n", self, error->message);
+        g_error_free (error);
+    }
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+    char *test_dir, *extension_dir, *cache_dir, *manifest;
+    char *source, *copy;
+    GFile *source_file, *copy_file;
+    int n_modules, i;
+
+    if (argc > 1 && g_strcmp0 (argv[1], "--child") == 0)
+    {
+        run_child ();
+        return 0;
+    }
+
+    n_modules = argc > 1 ? atoi (argv[1]) : DEFAULT_N_MODULES;
+
+    test_dir = g_dir_make_tmp ("nautilus-module-startup-XXXXXX", NULL);
+    extension_dir = g_build_filename (test_dir, "extensions", NULL);
+    cache_dir = g_build_filename (test_dir, "cache", NULL);
+    g_mkdir (extension_dir, 0700);
+
+    source = g_build_filename (DUMMY_EXTENSION_DIR,
+                               "libnautilus-dummy-extension." G_MODULE_SUFFIX, NULL);
+    source_file = g_file_new_for_path (source);
+
+    for (i = 0; i < n_modules; i++)
+    {
+        copy = g_strdup_printf ("%s/libdummy-%04d." G_MODULE_SUFFIX, extension_dir, i);
+        copy_file = g_file_new_for_path (copy);
+        g_file_copy (source_file, copy_file, G_FILE_COPY_NONE, NULL, NULL, NULL, NULL);
+        g_object_unref (copy_file);
+        g_free (copy);
+    }
+
+    g_setenv ("NAUTILUS_EXTENSION_DIR", extension_dir, TRUE);
+    g_setenv ("XDG_CACHE_HOME", cache_dir, TRUE);
+
+    g_print ("%d dummy extensions\n", n_modules);
+    spawn_child (argv[0], "no manifest:");
+    spawn_child (argv[0], "with manifest:");
+
+    for (i = 0; i < n_modules; i++)
+    {
+        copy = g_strdup_printf ("%s/libdummy-%04d." G_MODULE_SUFFIX, extension_dir, i);
+        g_unlink (copy);
+        g_free (copy);
+    }
+    manifest = g_build_filename (cache_dir, "nautilus", "extension-manifest", NULL);
+    g_unlink (manifest);
+    g_free (manifest);
+    manifest = g_build_filename (cache_dir, "nautilus", NULL);
+    g_rmdir (manifest);
+    g_free (manifest);
+    g_rmdir (cache_dir);
+    g_rmdir (extension_dir);
+    g_rmdir (test_dir);
+
+    g_object_unref (source_file);
+    g_free (source);
+    g_free (cache_dir);
+    g_free (extension_dir);
+    g_free (test_dir);
+
+    return 0;
+}
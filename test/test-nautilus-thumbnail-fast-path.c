@@ -0,0 +1,147 @@
+#define GNOME_DESKTOP_USE_UNSTABLE_API
+
+#include <src/nautilus-thumbnails.h>
+#include <libgnome-desktop/gnome-desktop-thumbnail.h>
+#include <gtk/gtk.h>
+
+/* Compares thumbnails/sec of the in-process fast path against the thumbnail
+ * factory on a directory of sample photos, e.g.
+ *   test-nautilus-thumbnail-fast-path ~/Pictures/camera-roll
+ * Nothing is written to the thumbnail cache. */
+
+#define THUMBNAIL_SIZE 256
+
+static GList *
+collect_sample_files (const char *path)
+{
+    GFile *directory;
+    GFileEnumerator *enumerator;
+    GFileInfo *info;
+    GList *samples;
+    GError *error;
+    const char *mime_type;
+
+    samples = NULL;
+    error = NULL;
+    directory = g_file_new_for_commandline_arg (path);
+    enumerator = g_file_enumerate_children (directory,
+                                            G_FILE_ATTRIBUTE_STANDARD_NAME ","
+                                            G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE,
+                                            0, NULL, &error);
+    if (enumerator == NULL)
+    {
+        g_printerr ("Could not list %s: %s\n", path, error->message);
+        g_error_free (error);
+        g_object_unref (directory);
+        return NULL;
+    }
+
+    while ((info = g_file_enumerator_next_file (enumerator, NULL, NULL)) != NULL)
+    {
+        mime_type = g_file_info_get_content_type (info);
+        if (nautilus_thumbnail_has_fast_path (mime_type))
+        {
+            samples = g_list_prepend (samples,
+                                      g_strdup (g_file_info_get_name (info)));
+        }
+        g_object_unref (info);
+    }
+
+    g_object_unref (enumerator);
+    g_object_unref (directory);
+
+    return g_list_reverse (samples);
+}
+
+static void
+run_benchmark (const char *path,
+               GList      *samples,
+               gboolean    fast_path)
+{
+    GnomeDesktopThumbnailFactory *factory;
+    GdkPixbuf *pixbuf;
+    GFile *file;
+    GTimer *timer;
+    GList *l;
+    char *uri, *mime_type, *full_path;
+    int made, failed;
+    double elapsed;
+
+    factory = gnome_desktop_thumbnail_factory_new (GNOME_DESKTOP_THUMBNAIL_SIZE_LARGE);
+    made = failed = 0;
+    timer = g_timer_new ();
+
+    for (l = samples; l != NULL; l = l->next)
+    {
+        full_path = g_build_filename (path, l->data, NULL);
+        file = g_file_new_for_commandline_arg (full_path);
+        uri = g_file_get_uri (file);
+        mime_type = g_content_type_guess (full_path, NULL, 0, NULL);
+
+        if (fast_path)
+        {
+            pixbuf = nautilus_thumbnail_generate_fast (uri, mime_type,
+                                                       THUMBNAIL_SIZE, NULL);
+        }
+        else
+        {
+            pixbuf = gnome_desktop_thumbnail_factory_generate_thumbnail (factory,
+                                                                         uri,
+                                                                         mime_type);
+        }
+
+        if (pixbuf != NULL)
+        {
+            made++;
+            g_object_unref (pixbuf);
+        }
+        else
+        {
+            failed++;
+        }
+
+        g_free (mime_type);
+        g_free (uri);
+        g_object_unref (file);
+        g_free (full_path);
+    }
+
+    elapsed = g_timer_elapsed (timer, NULL);
+    g_print ("%-10s %5d made, %5d failed, %8.3f s, %8.2f thumbnails/sec\n",
+             fast_path ? "fast path" : "factory",
+             made, failed, elapsed,
+             elapsed > 0 ? made / elapsed : 0.0);
+
+    g_timer_destroy (timer);
+    g_object_unref (factory);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+    GList *samples;
+
+    gtk_init (&argc, &argv);
+
+    if (argc != 2)
+    {
+        g_printerr ("Usage: %s DIRECTORY\n", argv[0]);
+        return 1;
+    }
+
+    samples = collect_sample_files (argv[1]);
+    if (samples == NULL)
+    {
+        g_printerr ("No JPEG or camera raw files in %s\n", argv[1]);
+        return 1;
+    }
+
+    g_print ("%d sample images\n", g_list_length (samples));
+    run_benchmark (argv[1], samples, FALSE);
+    run_benchmark (argv[1], samples, TRUE);
+
+    g_list_free_full (samples, g_free);
+
+    return 0;
+}